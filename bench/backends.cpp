@@ -0,0 +1,322 @@
+#include <tempest/server.hpp>
+#include <tempest/posix/posix_fs_directory.hpp>
+#include <tempest/posix/uring_server.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/placeholders.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if TEMPEST_USE_POSIX
+#	include <sys/resource.h>
+#	include <sys/wait.h>
+#	include <signal.h>
+#	include <unistd.h>
+#endif
+
+
+namespace tempest
+{
+	namespace bench
+	{
+#if TEMPEST_USE_POSIX
+		typedef boost::chrono::steady_clock clock;
+
+		struct backend_options
+		{
+			boost::uint16_t port;
+			unsigned connections;
+			unsigned seconds;
+			unsigned server_threads;
+			unsigned client_threads;
+			std::size_t file_size;
+		};
+
+		//Sends the next request on a persistent connection when the response
+		//to the previous one is complete.
+		struct connection TEMPEST_FINAL
+		        : boost::enable_shared_from_this<connection>
+		{
+			explicit connection(boost::asio::io_service &io_service,
+			                    std::string const &request,
+			                    clock::time_point end,
+			                    boost::uint64_t &completed,
+			                    boost::mutex &completed_mutex)
+			    : m_socket(io_service)
+			    , m_request(request)
+			    , m_end(end)
+			    , m_completed(completed)
+			    , m_completed_mutex(completed_mutex)
+			    , m_input(64 * 1024)
+			{
+			}
+
+			void start(boost::asio::ip::tcp::endpoint const &server)
+			{
+				m_socket.async_connect(server, boost::bind(
+				    &connection::handle_connected, shared_from_this(), boost::asio::placeholders::error));
+			}
+
+		private:
+
+			boost::asio::ip::tcp::socket m_socket;
+			std::string const &m_request;
+			clock::time_point const m_end;
+			boost::uint64_t &m_completed;
+			boost::mutex &m_completed_mutex;
+			std::string m_response;
+			std::vector<char> m_input;
+
+
+			void handle_connected(boost::system::error_code error)
+			{
+				if (!error)
+				{
+					send_request();
+				}
+			}
+
+			void send_request()
+			{
+				m_response.clear();
+				boost::asio::async_write(m_socket, boost::asio::buffer(m_request), boost::bind(
+				    &connection::handle_sent, shared_from_this(), boost::asio::placeholders::error));
+			}
+
+			void handle_sent(boost::system::error_code error)
+			{
+				if (!error)
+				{
+					receive();
+				}
+			}
+
+			void receive()
+			{
+				m_socket.async_read_some(boost::asio::buffer(m_input), boost::bind(
+				    &connection::handle_received, shared_from_this(),
+				    boost::asio::placeholders::error,
+				    boost::asio::placeholders::bytes_transferred));
+			}
+
+			void handle_received(boost::system::error_code error, std::size_t received)
+			{
+				if (error)
+				{
+					return;
+				}
+				m_response.append(m_input.data(), received);
+
+				std::size_t const header_end = m_response.find("\r\n\r\n");
+				std::size_t const length_begin = m_response.find("Content-Length: ");
+				if ((header_end == std::string::npos) ||
+				    (length_begin == std::string::npos))
+				{
+					return receive();
+				}
+				std::size_t const length_end = m_response.find('\r', length_begin);
+				std::size_t const body_length = boost::lexical_cast<std::size_t>(
+				            m_response.substr(length_begin + 16, length_end - length_begin - 16));
+				if (m_response.size() < (header_end + 4 + body_length))
+				{
+					return receive();
+				}
+
+				{
+					boost::mutex::scoped_lock const lock(m_completed_mutex);
+					++m_completed;
+				}
+				if (clock::now() < m_end)
+				{
+					send_request();
+				}
+			}
+		};
+
+		typedef void (*server_function)(boost::uint16_t,
+		                                boost::shared_ptr<directory>,
+		                                server_options const &);
+
+		//the server runs in a child process, so that it can be killed afterwards
+		pid_t start_server(server_function run,
+		                   boost::filesystem::path const &served,
+		                   backend_options const &options)
+		{
+			pid_t const child = fork();
+			if (child == 0)
+			{
+				server_options server;
+				server.thread_count = options.server_threads;
+				server.max_requests_per_connection = 1000 * 1000 * 1000;
+				boost::shared_ptr<posix::open_file_cache> const open_files =
+				        boost::make_shared<posix::open_file_cache>(posix::open_file_cache_options());
+				run(options.port,
+				    boost::make_shared<posix::file_system_directory>(
+				        served, boost::shared_ptr<posix::content_cache>(), open_files),
+				    server);
+				_exit(0);
+			}
+			return child;
+		}
+
+		//waits until the server accepts connections
+		bool wait_for_server(boost::asio::ip::tcp::endpoint const &server)
+		{
+			boost::asio::io_service io_service;
+			for (int i = 0; i < 100; ++i)
+			{
+				boost::asio::ip::tcp::socket socket(io_service);
+				boost::system::error_code error;
+				socket.connect(server, error);
+				if (!error)
+				{
+					return true;
+				}
+				boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+			}
+			return false;
+		}
+
+		double measure(server_function run,
+		               boost::filesystem::path const &served,
+		               backend_options const &options)
+		{
+			pid_t const server_process = start_server(run, served, options);
+			boost::asio::ip::tcp::endpoint const server(
+			            boost::asio::ip::address_v4::loopback(), options.port);
+			if (!wait_for_server(server))
+			{
+				kill(server_process, SIGKILL);
+				waitpid(server_process, 0, 0);
+				return 0;
+			}
+
+			std::string const request =
+			        "GET /file HTTP/1.1\r\n"
+			        "Host: 127.0.0.1\r\n"
+			        "\r\n";
+			boost::asio::io_service io_service;
+			boost::uint64_t completed = 0;
+			boost::mutex completed_mutex;
+			clock::time_point const started = clock::now();
+			clock::time_point const end = started + boost::chrono::seconds(options.seconds);
+			for (unsigned i = 0; i < options.connections; ++i)
+			{
+				boost::make_shared<connection>(boost::ref(io_service), boost::cref(request), end,
+				                               boost::ref(completed), boost::ref(completed_mutex))->start(server);
+			}
+
+			{
+				boost::thread_group workers;
+				for (unsigned i = 1; i < options.client_threads; ++i)
+				{
+					workers.create_thread(
+					    boost::bind(&boost::asio::io_service::run, &io_service));
+				}
+				io_service.run();
+				workers.join_all();
+			}
+			double const seconds =
+			        boost::chrono::duration_cast<boost::chrono::duration<double> >(clock::now() - started).count();
+
+			kill(server_process, SIGKILL);
+			waitpid(server_process, 0, 0);
+			return static_cast<double>(completed) / seconds;
+		}
+
+		//every connection needs a descriptor in both processes
+		void raise_descriptor_limit()
+		{
+			rlimit limit;
+			if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+			{
+				limit.rlim_cur = limit.rlim_max;
+				setrlimit(RLIMIT_NOFILE, &limit);
+			}
+		}
+#endif
+	}
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+#if TEMPEST_USE_POSIX
+	using namespace tempest::bench;
+
+	backend_options options;
+	options.port = 8090;
+	options.connections = 1000;
+	options.seconds = 5;
+	options.server_threads = 1;
+	options.client_threads = 1;
+	options.file_size = 4096;
+
+	po::options_description description("Compares the connection handling backends of tempestd "
+	                                    "with many persistent connections");
+	description.add_options()
+		("help,h", "produce help message to stdout and exit")
+		("port", po::value(&options.port), "the port of the servers (default: 8090)")
+		("connections,c", po::value(&options.connections), "the number of concurrent clients (default: 1000)")
+		("seconds,s", po::value(&options.seconds), "the duration of each measurement (default: 5)")
+		("server-threads", po::value(&options.server_threads), "the worker threads of the server (default: 1)")
+		("client-threads", po::value(&options.client_threads), "the threads sending requests (default: 1)")
+		("file-size", po::value(&options.file_size), "the size of the requested file in bytes (default: 4096)")
+		;
+
+	po::variables_map variables;
+	po::store(po::parse_command_line(argc, argv, description), variables);
+	po::notify(variables);
+
+	if (variables.count("help"))
+	{
+		std::cout << description << '\n';
+		return 0;
+	}
+
+	raise_descriptor_limit();
+
+	boost::filesystem::path const served =
+	        boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directories(served);
+	{
+		boost::filesystem::ofstream file(served / "file", std::ios::binary);
+		file << std::string(options.file_size, 'x');
+	}
+
+	std::cout << "connections:  " << options.connections << '\n'
+	          << "file size:    " << options.file_size << " bytes\n";
+	std::cout << "asio (epoll): " << measure(tempest::run_server, served, options) << " requests/sec\n";
+#if TEMPEST_USE_IO_URING
+	if (tempest::posix::is_uring_available())
+	{
+		++options.port;
+		std::cout << "io_uring:     " << measure(tempest::posix::run_uring_server, served, options) << " requests/sec\n";
+	}
+	else
+#endif
+	{
+		std::cout << "io_uring:     not available\n";
+	}
+
+	boost::filesystem::remove_all(served);
+	return 0;
+#else
+	(void)argc;
+	(void)argv;
+	std::cout << "This benchmark needs POSIX\n";
+	return 1;
+#endif
+}
@@ -0,0 +1,157 @@
+#ifndef TEMPEST_BENCH_HISTOGRAM_HPP
+#define TEMPEST_BENCH_HISTOGRAM_HPP
+
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+namespace tempest
+{
+	namespace bench
+	{
+		//Counts values in buckets whose width grows with the magnitude of the
+		//values like in an HDR histogram. Every power of two is divided into
+		//2^(precision_bits - 1) linear sub-buckets, so a percentile is off by
+		//less than 2^(1 - precision_bits) relative to the value. The memory
+		//does not depend on the number or the range of the values.
+		struct histogram
+		{
+			explicit histogram(unsigned precision_bits = 8)
+			    : m_precision_bits(precision_bits)
+			    , m_counts(bucket_count(precision_bits))
+			    , m_count(0)
+			    , m_min(std::numeric_limits<boost::uint64_t>::max())
+			    , m_max(0)
+			    , m_sum(0)
+			{
+				assert(precision_bits >= 2);
+				assert(precision_bits < 32);
+			}
+
+			void record(boost::uint64_t value)
+			{
+				++m_counts[index_of(value)];
+				++m_count;
+				m_min = (std::min)(m_min, value);
+				m_max = (std::max)(m_max, value);
+				m_sum += static_cast<double>(value);
+			}
+
+			void add(histogram const &other)
+			{
+				assert(other.m_precision_bits == m_precision_bits);
+				for (std::size_t i = 0; i < m_counts.size(); ++i)
+				{
+					m_counts[i] += other.m_counts[i];
+				}
+				m_count += other.m_count;
+				m_min = (std::min)(m_min, other.m_min);
+				m_max = (std::max)(m_max, other.m_max);
+				m_sum += other.m_sum;
+			}
+
+			boost::uint64_t count() const
+			{
+				return m_count;
+			}
+
+			boost::uint64_t min() const
+			{
+				return m_count ? m_min : 0;
+			}
+
+			boost::uint64_t max() const
+			{
+				return m_max;
+			}
+
+			double mean() const
+			{
+				return m_count ? (m_sum / static_cast<double>(m_count)) : 0.0;
+			}
+
+			//the largest value which is equivalent to the one below which
+			//the given percentage of the values lie
+			boost::uint64_t percentile(double percent) const
+			{
+				if (m_count == 0)
+				{
+					return 0;
+				}
+				boost::uint64_t const rank = (std::max)(static_cast<boost::uint64_t>(1),
+				    static_cast<boost::uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(m_count))));
+				boost::uint64_t seen = 0;
+				for (std::size_t i = 0; i < m_counts.size(); ++i)
+				{
+					seen += m_counts[i];
+					if (seen >= rank)
+					{
+						return (std::min)(highest_equivalent(i), m_max);
+					}
+				}
+				return m_max;
+			}
+
+		private:
+
+			unsigned m_precision_bits;
+			std::vector<boost::uint64_t> m_counts;
+			boost::uint64_t m_count;
+			boost::uint64_t m_min;
+			boost::uint64_t m_max;
+			double m_sum;
+
+
+			//The values below 2^precision_bits are counted exactly. Above that
+			//every power of two gets half as many buckets.
+			static std::size_t bucket_count(unsigned precision_bits)
+			{
+				std::size_t const exact = std::size_t(1) << precision_bits;
+				return exact + (64 - precision_bits) * (exact / 2);
+			}
+
+			static unsigned most_significant_bit(boost::uint64_t value)
+			{
+				unsigned bit = 0;
+				while (value >>= 1)
+				{
+					++bit;
+				}
+				return bit;
+			}
+
+			std::size_t index_of(boost::uint64_t value) const
+			{
+				std::size_t const exact = std::size_t(1) << m_precision_bits;
+				if (value < exact)
+				{
+					return static_cast<std::size_t>(value);
+				}
+				unsigned const shift = most_significant_bit(value) - m_precision_bits + 1;
+				std::size_t const mantissa = static_cast<std::size_t>(value >> shift);
+				return exact + (shift - 1) * (exact / 2) + (mantissa - exact / 2);
+			}
+
+			boost::uint64_t highest_equivalent(std::size_t index) const
+			{
+				std::size_t const exact = std::size_t(1) << m_precision_bits;
+				if (index < exact)
+				{
+					return index;
+				}
+				std::size_t const above = index - exact;
+				unsigned const shift = static_cast<unsigned>(above / (exact / 2)) + 1;
+				boost::uint64_t const mantissa = (above % (exact / 2)) + (exact / 2);
+				return ((mantissa + 1) << shift) - 1;
+			}
+		};
+	}
+}
+
+
+#endif
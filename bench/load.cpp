@@ -0,0 +1,788 @@
+#include "histogram.hpp"
+#include <tempest/server.hpp>
+#include <tempest/posix/posix_fs_directory.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/placeholders.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if TEMPEST_USE_POSIX
+#	include <sys/resource.h>
+#	include <sys/wait.h>
+#	include <signal.h>
+#	include <unistd.h>
+#endif
+
+
+namespace tempest
+{
+	namespace bench
+	{
+		typedef boost::chrono::steady_clock clock;
+
+		struct size_class
+		{
+			std::size_t size;
+			unsigned weight;
+		};
+
+		struct load_options
+		{
+			std::string host;
+			boost::uint16_t port;
+			std::vector<std::string> paths;
+			unsigned connections;
+			unsigned threads;
+			unsigned requests_per_connection;
+
+			//zero means that the requests per connection are counted instead
+			unsigned seconds;
+			bool keep_alive;
+
+			//a server started by the benchmark serves a generated file tree
+			std::string tempestd;
+			std::vector<std::string> server_arguments;
+			bool in_process;
+			unsigned server_threads;
+			unsigned file_count;
+			std::vector<size_class> sizes;
+
+			//the process whose RSS and CPU time are reported
+			boost::optional<int> server_pid;
+		};
+
+		//"1024:70,65536:25" means 70 parts files of 1 KiB, 25 parts 64 KiB
+		std::vector<size_class> parse_size_distribution(std::string const &description)
+		{
+			std::vector<std::string> entries;
+			boost::algorithm::split(entries, description, boost::algorithm::is_any_of(","));
+			std::vector<size_class> classes;
+			BOOST_FOREACH (std::string const &entry, entries)
+			{
+				std::size_t const colon = entry.find(':');
+				size_class parsed;
+				parsed.size = boost::lexical_cast<std::size_t>(entry.substr(0, colon));
+				parsed.weight = (colon == std::string::npos)
+				        ? 1
+				        : boost::lexical_cast<unsigned>(entry.substr(colon + 1));
+				classes.push_back(parsed);
+			}
+			return classes;
+		}
+
+		//a small deterministic generator, so that runs request the same files
+		struct xorshift
+		{
+			explicit xorshift(boost::uint64_t seed)
+			    : m_state(seed * 0x9E3779B97F4A7C15ull + 1)
+			{
+			}
+
+			boost::uint64_t next()
+			{
+				m_state ^= m_state << 13;
+				m_state ^= m_state >> 7;
+				m_state ^= m_state << 17;
+				return m_state;
+			}
+
+		private:
+
+			boost::uint64_t m_state;
+		};
+
+		//Writes file_count files into 16 sub-directories. The sizes are
+		//chosen with the weights of the distribution. Returns the request
+		//paths.
+		std::vector<std::string> generate_file_tree(boost::filesystem::path const &root,
+		                                            load_options const &options)
+		{
+			unsigned total_weight = 0;
+			BOOST_FOREACH (size_class const &size, options.sizes)
+			{
+				total_weight += size.weight;
+			}
+
+			std::vector<std::string> paths;
+			xorshift random(options.file_count);
+			std::string content;
+			for (unsigned i = 0; i < options.file_count; ++i)
+			{
+				unsigned chosen = static_cast<unsigned>(random.next() % total_weight);
+				std::size_t size = 0;
+				BOOST_FOREACH (size_class const &candidate, options.sizes)
+				{
+					size = candidate.size;
+					if (chosen < candidate.weight)
+					{
+						break;
+					}
+					chosen -= candidate.weight;
+				}
+
+				std::string const directory = "d" + boost::lexical_cast<std::string>(i % 16);
+				std::string const name = "f" + boost::lexical_cast<std::string>(i) + ".bin";
+				boost::filesystem::create_directories(root / directory);
+				content.resize(size);
+				for (std::size_t c = 0; c < size; ++c)
+				{
+					content[c] = static_cast<char>('a' + ((c + i) % 26));
+				}
+				boost::filesystem::ofstream file(root / directory / name, std::ios::binary);
+				file.write(content.data(), static_cast<std::streamsize>(content.size()));
+				paths.push_back("/" + directory + "/" + name);
+			}
+			return paths;
+		}
+
+		struct worker_result
+		{
+			histogram latencies_us;
+			boost::uint64_t connect_errors;
+			boost::uint64_t io_errors;
+			boost::uint64_t status_errors;
+
+			//503 responses of a server which sheds load are not errors,
+			//but they do not count as goodput either
+			boost::uint64_t shed;
+			boost::uint64_t bytes_received;
+
+			worker_result()
+			    : connect_errors(0)
+			    , io_errors(0)
+			    , status_errors(0)
+			    , shed(0)
+			    , bytes_received(0)
+			{
+			}
+
+			void add(worker_result const &other)
+			{
+				latencies_us.add(other.latencies_us);
+				connect_errors += other.connect_errors;
+				io_errors += other.io_errors;
+				status_errors += other.status_errors;
+				shed += other.shed;
+				bytes_received += other.bytes_received;
+			}
+
+			boost::uint64_t errors() const
+			{
+				return connect_errors + io_errors + status_errors;
+			}
+		};
+
+		//the connections of a thread share an io_service and a result
+		struct worker
+		{
+			load_options const &options;
+			boost::asio::ip::tcp::endpoint server;
+			clock::time_point deadline;
+			boost::asio::io_service io_service;
+			worker_result result;
+
+			worker(load_options const &options,
+			       boost::asio::ip::tcp::endpoint const &server,
+			       clock::time_point deadline)
+			    : options(options)
+			    , server(server)
+			    , deadline(deadline)
+			{
+			}
+		};
+
+		//Requests random paths one after another. Without keep-alive every
+		//request has a connection of its own and the latency includes the
+		//connect. After a 503 response the client waits as long as the
+		//Retry-After header asks before it connects again.
+		struct connection TEMPEST_FINAL
+		        : boost::enable_shared_from_this<connection>
+		{
+			explicit connection(worker &worker, unsigned index)
+			    : m_worker(worker)
+			    , m_socket(worker.io_service)
+			    , m_retry(worker.io_service)
+			    , m_connected(false)
+			    , m_sent(0)
+			    , m_random(index)
+			    , m_input(64 * 1024)
+			{
+			}
+
+			void start()
+			{
+				next();
+			}
+
+		private:
+
+			worker &m_worker;
+			boost::asio::ip::tcp::socket m_socket;
+			boost::asio::deadline_timer m_retry;
+			bool m_connected;
+			unsigned m_sent;
+			xorshift m_random;
+			std::string m_request;
+			std::string m_response;
+			std::vector<char> m_input;
+			clock::time_point m_started;
+
+
+			void next()
+			{
+				load_options const &options = m_worker.options;
+				bool const more = options.seconds
+				        ? (clock::now() < m_worker.deadline)
+				        : (m_sent < options.requests_per_connection);
+				if (!more)
+				{
+					return close();
+				}
+				++m_sent;
+
+				m_started = clock::now();
+				if (m_connected)
+				{
+					return send_request();
+				}
+				m_socket.async_connect(m_worker.server, boost::bind(
+				    &connection::handle_connected, shared_from_this(), boost::asio::placeholders::error));
+			}
+
+			void handle_connected(boost::system::error_code error)
+			{
+				if (error)
+				{
+					++m_worker.result.connect_errors;
+					close();
+					return next();
+				}
+				m_connected = true;
+				send_request();
+			}
+
+			void send_request()
+			{
+				load_options const &options = m_worker.options;
+				std::string const &path = options.paths[m_random.next() % options.paths.size()];
+				m_request = "GET " + path + " HTTP/1.1\r\n"
+				            "Host: " + options.host + "\r\n" +
+				            (options.keep_alive ? "" : "Connection: close\r\n") +
+				            "\r\n";
+				m_response.clear();
+				boost::asio::async_write(m_socket, boost::asio::buffer(m_request), boost::bind(
+				    &connection::handle_sent, shared_from_this(), boost::asio::placeholders::error));
+			}
+
+			void handle_sent(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return fail();
+				}
+				receive();
+			}
+
+			void receive()
+			{
+				m_socket.async_read_some(boost::asio::buffer(m_input), boost::bind(
+				    &connection::handle_received, shared_from_this(),
+				    boost::asio::placeholders::error,
+				    boost::asio::placeholders::bytes_transferred));
+			}
+
+			void handle_received(boost::system::error_code error, std::size_t received)
+			{
+				m_response.append(m_input.data(), received);
+
+				std::size_t const header_end = m_response.find("\r\n\r\n");
+				if (header_end == std::string::npos)
+				{
+					return error ? fail() : receive();
+				}
+
+				//without a Content-Length the body ends with the connection
+				std::string const header = m_response.substr(0, header_end + 2);
+				boost::optional<std::size_t> const body_length = header_number(header, "Content-Length");
+				bool const complete = body_length
+				        ? (m_response.size() >= (header_end + 4 + *body_length))
+				        : (error == boost::asio::error::eof);
+				if (!complete)
+				{
+					return error ? fail() : receive();
+				}
+
+				worker_result &result = m_worker.result;
+				result.latencies_us.record(static_cast<boost::uint64_t>(
+				    boost::chrono::duration_cast<boost::chrono::microseconds>(clock::now() - m_started).count()));
+				result.bytes_received += m_response.size();
+				if (is_unavailable(header))
+				{
+					++result.shed;
+					close();
+					return retry_later(header_number(header, "Retry-After").get_value_or(0));
+				}
+				if (!is_success(header))
+				{
+					++result.status_errors;
+				}
+
+				if (!m_worker.options.keep_alive ||
+				    (header.find("Connection: close\r\n") != std::string::npos) ||
+				    error)
+				{
+					close();
+				}
+				next();
+			}
+
+			//a timed run is not extended by the wait
+			void retry_later(std::size_t seconds)
+			{
+				clock::duration delay = boost::chrono::seconds(seconds);
+				if (m_worker.options.seconds)
+				{
+					delay = (std::min)(delay, m_worker.deadline - clock::now());
+				}
+				m_retry.expires_from_now(boost::posix_time::microseconds(
+				    boost::chrono::duration_cast<boost::chrono::microseconds>(delay).count()));
+				m_retry.async_wait(boost::bind(&connection::next, shared_from_this()));
+			}
+
+			void fail()
+			{
+				++m_worker.result.io_errors;
+				close();
+				next();
+			}
+
+			void close()
+			{
+				boost::system::error_code ignored;
+				m_socket.close(ignored);
+				m_connected = false;
+			}
+
+			static boost::optional<std::size_t> header_number(std::string const &header, char const *name)
+			{
+				std::string const prefix = std::string("\r\n") + name + ": ";
+				std::size_t const begin = header.find(prefix);
+				if (begin == std::string::npos)
+				{
+					return boost::none;
+				}
+				std::size_t const value = begin + prefix.size();
+				return boost::lexical_cast<std::size_t>(
+				    header.substr(value, header.find('\r', value) - value));
+			}
+
+			static bool is_success(std::string const &header)
+			{
+				//2xx and 3xx
+				return (header.size() > 9) && ((header[9] == '2') || (header[9] == '3'));
+			}
+
+			static bool is_unavailable(std::string const &header)
+			{
+				return header.compare(0, 13, "HTTP/1.1 503 ") == 0;
+			}
+		};
+
+		void run_worker(worker &worker, unsigned first_connection, unsigned connection_count)
+		{
+			for (unsigned i = 0; i < connection_count; ++i)
+			{
+				boost::make_shared<connection>(boost::ref(worker), first_connection + i)->start();
+			}
+			worker.io_service.run();
+		}
+
+#if TEMPEST_USE_POSIX
+		struct process_usage
+		{
+			double cpu_seconds;
+			boost::uint64_t rss_kib;
+			boost::uint64_t peak_rss_kib;
+
+			process_usage()
+			    : cpu_seconds(0)
+			    , rss_kib(0)
+			    , peak_rss_kib(0)
+			{
+			}
+		};
+
+		boost::uint64_t read_status_kib(std::string const &status, std::string const &name)
+		{
+			std::size_t const begin = status.find(name);
+			if (begin == std::string::npos)
+			{
+				return 0;
+			}
+			std::istringstream value(status.substr(begin + name.size()));
+			boost::uint64_t kib = 0;
+			value >> kib;
+			return kib;
+		}
+
+		//from /proc, so this is only available on Linux
+		boost::optional<process_usage> get_process_usage(int pid)
+		{
+			std::string const directory = "/proc/" + boost::lexical_cast<std::string>(pid);
+			std::ifstream stat_file((directory + "/stat").c_str());
+			std::string stat;
+			if (!std::getline(stat_file, stat))
+			{
+				return boost::none;
+			}
+
+			//utime and stime are the 14th and 15th fields. The name in
+			//parentheses may contain spaces.
+			std::istringstream fields(stat.substr(stat.rfind(')') + 2));
+			std::string field;
+			for (int i = 3; i < 14; ++i)
+			{
+				fields >> field;
+			}
+			unsigned long user_ticks = 0;
+			unsigned long system_ticks = 0;
+			fields >> user_ticks >> system_ticks;
+
+			std::ifstream status_file((directory + "/status").c_str());
+			std::string const status((std::istreambuf_iterator<char>(status_file)),
+			                         std::istreambuf_iterator<char>());
+
+			process_usage usage;
+			usage.cpu_seconds = static_cast<double>(user_ticks + system_ticks) /
+			                    static_cast<double>(sysconf(_SC_CLK_TCK));
+			usage.rss_kib = read_status_kib(status, "VmRSS:");
+			usage.peak_rss_kib = read_status_kib(status, "VmHWM:");
+			return usage;
+		}
+
+		int start_tempestd(load_options const &options, boost::filesystem::path const &served)
+		{
+			std::string const port = boost::lexical_cast<std::string>(options.port);
+			std::string const threads = boost::lexical_cast<std::string>(options.server_threads);
+			std::string const dir = served.string();
+			std::vector<char const *> arguments;
+			arguments.push_back(options.tempestd.c_str());
+			char const * const fixed[] =
+			{
+			    "--dir", dir.c_str(),
+			    "--port", port.c_str(),
+			    "--threads", threads.c_str(),
+			    "--max-requests", "1000000000"
+			};
+			arguments.insert(arguments.end(), fixed, fixed + (sizeof(fixed) / sizeof(fixed[0])));
+			BOOST_FOREACH (std::string const &argument, options.server_arguments)
+			{
+				arguments.push_back(argument.c_str());
+			}
+			arguments.push_back(0);
+			pid_t const child = fork();
+			if (child == 0)
+			{
+				execv(options.tempestd.c_str(), const_cast<char * const *>(arguments.data()));
+				std::cerr << "Could not start " << options.tempestd << '\n';
+				_exit(1);
+			}
+			return child;
+		}
+
+		int start_in_process_server(load_options const &options, boost::filesystem::path const &served)
+		{
+			pid_t const child = fork();
+			if (child == 0)
+			{
+				//like tempestd
+				signal(SIGPIPE, SIG_IGN);
+				server_options server;
+				server.thread_count = options.server_threads;
+				server.max_requests_per_connection = 1000 * 1000 * 1000;
+				run_server(options.port,
+				           boost::make_shared<posix::file_system_directory>(
+				               served,
+				               boost::shared_ptr<posix::content_cache>(),
+				               boost::make_shared<posix::open_file_cache>(posix::open_file_cache_options())),
+				           server);
+				_exit(0);
+			}
+			return child;
+		}
+
+		void stop_server(int pid)
+		{
+			kill(pid, SIGTERM);
+			waitpid(pid, 0, 0);
+		}
+
+		//every connection needs a descriptor
+		void raise_descriptor_limit()
+		{
+			rlimit limit;
+			if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+			{
+				limit.rlim_cur = limit.rlim_max;
+				setrlimit(RLIMIT_NOFILE, &limit);
+			}
+		}
+#endif
+
+		bool wait_for_server(boost::asio::ip::tcp::endpoint const &server)
+		{
+			boost::asio::io_service io_service;
+			for (int i = 0; i < 200; ++i)
+			{
+				boost::asio::ip::tcp::socket socket(io_service);
+				boost::system::error_code error;
+				socket.connect(server, error);
+				if (!error)
+				{
+					return true;
+				}
+				boost::this_thread::sleep(boost::posix_time::milliseconds(25));
+			}
+			return false;
+		}
+
+		std::string json_string(std::string const &value)
+		{
+			std::string escaped = "\"";
+			BOOST_FOREACH (char c, value)
+			{
+				if ((c == '"') || (c == '\\'))
+				{
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped + "\"";
+		}
+	}
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+	using namespace tempest::bench;
+
+	load_options options;
+	options.host = "127.0.0.1";
+	options.port = 8080;
+	options.connections = 64;
+	options.threads = 1;
+	options.requests_per_connection = 1000;
+	options.seconds = 0;
+	options.in_process = false;
+	options.server_threads = 1;
+	options.file_count = 1000;
+	std::string sizes = "1024:60,16384:30,262144:9,4194304:1";
+	std::string json_file;
+	int server_pid = 0;
+
+	po::options_description description("Tempest HTTP load generator options");
+	description.add_options()
+		("help,h", "produce help message to stdout and exit")
+		("host", po::value(&options.host), "the IPv4 address of the server (default: 127.0.0.1)")
+		("port", po::value(&options.port), "the port of the server (default: 8080)")
+		("path", po::value(&options.paths), "a requested path, can be repeated (default: /)")
+		("connections,c", po::value(&options.connections), "the number of concurrent clients (default: 64)")
+		("threads,t", po::value(&options.threads), "the threads sending the requests (default: 1)")
+		("requests,n", po::value(&options.requests_per_connection), "the number of requests per client (default: 1000)")
+		("seconds,s", po::value(&options.seconds), "run for this many seconds instead of a number of requests")
+		("keep-alive,k", "send all requests of a client on one persistent connection")
+		("tempestd", po::value(&options.tempestd), "start this tempestd executable on the port")
+		("server-arg", po::value(&options.server_arguments),
+		 "an additional argument for the started tempestd like --max-connections=64, can be repeated")
+		("in-process", "start the server in a child process of the benchmark")
+		("server-threads", po::value(&options.server_threads), "the worker threads of a started server (default: 1)")
+		("files", po::value(&options.file_count), "the number of files generated for a started server (default: 1000)")
+		("sizes", po::value(&sizes), ("the distribution of file sizes as size:weight,... (default: " + sizes + ")").c_str())
+		("server-pid", po::value(&server_pid), "report the RSS and CPU time of this process")
+		("json", po::value(&json_file), "write the results as JSON to this file")
+		;
+
+	po::variables_map variables;
+	po::store(po::parse_command_line(argc, argv, description), variables);
+	po::notify(variables);
+
+	if (variables.count("help"))
+	{
+		std::cout << description << '\n';
+		return 0;
+	}
+
+	if ((options.connections < 1) || (options.threads < 1))
+	{
+		std::cout << "'connections' and 'threads' have to be at least 1\n";
+		return 1;
+	}
+
+	options.keep_alive = variables.count("keep-alive") > 0;
+	options.in_process = variables.count("in-process") > 0;
+	options.sizes = parse_size_distribution(sizes);
+	if (server_pid > 0)
+	{
+		options.server_pid = server_pid;
+	}
+
+	boost::asio::ip::tcp::endpoint const server(
+	            boost::asio::ip::address::from_string(options.host), options.port);
+
+	bool const start_server = options.in_process || !options.tempestd.empty();
+	boost::filesystem::path served;
+	if (start_server)
+	{
+#if TEMPEST_USE_POSIX
+		served = boost::filesystem::temp_directory_path() /
+		         boost::filesystem::unique_path("tempest-bench-%%%%-%%%%");
+		options.paths = generate_file_tree(served, options);
+		options.server_pid = options.in_process
+		        ? start_in_process_server(options, served)
+		        : start_tempestd(options, served);
+		if (!wait_for_server(server))
+		{
+			std::cerr << "The server does not accept connections\n";
+			stop_server(*options.server_pid);
+			boost::filesystem::remove_all(served);
+			return 1;
+		}
+#else
+		std::cerr << "Starting a server needs POSIX\n";
+		return 1;
+#endif
+	}
+	else if (options.paths.empty())
+	{
+		options.paths.push_back("/");
+	}
+
+#if TEMPEST_USE_POSIX
+	raise_descriptor_limit();
+	boost::optional<process_usage> const usage_before =
+	        options.server_pid ? get_process_usage(*options.server_pid) : boost::none;
+#endif
+
+	clock::time_point const started = clock::now();
+	std::vector<boost::shared_ptr<worker> > workers;
+	{
+		boost::thread_group threads;
+		unsigned first_connection = 0;
+		for (unsigned i = 0; i < options.threads; ++i)
+		{
+			//the connections are distributed evenly
+			unsigned const connection_count = (options.connections / options.threads) +
+			                                  ((i < (options.connections % options.threads)) ? 1 : 0);
+			workers.push_back(boost::make_shared<worker>(
+			    boost::cref(options), boost::cref(server), started + boost::chrono::seconds(options.seconds)));
+			threads.create_thread(boost::bind(run_worker, boost::ref(*workers.back()),
+			                                  first_connection, connection_count));
+			first_connection += connection_count;
+		}
+		threads.join_all();
+	}
+	double const seconds =
+	        boost::chrono::duration_cast<boost::chrono::duration<double> >(clock::now() - started).count();
+
+	worker_result total;
+	BOOST_FOREACH (boost::shared_ptr<worker> const &worker, workers)
+	{
+		total.add(worker->result);
+	}
+	histogram const &latencies = total.latencies_us;
+	double const requests_per_second = static_cast<double>(latencies.count()) / seconds;
+	double const goodput = static_cast<double>(latencies.count() - total.shed - total.status_errors) / seconds;
+	double const bytes_per_second = static_cast<double>(total.bytes_received) / seconds;
+
+	std::cout << "requests:       " << latencies.count() << '\n'
+	          << "errors:         " << total.errors()
+	          << " (connect " << total.connect_errors
+	          << ", io " << total.io_errors
+	          << ", status " << total.status_errors << ")\n"
+	          << "shed (503):     " << total.shed << '\n'
+	          << "duration:       " << seconds << " s\n"
+	          << "requests/sec:   " << requests_per_second << '\n'
+	          << "goodput/sec:    " << goodput << '\n'
+	          << "received/sec:   " << (bytes_per_second / (1024 * 1024)) << " MiB\n"
+	          << "latency mean:   " << latencies.mean() << " us\n"
+	          << "latency p50:    " << latencies.percentile(50) << " us\n"
+	          << "latency p90:    " << latencies.percentile(90) << " us\n"
+	          << "latency p99:    " << latencies.percentile(99) << " us\n"
+	          << "latency p99.9:  " << latencies.percentile(99.9) << " us\n"
+	          << "latency max:    " << latencies.max() << " us\n";
+
+	std::ostringstream server_json;
+#if TEMPEST_USE_POSIX
+	boost::optional<process_usage> const usage_after =
+	        options.server_pid ? get_process_usage(*options.server_pid) : boost::none;
+	if (usage_before && usage_after)
+	{
+		double const cpu_seconds = usage_after->cpu_seconds - usage_before->cpu_seconds;
+		std::cout << "server CPU:     " << cpu_seconds << " s ("
+		          << (100.0 * cpu_seconds / seconds) << " %)\n"
+		          << "server RSS:     " << usage_after->rss_kib << " KiB (peak "
+		          << usage_after->peak_rss_kib << " KiB)\n";
+		server_json << ",\n  \"server\": {\"cpu_seconds\": " << cpu_seconds
+		            << ", \"cpu_percent\": " << (100.0 * cpu_seconds / seconds)
+		            << ", \"rss_kib\": " << usage_after->rss_kib
+		            << ", \"peak_rss_kib\": " << usage_after->peak_rss_kib << "}";
+	}
+	if (start_server)
+	{
+		stop_server(*options.server_pid);
+		boost::filesystem::remove_all(served);
+	}
+#endif
+
+	if (!json_file.empty())
+	{
+		std::ofstream json(json_file.c_str());
+		json << "{\n"
+		     << "  \"options\": {\"connections\": " << options.connections
+		     << ", \"threads\": " << options.threads
+		     << ", \"keep_alive\": " << (options.keep_alive ? "true" : "false")
+		     << ", \"paths\": " << options.paths.size()
+		     << ", \"sizes\": " << json_string(sizes) << "},\n"
+		     << "  \"requests\": " << latencies.count() << ",\n"
+		     << "  \"errors\": {\"connect\": " << total.connect_errors
+		     << ", \"io\": " << total.io_errors
+		     << ", \"status\": " << total.status_errors << "},\n"
+		     << "  \"shed\": " << total.shed << ",\n"
+		     << "  \"duration_seconds\": " << seconds << ",\n"
+		     << "  \"requests_per_second\": " << requests_per_second << ",\n"
+		     << "  \"goodput_per_second\": " << goodput << ",\n"
+		     << "  \"bytes_per_second\": " << bytes_per_second << ",\n"
+		     << "  \"latency_us\": {\"mean\": " << latencies.mean()
+		     << ", \"min\": " << latencies.min()
+		     << ", \"p50\": " << latencies.percentile(50)
+		     << ", \"p90\": " << latencies.percentile(90)
+		     << ", \"p99\": " << latencies.percentile(99)
+		     << ", \"p99.9\": " << latencies.percentile(99.9)
+		     << ", \"max\": " << latencies.max() << "}"
+		     << server_json.str() << "\n"
+		     << "}\n";
+	}
+	return (total.errors() == 0) ? 0 : 1;
+}
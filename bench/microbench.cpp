@@ -0,0 +1,557 @@
+#include "http/arena.hpp"
+#include "http/http_request.hpp"
+#include "http/request_parser.hpp"
+#include "http/http_response.hpp"
+#include "http/response_writer.hpp"
+#include "http/decode_uri.hpp"
+#include "http/scan.hpp"
+#include <tempest/access_log.hpp>
+#include <tempest/archive.hpp>
+#include <tempest/memory_client.hpp>
+#include <tempest/metrics.hpp>
+#include <tempest/portable_fs_directory.hpp>
+#include <tempest/posix/archive_directory.hpp>
+#include <tempest/posix/posix_fs_directory.hpp>
+#include <tempest/responses.hpp>
+#include <tempest/router.hpp>
+#include <tempest/server.hpp>
+#include <tempest/timer_wheel.hpp>
+#include <tempest/virtual_directory.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+
+//Every allocation of the process is counted, so that the allocations per
+//operation can be reported. The benchmark is single-threaded.
+namespace
+{
+	std::size_t allocation_count;
+}
+
+void *operator new(std::size_t size)
+{
+	++allocation_count;
+	void * const memory = std::malloc(size ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void *memory) throw()
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) throw()
+{
+	std::free(memory);
+}
+
+
+namespace tempest
+{
+	namespace bench
+	{
+		typedef boost::chrono::steady_clock clock;
+
+		//prevents the compiler from removing the measured work
+		volatile std::size_t sink;
+
+		template <class Function>
+		void measure(char const *name, std::size_t iterations, Function function)
+		{
+			std::size_t const allocations_before = allocation_count;
+			clock::time_point const started = clock::now();
+			for (std::size_t i = 0; i < iterations; ++i)
+			{
+				sink = function();
+			}
+			double const seconds = boost::chrono::duration_cast<
+			        boost::chrono::duration<double> >(clock::now() - started).count();
+			double const allocations =
+			        static_cast<double>(allocation_count - allocations_before) / iterations;
+
+			std::cout << name << ": "
+			          << (seconds * 1e9 / iterations) << " ns/op, "
+			          << static_cast<std::size_t>(iterations / seconds) << " op/s, "
+			          << allocations << " allocations/op\n";
+		}
+
+		//a request head as sent by a typical browser
+		std::string const browser_request =
+		        "GET /static/css/site.css?v=20131027 HTTP/1.1\r\n"
+		        "Host: www.example.com\r\n"
+		        "Connection: keep-alive\r\n"
+		        "Accept: text/css,*/*;q=0.1\r\n"
+		        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/30.0.1599.101 Safari/537.36\r\n"
+		        "Referer: http://www.example.com/\r\n"
+		        "Accept-Encoding: gzip,deflate,sdch\r\n"
+		        "Accept-Language: en-US,en;q=0.8\r\n"
+		        "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; tracking=a1b2c3d4e5f6\r\n"
+		        "\r\n";
+
+		struct parse_istream
+		{
+			std::size_t operator ()() const
+			{
+				std::istringstream source(browser_request);
+				return parse_request(source).headers.size();
+			}
+		};
+
+		//an application behind the server with many cookies
+		std::string const cookie_request =
+		        "GET /app/dashboard HTTP/1.1\r\n"
+		        "Host: www.example.com\r\n"
+		        "Cookie: " + std::string(2000, 'c') + "\r\n"
+		        "Accept-Encoding: gzip\r\n"
+		        "\r\n";
+
+		struct parse_buffer
+		{
+			request_parser *parser;
+			std::string const *head;
+
+			std::size_t operator ()() const
+			{
+				parser->reset();
+				parser->parse(head->data(), head->size());
+				return parser->request().headers.size();
+			}
+		};
+
+		struct parse_buffer_to_request
+		{
+			request_parser *parser;
+
+			std::size_t operator ()() const
+			{
+				parser->reset();
+				parser->parse(browser_request.data(), browser_request.size());
+				return make_request(parser->request()).headers.size();
+			}
+		};
+
+		//what a connection does for every request
+		struct parse_buffer_into_arena
+		{
+			request_parser *parser;
+			arena *memory;
+			http_request *request;
+
+			std::size_t operator ()() const
+			{
+				parser->reset();
+				parser->parse(browser_request.data(), browser_request.size());
+				request->headers.clear();
+				memory->reset();
+				make_request(parser->request(), *request);
+				return request->headers.size();
+			}
+		};
+
+		//the way a file response header used to be rendered
+		struct render_with_map
+		{
+			std::size_t operator ()() const
+			{
+				http_response response;
+				response.version = "HTTP/1.1";
+				response.status = 200;
+				response.reason = "OK";
+				response.headers["Content-Length"] = boost::lexical_cast<std::string>(123456u);
+				response.headers["Connection"] = "keep-alive";
+				std::ostringstream rendered;
+				print_response(response, rendered);
+				return rendered.str().size();
+			}
+		};
+
+		struct render_with_writer
+		{
+			std::string *buffer;
+
+			std::size_t operator ()() const
+			{
+				buffer->clear();
+				response_writer writer(*buffer);
+				writer.status_line("HTTP/1.1", 200, "OK");
+				writer.header("Content-Length", static_cast<boost::uint64_t>(123456u));
+				writer.header("Connection", "keep-alive");
+				writer.end();
+				return buffer->size();
+			}
+		};
+
+		struct decode_path
+		{
+			std::string const *encoded;
+
+			std::size_t operator ()() const
+			{
+				std::string uri = *encoded;
+				decode_uri(uri);
+				return uri.size();
+			}
+		};
+
+		//the generic version which works on any iterators
+		struct decode_path_generic
+		{
+			std::string const *encoded;
+
+			std::size_t operator ()() const
+			{
+				std::string uri = *encoded;
+				uri.erase(decode_uri(uri.begin(), uri.end(), uri.begin()), uri.end());
+				return uri.size();
+			}
+		};
+
+		template <char const *(*Find)(char const *, char const *, char, char, char, char)>
+		struct find_delimiter
+		{
+			std::string const *text;
+
+			std::size_t operator ()() const
+			{
+				return static_cast<std::size_t>(
+				            Find(text->data(), text->data() + text->size(), '\r', '\n', ':', ' ') - text->data());
+			}
+		};
+
+		struct complete_path
+		{
+			boost::filesystem::path const *top;
+
+			std::size_t operator ()() const
+			{
+				return complete_served_path(*top, "/static/css/site.css")->native().size();
+			}
+		};
+
+		//isolates the dispatch of the virtual_directory
+		struct empty_directory : directory
+		{
+			virtual void respond(http_request const &,
+			                     boost::string_ref,
+			                     sender &) TEMPEST_OVERRIDE
+			{
+			}
+		};
+
+		directory *map_static(directory *static_dir, std::string const &name)
+		{
+			return (name == "static") ? static_dir : 0;
+		}
+
+		struct respond_with
+		{
+			directory *served;
+			http_request const *request;
+			memory_client *client;
+
+			std::size_t operator ()() const
+			{
+				client->clear_output();
+				served->respond(*request, request->file, client->get_sender());
+				return client->output().size();
+			}
+		};
+
+		void ignore_result(boost::system::error_code)
+		{
+		}
+
+		struct async_respond_with
+		{
+			directory *served;
+			http_request const *request;
+			memory_client *client;
+
+			std::size_t operator ()() const
+			{
+				client->clear_output();
+				served->async_respond(*request, request->file, client->get_async_sender(), ignore_result);
+				client->poll();
+				return client->output().size();
+			}
+		};
+
+		//the whole way of a request through the server without the network
+		struct serve_request
+		{
+			boost::shared_ptr<directory> served;
+			std::string const *request;
+			server_options const *options;
+
+			std::size_t operator ()() const
+			{
+				boost::shared_ptr<memory_client> const client = boost::make_shared<memory_client>();
+				client->feed(*request);
+				serve_client(client, served, *options);
+				client->poll();
+				return client->output().size();
+			}
+		};
+
+		//what the server records for a request with metrics enabled
+		struct record_request
+		{
+			tempest::metrics *metrics;
+
+			std::size_t operator ()() const
+			{
+				boost::chrono::steady_clock::time_point const begin = boost::chrono::steady_clock::now();
+				metrics->add(tempest::request_counter);
+				metrics->record(tempest::parse_phase, boost::chrono::steady_clock::now() - begin);
+				metrics->record(tempest::lookup_phase, boost::chrono::steady_clock::now() - begin);
+				metrics->count_status(200);
+				metrics->record(tempest::send_phase, boost::chrono::steady_clock::now() - begin);
+				metrics->add(tempest::sent_bytes_counter, 1000);
+				return 1;
+			}
+		};
+
+		struct log_request
+		{
+			tempest::access_log *log;
+
+			std::size_t operator ()() const
+			{
+				log->log_request("GET", "/static/css/site.css", 200, 1234,
+				                 boost::chrono::microseconds(50));
+				return 1;
+			}
+		};
+
+		bool keep_running()
+		{
+			return true;
+		}
+
+		//what a connection does on every receive and send
+		struct restart_timer
+		{
+			tempest::wheel_timer *timer;
+
+			std::size_t operator ()() const
+			{
+				timer->start(boost::chrono::seconds(10));
+				timer->stop();
+				return 1;
+			}
+		};
+
+		http_request make_get_request(std::string const &path)
+		{
+			request_parser parser;
+			std::string const head = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+			parser.parse(head.data(), head.size());
+			return make_request(parser.request());
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	using namespace tempest::bench;
+
+	std::size_t const iterations = (argc >= 2)
+	        ? boost::lexical_cast<std::size_t>(argv[1])
+	        : 1000000;
+
+	using tempest::memory_client;
+	using tempest::virtual_directory;
+	using tempest::http_request;
+
+	tempest::request_parser parser;
+
+	measure("parse_request(istream)", iterations, parse_istream());
+
+	parse_buffer const buffer = {&parser, &browser_request};
+	measure("request_parser", iterations, buffer);
+
+	parse_buffer const cookie_buffer = {&parser, &cookie_request};
+	measure("request_parser (2 KB cookie)", iterations, cookie_buffer);
+
+	parse_buffer_to_request const to_request = {&parser};
+	measure("request_parser + make_request", iterations, to_request);
+
+	{
+		tempest::arena memory;
+		http_request reused(memory);
+		parse_buffer_into_arena const into_arena = {&parser, &memory, &reused};
+		measure("request_parser + make_request (reused, arena)", iterations, into_arena);
+		std::cout << "  " << (memory.statistics().allocations / iterations) << " allocations of "
+		          << (memory.statistics().allocated_bytes / iterations) << " bytes per request in "
+		          << memory.statistics().chunks << " chunks\n";
+	}
+
+	measure("response header: map + ostream", iterations, render_with_map());
+
+	std::string header;
+	render_with_writer const writer = {&header};
+	measure("response header: response_writer", iterations, writer);
+
+	std::string const short_uri = "/static/some%20file%2Bname.css";
+	std::string const query_uri = "/search?" + std::string(500, 'q') + "&page=2";
+	std::string const escaped_uri = "/search?q=" + std::string(200, 'q') + "%20" + std::string(200, 'r');
+	decode_path const decode_short = {&short_uri};
+	measure("decode_uri", iterations, decode_short);
+	decode_path const decode_query = {&query_uri};
+	measure("decode_uri (long query)", iterations, decode_query);
+	decode_path_generic const decode_query_generic = {&query_uri};
+	measure("decode_uri (long query, generic)", iterations, decode_query_generic);
+	decode_path const decode_escaped = {&escaped_uri};
+	measure("decode_uri (long query, one escape)", iterations, decode_escaped);
+	decode_path_generic const decode_escaped_generic = {&escaped_uri};
+	measure("decode_uri (long query, one escape, generic)", iterations, decode_escaped_generic);
+
+	std::string const long_line = std::string(1000, 'x') + "\r\n";
+	find_delimiter<&tempest::find_first_of> const find_vector = {&long_line};
+	measure("find_first_of (1 KB)", iterations, find_vector);
+	find_delimiter<&tempest::detail::find_first_of_scalar> const find_scalar = {&long_line};
+	measure("find_first_of (1 KB, scalar)", iterations, find_scalar);
+
+	boost::filesystem::path const served_dir =
+	        boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-microbench-%%%%-%%%%");
+	boost::filesystem::create_directories(served_dir);
+	{
+		boost::filesystem::ofstream file(served_dir / "site.css", std::ios::binary);
+		file << std::string(1024, 'x');
+	}
+
+	complete_path const complete = {&served_dir};
+	measure("complete_served_path", iterations, complete);
+
+	memory_client client;
+	empty_directory empty;
+	virtual_directory dispatching(boost::bind(map_static, &empty, _1));
+	http_request const static_request = make_get_request("/static/css/site.css");
+	respond_with const dispatch = {&dispatching, &static_request, &client};
+	measure("virtual_directory::respond dispatch", iterations, dispatch);
+
+	//a lookup costs a probe per segment however many routes there are
+	boost::shared_ptr<tempest::route_table> const routes = boost::make_shared<tempest::route_table>();
+	boost::shared_ptr<tempest::directory> const shared_empty = boost::make_shared<empty_directory>();
+	for (unsigned host = 0; host < 100; ++host)
+	{
+		for (unsigned section = 0; section < 50; ++section)
+		{
+			routes->add("host" + boost::lexical_cast<std::string>(host) + ".example.com",
+			            "/section" + boost::lexical_cast<std::string>(section) + "/static",
+			            tempest::prefix_match, shared_empty);
+		}
+	}
+	routes->add("localhost", "/static", tempest::prefix_match, shared_empty);
+	tempest::router routing(routes);
+	respond_with const route = {&routing, &static_request, &client};
+	measure("router::respond dispatch (5001 routes)", iterations, route);
+
+	//the files are served from the page cache, so these measure the CPU cost
+	http_request const file_request = make_get_request("/site.css");
+	tempest::portable::file_system_directory portable(served_dir);
+	respond_with const portable_respond = {&portable, &file_request, &client};
+	measure("portable::file_system_directory::respond", iterations, portable_respond);
+
+	tempest::posix::file_system_directory uncached(served_dir);
+	respond_with const uncached_respond = {&uncached, &file_request, &client};
+	measure("posix::file_system_directory::respond", iterations, uncached_respond);
+
+	tempest::posix::file_system_directory open_files(
+	            served_dir,
+	            boost::shared_ptr<tempest::posix::content_cache>(),
+	            boost::make_shared<tempest::posix::open_file_cache>(tempest::posix::open_file_cache_options()));
+	respond_with const open_files_respond = {&open_files, &file_request, &client};
+	measure("posix::file_system_directory::respond (open files)", iterations, open_files_respond);
+
+	async_respond_with const open_files_async = {&open_files, &file_request, &client};
+	measure("posix::file_system_directory::async_respond (open files)", iterations, open_files_async);
+
+	tempest::posix::file_system_directory cached(
+	            served_dir,
+	            boost::make_shared<tempest::posix::content_cache>(tempest::posix::content_cache_options()),
+	            boost::make_shared<tempest::posix::open_file_cache>(tempest::posix::open_file_cache_options()));
+	async_respond_with const cached_async = {&cached, &file_request, &client};
+	measure("posix::file_system_directory::async_respond (content cache)", iterations, cached_async);
+
+	boost::filesystem::path const archive_file = served_dir.string() + ".pack";
+	tempest::pack_directory(served_dir, archive_file);
+	boost::shared_ptr<tempest::posix::archive_directory> const archive =
+	        boost::make_shared<tempest::posix::archive_directory>(archive_file);
+	async_respond_with const archive_async = {archive.get(), &file_request, &client};
+	measure("posix::archive_directory::async_respond", iterations, archive_async);
+
+	//the mapping stays valid
+	boost::filesystem::remove(archive_file);
+
+	std::string const persistent_request = "GET /site.css HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	boost::shared_ptr<tempest::directory> const served = boost::make_shared<tempest::posix::file_system_directory>(
+	        served_dir,
+	        boost::make_shared<tempest::posix::content_cache>(tempest::posix::content_cache_options()),
+	        boost::make_shared<tempest::posix::open_file_cache>(tempest::posix::open_file_cache_options()));
+	tempest::server_options const without_metrics;
+	serve_request const serve = {served, &persistent_request, &without_metrics};
+	measure("serve_client with memory_client", iterations, serve);
+
+	//the overhead of the metrics per request without the connection setup
+	std::string pipelined_requests;
+	for (unsigned i = 0; i < 64; ++i)
+	{
+		pipelined_requests += persistent_request;
+	}
+	serve_request const serve_pipelined = {served, &pipelined_requests, &without_metrics};
+	measure("serve_client with memory_client, 64 pipelined", iterations / 64, serve_pipelined);
+
+	//the connection, the client and the output are what is left to allocate
+	serve_request const serve_archive = {archive, &pipelined_requests, &without_metrics};
+	measure("serve_client with memory_client, 64 pipelined, archive", iterations / 64, serve_archive);
+
+	tempest::server_options with_metrics;
+	with_metrics.metrics = boost::make_shared<tempest::metrics>();
+	serve_request const serve_metered = {served, &pipelined_requests, &with_metrics};
+	measure("serve_client with memory_client, 64 pipelined, metrics", iterations / 64, serve_metered);
+
+	record_request const record = {with_metrics.metrics.get()};
+	measure("metrics of one request", iterations, record);
+
+	{
+		tempest::access_log_options log_options;
+		log_options.path = "/dev/null";
+		tempest::access_log log(log_options);
+		log_request const logging = {&log};
+		measure("access_log::log_request", iterations, logging);
+		std::cout << "  dropped " << log.dropped() << " of " << iterations << '\n';
+	}
+
+	{
+		//the cost of a timer does not depend on how many others are running
+		tempest::timer_wheel wheel;
+		boost::ptr_vector<tempest::wheel_timer> running;
+		for (unsigned i = 0; i < 100000; ++i)
+		{
+			running.push_back(new tempest::wheel_timer(&wheel, keep_running));
+			running.back().start(boost::chrono::milliseconds(i));
+		}
+		tempest::wheel_timer timer(&wheel, keep_running);
+		restart_timer const restart = {&timer};
+		measure("wheel_timer start and stop, 100000 running", iterations, restart);
+		running.clear();
+	}
+
+	boost::filesystem::remove_all(served_dir);
+}
@@ -1,16 +1,259 @@
-#include <tempest/tcp_acceptor.hpp>
+//Generates its responses instead of reading files. /numbers.csv streams a
+//table of any size with constant memory, for example
+//  curl -o numbers.csv "http://localhost:8080/numbers.csv?rows=100000000"
+//is about 2.5 GB, but the server only ever holds a chunk of it.
+//POST /count reads a body of any size the same way and answers with its
+//length:
+//  head -c 1G /dev/zero | curl -T - http://localhost:8080/count
+
+#include <tempest/chunked_writer.hpp>
+#include <tempest/client.hpp>
+#include <tempest/directory.hpp>
+#include <tempest/responses.hpp>
+#include <tempest/server.hpp>
+#include <http/http_request.hpp>
+#include <http/request_body.hpp>
+#include <http/response_writer.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+#include <csignal>
+#include <iostream>
 
 namespace
 {
-	void handle_client(tempest::tcp_acceptor::client_ptr &client)
+	//"?rows=123" is 123, everything else is the default
+	boost::uint64_t parse_row_count(boost::string_ref query)
 	{
-
+		boost::uint64_t const default_rows = 1000;
+		//the squares have to fit into 64 bits
+		boost::uint64_t const max_rows = boost::uint64_t(1) << 32;
+		boost::string_ref const key = "?rows=";
+		if (!query.starts_with(key) || (query.size() == key.size()))
+		{
+			return default_rows;
+		}
+		boost::uint64_t rows = 0;
+		for (boost::string_ref::const_iterator i = query.begin() + key.size(); i != query.end(); ++i)
+		{
+			if ((*i < '0') || (*i > '9') || (rows > max_rows))
+			{
+				return default_rows;
+			}
+			rows = rows * 10 + static_cast<boost::uint64_t>(*i - '0');
+		}
+		return (rows > max_rows) ? default_rows : rows;
 	}
+
+	//Writes rows until the buffer of the writer is full and continues when
+	//the client has taken them.
+	struct number_table : boost::enable_shared_from_this<number_table>
+	{
+		number_table(tempest::http_request const &request,
+		             tempest::async_sender &sender,
+		             boost::uint64_t rows,
+		             tempest::directory::response_handler handler)
+		    : m_writer(request, sender, make_header())
+		    , m_rows(rows)
+		    , m_next_row(0)
+		    , m_handler(boost::move(handler))
+		{
+		}
+
+		void start()
+		{
+			m_writer.write("n,square\n");
+			produce(boost::system::error_code());
+		}
+
+	private:
+
+		tempest::chunked_writer m_writer;
+		boost::uint64_t const m_rows;
+		boost::uint64_t m_next_row;
+		tempest::directory::response_handler const m_handler;
+
+
+		//An HTTP/1.0 client gets the same status line, but the writer sends
+		//the body without chunks and closes the connection after it.
+		static std::string make_header()
+		{
+			std::string header;
+			tempest::response_writer writer(header);
+			writer.status_line("HTTP/1.1", 200, "OK");
+			writer.header("Content-Type", "text/csv");
+			return header;
+		}
+
+		void produce(boost::system::error_code error)
+		{
+			if (error)
+			{
+				return m_handler(error);
+			}
+
+			char row[2 * tempest::max_decimal_length + 2];
+			while (m_next_row < m_rows)
+			{
+				char * const end = row + sizeof(row);
+				char *first = end;
+				*--first = '\n';
+				first = tempest::format_decimal(m_next_row * m_next_row, first);
+				*--first = ',';
+				first = tempest::format_decimal(m_next_row, first);
+
+				std::size_t const length = static_cast<std::size_t>(end - first);
+				if (m_writer.available() < length)
+				{
+					return m_writer.async_flush(
+					    boost::bind(&number_table::produce, shared_from_this(), _1));
+				}
+				m_writer.write(boost::string_ref(first, length));
+				++m_next_row;
+			}
+
+			m_writer.async_finish(
+			    boost::bind(&number_table::handle_finished, shared_from_this(), _1));
+		}
+
+		void handle_finished(boost::system::error_code error)
+		{
+			m_handler(error);
+		}
+	};
+
+	//Counts the bytes of a body while they are received.
+	struct body_counter : boost::enable_shared_from_this<body_counter>
+	{
+		body_counter(tempest::http_request const &request,
+		             tempest::async_sender &sender,
+		             tempest::directory::response_handler handler)
+		    : m_body(*request.body)
+		    , m_sender(sender)
+		    , m_counted(0)
+		    , m_handler(boost::move(handler))
+		{
+		}
+
+		void count(boost::system::error_code error)
+		{
+			if (error)
+			{
+				return m_handler(error);
+			}
+			for (;;)
+			{
+				boost::string_ref piece;
+				switch (m_body.read(piece))
+				{
+				case tempest::body_piece:
+					m_counted += piece.size();
+					break;
+
+				case tempest::body_incomplete:
+					return m_body.async_wait(
+					    boost::bind(&body_counter::count, shared_from_this(), _1));
+
+				case tempest::body_complete:
+					return respond();
+
+				case tempest::body_bad_request:
+				case tempest::body_too_large:
+					return m_handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+				}
+			}
+		}
+
+	private:
+
+		tempest::request_body &m_body;
+		tempest::async_sender &m_sender;
+		boost::uint64_t m_counted;
+		tempest::directory::response_handler const m_handler;
+
+
+		void respond()
+		{
+			tempest::in_memory_response response;
+			char digits[tempest::max_decimal_length];
+			char * const end = digits + sizeof(digits);
+			response.body.assign(tempest::format_decimal(m_counted, end), end);
+			response.body += '\n';
+			tempest::response_writer writer(response.header);
+			writer.status_line("HTTP/1.1", 200, "OK");
+			writer.header("Content-Type", "text/plain");
+			writer.header("Content-Length", response.body.size());
+			tempest::async_send_in_memory_response(response, m_sender, m_handler);
+		}
+	};
+
+	struct dynamic_site : tempest::directory
+	{
+		virtual void respond(tempest::http_request const &,
+		                     boost::string_ref sub_path,
+		                     tempest::sender &sender) TEMPEST_OVERRIDE
+		{
+			if (sub_path.empty() || (sub_path == "/"))
+			{
+				tempest::in_memory_response response;
+				response.body =
+				        "<html><body><a href=\"numbers.csv?rows=1000000\">numbers.csv</a></body></html>";
+				tempest::response_writer writer(response.header);
+				writer.status_line("HTTP/1.1", 200, "OK");
+				writer.header("Content-Type", "text/html");
+				writer.header("Content-Length", response.body.size());
+				return tempest::send_in_memory_response(response, sender);
+			}
+
+			//a table is only streamed by async_respond
+			tempest::send_in_memory_response(
+			    tempest::make_not_found_response(sub_path.to_string()), sender);
+		}
+
+		virtual void async_respond(tempest::http_request const &request,
+		                           boost::string_ref sub_path,
+		                           tempest::async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE
+		{
+			if ((sub_path == "/count") && request.body)
+			{
+				boost::make_shared<body_counter>(request, sender, boost::move(handler))
+				        ->count(boost::system::error_code());
+				return;
+			}
+
+			boost::string_ref const table = "/numbers.csv";
+			if (sub_path.starts_with(table))
+			{
+				boost::string_ref const query = sub_path.substr(table.size());
+				if (query.empty() || (query[0] == '?'))
+				{
+					boost::make_shared<number_table>(
+					    request, sender, parse_row_count(query), boost::move(handler))->start();
+					return;
+				}
+			}
+			tempest::directory::async_respond(request, sub_path, sender, boost::move(handler));
+		}
+	};
 }
 
 int main()
 {
-	boost::asio::io_service io;
-	tempest::tcp_acceptor acceptor(8080, handle_client, io);
-	io.run();
+#ifdef SIGPIPE
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	try
+	{
+		tempest::server_options options;
+		options.max_body_size = boost::uint64_t(1) << 40;
+		tempest::run_server(8080, boost::make_shared<dynamic_site>(), options);
+	}
+	catch (std::exception const &ex)
+	{
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
 }
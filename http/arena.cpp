@@ -0,0 +1,114 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <new>
+
+
+namespace tempest
+{
+	arena_statistics::arena_statistics()
+	    : allocations(0)
+	    , allocated_bytes(0)
+	    , chunks(0)
+	    , chunk_bytes(0)
+	{
+	}
+
+	//the memory of a chunk follows its header
+	struct arena::chunk
+	{
+		chunk *next;
+		std::size_t size;
+
+		char *begin()
+		{
+			return reinterpret_cast<char *>(this + 1);
+		}
+	};
+
+	arena::arena(std::size_t chunk_size)
+	    : m_chunk_size(chunk_size)
+	    , m_first(0)
+	    , m_current(0)
+	    , m_used(0)
+	{
+	}
+
+	arena::~arena()
+	{
+		while (m_first)
+		{
+			chunk * const next = m_first->next;
+			::operator delete(m_first);
+			m_first = next;
+		}
+	}
+
+	void *arena::allocate(std::size_t size, std::size_t alignment)
+	{
+		assert(alignment && ((alignment & (alignment - 1)) == 0));
+		if (size > std::numeric_limits<std::size_t>::max() - alignment - sizeof(chunk))
+		{
+			throw std::bad_alloc();
+		}
+		for (;;)
+		{
+			if (m_current)
+			{
+				std::size_t const address = reinterpret_cast<std::size_t>(m_current->begin() + m_used);
+				std::size_t const padding = (alignment - (address % alignment)) % alignment;
+				std::size_t const free = m_current->size - m_used;
+				if ((padding <= free) && (size <= free - padding))
+				{
+					char * const allocated = m_current->begin() + m_used + padding;
+					m_used += padding + size;
+					++m_statistics.allocations;
+					m_statistics.allocated_bytes += size;
+					return allocated;
+				}
+			}
+
+			//the chunks which have been kept by reset are used before new ones
+			if (m_current && m_current->next)
+			{
+				m_current = m_current->next;
+			}
+			else
+			{
+				m_current = add_chunk(size + alignment);
+			}
+			m_used = 0;
+		}
+	}
+
+	void arena::reset()
+	{
+		m_current = m_first;
+		m_used = 0;
+	}
+
+	arena_statistics const &arena::statistics() const
+	{
+		return m_statistics;
+	}
+
+	arena::chunk *arena::add_chunk(std::size_t minimum_size)
+	{
+		std::size_t const size = (std::max)(m_chunk_size, minimum_size);
+		chunk * const added = static_cast<chunk *>(::operator new(sizeof(chunk) + size));
+		added->next = 0;
+		added->size = size;
+		if (m_current)
+		{
+			m_current->next = added;
+		}
+		else
+		{
+			m_first = added;
+		}
+		++m_statistics.chunks;
+		m_statistics.chunk_bytes += size;
+		return added;
+	}
+}
@@ -0,0 +1,172 @@
+#ifndef TEMPEST_HTTP_ARENA_HPP
+#define TEMPEST_HTTP_ARENA_HPP
+
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <cstddef>
+#include <limits>
+#include <new>
+
+
+namespace tempest
+{
+	//what an arena has done since it was created
+	struct arena_statistics
+	{
+		//the allocations served by the arena
+		boost::uint64_t allocations;
+		boost::uint64_t allocated_bytes;
+
+		//the chunks the arena had to take from the heap
+		boost::uint64_t chunks;
+		boost::uint64_t chunk_bytes;
+
+		arena_statistics();
+	};
+
+	//A bump allocator for objects which all die at the same time, for
+	//example the headers of a request. Freeing single allocations does
+	//nothing. reset makes all the memory available again, but keeps the
+	//chunks, so an arena which is reset between requests only allocates
+	//from the heap until it has seen its largest request. Not thread-safe.
+	struct arena : boost::noncopyable
+	{
+		explicit arena(std::size_t chunk_size = 4096);
+		~arena();
+
+		//never returns null, throws std::bad_alloc
+		void *allocate(std::size_t size, std::size_t alignment);
+
+		//Everything allocated so far must not be used anymore.
+		void reset();
+
+		arena_statistics const &statistics() const;
+
+	private:
+
+		struct chunk;
+
+		std::size_t const m_chunk_size;
+		chunk *m_first;
+		chunk *m_current;
+		std::size_t m_used;
+		arena_statistics m_statistics;
+
+
+		chunk *add_chunk(std::size_t minimum_size);
+	};
+
+	//Allocates from an arena, or from the heap if it has none. A container
+	//which is copied gets the heap, so the copy can outlive the arena.
+	template <class T>
+	struct arena_allocator
+	{
+		typedef T value_type;
+		typedef T *pointer;
+		typedef T const *const_pointer;
+		typedef T &reference;
+		typedef T const &const_reference;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		template <class U>
+		struct rebind
+		{
+			typedef arena_allocator<U> other;
+		};
+
+		arena_allocator()
+		    : m_arena(0)
+		{
+		}
+
+		explicit arena_allocator(tempest::arena &memory)
+		    : m_arena(&memory)
+		{
+		}
+
+		template <class U>
+		arena_allocator(arena_allocator<U> const &other)
+		    : m_arena(other.get_arena())
+		{
+		}
+
+		pointer allocate(size_type count, void const * = 0)
+		{
+			if (count > max_size())
+			{
+				throw std::bad_alloc();
+			}
+			std::size_t const size = count * sizeof(T);
+			void * const memory = m_arena
+			        ? m_arena->allocate(size, boost::alignment_of<T>::value)
+			        : ::operator new(size);
+			return static_cast<pointer>(memory);
+		}
+
+		void deallocate(pointer memory, size_type)
+		{
+			if (!m_arena)
+			{
+				::operator delete(memory);
+			}
+		}
+
+		size_type max_size() const
+		{
+			return std::numeric_limits<size_type>::max() / sizeof(T);
+		}
+
+		void construct(pointer where, T const &value)
+		{
+			new (static_cast<void *>(where)) T(value);
+		}
+
+		void destroy(pointer where)
+		{
+			where->~T();
+		}
+
+		pointer address(reference value) const
+		{
+			return &value;
+		}
+
+		const_pointer address(const_reference value) const
+		{
+			return &value;
+		}
+
+		arena_allocator select_on_container_copy_construction() const
+		{
+			return arena_allocator();
+		}
+
+		//null for the heap
+		tempest::arena *get_arena() const
+		{
+			return m_arena;
+		}
+
+	private:
+
+		tempest::arena *m_arena;
+	};
+
+	template <class T, class U>
+	bool operator == (arena_allocator<T> const &left, arena_allocator<U> const &right)
+	{
+		return left.get_arena() == right.get_arena();
+	}
+
+	template <class T, class U>
+	bool operator != (arena_allocator<T> const &left, arena_allocator<U> const &right)
+	{
+		return !(left == right);
+	}
+}
+
+
+#endif
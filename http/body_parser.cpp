@@ -0,0 +1,284 @@
+#include "body_parser.hpp"
+#include "request_parser.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+namespace tempest
+{
+	namespace
+	{
+		boost::string_ref trim(boost::string_ref text)
+		{
+			while (!text.empty() && ((text.front() == ' ') || (text.front() == '\t')))
+			{
+				text.remove_prefix(1);
+			}
+			while (!text.empty() && ((text.back() == ' ') || (text.back() == '\t')))
+			{
+				text.remove_suffix(1);
+			}
+			return text;
+		}
+
+		//false for anything but decimal digits and for overflows
+		bool parse_length(boost::string_ref text, boost::uint64_t &length)
+		{
+			if (text.empty())
+			{
+				return false;
+			}
+			length = 0;
+			for (boost::string_ref::const_iterator i = text.begin(); i != text.end(); ++i)
+			{
+				if ((*i < '0') || (*i > '9'))
+				{
+					return false;
+				}
+				boost::uint64_t const digit = static_cast<boost::uint64_t>(*i - '0');
+				if (length > (std::numeric_limits<boost::uint64_t>::max() - digit) / 10)
+				{
+					return false;
+				}
+				length = length * 10 + digit;
+			}
+			return true;
+		}
+
+		int hex_digit_value(char c)
+		{
+			if ((c >= '0') && (c <= '9'))
+			{
+				return c - '0';
+			}
+			if ((c >= 'a') && (c <= 'f'))
+			{
+				return c - 'a' + 10;
+			}
+			if ((c >= 'A') && (c <= 'F'))
+			{
+				return c - 'A' + 10;
+			}
+			return -1;
+		}
+	}
+
+	body_framing find_body_framing(request_view const &request,
+	                               boost::uint64_t &length)
+	{
+		//Every copy of the headers counts, whatever the case of its name,
+		//because a proxy in front may pick a different one.
+		std::size_t content_lengths = 0;
+		std::size_t transfer_encodings = 0;
+		boost::string_ref transfer_encoding;
+		BOOST_FOREACH (header_field const &header, request.headers)
+		{
+			if (boost::algorithm::iequals(header.name, "Content-Length"))
+			{
+				boost::uint64_t parsed = 0;
+				if (!parse_length(trim(header.value), parsed) ||
+				    (content_lengths && (parsed != length)))
+				{
+					return invalid_framing;
+				}
+				length = parsed;
+				++content_lengths;
+			}
+			else if (boost::algorithm::iequals(header.name, "Transfer-Encoding"))
+			{
+				transfer_encoding = header.value;
+				++transfer_encodings;
+			}
+		}
+
+		//a request with both could be read differently by a proxy in front
+		if (content_lengths && transfer_encodings)
+		{
+			return invalid_framing;
+		}
+
+		if (transfer_encodings)
+		{
+			//only chunked is understood, so it has to be the only coding
+			return ((transfer_encodings == 1) &&
+			        boost::algorithm::iequals(trim(transfer_encoding), "chunked"))
+			        ? chunked_framing : invalid_framing;
+		}
+
+		if (content_lengths)
+		{
+			return (length == 0) ? no_body : length_framing;
+		}
+
+		return no_body;
+	}
+
+	std::size_t const body_parser::max_line_length;
+
+	body_parser::body_parser()
+	    : m_state(complete)
+	    , m_remaining(0)
+	    , m_received(0)
+	    , m_max_size(0)
+	    , m_consumed(0)
+	{
+	}
+
+	void body_parser::start_length(boost::uint64_t length)
+	{
+		m_state = (length == 0) ? complete : length_data;
+		m_remaining = length;
+		m_received = 0;
+		m_max_size = length;
+		m_consumed = 0;
+	}
+
+	void body_parser::start_chunked(boost::uint64_t max_size)
+	{
+		m_state = chunk_size;
+		m_remaining = 0;
+		m_received = 0;
+		m_max_size = max_size;
+		m_consumed = 0;
+	}
+
+	body_result body_parser::parse(char const *data, std::size_t size, boost::string_ref &piece)
+	{
+		m_consumed = 0;
+		for (;;)
+		{
+			switch (m_state)
+			{
+			case length_data:
+			case chunk_data:
+				{
+					if (m_consumed == size)
+					{
+						return body_incomplete;
+					}
+					std::size_t const length = static_cast<std::size_t>(
+					        (std::min)(m_remaining, static_cast<boost::uint64_t>(size - m_consumed)));
+					piece = boost::string_ref(data + m_consumed, length);
+					m_consumed += length;
+					m_remaining -= length;
+					m_received += length;
+					if (m_remaining == 0)
+					{
+						m_state = (m_state == length_data) ? complete : chunk_end;
+					}
+					return body_piece;
+				}
+
+			case chunk_end:
+				if ((size - m_consumed) < 2)
+				{
+					return body_incomplete;
+				}
+				if (std::memcmp(data + m_consumed, "\r\n", 2) != 0)
+				{
+					return body_bad_request;
+				}
+				m_consumed += 2;
+				m_state = chunk_size;
+				break;
+
+			case chunk_size:
+			case trailer:
+				{
+					void const * const new_line =
+					        std::memchr(data + m_consumed, '\n', size - m_consumed);
+					if (!new_line)
+					{
+						return ((size - m_consumed) > max_line_length)
+						        ? body_bad_request : body_incomplete;
+					}
+					std::size_t const line_end =
+					        static_cast<std::size_t>(static_cast<char const *>(new_line) - data);
+					if ((line_end - m_consumed) > max_line_length)
+					{
+						return body_bad_request;
+					}
+
+					//lines end with \r\n, but a single \n is tolerated
+					boost::string_ref line(data + m_consumed, line_end - m_consumed);
+					if (!line.empty() && (line.back() == '\r'))
+					{
+						line.remove_suffix(1);
+					}
+					m_consumed = line_end + 1;
+
+					if (m_state == trailer)
+					{
+						//the trailers are not used
+						if (line.empty())
+						{
+							m_state = complete;
+						}
+						break;
+					}
+
+					body_result const result = parse_chunk_size(line);
+					if (result != body_incomplete)
+					{
+						return result;
+					}
+					break;
+				}
+
+			case complete:
+				return body_complete;
+			}
+		}
+	}
+
+	std::size_t body_parser::consumed() const
+	{
+		return m_consumed;
+	}
+
+	bool body_parser::is_complete() const
+	{
+		return (m_state == complete);
+	}
+
+	//returns body_incomplete when the line is valid
+	body_result body_parser::parse_chunk_size(boost::string_ref line)
+	{
+		//1a;name=value
+		boost::uint64_t size = 0;
+		std::size_t digits = 0;
+		for (; digits < line.size(); ++digits)
+		{
+			int const value = hex_digit_value(line[digits]);
+			if (value < 0)
+			{
+				break;
+			}
+			if (size > (std::numeric_limits<boost::uint64_t>::max() >> 4))
+			{
+				return body_too_large;
+			}
+			size = (size << 4) | static_cast<boost::uint64_t>(value);
+		}
+		if (digits == 0)
+		{
+			return body_bad_request;
+		}
+		boost::string_ref const extensions = trim(line.substr(digits));
+		if (!extensions.empty() && (extensions.front() != ';'))
+		{
+			return body_bad_request;
+		}
+		if (size > (m_max_size - m_received))
+		{
+			return body_too_large;
+		}
+
+		m_remaining = size;
+		m_state = (size == 0) ? trailer : chunk_data;
+		return body_incomplete;
+	}
+}
@@ -0,0 +1,102 @@
+#ifndef TEMPEST_HTTP_BODY_PARSER_HPP
+#define TEMPEST_HTTP_BODY_PARSER_HPP
+
+
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+
+
+namespace tempest
+{
+	struct request_view;
+
+	//how the end of the body of a request is found
+	enum body_framing
+	{
+		no_body,
+
+		//Content-Length
+		length_framing,
+
+		//Transfer-Encoding: chunked
+		chunked_framing,
+
+		//Both headers, a malformed length or a coding other than chunked.
+		//Such a request cannot be told from the next one.
+		invalid_framing
+	};
+
+	//The length is set for length_framing. A Content-Length of zero is
+	//no_body. Repeated Content-Length headers have to agree and
+	//Transfer-Encoding must not be repeated. The view is used instead of
+	//an http_request because its headers keep all the copies.
+	body_framing find_body_framing(request_view const &request,
+	                               boost::uint64_t &length);
+
+	enum body_result
+	{
+		//a piece of the body has been found
+		body_piece,
+
+		//the next piece has not been received yet
+		body_incomplete,
+
+		//the body has ended, the rest of the data belongs to the next request
+		body_complete,
+
+		body_bad_request,
+		body_too_large
+	};
+
+	//A resumable decoder for the body of a request which works directly on
+	//the receive buffer like request_parser. The pieces are slices of the
+	//data, so the body is never copied.
+	struct body_parser
+	{
+		//the longest line of the chunked framing: a chunk size with its
+		//extensions or a trailer
+		static std::size_t const max_line_length = 4096;
+
+		//starts as no_body which is complete at once
+		body_parser();
+
+		void start_length(boost::uint64_t length);
+
+		//the sizes of the chunks must not add up to more than the maximum
+		void start_chunked(boost::uint64_t max_size);
+
+		//The data is what has been received after the bytes consumed by the
+		//previous calls. After body_piece the piece is a slice of the data.
+		body_result parse(char const *data, std::size_t size, boost::string_ref &piece);
+
+		//how many bytes of the data the last call to parse has used
+		std::size_t consumed() const;
+
+		bool is_complete() const;
+
+	private:
+
+		enum state
+		{
+			length_data,
+			chunk_size,
+			chunk_data,
+			chunk_end,
+			trailer,
+			complete
+		};
+
+		state m_state;
+		boost::uint64_t m_remaining;
+		boost::uint64_t m_received;
+		boost::uint64_t m_max_size;
+		std::size_t m_consumed;
+
+
+		body_result parse_chunk_size(boost::string_ref line);
+	};
+}
+
+
+#endif
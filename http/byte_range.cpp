@@ -0,0 +1,171 @@
+#include "byte_range.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <algorithm>
+#include <limits>
+
+
+namespace tempest
+{
+	namespace
+	{
+		boost::string_ref trim(boost::string_ref text)
+		{
+			while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+			{
+				text.remove_prefix(1);
+			}
+			while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+			{
+				text.remove_suffix(1);
+			}
+			return text;
+		}
+
+		//accepts only digits, at least one
+		bool parse_number(boost::string_ref text, boost::uint64_t &value)
+		{
+			if (text.empty())
+			{
+				return false;
+			}
+
+			value = 0;
+			for (boost::string_ref::const_iterator i = text.begin(); i != text.end(); ++i)
+			{
+				if (*i < '0' || *i > '9')
+				{
+					return false;
+				}
+				unsigned const digit = static_cast<unsigned>(*i - '0');
+				if (value > (std::numeric_limits<boost::uint64_t>::max() - digit) / 10)
+				{
+					return false;
+				}
+				value = value * 10 + digit;
+			}
+			return true;
+		}
+
+		enum spec_result
+		{
+			spec_invalid,
+			spec_unsatisfiable,
+			spec_satisfiable
+		};
+
+		//"first-last", "first-" or "-suffix_length"
+		spec_result parse_range_spec(boost::string_ref spec,
+		                             boost::uint64_t size,
+		                             byte_range &range)
+		{
+			std::size_t const dash = spec.find('-');
+			if (dash == boost::string_ref::npos)
+			{
+				return spec_invalid;
+			}
+
+			boost::string_ref const first_text = trim(spec.substr(0, dash));
+			boost::string_ref const last_text = trim(spec.substr(dash + 1));
+			if (first_text.empty())
+			{
+				boost::uint64_t suffix_length = 0;
+				if (!parse_number(last_text, suffix_length))
+				{
+					return spec_invalid;
+				}
+				if (suffix_length == 0 || size == 0)
+				{
+					return spec_unsatisfiable;
+				}
+				range.length = std::min(suffix_length, size);
+				range.first = size - range.length;
+				return spec_satisfiable;
+			}
+
+			boost::uint64_t first = 0;
+			if (!parse_number(first_text, first))
+			{
+				return spec_invalid;
+			}
+
+			boost::uint64_t last = std::numeric_limits<boost::uint64_t>::max();
+			if (!last_text.empty())
+			{
+				if (!parse_number(last_text, last) ||
+				    (last < first))
+				{
+					return spec_invalid;
+				}
+			}
+
+			if (first >= size)
+			{
+				return spec_unsatisfiable;
+			}
+			range.first = first;
+			range.length = std::min(last, size - 1) - first + 1;
+			return spec_satisfiable;
+		}
+	}
+
+	range_result parse_byte_ranges(boost::string_ref header,
+	                               boost::uint64_t size,
+	                               std::vector<byte_range> &ranges)
+	{
+		std::size_t const original_count = ranges.size();
+		header = trim(header);
+
+		boost::string_ref const unit = "bytes=";
+		if (header.size() < unit.size() ||
+		    !boost::algorithm::iequals(header.substr(0, unit.size()), unit))
+		{
+			return range_ignored;
+		}
+		header.remove_prefix(unit.size());
+
+		std::size_t spec_count = 0;
+		for (;;)
+		{
+			std::size_t const comma = header.find(',');
+			boost::string_ref const spec = trim(header.substr(0, comma));
+
+			//empty list elements are allowed
+			if (!spec.empty())
+			{
+				if (++spec_count > max_byte_ranges)
+				{
+					ranges.resize(original_count);
+					return range_ignored;
+				}
+
+				byte_range range;
+				switch (parse_range_spec(spec, size, range))
+				{
+				case spec_invalid:
+					ranges.resize(original_count);
+					return range_ignored;
+
+				case spec_unsatisfiable:
+					break;
+
+				case spec_satisfiable:
+					ranges.push_back(range);
+					break;
+				}
+			}
+
+			if (comma == boost::string_ref::npos)
+			{
+				break;
+			}
+			header.remove_prefix(comma + 1);
+		}
+
+		if (spec_count == 0)
+		{
+			return range_ignored;
+		}
+		return (ranges.size() > original_count) ? range_satisfiable
+		                                        : range_not_satisfiable;
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef TEMPEST_HTTP_BYTE_RANGE_HPP
+#define TEMPEST_HTTP_BYTE_RANGE_HPP
+
+
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <vector>
+
+
+namespace tempest
+{
+	//a non-empty part of a representation
+	struct byte_range
+	{
+		boost::uint64_t first;
+		boost::uint64_t length;
+	};
+
+	enum range_result
+	{
+		//the whole representation is sent as if there was no Range header
+		range_ignored,
+		range_satisfiable,
+		range_not_satisfiable
+	};
+
+	//A client could request the same bytes many times with overlapping
+	//ranges. More ranges than this are ignored.
+	std::size_t const max_byte_ranges = 16;
+
+	//Parses the value of a Range header like "bytes=0-99,-100" for a
+	//representation of the given size. The ranges are appended in the
+	//requested order. Ranges which start after the end are skipped and the
+	//others are clamped to the size.
+	range_result parse_byte_ranges(boost::string_ref header,
+	                               boost::uint64_t size,
+	                               std::vector<byte_range> &ranges);
+}
+
+
+#endif
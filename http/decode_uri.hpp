@@ -4,7 +4,8 @@
 
 #include <iterator>
 #include <stdexcept>
-#include <cctype>
+#include <string>
+#include <cstring>
 #include <boost/range.hpp>
 
 
@@ -33,10 +34,11 @@ namespace tempest
 				return (c - '0');
 			}
 
-			c = std::tolower(c);
-			if (c >= 'a' && c <= 'f')
+			//ASCII letters become lower case by setting this bit
+			Char const lower = static_cast<Char>(c | 0x20);
+			if (lower >= 'a' && lower <= 'f')
 			{
-				return (c - 'a' + 10);
+				return (lower - 'a' + 10);
 			}
 
 			throw std::invalid_argument("Hexadecimal digit expected");
@@ -81,6 +83,53 @@ namespace tempest
 			decode_uri(boost::begin(uri), boost::end(uri), boost::begin(uri));
 		uri.erase(new_end, boost::end(uri));
 	}
+
+	//The fast path for the common case: the runs between the escapes are
+	//found with memchr and moved as a whole, so a URI without any escape
+	//is not written at all.
+	inline void decode_uri(std::string &uri)
+	{
+		if (uri.empty())
+		{
+			return;
+		}
+
+		char * const data = &uri[0];
+		char const * const end = data + uri.size();
+		char const *source = static_cast<char const *>(std::memchr(data, '%', uri.size()));
+		if (!source)
+		{
+			return;
+		}
+
+		char *dest = data + (source - data);
+		while (source != end)
+		{
+			//source is at a '%'
+			++source;
+			unsigned char_value = 0;
+			for (unsigned i = 0; i < 2; ++i)
+			{
+				char const digit = detail::require_char(source, end);
+				char_value *= 16;
+				char_value += detail::decode_hex(digit);
+			}
+			*dest++ = static_cast<char>(char_value);
+
+			char const *next = static_cast<char const *>(
+			            std::memchr(source, '%', static_cast<std::size_t>(end - source)));
+			if (!next)
+			{
+				next = end;
+			}
+			std::size_t const run = static_cast<std::size_t>(next - source);
+			std::memmove(dest, source, run);
+			dest += run;
+			source = next;
+		}
+
+		uri.resize(static_cast<std::size_t>(dest - data));
+	}
 }
 
 #endif
@@ -0,0 +1,152 @@
+#include "http_date.hpp"
+#include <algorithm>
+#include <cassert>
+
+
+namespace tempest
+{
+	namespace
+	{
+		void format_two_digits(unsigned value, char *destination)
+		{
+			assert(value < 100);
+			destination[0] = static_cast<char>('0' + (value / 10));
+			destination[1] = static_cast<char>('0' + (value % 10));
+		}
+
+		bool parse_digits(boost::string_ref digits, unsigned &value)
+		{
+			value = 0;
+			for (boost::string_ref::const_iterator i = digits.begin(); i != digits.end(); ++i)
+			{
+				if (*i < '0' || *i > '9')
+				{
+					return false;
+				}
+				value = value * 10 + static_cast<unsigned>(*i - '0');
+			}
+			return true;
+		}
+
+		//the day number since 1970-01-01, see Howard Hinnant's
+		//"chrono-Compatible Low-Level Date Algorithms"
+		boost::int64_t days_from_civil(boost::int64_t year, unsigned month, unsigned day)
+		{
+			year -= (month <= 2) ? 1 : 0;
+			boost::int64_t const era = (year >= 0 ? year : year - 399) / 400;
+			unsigned const year_of_era = static_cast<unsigned>(year - era * 400);
+			unsigned const day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+			unsigned const day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+			                            day_of_year;
+			return era * 146097 + static_cast<boost::int64_t>(day_of_era) - 719468;
+		}
+
+		char const week_days[] = "ThuFriSatSunMonTueWed";
+		char const months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	}
+
+	void format_http_date(boost::int64_t seconds, char *destination)
+	{
+		boost::int64_t days = seconds / 86400;
+		boost::int64_t second_of_day = seconds % 86400;
+		if (second_of_day < 0)
+		{
+			second_of_day += 86400;
+			--days;
+		}
+
+		//1970-01-01 was a Thursday
+		boost::int64_t const week_day = ((days % 7) + 7) % 7;
+
+		//civil date from the day number, the inverse of days_from_civil
+		boost::int64_t const shifted = days + 719468;
+		boost::int64_t const era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+		unsigned const day_of_era = static_cast<unsigned>(shifted - era * 146097);
+		unsigned const year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+		                              day_of_era / 146096) / 365;
+		unsigned const day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 -
+		                                           year_of_era / 100);
+		unsigned const shifted_month = (5 * day_of_year + 2) / 153;
+		unsigned const day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+		unsigned const month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+		boost::int64_t const year = static_cast<boost::int64_t>(year_of_era) + era * 400 +
+		                            (month <= 2 ? 1 : 0);
+
+		char *out = destination;
+		std::copy(week_days + week_day * 3, week_days + week_day * 3 + 3, out);
+		out += 3;
+		*out++ = ',';
+		*out++ = ' ';
+		format_two_digits(day, out);
+		out += 2;
+		*out++ = ' ';
+		std::copy(months + (month - 1) * 3, months + (month - 1) * 3 + 3, out);
+		out += 3;
+		*out++ = ' ';
+
+		//HTTP dates have four digit years
+		unsigned const clamped_year = static_cast<unsigned>(
+		            std::max<boost::int64_t>(0, std::min<boost::int64_t>(9999, year)));
+		format_two_digits(clamped_year / 100, out);
+		format_two_digits(clamped_year % 100, out + 2);
+		out += 4;
+		*out++ = ' ';
+
+		unsigned const seconds_of_day = static_cast<unsigned>(second_of_day);
+		format_two_digits(seconds_of_day / 3600, out);
+		out += 2;
+		*out++ = ':';
+		format_two_digits(seconds_of_day / 60 % 60, out);
+		out += 2;
+		*out++ = ':';
+		format_two_digits(seconds_of_day % 60, out);
+		out += 2;
+		std::copy(" GMT", " GMT" + 4, out);
+	}
+
+	bool parse_http_date(boost::string_ref date, boost::int64_t &seconds)
+	{
+		//"Sun, 06 Nov 1994 08:49:37 GMT"
+		if (date.size() != http_date_length ||
+		    date.substr(3, 2) != ", " ||
+		    date[7] != ' ' ||
+		    date[11] != ' ' ||
+		    date[16] != ' ' ||
+		    date[19] != ':' ||
+		    date[22] != ':' ||
+		    date.substr(25) != " GMT")
+		{
+			return false;
+		}
+
+		boost::string_ref const month_name = date.substr(8, 3);
+		boost::string_ref const all_months = months;
+		std::size_t const month_index = all_months.find(month_name);
+		if (month_index == boost::string_ref::npos ||
+		    (month_index % 3) != 0)
+		{
+			return false;
+		}
+
+		unsigned day = 0;
+		unsigned year = 0;
+		unsigned hour = 0;
+		unsigned minute = 0;
+		unsigned second = 0;
+		if (!parse_digits(date.substr(5, 2), day) ||
+		    !parse_digits(date.substr(12, 4), year) ||
+		    !parse_digits(date.substr(17, 2), hour) ||
+		    !parse_digits(date.substr(20, 2), minute) ||
+		    !parse_digits(date.substr(23, 2), second) ||
+		    day < 1 || day > 31 ||
+		    hour > 23 || minute > 59 || second > 60)
+		{
+			return false;
+		}
+
+		unsigned const month = static_cast<unsigned>(month_index / 3 + 1);
+		seconds = days_from_civil(year, month, day) * 86400 +
+		          hour * 3600 + minute * 60 + second;
+		return true;
+	}
+}
@@ -0,0 +1,25 @@
+#ifndef TEMPEST_HTTP_DATE_HPP
+#define TEMPEST_HTTP_DATE_HPP
+
+
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+
+
+namespace tempest
+{
+	//"Sun, 06 Nov 1994 08:49:37 GMT"
+	std::size_t const http_date_length = 29;
+
+	//Writes http_date_length characters. The time is in seconds since
+	//1970 (UTC).
+	void format_http_date(boost::int64_t seconds, char *destination);
+
+	//Accepts the format written by format_http_date. The obsolete formats
+	//are not supported, a condition with such a date is ignored.
+	bool parse_http_date(boost::string_ref date, boost::int64_t &seconds);
+}
+
+
+#endif
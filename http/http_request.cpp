@@ -1,70 +1,194 @@
 #include "http_request.hpp"
-#include "decode_uri.hpp"
+#include "request_parser.hpp"
 #include <stdexcept>
-#include <boost/move/move.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/foreach.hpp>
 
 
 namespace tempest
 {
 	namespace
 	{
-		void trim_trailing_char(std::string &str, char trailing)
+		//Splits off the text before the next separator or the whole rest if
+		//there is none. The elements of a list are not copied.
+		boost::string_ref split_off(boost::string_ref &list, char separator)
 		{
-			if (!str.empty() &&
-			    //use rbegin instead of back to support old implementations
-			    *str.rbegin() == trailing)
+			std::size_t const end = list.find(separator);
+			boost::string_ref const element = list.substr(0, end);
+			list.remove_prefix((end == boost::string_ref::npos) ? list.size() : (end + 1));
+			return element;
+		}
+
+		boost::string_ref trim(boost::string_ref text)
+		{
+			while (!text.empty() && ((text.front() == ' ') || (text.front() == '\t')))
+			{
+				text.remove_prefix(1);
+			}
+			while (!text.empty() && ((text.back() == ' ') || (text.back() == '\t')))
+			{
+				text.remove_suffix(1);
+			}
+			return text;
+		}
+
+		bool has_token(boost::string_ref list, char const *token)
+		{
+			while (!list.empty())
+			{
+				if (boost::algorithm::iequals(trim(split_off(list, ',')), token))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		//whether a weight like "0.5" is above zero
+		bool is_positive_weight(boost::string_ref weight)
+		{
+			for (boost::string_ref::const_iterator i = weight.begin(); i != weight.end(); ++i)
+			{
+				if ((*i >= '1') && (*i <= '9'))
+				{
+					return true;
+				}
+				if ((*i != '0') && (*i != '.'))
+				{
+					break;
+				}
+			}
+			return false;
+		}
+
+		//an element of a list like Accept-Encoding: "gzip;q=0.5"
+		struct weighted_token
+		{
+			boost::string_ref token;
+			bool acceptable;
+		};
+
+		weighted_token parse_weighted_token(boost::string_ref element)
+		{
+			weighted_token result;
+			result.token = trim(split_off(element, ';'));
+			result.acceptable = true;
+			while (!element.empty())
 			{
-				str.resize(str.size() - 1);
+				boost::string_ref const parameter = trim(split_off(element, ';'));
+				if (boost::algorithm::istarts_with(parameter, "q="))
+				{
+					//"q=0" forbids the token
+					result.acceptable = is_positive_weight(trim(parameter.substr(2)));
+				}
 			}
+			return result;
 		}
 	}
 
+	http_request::http_request()
+	    : body(0)
+	{
+	}
+
+	http_request::http_request(arena &memory)
+	    : headers(std::less<header_string>(), arena_allocator<header_map::value_type>(memory))
+	    , body(0)
+	{
+	}
+
 	http_request parse_request(std::istream &source)
 	{
 		//throw in case of errors because there is no sensible way to handle
 		//errors here
 		source.exceptions(std::ios::failbit | std::ios::badbit);
 
-		http_request request;
+		//The head is read line by line so that nothing after it (the body
+		//or the next request) is taken from the stream.
+		request_parser parser;
+		std::string head;
+		std::string line;
+		for (;;)
+		{
+			getline(source, line, '\n');
+			head += line;
+			head += '\n';
 
-		//GET /file HTTP/1.1\r\n
-		getline(source, request.method, ' ');
+			switch (parser.parse(head.data(), head.size()))
+			{
+			case parse_incomplete:
+				break;
 
-		getline(source, request.file, ' ');
-		decode_uri(request.file);
+			case parse_complete:
+				//The body is left in the source, find_body_framing on the
+				//view tells how to read it.
+				return make_request(parser.request());
 
-		getline(source, request.version, '\n');
-		trim_trailing_char(request.version, '\r');
+			case parse_bad_request:
+				throw std::runtime_error("Bad request: Malformed request head");
 
-		while (source.peek() != '\r')
-		{
-			std::string key, value;
+			case parse_too_large:
+				throw std::runtime_error("Bad request: Request head too large");
+			}
+		}
+	}
 
-			//key: value\r\n
-			getline(source, key, ':');
-			if (source.peek() == ' ')
+	http_request::header_string const *find_header(http_request const &request,
+	                                               boost::string_ref name)
+	{
+		BOOST_FOREACH (http_request::header_map::value_type const &header,
+		               request.headers)
+		{
+			//the comparison with a locale is only worth it for the same length
+			if ((header.first.size() == name.size()) &&
+			    boost::algorithm::iequals(header.first, name))
 			{
-				source.get();
+				return &header.second;
 			}
-			getline(source, value, '\n');
-			trim_trailing_char(value, '\r');
-
-			request.headers.insert(
-			            std::make_pair(boost::move(key), boost::move(value)));
 		}
+		return 0;
+	}
 
-		//the headers end with \r\n
-
-		//skip \r
-		source.get();
-
-		if (source.get() != '\n')
+	bool wants_persistent_connection(http_request const &request)
+	{
+		http_request::header_string const * const connection = find_header(request, "Connection");
+		if (connection)
 		{
-			throw std::runtime_error("Bad request: Missing new-line at the end");
+			if (has_token(*connection, "close"))
+			{
+				return false;
+			}
+			if (has_token(*connection, "keep-alive"))
+			{
+				return true;
+			}
 		}
+		return (request.version == "HTTP/1.1");
+	}
 
-		//TODO: here comes the body..
+	bool accepts_encoding(http_request const &request, char const *coding)
+	{
+		http_request::header_string const * const accepted = find_header(request, "Accept-Encoding");
+		if (!accepted)
+		{
+			return false;
+		}
 
-		return request;
+		boost::string_ref list = *accepted;
+		bool wildcard = false;
+		while (!list.empty())
+		{
+			weighted_token const parsed = parse_weighted_token(split_off(list, ','));
+			if (boost::algorithm::iequals(parsed.token, coding))
+			{
+				//an explicit entry overrides the wildcard
+				return parsed.acceptable;
+			}
+			if (parsed.token == "*")
+			{
+				wildcard = parsed.acceptable;
+			}
+		}
+		return wildcard;
 	}
 }
@@ -2,6 +2,8 @@
 #define TEMPEST_HTTP_REQUEST_HPP
 
 
+#include <http/arena.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <string>
 #include <map>
 #include <istream>
@@ -11,15 +13,46 @@ namespace tempest
 {
 	typedef std::string url;
 
+	struct request_body;
+
 	struct http_request
 	{
+		//The headers are the many small allocations of a request, so they
+		//can be put into an arena. A copy of a request uses the heap.
+		typedef std::basic_string<char, std::char_traits<char>, arena_allocator<char> > header_string;
+		typedef std::map<header_string, header_string, std::less<header_string>,
+		                 arena_allocator<std::pair<header_string const, header_string> > > header_map;
+
 		std::string method;
 		url file;
 		std::string version;
-		std::map<std::string, std::string> headers;
+		header_map headers;
+
+		//Null if the request has no body. Only the server which received
+		//the request can read it, and only while it is being responded to.
+		request_body *body;
+
+		//the headers are allocated from the heap
+		http_request();
+
+		//The headers are allocated from the memory. They have to be cleared
+		//before the memory is reset.
+		explicit http_request(arena &memory);
 	};
 
 	http_request parse_request(std::istream &source);
+
+	//header names are compared case-insensitively
+	http_request::header_string const *find_header(http_request const &request,
+	                                               boost::string_ref name);
+
+	//HTTP/1.1 connections are persistent unless "Connection: close" is given,
+	//HTTP/1.0 connections only with "Connection: keep-alive"
+	bool wants_persistent_connection(http_request const &request);
+
+	//Whether Accept-Encoding allows a content coding like "gzip". Without
+	//the header only the identity is assumed to be acceptable.
+	bool accepts_encoding(http_request const &request, char const *coding);
 }
 
 
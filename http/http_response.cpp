@@ -1,24 +1,28 @@
 #include "http_response.hpp"
+#include "response_writer.hpp"
 #include <boost/foreach.hpp>
 
 
 namespace tempest
 {
-	void print_response(http_response const &response, std::ostream &out)
+	void write_response_header(http_response const &response,
+	                           std::string &destination)
 	{
-		//HTTP/1.1 200 OK\r\n
-		out << response.version << ' '
-		    << response.status << ' '
-		    << response.reason << "\r\n";
-
-		//key: value\r\n
+		response_writer writer(destination);
+		writer.status_line(response.version, response.status, response.reason);
 		BOOST_FOREACH (
 			http_response::header_map::value_type const &header,
 			response.headers)
 		{
-			out << header.first << ": " << header.second << "\r\n";
+			writer.header(header.first, header.second);
 		}
+	}
 
-		out << "\r\n";
+	void print_response(http_response const &response, std::ostream &out)
+	{
+		std::string rendered;
+		write_response_header(response, rendered);
+		rendered += "\r\n";
+		out.write(rendered.data(), static_cast<std::streamsize>(rendered.size()));
 	}
 }
@@ -19,6 +19,10 @@ namespace tempest
 		header_map headers;
 	};
 
+	//appends the status line and the headers without the empty line
+	void write_response_header(http_response const &response,
+	                           std::string &destination);
+
 	void print_response(http_response const &response, std::ostream &out);
 }
 
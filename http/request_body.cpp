@@ -0,0 +1,9 @@
+#include "request_body.hpp"
+
+
+namespace tempest
+{
+	request_body::~request_body()
+	{
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef TEMPEST_HTTP_REQUEST_BODY_HPP
+#define TEMPEST_HTTP_REQUEST_BODY_HPP
+
+
+#include <http/body_parser.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/utility/string_ref.hpp>
+
+
+namespace tempest
+{
+	//The body of a request, which is pulled piece by piece while the
+	//response is being made. The pieces are slices of the receive buffer,
+	//so only as much of a large upload is held in memory as that buffer.
+	//A body which has not been read when the response is complete is
+	//discarded.
+	struct request_body
+	{
+		typedef boost::function<void (boost::system::error_code)> wait_handler;
+
+		virtual ~request_body();
+
+		//Hands out the next piece which has already been received without
+		//waiting. The piece is valid until the next call of read or
+		//async_wait. body_incomplete means that async_wait has to be called.
+		virtual body_result read(boost::string_ref &piece) = 0;
+
+		//Calls the handler when read can hand out more. A client which has
+		//sent "Expect: 100-continue" is asked for the body by the first
+		//call, so it has to come before the response is sent. The handler is
+		//never called from within async_wait.
+		virtual void async_wait(wait_handler handler) = 0;
+
+		//the Content-Length or none for a chunked body
+		virtual boost::optional<boost::uint64_t> length() const = 0;
+	};
+}
+
+
+#endif
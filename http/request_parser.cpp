@@ -0,0 +1,247 @@
+#include "request_parser.hpp"
+#include "http_request.hpp"
+#include "decode_uri.hpp"
+#include "scan.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/foreach.hpp>
+#include <cstring>
+
+
+namespace tempest
+{
+	namespace
+	{
+		bool is_whitespace(char c)
+		{
+			return (c == ' ') || (c == '\t');
+		}
+
+		boost::string_ref make_slice(char const *data,
+		                             std::size_t begin,
+		                             std::size_t end)
+		{
+			return boost::string_ref(data + begin, end - begin);
+		}
+	}
+
+	request_limits::request_limits()
+	    : max_header_bytes(16 * 1024)
+	    , max_header_count(100)
+	{
+	}
+
+	boost::string_ref const *request_view::find_header(boost::string_ref name) const
+	{
+		BOOST_FOREACH (header_field const &header, headers)
+		{
+			if (boost::algorithm::iequals(header.name, name))
+			{
+				return &header.value;
+			}
+		}
+		return 0;
+	}
+
+	request_parser::request_parser(request_limits limits)
+	    : m_limits(limits)
+	{
+		reset();
+	}
+
+	parse_result request_parser::parse(char const *data, std::size_t size)
+	{
+		for (;;)
+		{
+			void const * const new_line =
+			        std::memchr(data + m_scanned, '\n', size - m_scanned);
+			if (!new_line)
+			{
+				m_scanned = size;
+				return (size > m_limits.max_header_bytes)
+				        ? parse_too_large : parse_incomplete;
+			}
+
+			std::size_t line_end =
+			        static_cast<std::size_t>(static_cast<char const *>(new_line) - data);
+			m_scanned = line_end + 1;
+			if (m_scanned > m_limits.max_header_bytes)
+			{
+				return parse_too_large;
+			}
+
+			//lines end with \r\n, but a single \n is tolerated
+			if ((line_end > m_line_begin) &&
+			    (data[line_end - 1] == '\r'))
+			{
+				--line_end;
+			}
+
+			parse_result const result = m_has_request_line
+			        ? parse_header_line(data, line_end)
+			        : parse_request_line(data, line_end);
+			m_line_begin = m_scanned;
+
+			if (result == parse_complete)
+			{
+				make_view(data);
+			}
+			if (result != parse_incomplete)
+			{
+				return result;
+			}
+		}
+	}
+
+	request_view const &request_parser::request() const
+	{
+		return m_view;
+	}
+
+	std::size_t request_parser::consumed() const
+	{
+		return m_scanned;
+	}
+
+	void request_parser::reset()
+	{
+		m_scanned = 0;
+		m_line_begin = 0;
+		m_has_request_line = false;
+		m_method_begin = m_method_end = 0;
+		m_target_begin = m_target_end = 0;
+		m_version_begin = m_version_end = 0;
+		m_fields.clear();
+	}
+
+	parse_result request_parser::parse_request_line(char const *data, std::size_t line_end)
+	{
+		//empty lines before the request line are ignored (RFC 7230 3.5)
+		if (line_end == m_line_begin)
+		{
+			return parse_incomplete;
+		}
+
+		//GET /file HTTP/1.1
+		char const * const line = data + m_line_begin;
+		std::size_t const length = line_end - m_line_begin;
+		char const * const method_end = static_cast<char const *>(std::memchr(line, ' ', length));
+		if (!method_end || (method_end == line))
+		{
+			return parse_bad_request;
+		}
+
+		m_method_begin = m_line_begin;
+		m_method_end = static_cast<std::size_t>(method_end - data);
+		m_target_begin = m_method_end + 1;
+		char const * const target_end = static_cast<char const *>(
+		            std::memchr(data + m_target_begin, ' ', line_end - m_target_begin));
+		if (!target_end)
+		{
+			return parse_bad_request;
+		}
+
+		m_target_end = static_cast<std::size_t>(target_end - data);
+		m_version_begin = m_target_end + 1;
+		m_version_end = line_end;
+		if ((m_target_end == m_target_begin) ||
+		    !boost::algorithm::starts_with(make_slice(data, m_version_begin, m_version_end), "HTTP/"))
+		{
+			return parse_bad_request;
+		}
+
+		m_has_request_line = true;
+		return parse_incomplete;
+	}
+
+	parse_result request_parser::parse_header_line(char const *data, std::size_t line_end)
+	{
+		//the head ends with an empty line
+		if (line_end == m_line_begin)
+		{
+			return parse_complete;
+		}
+
+		//obsolete line folding is not supported
+		if (is_whitespace(data[m_line_begin]))
+		{
+			return parse_bad_request;
+		}
+
+		if (m_fields.size() >= m_limits.max_header_count)
+		{
+			return parse_too_large;
+		}
+
+		//key: value
+		//a single scan finds the colon and whitespace in the name
+		char const * const line_end_pointer = data + line_end;
+		char const * const colon = find_first_of(data + m_line_begin, line_end_pointer,
+		                                         ':', ' ', '\t', ':');
+		if ((colon == line_end_pointer) ||
+		    (colon == data + m_line_begin) ||
+		    (*colon != ':'))
+		{
+			return parse_bad_request;
+		}
+
+		field_offsets field;
+		field.name_begin = m_line_begin;
+		field.name_end = static_cast<std::size_t>(colon - data);
+
+		field.value_begin = field.name_end + 1;
+		field.value_end = line_end;
+		while ((field.value_begin < field.value_end) &&
+		       is_whitespace(data[field.value_begin]))
+		{
+			++field.value_begin;
+		}
+		while ((field.value_end > field.value_begin) &&
+		       is_whitespace(data[field.value_end - 1]))
+		{
+			--field.value_end;
+		}
+
+		m_fields.push_back(field);
+		return parse_incomplete;
+	}
+
+	void request_parser::make_view(char const *data)
+	{
+		m_view.method = make_slice(data, m_method_begin, m_method_end);
+		m_view.target = make_slice(data, m_target_begin, m_target_end);
+		m_view.version = make_slice(data, m_version_begin, m_version_end);
+
+		m_view.headers.resize(m_fields.size());
+		for (std::size_t i = 0; i < m_fields.size(); ++i)
+		{
+			field_offsets const &offsets = m_fields[i];
+			m_view.headers[i].name = make_slice(data, offsets.name_begin, offsets.name_end);
+			m_view.headers[i].value = make_slice(data, offsets.value_begin, offsets.value_end);
+		}
+	}
+
+	http_request make_request(request_view const &view)
+	{
+		http_request request;
+		make_request(view, request);
+		return request;
+	}
+
+	void make_request(request_view const &view, http_request &request)
+	{
+		request.method.assign(view.method.begin(), view.method.end());
+		request.file.assign(view.target.begin(), view.target.end());
+		decode_uri(request.file);
+		request.version.assign(view.version.begin(), view.version.end());
+		request.body = 0;
+
+		request.headers.clear();
+		arena_allocator<char> const memory = request.headers.get_allocator();
+		BOOST_FOREACH (header_field const &header, view.headers)
+		{
+			request.headers.insert(std::make_pair(
+			    http_request::header_string(header.name.begin(), header.name.end(), memory),
+			    http_request::header_string(header.value.begin(), header.value.end(), memory)));
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef TEMPEST_HTTP_REQUEST_PARSER_HPP
+#define TEMPEST_HTTP_REQUEST_PARSER_HPP
+
+
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <vector>
+
+
+namespace tempest
+{
+	struct http_request;
+
+	struct request_limits
+	{
+		//request line and headers including the empty line at the end
+		std::size_t max_header_bytes;
+		std::size_t max_header_count;
+
+		request_limits();
+	};
+
+	struct header_field
+	{
+		boost::string_ref name;
+		boost::string_ref value;
+	};
+
+	//Non-owning slices of a request head in a receive buffer
+	struct request_view
+	{
+		boost::string_ref method;
+		boost::string_ref target;
+		boost::string_ref version;
+		std::vector<header_field> headers;
+
+		//header names are compared case-insensitively
+		boost::string_ref const *find_header(boost::string_ref name) const;
+	};
+
+	enum parse_result
+	{
+		parse_incomplete,
+		parse_complete,
+		parse_bad_request,
+		parse_too_large
+	};
+
+	//A resumable parser for the head of a request (request line and headers)
+	//which works directly on a contiguous receive buffer.
+	struct request_parser
+	{
+		explicit request_parser(request_limits limits = request_limits());
+
+		//The data begins with the request and contains every byte received
+		//so far. The buffer may have moved since the previous call because
+		//only offsets are remembered. Scanning continues where the previous
+		//call stopped.
+		parse_result parse(char const *data, std::size_t size);
+
+		//valid after parse_complete until the data given to parse changes
+		request_view const &request() const;
+
+		//the length of the request head after parse_complete
+		std::size_t consumed() const;
+
+		//prepares the parser for the next request, keeps allocated memory
+		void reset();
+
+	private:
+
+		struct field_offsets
+		{
+			std::size_t name_begin, name_end;
+			std::size_t value_begin, value_end;
+		};
+
+		request_limits m_limits;
+		std::size_t m_scanned;
+		std::size_t m_line_begin;
+		bool m_has_request_line;
+		std::size_t m_method_begin, m_method_end;
+		std::size_t m_target_begin, m_target_end;
+		std::size_t m_version_begin, m_version_end;
+		std::vector<field_offsets> m_fields;
+		request_view m_view;
+
+		parse_result parse_request_line(char const *data, std::size_t line_end);
+		parse_result parse_header_line(char const *data, std::size_t line_end);
+		void make_view(char const *data);
+	};
+
+	//convenience layer for code using http_request
+	http_request make_request(request_view const &view);
+
+	//Overwrites a request which is reused for every request of a
+	//connection. The strings keep their memory and the headers are
+	//allocated where the previous ones were.
+	void make_request(request_view const &view, http_request &request);
+}
+
+
+#endif
@@ -0,0 +1,72 @@
+#include "response_writer.hpp"
+
+
+namespace tempest
+{
+	char *format_decimal(boost::uint64_t value, char *end)
+	{
+		char *first = end;
+		do
+		{
+			--first;
+			*first = static_cast<char>('0' + (value % 10));
+			value /= 10;
+		}
+		while (value != 0);
+		return first;
+	}
+
+	response_writer::response_writer(std::string &destination)
+	    : m_destination(destination)
+	{
+	}
+
+	void response_writer::status_line(boost::string_ref version,
+	                                  unsigned status,
+	                                  boost::string_ref reason)
+	{
+		char digits[max_decimal_length];
+		char * const end = digits + sizeof(digits);
+		char * const first = format_decimal(status, end);
+
+		append(version);
+		m_destination += ' ';
+		append(boost::string_ref(first, static_cast<std::size_t>(end - first)));
+		m_destination += ' ';
+		append(reason);
+		append("\r\n");
+	}
+
+	void response_writer::header(boost::string_ref name, boost::string_ref value)
+	{
+		append(name);
+		append(": ");
+		append(value);
+		append("\r\n");
+	}
+
+	void response_writer::header(boost::string_ref name, boost::uint64_t value)
+	{
+		char digits[max_decimal_length];
+		char * const end = digits + sizeof(digits);
+		char * const first = format_decimal(value, end);
+		header(name, boost::string_ref(first, static_cast<std::size_t>(end - first)));
+	}
+
+	void response_writer::date_header(boost::string_ref name, boost::int64_t seconds)
+	{
+		char date[http_date_length];
+		format_http_date(seconds, date);
+		header(name, boost::string_ref(date, sizeof(date)));
+	}
+
+	void response_writer::end()
+	{
+		append("\r\n");
+	}
+
+	void response_writer::append(boost::string_ref piece)
+	{
+		m_destination.append(piece.data(), piece.size());
+	}
+}
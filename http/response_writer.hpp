@@ -0,0 +1,50 @@
+#ifndef TEMPEST_HTTP_RESPONSE_WRITER_HPP
+#define TEMPEST_HTTP_RESPONSE_WRITER_HPP
+
+
+#include "http_date.hpp"
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <string>
+
+
+namespace tempest
+{
+	//the longest decimal representation of a 64 bit integer
+	std::size_t const max_decimal_length = 20;
+
+	//Writes the digits so that the last one is in front of end. Returns the
+	//first digit.
+	char *format_decimal(boost::uint64_t value, char *end);
+
+	//Appends a response header to a byte buffer. The buffer is meant to be
+	//cleared and used again so that its capacity is allocated only once.
+	struct response_writer
+	{
+		explicit response_writer(std::string &destination);
+
+		//HTTP/1.1 200 OK\r\n
+		void status_line(boost::string_ref version,
+		                 unsigned status,
+		                 boost::string_ref reason);
+
+		//key: value\r\n
+		void header(boost::string_ref name, boost::string_ref value);
+		void header(boost::string_ref name, boost::uint64_t value);
+
+		//Last-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n
+		void date_header(boost::string_ref name, boost::int64_t seconds);
+
+		//the empty line after the headers
+		void end();
+
+	private:
+
+		std::string &m_destination;
+
+		void append(boost::string_ref piece);
+	};
+}
+
+
+#endif
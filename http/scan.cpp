@@ -0,0 +1,109 @@
+#include "scan.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	define TEMPEST_HTTP_SCAN_X86 1
+#	include <immintrin.h>
+#else
+#	define TEMPEST_HTTP_SCAN_X86 0
+#endif
+
+
+namespace tempest
+{
+	namespace detail
+	{
+		char const *find_first_of_scalar(char const *begin, char const *end,
+		                                 char a, char b, char c, char d)
+		{
+			for (; begin != end; ++begin)
+			{
+				char const current = *begin;
+				if ((current == a) || (current == b) ||
+				    (current == c) || (current == d))
+				{
+					break;
+				}
+			}
+			return begin;
+		}
+	}
+
+	namespace
+	{
+		typedef char const *(*find_first_of_function)(char const *, char const *,
+		                                               char, char, char, char);
+
+#if TEMPEST_HTTP_SCAN_X86
+		//SSE2 is part of every x86-64 CPU
+		char const *find_first_of_sse2(char const *begin, char const *end,
+		                               char a, char b, char c, char d)
+		{
+			__m128i const needle_a = _mm_set1_epi8(a);
+			__m128i const needle_b = _mm_set1_epi8(b);
+			__m128i const needle_c = _mm_set1_epi8(c);
+			__m128i const needle_d = _mm_set1_epi8(d);
+			while ((end - begin) >= 16)
+			{
+				__m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(begin));
+				__m128i const found = _mm_or_si128(
+				            _mm_or_si128(_mm_cmpeq_epi8(block, needle_a), _mm_cmpeq_epi8(block, needle_b)),
+				            _mm_or_si128(_mm_cmpeq_epi8(block, needle_c), _mm_cmpeq_epi8(block, needle_d)));
+				int const mask = _mm_movemask_epi8(found);
+				if (mask)
+				{
+					return begin + __builtin_ctz(static_cast<unsigned>(mask));
+				}
+				begin += 16;
+			}
+			return detail::find_first_of_scalar(begin, end, a, b, c, d);
+		}
+
+		__attribute__((target("avx2")))
+		char const *find_first_of_avx2(char const *begin, char const *end,
+		                               char a, char b, char c, char d)
+		{
+			__m256i const needle_a = _mm256_set1_epi8(a);
+			__m256i const needle_b = _mm256_set1_epi8(b);
+			__m256i const needle_c = _mm256_set1_epi8(c);
+			__m256i const needle_d = _mm256_set1_epi8(d);
+			while ((end - begin) >= 32)
+			{
+				__m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(begin));
+				__m256i const found = _mm256_or_si256(
+				            _mm256_or_si256(_mm256_cmpeq_epi8(block, needle_a), _mm256_cmpeq_epi8(block, needle_b)),
+				            _mm256_or_si256(_mm256_cmpeq_epi8(block, needle_c), _mm256_cmpeq_epi8(block, needle_d)));
+				int const mask = _mm256_movemask_epi8(found);
+				if (mask)
+				{
+					return begin + __builtin_ctz(static_cast<unsigned>(mask));
+				}
+				begin += 32;
+			}
+			//the rest of up to 31 bytes
+			return find_first_of_sse2(begin, end, a, b, c, d);
+		}
+#endif
+
+		find_first_of_function select_find_first_of()
+		{
+#if TEMPEST_HTTP_SCAN_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+			{
+				return &find_first_of_avx2;
+			}
+			return &find_first_of_sse2;
+#else
+			return &detail::find_first_of_scalar;
+#endif
+		}
+	}
+
+	char const *find_first_of(char const *begin, char const *end,
+	                          char a, char b, char c, char d)
+	{
+		//a local static so that it is ready for callers during static initialization
+		static find_first_of_function const selected = select_find_first_of();
+		return selected(begin, end, a, b, c, d);
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef TEMPEST_HTTP_SCAN_HPP
+#define TEMPEST_HTTP_SCAN_HPP
+
+
+namespace tempest
+{
+	//Returns the first character in [begin, end) which equals one of the
+	//four given characters, or end. Pass a character repeatedly to search
+	//for fewer. Blocks of 32 (AVX2) or 16 (SSE2) bytes are compared at
+	//once when the CPU supports it, which is checked once at startup.
+	char const *find_first_of(char const *begin, char const *end,
+	                          char a, char b, char c, char d);
+
+	namespace detail
+	{
+		//the portable version for comparison
+		char const *find_first_of_scalar(char const *begin, char const *end,
+		                                 char a, char b, char c, char d);
+	}
+}
+
+
+#endif
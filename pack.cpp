@@ -0,0 +1,52 @@
+#include <tempest/archive.hpp>
+#include <boost/chrono.hpp>
+#include <boost/program_options.hpp>
+#include <iostream>
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+	std::string directory;
+	std::string archive;
+
+	po::options_description options("Packs a directory tree into an archive which tempestd serves with --archive");
+	options.add_options()
+		("help,h", "produce help message to stdout and exit")
+		("dir", po::value(&directory), "the directory to pack, including the precompressed files")
+		("out", po::value(&archive), "the archive to write, replaced when it is complete")
+		;
+
+	po::positional_options_description positions;
+	positions.add("dir", 1);
+	positions.add("out", 1);
+
+	po::variables_map variables;
+	po::store(po::command_line_parser(argc, argv).options(options).positional(positions).run(),
+			  variables);
+	po::notify(variables);
+
+	if (variables.count("help"))
+	{
+		std::cout << options << '\n';
+		return 0;
+	}
+
+	if (!variables.count("dir") || !variables.count("out"))
+	{
+		std::cout << "'dir' and 'out' arguments required\n\n";
+		std::cout << options << '\n';
+		return 1;
+	}
+
+	boost::chrono::steady_clock::time_point const started = boost::chrono::steady_clock::now();
+	tempest::pack_summary const summary = tempest::pack_directory(directory, archive);
+	boost::chrono::milliseconds const duration =
+	        boost::chrono::duration_cast<boost::chrono::milliseconds>(boost::chrono::steady_clock::now() - started);
+
+	std::cout << "files: " << summary.files
+	          << ", precompressed variants: " << summary.precompressed << '\n';
+	std::cout << "bytes: " << summary.body_bytes
+	          << " -> " << summary.archive_bytes
+	          << " in " << duration.count() << " ms\n";
+}
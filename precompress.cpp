@@ -0,0 +1,185 @@
+#include <tempest/content_type.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/version.hpp>
+#include <iostream>
+
+#if BOOST_VERSION >= 107200
+//the directory iterators used to be declared in operations.hpp
+#	include <boost/filesystem/directory.hpp>
+#endif
+
+
+namespace tempest
+{
+	namespace precompress
+	{
+		struct summary
+		{
+			std::size_t compressed;
+			std::size_t up_to_date;
+			std::size_t skipped;
+			boost::uintmax_t original_bytes;
+			boost::uintmax_t compressed_bytes;
+
+			summary()
+			    : compressed(0)
+			    , up_to_date(0)
+			    , skipped(0)
+			    , original_bytes(0)
+			    , compressed_bytes(0)
+			{
+			}
+		};
+
+		//Media which are already compressed are not worth the effort.
+		bool is_compressible(boost::filesystem::path const &file)
+		{
+			boost::string_ref const type = find_content_type(file.string());
+			return type.starts_with("text/") ||
+			       type.starts_with("application/json") ||
+			       type.starts_with("application/xml") ||
+			       type.starts_with("application/wasm") ||
+			       type.starts_with("image/svg+xml") ||
+			       type.starts_with("image/bmp") ||
+			       type.starts_with("image/x-icon") ||
+			       type.starts_with("font/otf") ||
+			       type.starts_with("font/ttf");
+		}
+
+		//The sidecar gets the modification time of the original so that
+		//both are served with the same Last-Modified and so that an
+		//outdated sidecar can be recognized.
+		void compress_file(boost::filesystem::path const &original,
+		                   int level,
+		                   boost::uintmax_t min_size,
+		                   summary &summary)
+		{
+			boost::uintmax_t const original_size = boost::filesystem::file_size(original);
+			std::time_t const modified = boost::filesystem::last_write_time(original);
+			boost::filesystem::path const sidecar = original.string() + ".gz";
+
+			if (original_size < min_size || !is_compressible(original))
+			{
+				++summary.skipped;
+				return;
+			}
+
+			if (boost::filesystem::is_regular_file(sidecar) &&
+			    boost::filesystem::last_write_time(sidecar) == modified)
+			{
+				++summary.up_to_date;
+				return;
+			}
+
+			boost::filesystem::path const temporary = sidecar.string() + ".tmp";
+			{
+				boost::filesystem::ifstream in(original, std::ios::binary);
+				boost::filesystem::ofstream out(temporary, std::ios::binary);
+				boost::iostreams::filtering_ostream compressor;
+				compressor.push(boost::iostreams::gzip_compressor(
+				                    boost::iostreams::gzip_params(level)));
+				compressor.push(out);
+				boost::iostreams::copy(in, compressor);
+			}
+
+			boost::uintmax_t const compressed_size = boost::filesystem::file_size(temporary);
+			if (compressed_size >= original_size)
+			{
+				//the client would only have to decompress for nothing
+				boost::filesystem::remove(temporary);
+				boost::filesystem::remove(sidecar);
+				++summary.skipped;
+				return;
+			}
+
+			boost::filesystem::last_write_time(temporary, modified);
+			boost::filesystem::rename(temporary, sidecar);
+			++summary.compressed;
+			summary.original_bytes += original_size;
+			summary.compressed_bytes += compressed_size;
+		}
+
+		bool is_sidecar(boost::filesystem::path const &file)
+		{
+			boost::filesystem::path const extension = file.extension();
+			return (extension == ".gz") ||
+			       (extension == ".br") ||
+			       (extension == ".tmp");
+		}
+	}
+}
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+	using namespace tempest::precompress;
+
+	std::string directory;
+	int level = 9;
+	boost::uintmax_t min_size = 256;
+
+	po::options_description options("Writes a .gz file next to every compressible file of a directory tree");
+	options.add_options()
+		("help,h", "produce help message to stdout and exit")
+		("dir", po::value(&directory), "the directory served by tempestd")
+		("level", po::value(&level), ("the gzip compression level from 1 to 9 (default: " +
+		                              boost::lexical_cast<std::string>(level) + ")").c_str())
+		("min-size", po::value(&min_size), ("smaller files are not compressed (default: " +
+		                                    boost::lexical_cast<std::string>(min_size) + ")").c_str())
+		;
+
+	po::positional_options_description positions;
+	positions.add("dir", 1);
+
+	po::variables_map variables;
+	po::store(po::command_line_parser(argc, argv).options(options).positional(positions).run(),
+			  variables);
+	po::notify(variables);
+
+	if (variables.count("help"))
+	{
+		std::cout << options << '\n';
+		return 0;
+	}
+
+	if (!variables.count("dir"))
+	{
+		std::cout << "'dir' argument required\n\n";
+		std::cout << options << '\n';
+		return 1;
+	}
+
+	if (level < 1 || level > 9)
+	{
+		std::cout << "'level' has to be between 1 and 9\n";
+		return 1;
+	}
+
+	summary summary;
+	for (boost::filesystem::recursive_directory_iterator i(directory), end; i != end; ++i)
+	{
+		boost::filesystem::path const &file = i->path();
+		if (!boost::filesystem::is_regular_file(file) ||
+		    is_sidecar(file))
+		{
+			continue;
+		}
+		compress_file(file, level, min_size, summary);
+	}
+
+	std::cout << "compressed: " << summary.compressed
+	          << ", up to date: " << summary.up_to_date
+	          << ", skipped: " << summary.skipped << '\n';
+	if (summary.compressed > 0)
+	{
+		std::cout << "bytes: " << summary.original_bytes
+		          << " -> " << summary.compressed_bytes << '\n';
+	}
+}
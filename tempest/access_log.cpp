@@ -0,0 +1,385 @@
+#include "access_log.hpp"
+#include "http/http_date.hpp"
+#include "http/response_writer.hpp"
+#include <boost/bind.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace tempest
+{
+	namespace
+	{
+		//the records written together at most
+		std::size_t const max_batch = 256;
+
+		void append_decimal(std::string &destination, boost::uint64_t value)
+		{
+			char digits[max_decimal_length];
+			char * const end = digits + max_decimal_length;
+			destination.append(format_decimal(value, end), end);
+		}
+
+		//Control characters, quotes and backslashes are written as \xHH so
+		//that a request cannot forge lines or fields.
+		void append_escaped(std::string &destination, char const *text, std::size_t length)
+		{
+			static char const hex[] = "0123456789abcdef";
+			for (std::size_t i = 0; i < length; ++i)
+			{
+				unsigned char const c = static_cast<unsigned char>(text[i]);
+				if ((c < 0x20) || (c == 0x7f) || (c == '"') || (c == '\\'))
+				{
+					destination += "\\x";
+					destination += hex[c >> 4];
+					destination += hex[c & 15];
+				}
+				else
+				{
+					destination += static_cast<char>(c);
+				}
+			}
+		}
+
+		void append_little_endian(std::string &destination, boost::uint64_t value, std::size_t size)
+		{
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				destination += static_cast<char>((value >> (8 * i)) & 0xff);
+			}
+		}
+
+		boost::int64_t now_since_epoch()
+		{
+			return boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+			            boost::chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		//unbuffered so that a batch is written at once, returns null on
+		//failure
+		std::FILE *open_for_appending(std::string const &path)
+		{
+			std::FILE * const file = std::fopen(path.c_str(), "ab");
+			if (file)
+			{
+				std::setvbuf(file, 0, _IONBF, 0);
+			}
+			return file;
+		}
+
+		std::size_t copy_truncated(boost::string_ref from, char *to, std::size_t capacity)
+		{
+			std::size_t const length = (std::min)(from.size(), capacity);
+			std::memcpy(to, from.data(), length);
+			return length;
+		}
+	}
+
+	access_log_options::access_log_options()
+	    : format("%t \"%m %U\" %s %b %D")
+	    , binary(false)
+	    , capacity(4096)
+	    , idle_interval(10)
+	{
+	}
+
+	access_log::access_log(access_log_options const &options)
+	    : m_options(options)
+	    , m_queue(options.capacity)
+	    , m_dropped(0)
+	    , m_reopen(false)
+	    , m_file(0)
+	{
+		std::string const &format = m_options.format;
+		std::string literal;
+		for (std::size_t i = 0; i < format.size(); ++i)
+		{
+			if (format[i] != '%')
+			{
+				literal += format[i];
+				continue;
+			}
+			if (i + 1 == format.size())
+			{
+				throw std::invalid_argument("The log format ends with a %");
+			}
+			char const placeholder = format[++i];
+			if (placeholder == '%')
+			{
+				literal += '%';
+				continue;
+			}
+
+			format_piece piece;
+			switch (placeholder)
+			{
+			case 't': piece.what = time_field; break;
+			case 'm': piece.what = method_field; break;
+			case 'U': piece.what = path_field; break;
+			case 's': piece.what = status_field; break;
+			case 'b': piece.what = bytes_field; break;
+			case 'D': piece.what = duration_field; break;
+			default:
+				throw std::invalid_argument(std::string("Unknown log format placeholder %") + placeholder);
+			}
+			if (!literal.empty())
+			{
+				format_piece text;
+				text.what = literal_field;
+				text.literal.swap(literal);
+				m_format.push_back(text);
+			}
+			m_format.push_back(piece);
+		}
+		if (!literal.empty())
+		{
+			format_piece text;
+			text.what = literal_field;
+			text.literal.swap(literal);
+			m_format.push_back(text);
+		}
+
+		open_file();
+		m_writer.reset(new boost::thread(boost::bind(&access_log::run_writer, this)));
+	}
+
+	access_log::~access_log()
+	{
+		m_writer->interrupt();
+		m_writer->join();
+		close_file();
+	}
+
+	void access_log::log_request(boost::string_ref method,
+	                             boost::string_ref path,
+	                             unsigned status,
+	                             boost::uint64_t bytes,
+	                             boost::chrono::steady_clock::duration duration)
+	{
+		record entry;
+		entry.kind = request_record;
+		entry.method_length = static_cast<boost::uint8_t>(copy_truncated(method, entry.method, sizeof(entry.method)));
+		entry.text_length = static_cast<boost::uint16_t>(copy_truncated(path, entry.text, sizeof(entry.text)));
+		entry.status = static_cast<boost::uint16_t>(status);
+		entry.time = now_since_epoch();
+		entry.duration = static_cast<boost::uint64_t>((std::max)(boost::int64_t(0),
+		    static_cast<boost::int64_t>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(duration).count())));
+		entry.bytes = bytes;
+		push(entry);
+	}
+
+	void access_log::log_error(boost::string_ref message)
+	{
+		record entry;
+		entry.kind = error_record;
+		entry.method_length = 0;
+		entry.text_length = static_cast<boost::uint16_t>(copy_truncated(message, entry.text, sizeof(entry.text)));
+		entry.status = 0;
+		entry.time = now_since_epoch();
+		entry.duration = 0;
+		entry.bytes = 0;
+		push(entry);
+	}
+
+	void access_log::reopen()
+	{
+		m_reopen.store(true, boost::memory_order_release);
+	}
+
+	boost::uint64_t access_log::dropped() const
+	{
+		return m_dropped.load(boost::memory_order_relaxed);
+	}
+
+	void access_log::push(record const &entry)
+	{
+		if (!m_queue.try_push(entry))
+		{
+			m_dropped.fetch_add(1, boost::memory_order_relaxed);
+		}
+	}
+
+	void access_log::run_writer()
+	{
+		std::string batch;
+		boost::uint64_t reported_drops = 0;
+		try
+		{
+			for (;;)
+			{
+				if (!write_batch(batch, reported_drops))
+				{
+					boost::this_thread::sleep_for(m_options.idle_interval);
+				}
+			}
+		}
+		catch (boost::thread_interrupted const &)
+		{
+			//everything logged before the destructor is written
+			while (write_batch(batch, reported_drops))
+			{
+			}
+		}
+	}
+
+	bool access_log::write_batch(std::string &batch, boost::uint64_t &reported_drops)
+	{
+		batch.clear();
+		bool popped = false;
+		record entry;
+		for (std::size_t i = 0; (i < max_batch) && m_queue.try_pop(entry); ++i)
+		{
+			popped = true;
+			format_record(entry, batch);
+		}
+
+		boost::uint64_t const drops = m_dropped.load(boost::memory_order_relaxed);
+		if (drops != reported_drops)
+		{
+			std::string message = "the log was full, ";
+			append_decimal(message, drops - reported_drops);
+			message += " records have been dropped";
+			reported_drops = drops;
+
+			record notice;
+			notice.kind = error_record;
+			notice.method_length = 0;
+			notice.text_length = static_cast<boost::uint16_t>(copy_truncated(message, notice.text, sizeof(notice.text)));
+			notice.status = 0;
+			notice.time = now_since_epoch();
+			notice.duration = 0;
+			notice.bytes = 0;
+			format_record(notice, batch);
+		}
+
+		//Checked after taking the records, so that a record logged after a
+		//call to reopen is never written to the old file.
+		if (m_reopen.exchange(false, boost::memory_order_acq_rel))
+		{
+			reopen_file();
+		}
+
+		if (!batch.empty() && m_file)
+		{
+			//the stream is unbuffered, so this is a single write in general
+			if (std::fwrite(batch.data(), 1, batch.size(), m_file) != batch.size())
+			{
+				//there is no better place to report a failing log
+				std::clearerr(m_file);
+			}
+		}
+		return popped;
+	}
+
+	void access_log::format_record(record const &entry, std::string &destination) const
+	{
+		if (m_options.binary)
+		{
+			append_little_endian(destination, entry.kind, 1);
+			append_little_endian(destination, entry.method_length, 1);
+			append_little_endian(destination, entry.text_length, 2);
+			append_little_endian(destination, entry.status, 2);
+			append_little_endian(destination, 0, 2);
+			append_little_endian(destination, static_cast<boost::uint64_t>(entry.time), 8);
+			append_little_endian(destination, entry.duration, 8);
+			append_little_endian(destination, entry.bytes, 8);
+			destination.append(entry.method, entry.method_length);
+			destination.append(entry.text, entry.text_length);
+			return;
+		}
+
+		boost::int64_t const seconds = entry.time / 1000000000;
+		if (entry.kind == error_record)
+		{
+			char date[http_date_length];
+			format_http_date(seconds, date);
+			destination.append(date, http_date_length);
+			destination += " error: ";
+			append_escaped(destination, entry.text, entry.text_length);
+			destination += '\n';
+			return;
+		}
+
+		for (std::vector<format_piece>::const_iterator piece = m_format.begin(); piece != m_format.end(); ++piece)
+		{
+			switch (piece->what)
+			{
+			case literal_field:
+				destination += piece->literal;
+				break;
+
+			case time_field:
+				{
+					char date[http_date_length];
+					format_http_date(seconds, date);
+					destination.append(date, http_date_length);
+					break;
+				}
+
+			case method_field:
+				append_escaped(destination, entry.method, entry.method_length);
+				break;
+
+			case path_field:
+				append_escaped(destination, entry.text, entry.text_length);
+				break;
+
+			case status_field:
+				append_decimal(destination, entry.status);
+				break;
+
+			case bytes_field:
+				append_decimal(destination, entry.bytes);
+				break;
+
+			case duration_field:
+				append_decimal(destination, entry.duration / 1000);
+				break;
+			}
+		}
+		destination += '\n';
+	}
+
+	void access_log::open_file()
+	{
+		if (m_options.path.empty())
+		{
+			m_file = stderr;
+			return;
+		}
+
+		m_file = open_for_appending(m_options.path);
+		if (!m_file)
+		{
+			throw boost::system::system_error(errno, boost::system::system_category());
+		}
+	}
+
+	void access_log::reopen_file()
+	{
+		if (m_options.path.empty())
+		{
+			return;
+		}
+
+		//a failed rotation keeps the previous file
+		std::FILE * const replacement = open_for_appending(m_options.path);
+		if (replacement)
+		{
+			close_file();
+			m_file = replacement;
+		}
+	}
+
+	void access_log::close_file()
+	{
+		if (m_file && (m_file != stderr))
+		{
+			std::fclose(m_file);
+		}
+		m_file = 0;
+	}
+}
@@ -0,0 +1,140 @@
+#ifndef TEMPEST_ACCESS_LOG_HPP
+#define TEMPEST_ACCESS_LOG_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/bounded_queue.hpp>
+#include <boost/atomic.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	struct access_log_options
+	{
+		//the file which the records are appended to, stderr if empty
+		std::string path;
+
+		//The line of a request in the text mode. The placeholders are %t
+		//(the date as in HTTP), %m (the method), %U (the decoded path), %s
+		//(the status), %b (the bytes of the response), %D (the duration in
+		//microseconds) and %% for a percent sign.
+		std::string format;
+
+		//writes records as described at access_log instead of text lines
+		bool binary;
+
+		//how many records can wait for the writer before new ones are
+		//dropped
+		std::size_t capacity;
+
+		//how long the writer sleeps when there is nothing to write
+		boost::chrono::milliseconds idle_interval;
+
+		access_log_options();
+	};
+
+	//Collects the requests and errors of a server in a bounded queue, so
+	//that logging never blocks and never allocates in the threads which
+	//handle the requests. A background thread writes everything it finds in
+	//the queue with one write per batch. When the queue is full new records
+	//are dropped and counted, and the writer reports the number of dropped
+	//records in the log.
+	//A record of the binary mode consists of these little-endian fields:
+	//  u8 kind (0 request, 1 error), u8 method length, u16 text length,
+	//  u16 status, u16 zero, i64 time in ns since 1970, u64 duration in ns,
+	//  u64 bytes, the method, the text (the path or the error message)
+	struct access_log TEMPEST_FINAL : boost::noncopyable
+	{
+		//Throws std::invalid_argument for an unknown placeholder and
+		//boost::system::system_error if the file cannot be opened.
+		explicit access_log(access_log_options const &options);
+
+		//writes the remaining records
+		~access_log();
+
+		//longer paths and messages are truncated
+		static std::size_t const max_text_length = 200;
+
+		void log_request(boost::string_ref method,
+		                 boost::string_ref path,
+		                 unsigned status,
+		                 boost::uint64_t bytes,
+		                 boost::chrono::steady_clock::duration duration);
+
+		void log_error(boost::string_ref message);
+
+		//The file is closed and opened again before the next write, so that
+		//it can be rotated by renaming it first.
+		void reopen();
+
+		//the number of records which did not fit into the queue
+		boost::uint64_t dropped() const;
+
+	private:
+
+		enum record_kind
+		{
+			request_record,
+			error_record
+		};
+
+		struct record
+		{
+			boost::uint8_t kind;
+			boost::uint8_t method_length;
+			boost::uint16_t text_length;
+			boost::uint16_t status;
+			boost::int64_t time;
+			boost::uint64_t duration;
+			boost::uint64_t bytes;
+			char method[16];
+			char text[max_text_length];
+		};
+
+		enum field
+		{
+			literal_field,
+			time_field,
+			method_field,
+			path_field,
+			status_field,
+			bytes_field,
+			duration_field
+		};
+
+		struct format_piece
+		{
+			field what;
+			std::string literal;
+		};
+
+		access_log_options const m_options;
+		std::vector<format_piece> m_format;
+		bounded_queue<record> m_queue;
+		boost::atomic<boost::uint64_t> m_dropped;
+		boost::atomic<bool> m_reopen;
+		std::FILE *m_file;
+		boost::scoped_ptr<boost::thread> m_writer;
+
+
+		void push(record const &entry);
+		void run_writer();
+		bool write_batch(std::string &batch, boost::uint64_t &reported_drops);
+		void format_record(record const &entry, std::string &destination) const;
+		void open_file();
+		void reopen_file();
+		void close_file();
+	};
+}
+
+
+#endif
@@ -0,0 +1,121 @@
+#include "admission.hpp"
+#include "responses.hpp"
+
+
+namespace tempest
+{
+	namespace
+	{
+		//Counts one more unless the counter has reached the limit already.
+		//A limit of zero means no limit.
+		bool try_increment(boost::atomic<std::size_t> &counter, std::size_t limit)
+		{
+			std::size_t current = counter.load(boost::memory_order_relaxed);
+			do
+			{
+				if (limit && (current >= limit))
+				{
+					return false;
+				}
+			}
+			while (!counter.compare_exchange_weak(current, current + 1, boost::memory_order_relaxed));
+			return true;
+		}
+
+		bool is_full(boost::atomic<std::size_t> const &counter, std::size_t limit)
+		{
+			return limit && (counter.load(boost::memory_order_relaxed) >= limit);
+		}
+	}
+
+	admission_options::admission_options()
+	    : max_connections(0)
+	    , max_requests(0)
+	    , policy(pause_policy)
+	    , retry_after_seconds(1)
+	    , pause_interval(boost::posix_time::milliseconds(10))
+	{
+	}
+
+	admission_control::admission_control(admission_options const &options)
+	    : m_options(options)
+	    , m_rejection(render_unavailable_response(options.retry_after_seconds))
+	    , m_connections(0)
+	    , m_requests(0)
+	    , m_rejected_connections(0)
+	    , m_rejected_requests(0)
+	    , m_accept_pauses(0)
+	{
+	}
+
+	admission_options const &admission_control::options() const
+	{
+		return m_options;
+	}
+
+	bool admission_control::try_open_connection()
+	{
+		if (m_options.policy == pause_policy)
+		{
+			//the acceptor has checked the limit before accepting
+			m_connections.fetch_add(1, boost::memory_order_relaxed);
+			return true;
+		}
+		if (try_increment(m_connections, m_options.max_connections))
+		{
+			return true;
+		}
+		m_rejected_connections.fetch_add(1, boost::memory_order_relaxed);
+		return false;
+	}
+
+	void admission_control::close_connection()
+	{
+		m_connections.fetch_sub(1, boost::memory_order_relaxed);
+	}
+
+	bool admission_control::try_begin_request()
+	{
+		if (try_increment(m_requests, m_options.max_requests))
+		{
+			return true;
+		}
+		m_rejected_requests.fetch_add(1, boost::memory_order_relaxed);
+		return false;
+	}
+
+	void admission_control::end_request()
+	{
+		m_requests.fetch_sub(1, boost::memory_order_relaxed);
+	}
+
+	bool admission_control::should_pause() const
+	{
+		//Saturated request handling is a reason to stop taking more work as
+		//well. The connections which are open already are still served.
+		return (m_options.policy == pause_policy) &&
+		       (is_full(m_connections, m_options.max_connections) ||
+		        is_full(m_requests, m_options.max_requests));
+	}
+
+	void admission_control::count_pause()
+	{
+		m_accept_pauses.fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	boost::asio::const_buffer admission_control::rejection() const
+	{
+		return boost::asio::buffer(m_rejection);
+	}
+
+	admission_statistics admission_control::statistics() const
+	{
+		admission_statistics result;
+		result.connections = m_connections.load(boost::memory_order_relaxed);
+		result.requests = m_requests.load(boost::memory_order_relaxed);
+		result.rejected_connections = m_rejected_connections.load(boost::memory_order_relaxed);
+		result.rejected_requests = m_rejected_requests.load(boost::memory_order_relaxed);
+		result.accept_pauses = m_accept_pauses.load(boost::memory_order_relaxed);
+		return result;
+	}
+}
@@ -0,0 +1,107 @@
+#ifndef TEMPEST_ADMISSION_HPP
+#define TEMPEST_ADMISSION_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+
+
+namespace tempest
+{
+	//what happens to the connections which arrive while the server is full
+	enum overload_policy
+	{
+		//The acceptors stop accepting until there is room again, so the
+		//connections wait in the backlog of the kernel.
+		pause_policy,
+
+		//The connections are accepted and answered with a 503 response.
+		reject_policy
+	};
+
+	struct admission_options
+	{
+		//zero means no limit
+		std::size_t max_connections;
+
+		//The number of requests which are being responded to at the same
+		//time. A request over the limit is always answered with a 503
+		//response. Zero means no limit.
+		std::size_t max_requests;
+
+		overload_policy policy;
+
+		//the value of the Retry-After header of the 503 response
+		unsigned retry_after_seconds;
+
+		//how often a paused acceptor checks whether it can accept again
+		boost::posix_time::time_duration pause_interval;
+
+		admission_options();
+	};
+
+	struct admission_statistics
+	{
+		boost::uint64_t connections;
+		boost::uint64_t requests;
+		boost::uint64_t rejected_connections;
+		boost::uint64_t rejected_requests;
+
+		//how often an acceptor has stopped accepting
+		boost::uint64_t accept_pauses;
+	};
+
+	//Counts the open connections and the requests in flight of a server
+	//and decides which of them are admitted. Every method can be called
+	//from any thread.
+	struct admission_control TEMPEST_FINAL : boost::noncopyable
+	{
+		explicit admission_control(admission_options const &options);
+
+		admission_options const &options() const;
+
+		//Counts a new connection unless the limit has been reached and the
+		//policy is to reject. A connection which has not been counted is to
+		//be answered with rejection(). With the pause policy the limit can
+		//be exceeded by the accepts which were already pending when it was
+		//reached.
+		bool try_open_connection();
+
+		//for every connection counted by try_open_connection
+		void close_connection();
+
+		bool try_begin_request();
+
+		//for every request counted by try_begin_request
+		void end_request();
+
+		//Whether an acceptor with the pause policy should stop accepting.
+		//The acceptor calls count_pause when it does.
+		bool should_pause() const;
+		void count_pause();
+
+		//A complete 503 response with Retry-After which closes the
+		//connection. Rendered once.
+		boost::asio::const_buffer rejection() const;
+
+		admission_statistics statistics() const;
+
+	private:
+
+		admission_options const m_options;
+		std::string const m_rejection;
+		boost::atomic<std::size_t> m_connections;
+		boost::atomic<std::size_t> m_requests;
+		boost::atomic<boost::uint64_t> m_rejected_connections;
+		boost::atomic<boost::uint64_t> m_rejected_requests;
+		boost::atomic<boost::uint64_t> m_accept_pauses;
+	};
+}
+
+
+#endif
@@ -0,0 +1,385 @@
+#include "archive.hpp"
+#include "responses.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/foreach.hpp>
+#include <boost/version.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+#if BOOST_VERSION >= 107200
+//the directory iterators used to be declared in operations.hpp
+#	include <boost/filesystem/directory.hpp>
+#endif
+
+
+namespace tempest
+{
+	namespace
+	{
+		char const archive_magic[8] = {'T', 'E', 'M', 'P', 'E', 'S', 'T', 'A'};
+
+		//reads differently on a machine with another byte order
+		boost::uint32_t const native_byte_order = 0x01020304u;
+
+		boost::uint64_t mix(boost::uint64_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		struct larger_bucket
+		{
+			std::vector<std::vector<std::size_t> > const *buckets;
+
+			bool operator ()(std::size_t left, std::size_t right) const
+			{
+				std::size_t const left_size = (*buckets)[left].size();
+				std::size_t const right_size = (*buckets)[right].size();
+				return (left_size != right_size) ? (left_size > right_size) : (left < right);
+			}
+		};
+	}
+
+	bool is_archive_header(archive_header const &header)
+	{
+		return (std::memcmp(header.magic, archive_magic, sizeof(archive_magic)) == 0) &&
+		       (header.version == archive_version) &&
+		       (header.byte_order == native_byte_order);
+	}
+
+	boost::uint64_t hash_archive_path(boost::string_ref path, boost::uint32_t seed)
+	{
+		//FNV-1a with the seed in the offset basis
+		boost::uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+		for (boost::string_ref::const_iterator i = path.begin(); i != path.end(); ++i)
+		{
+			hash ^= static_cast<unsigned char>(*i);
+			hash *= 0x100000001b3ULL;
+		}
+		return mix(hash);
+	}
+
+	std::vector<boost::int32_t> build_perfect_hash(std::vector<std::string> const &keys,
+	                                               std::vector<std::size_t> &slots)
+	{
+		std::size_t const count = keys.size();
+		if (count > static_cast<std::size_t>((std::numeric_limits<boost::int32_t>::max)()))
+		{
+			throw std::invalid_argument("Too many keys for a perfect hash");
+		}
+
+		std::vector<std::vector<std::size_t> > buckets(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			buckets[hash_archive_path(keys[i], 0) % count].push_back(i);
+		}
+		std::vector<std::size_t> order(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			order[i] = i;
+		}
+		larger_bucket const by_size = {&buckets};
+		std::sort(order.begin(), order.end(), by_size);
+
+		std::vector<boost::int32_t> seeds(count, 0);
+		std::vector<bool> taken(count, false);
+		slots.assign(count, 0);
+		std::vector<std::size_t> tried;
+		std::size_t next = 0;
+		for (; (next < count) && (buckets[order[next]].size() > 1); ++next)
+		{
+			std::vector<std::size_t> const &bucket = buckets[order[next]];
+			boost::int32_t seed = 1;
+			for (std::size_t item = 0; item < bucket.size();)
+			{
+				std::size_t const slot = hash_archive_path(keys[bucket[item]],
+				                                           static_cast<boost::uint32_t>(seed)) % count;
+				if (taken[slot] ||
+				    (std::find(tried.begin(), tried.end(), slot) != tried.end()))
+				{
+					if (seed == (std::numeric_limits<boost::int32_t>::max)())
+					{
+						throw std::invalid_argument("The keys of a perfect hash have to be distinct");
+					}
+					++seed;
+					item = 0;
+					tried.clear();
+					continue;
+				}
+				tried.push_back(slot);
+				++item;
+			}
+			for (std::size_t item = 0; item < bucket.size(); ++item)
+			{
+				taken[tried[item]] = true;
+				slots[bucket[item]] = tried[item];
+			}
+			seeds[order[next]] = seed;
+			tried.clear();
+		}
+
+		//the remaining buckets have at most one key
+		std::size_t free_slot = 0;
+		for (; (next < count) && (buckets[order[next]].size() == 1); ++next)
+		{
+			while (taken[free_slot])
+			{
+				++free_slot;
+			}
+			taken[free_slot] = true;
+			slots[buckets[order[next]].front()] = free_slot;
+			seeds[order[next]] = -static_cast<boost::int32_t>(free_slot) - 1;
+		}
+		return seeds;
+	}
+
+	std::size_t find_perfect_hash_slot(boost::int32_t const *seeds,
+	                                   std::size_t count,
+	                                   boost::string_ref key)
+	{
+		boost::int32_t const seed = seeds[hash_archive_path(key, 0) % count];
+		if (seed < 0)
+		{
+			return static_cast<std::size_t>(-(seed + 1));
+		}
+		return static_cast<std::size_t>(hash_archive_path(key, static_cast<boost::uint32_t>(seed)) % count);
+	}
+
+	pack_summary::pack_summary()
+	    : files(0)
+	    , precompressed(0)
+	    , body_bytes(0)
+	    , archive_bytes(0)
+	{
+	}
+
+	namespace
+	{
+		struct packed_file
+		{
+			boost::uint64_t body_offset;
+			boost::uint64_t body_size;
+			boost::int64_t modified_seconds;
+			std::string etag;
+		};
+
+		//where the next body starts
+		boost::uint64_t align_body(boost::uint64_t offset, boost::uint64_t size)
+		{
+			boost::uint64_t const in_page = offset % archive_page_size;
+			if ((in_page == 0) ||
+			    ((size < archive_page_size) && (in_page + size <= archive_page_size)))
+			{
+				return offset;
+			}
+			return offset + archive_page_size - in_page;
+		}
+
+		void write_zeros(std::ostream &out, boost::uint64_t count)
+		{
+			static char const zeros[archive_page_size] = {};
+			while (count > 0)
+			{
+				std::size_t const piece = static_cast<std::size_t>(
+				            (std::min)(count, archive_page_size));
+				out.write(zeros, static_cast<std::streamsize>(piece));
+				count -= piece;
+			}
+		}
+
+		template <class Element>
+		void write_array(std::ostream &out, std::vector<Element> const &elements)
+		{
+			if (!elements.empty())
+			{
+				out.write(reinterpret_cast<char const *>(&elements[0]),
+				          static_cast<std::streamsize>(elements.size() * sizeof(Element)));
+			}
+		}
+
+		//Copies the file and computes the entity tag from its content, so
+		//that the tag stays the same when the archive is packed again.
+		packed_file copy_body(boost::filesystem::path const &file,
+		                      boost::uint64_t offset,
+		                      std::ostream &out)
+		{
+			packed_file packed;
+			packed.body_offset = offset;
+			packed.body_size = 0;
+			packed.modified_seconds = boost::filesystem::last_write_time(file);
+
+			boost::filesystem::ifstream in(file, std::ios::binary);
+			if (!in)
+			{
+				throw std::runtime_error("Could not open " + file.string());
+			}
+			boost::uint64_t hash = 0xcbf29ce484222325ULL;
+			char buffer[64 * 1024];
+			while (in)
+			{
+				in.read(buffer, sizeof(buffer));
+				std::size_t const read = static_cast<std::size_t>(in.gcount());
+				for (std::size_t i = 0; i < read; ++i)
+				{
+					hash ^= static_cast<unsigned char>(buffer[i]);
+					hash *= 0x100000001b3ULL;
+				}
+				out.write(buffer, static_cast<std::streamsize>(read));
+				packed.body_size += read;
+			}
+			packed.etag = make_entity_tag(mix(hash), packed.modified_seconds, 0, packed.body_size);
+			return packed;
+		}
+
+		archive_string add_string(std::string &strings, boost::string_ref added)
+		{
+			archive_string const result = {strings.size(), added.size()};
+			strings.append(added.data(), added.size());
+			return result;
+		}
+
+		//The headers are rendered for the name of the original file, so
+		//that a precompressed variant gets its Content-Type.
+		boost::uint32_t add_variant(packed_file const &file,
+		                            std::string const &name,
+		                            content_coding coding,
+		                            std::vector<archive_variant> &variants,
+		                            std::string &strings)
+		{
+			file_validators validators;
+			validators.etag = file.etag;
+			validators.modified_seconds = file.modified_seconds;
+			file_headers headers;
+			render_file_headers(headers, name, file.body_size, validators, coding);
+
+			archive_variant variant;
+			variant.body_offset = file.body_offset;
+			variant.body_size = file.body_size;
+			variant.modified_seconds = file.modified_seconds;
+			variant.etag = add_string(strings, file.etag);
+			variant.ok = add_string(strings, headers.ok);
+			variant.not_modified = add_string(strings, headers.not_modified);
+			variants.push_back(variant);
+			return static_cast<boost::uint32_t>(variants.size() - 1);
+		}
+
+		std::string relative_path(boost::filesystem::path const &dir,
+		                          boost::filesystem::path const &file)
+		{
+			std::string const top = dir.generic_string();
+			std::string relative = file.generic_string().substr(top.size());
+			relative.erase(0, relative.find_first_not_of('/'));
+			return relative;
+		}
+	}
+
+	pack_summary pack_directory(boost::filesystem::path const &dir,
+	                            boost::filesystem::path const &archive)
+	{
+		//sorted, so that the same directory results in the same archive
+		std::map<std::string, boost::filesystem::path> found;
+		for (boost::filesystem::recursive_directory_iterator i(dir), end; i != end; ++i)
+		{
+			if (boost::filesystem::is_regular_file(i->path()))
+			{
+				found.insert(std::make_pair(relative_path(dir, i->path()), i->path()));
+			}
+		}
+
+		boost::filesystem::path const temporary = archive.string() + ".tmp";
+		boost::filesystem::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			throw std::runtime_error("Could not create " + temporary.string());
+		}
+
+		//the header is written last when everything else is known
+		pack_summary summary;
+		write_zeros(out, archive_page_size);
+		boost::uint64_t offset = archive_page_size;
+		std::vector<std::string> keys;
+		std::vector<packed_file> files;
+		for (std::map<std::string, boost::filesystem::path>::const_iterator i = found.begin();
+		     i != found.end(); ++i)
+		{
+			boost::uint64_t const begin = align_body(offset, boost::filesystem::file_size(i->second));
+			write_zeros(out, begin - offset);
+			files.push_back(copy_body(i->second, begin, out));
+			keys.push_back(i->first);
+			offset = begin + files.back().body_size;
+			summary.body_bytes += files.back().body_size;
+		}
+		summary.files = files.size();
+
+		std::vector<std::size_t> slots;
+		std::vector<boost::int32_t> const seeds = build_perfect_hash(keys, slots);
+		std::vector<archive_entry> entries(keys.size());
+		std::vector<archive_variant> variants;
+		std::string strings;
+		content_coding const precompressed[] = {gzip_coding, brotli_coding};
+		for (std::size_t i = 0; i < keys.size(); ++i)
+		{
+			archive_entry &entry = entries[slots[i]];
+			entry.path = add_string(strings, keys[i]);
+			entry.variants[identity_coding] = add_variant(files[i], keys[i], identity_coding,
+			                                              variants, strings);
+			entry.reserved = 0;
+			BOOST_FOREACH (content_coding coding, precompressed)
+			{
+				std::vector<std::string>::const_iterator const sidecar = std::lower_bound(
+				            keys.begin(), keys.end(), keys[i] + sidecar_extension(coding));
+				if ((sidecar == keys.end()) ||
+				    (*sidecar != keys[i] + sidecar_extension(coding)))
+				{
+					entry.variants[coding] = no_archive_variant;
+					continue;
+				}
+				entry.variants[coding] = add_variant(files[sidecar - keys.begin()], keys[i],
+				                                     coding, variants, strings);
+				++summary.precompressed;
+			}
+		}
+
+		archive_header header;
+		std::memcpy(header.magic, archive_magic, sizeof(archive_magic));
+		header.version = archive_version;
+		header.byte_order = native_byte_order;
+		header.entry_count = entries.size();
+		header.variant_count = variants.size();
+
+		//every table is aligned for its elements
+		write_zeros(out, (8 - offset % 8) % 8);
+		header.seeds_offset = offset + (8 - offset % 8) % 8;
+		write_array(out, seeds);
+		boost::uint64_t const seeds_end = header.seeds_offset + seeds.size() * sizeof(boost::int32_t);
+		write_zeros(out, (8 - seeds_end % 8) % 8);
+		header.entries_offset = seeds_end + (8 - seeds_end % 8) % 8;
+		write_array(out, entries);
+		header.variants_offset = header.entries_offset + entries.size() * sizeof(archive_entry);
+		write_array(out, variants);
+		header.strings_offset = header.variants_offset + variants.size() * sizeof(archive_variant);
+		header.strings_size = strings.size();
+		out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+		header.size = header.strings_offset + header.strings_size;
+
+		out.seekp(0);
+		out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		out.close();
+		if (!out)
+		{
+			boost::filesystem::remove(temporary);
+			throw std::runtime_error("Could not write " + temporary.string());
+		}
+		boost::filesystem::rename(temporary, archive);
+		summary.archive_bytes = header.size;
+		return summary;
+	}
+}
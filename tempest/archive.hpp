@@ -0,0 +1,129 @@
+#ifndef TEMPEST_ARCHIVE_HPP
+#define TEMPEST_ARCHIVE_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	//An archive is a whole directory tree in a single file, written once by
+	//tempest-pack and served read-only. It consists of
+	// - the archive_header on the first page,
+	// - the file bodies,
+	// - the bucket seeds of a minimal perfect hash of the paths,
+	// - one archive_entry per path in the slot order of the hash,
+	// - the archive_variants of the entries,
+	// - the strings: the paths and the pre-rendered header blocks.
+	//The numbers are stored in the byte order of the packing machine, which
+	//is recorded in the header.
+	//A body of at least a page starts at a page boundary. Smaller bodies
+	//are packed more tightly but do not cross a page boundary.
+	boost::uint64_t const archive_page_size = 4096;
+
+	boost::uint32_t const archive_version = 1;
+
+	//a region of the strings
+	struct archive_string
+	{
+		boost::uint64_t offset;
+		boost::uint64_t length;
+	};
+
+	struct archive_header
+	{
+		char magic[8];
+		boost::uint32_t version;
+		boost::uint32_t byte_order;
+
+		//the size of the whole archive, so that a truncated one is noticed
+		boost::uint64_t size;
+
+		boost::uint64_t entry_count;
+		boost::uint64_t variant_count;
+
+		//from the beginning of the archive
+		boost::uint64_t seeds_offset;
+		boost::uint64_t entries_offset;
+		boost::uint64_t variants_offset;
+		boost::uint64_t strings_offset;
+		boost::uint64_t strings_size;
+	};
+
+	//a file as it is sent with one of the content codings
+	struct archive_variant
+	{
+		//from the beginning of the archive
+		boost::uint64_t body_offset;
+		boost::uint64_t body_size;
+
+		boost::int64_t modified_seconds;
+		archive_string etag;
+
+		//the header blocks of a 200 and a 304 response
+		archive_string ok;
+		archive_string not_modified;
+	};
+
+	boost::uint32_t const no_archive_variant = 0xffffffffu;
+
+	struct archive_entry
+	{
+		//relative to the packed directory with / as the separator and
+		//without a leading /
+		archive_string path;
+
+		//indexed by content_coding, no_archive_variant if there is no such
+		//precompressed file
+		boost::uint32_t variants[3];
+		boost::uint32_t reserved;
+	};
+
+	//checks the magic, the version and the byte order
+	bool is_archive_header(archive_header const &header);
+
+	//the hash of a path with one of the seeds of a perfect hash
+	boost::uint64_t hash_archive_path(boost::string_ref path, boost::uint32_t seed);
+
+	//A minimal perfect hash after "hash, displace, and compress": every key
+	//is put into one of as many buckets as there are keys. The keys of a
+	//bucket are hashed again with a seed which is searched for until none
+	//of them collides with a key of a larger bucket. Single keys are put
+	//into the remaining slots directly, which is stored as a negative seed.
+	//Returns the seed of every bucket. slots receives the slot of every key.
+	//The keys must be distinct.
+	std::vector<boost::int32_t> build_perfect_hash(std::vector<std::string> const &keys,
+	                                               std::vector<std::size_t> &slots);
+
+	//Returns the only slot where the key can be. A key which was not hashed
+	//gets an arbitrary slot, so the key in the slot has to be compared.
+	//The count must not be zero.
+	std::size_t find_perfect_hash_slot(boost::int32_t const *seeds,
+	                                   std::size_t count,
+	                                   boost::string_ref key);
+
+	struct pack_summary
+	{
+		std::size_t files;
+		std::size_t precompressed;
+		boost::uint64_t body_bytes;
+		boost::uint64_t archive_bytes;
+
+		pack_summary();
+	};
+
+	//Writes every regular file below the directory into a new archive.
+	//A precompressed file like "site.css.gz" is also stored as the gzip
+	//variant of "site.css" without being stored twice. The archive is
+	//written next to its destination first and then renamed.
+	pack_summary pack_directory(boost::filesystem::path const &dir,
+	                            boost::filesystem::path const &archive);
+}
+
+
+#endif
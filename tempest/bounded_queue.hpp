@@ -0,0 +1,138 @@
+#ifndef TEMPEST_BOUNDED_QUEUE_HPP
+#define TEMPEST_BOUNDED_QUEUE_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <cassert>
+#include <cstddef>
+
+
+namespace tempest
+{
+	//A queue of fixed capacity for any number of producers and consumers
+	//which never blocks and never allocates after the construction (Dmitry
+	//Vyukov's algorithm). The sequence number of a cell tells whether it is
+	//ready to be written or to be read in the current round.
+	template <class T>
+	struct bounded_queue TEMPEST_FINAL : boost::noncopyable
+	{
+		//the capacity is rounded up to a power of two
+		explicit bounded_queue(std::size_t capacity)
+		    : m_mask(round_up(capacity) - 1)
+		    , m_cells(new cell[m_mask + 1])
+		    , m_enqueue_position(0)
+		    , m_dequeue_position(0)
+		{
+			for (std::size_t i = 0; i <= m_mask; ++i)
+			{
+				m_cells[i].sequence.store(i, boost::memory_order_relaxed);
+			}
+		}
+
+		std::size_t capacity() const
+		{
+			return m_mask + 1;
+		}
+
+		//returns false if the queue is full
+		bool try_push(T const &value)
+		{
+			std::size_t position = m_enqueue_position.load(boost::memory_order_relaxed);
+			cell *target;
+			for (;;)
+			{
+				target = &m_cells[position & m_mask];
+				std::size_t const sequence = target->sequence.load(boost::memory_order_acquire);
+				std::ptrdiff_t const difference =
+				        static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+				if (difference == 0)
+				{
+					if (m_enqueue_position.compare_exchange_weak(
+					        position, position + 1, boost::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = m_enqueue_position.load(boost::memory_order_relaxed);
+				}
+			}
+			target->value = value;
+			target->sequence.store(position + 1, boost::memory_order_release);
+			return true;
+		}
+
+		//returns false if the queue is empty
+		bool try_pop(T &value)
+		{
+			std::size_t position = m_dequeue_position.load(boost::memory_order_relaxed);
+			cell *source;
+			for (;;)
+			{
+				source = &m_cells[position & m_mask];
+				std::size_t const sequence = source->sequence.load(boost::memory_order_acquire);
+				std::ptrdiff_t const difference =
+				        static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+				if (difference == 0)
+				{
+					if (m_dequeue_position.compare_exchange_weak(
+					        position, position + 1, boost::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (difference < 0)
+				{
+					return false;
+				}
+				else
+				{
+					position = m_dequeue_position.load(boost::memory_order_relaxed);
+				}
+			}
+			value = source->value;
+			source->sequence.store(position + m_mask + 1, boost::memory_order_release);
+			return true;
+		}
+
+	private:
+
+		struct cell
+		{
+			boost::atomic<std::size_t> sequence;
+			T value;
+		};
+
+		std::size_t const m_mask;
+		boost::scoped_array<cell> const m_cells;
+
+		//the producers and the consumers should not share a cache line
+		char m_padding_before[64];
+		boost::atomic<std::size_t> m_enqueue_position;
+		char m_padding_between[64];
+		boost::atomic<std::size_t> m_dequeue_position;
+
+
+		static std::size_t round_up(std::size_t capacity)
+		{
+			assert(capacity >= 1);
+			std::size_t rounded = 1;
+			while (rounded < capacity)
+			{
+				rounded *= 2;
+			}
+			return rounded;
+		}
+	};
+}
+
+
+#endif
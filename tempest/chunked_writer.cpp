@@ -0,0 +1,168 @@
+#include "chunked_writer.hpp"
+#include "client.hpp"
+#include "responses.hpp"
+#include "http/http_request.hpp"
+#include <boost/bind.hpp>
+#include <boost/move/move.hpp>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+
+namespace tempest
+{
+	namespace
+	{
+		//the size line of the largest chunk: "ffffffff\r\n"
+		std::size_t const max_size_line = 8 + 2;
+
+		//the end of a chunk and the last chunk: "\r\n0\r\n\r\n"
+		char const end_of_chunk[] = "\r\n";
+		char const last_chunk[] = "0\r\n\r\n";
+		std::size_t const max_trailer = (sizeof(end_of_chunk) - 1) + (sizeof(last_chunk) - 1);
+
+		//Writes the size line so that it ends in front of end. Returns its
+		//first character.
+		char *format_size_line(std::size_t size, char *end)
+		{
+			static char const digits[] = "0123456789abcdef";
+			char *first = end - 2;
+			first[0] = '\r';
+			first[1] = '\n';
+			do
+			{
+				--first;
+				*first = digits[size % 16];
+				size /= 16;
+			}
+			while (size != 0);
+			return first;
+		}
+	}
+
+	std::size_t const chunked_writer::default_buffer_size;
+
+	chunked_writer::chunked_writer(http_request const &request,
+	                               async_sender &sender,
+	                               std::string header,
+	                               std::size_t buffer_size)
+	    : m_sender(sender)
+	    , m_chunked(request.version == "HTTP/1.1")
+	    , m_has_body(request.method != "HEAD")
+	    , m_header_sent(false)
+	    , m_pending(false)
+	    , m_flush(false)
+	    , m_capacity(buffer_size)
+	    , m_used(0)
+	{
+		if ((buffer_size == 0) || (buffer_size > 0xffffffffu))
+		{
+			throw std::invalid_argument("The buffer size of a chunked_writer must fit into eight hex digits");
+		}
+
+		m_header.swap(header);
+		if (m_chunked)
+		{
+			m_header += "Transfer-Encoding: chunked\r\n";
+		}
+		else
+		{
+			//only the end of the connection tells the client where the body ends
+			m_sender.set_persistent(false);
+		}
+
+		if (m_has_body)
+		{
+			m_buffer.resize(max_size_line + m_capacity + max_trailer);
+		}
+	}
+
+	std::size_t chunked_writer::available() const
+	{
+		return m_capacity - m_used;
+	}
+
+	std::size_t chunked_writer::write(boost::string_ref data)
+	{
+		assert(!m_pending);
+		std::size_t const taken = (std::min)(data.size(), available());
+		if (m_has_body)
+		{
+			std::copy(data.begin(), data.begin() + taken,
+			          m_buffer.begin() + max_size_line + m_used);
+		}
+		m_used += taken;
+		return taken;
+	}
+
+	void chunked_writer::async_flush(write_handler handler)
+	{
+		send(false, handler);
+	}
+
+	void chunked_writer::async_finish(write_handler handler)
+	{
+		send(true, handler);
+	}
+
+	void chunked_writer::send(bool last, write_handler &handler)
+	{
+		assert(!m_pending);
+		m_pending = true;
+		m_flush = !last;
+		m_handler = boost::move(handler);
+
+		send_parts parts;
+		if (!m_header_sent)
+		{
+			m_header_sent = true;
+			parts.push_back(send_part::from_memory(boost::asio::buffer(m_header)));
+			parts.push_back(send_part::from_memory(end_of_header_block(m_sender.is_persistent())));
+		}
+
+		if (m_has_body)
+		{
+			char * const data = m_buffer.data() + max_size_line;
+			char *begin = data;
+			char *end = data + m_used;
+			if (m_chunked)
+			{
+				//an empty chunk would end the body
+				if (m_used > 0)
+				{
+					begin = format_size_line(m_used, data);
+					end = std::copy(end_of_chunk, end_of_chunk + sizeof(end_of_chunk) - 1, end);
+				}
+				if (last)
+				{
+					end = std::copy(last_chunk, last_chunk + sizeof(last_chunk) - 1, end);
+				}
+			}
+			if (begin != end)
+			{
+				parts.push_back(send_part::from_memory(
+				    boost::asio::buffer(begin, static_cast<std::size_t>(end - begin))));
+			}
+		}
+
+		//Even nothing is passed to the sender, so that the handler is never
+		//called from here.
+		m_sender.async_send(parts, boost::bind(&chunked_writer::handle_sent, this, _1));
+	}
+
+	void chunked_writer::handle_sent(boost::system::error_code error)
+	{
+		//the sender may only have collected the chunk
+		if (!error && m_flush)
+		{
+			m_flush = false;
+			return m_sender.async_flush(boost::bind(&chunked_writer::handle_sent, this, _1));
+		}
+
+		m_used = 0;
+		m_pending = false;
+		write_handler handler;
+		handler.swap(m_handler);
+		handler(error);
+	}
+}
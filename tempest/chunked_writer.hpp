@@ -0,0 +1,88 @@
+#ifndef TEMPEST_CHUNKED_WRITER_HPP
+#define TEMPEST_CHUNKED_WRITER_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	struct http_request;
+	struct async_sender;
+
+	//Streams a response whose length is not known in advance, for example
+	//a generated export of several gigabytes. The body is written into a
+	//buffer of a fixed size which is sent as one chunk of
+	//Transfer-Encoding: chunked. The buffer cannot be written again before
+	//the sender has taken the chunk, so a slow client slows the producer
+	//down instead of making the server hold the body in memory.
+	//A client which does not speak HTTP/1.1, like an HTTP/1.0 one, gets the
+	//body without framing and the connection is closed after it. A HEAD
+	//request gets only the header.
+	struct chunked_writer TEMPEST_FINAL : boost::noncopyable
+	{
+		typedef boost::function<void (boost::system::error_code)> write_handler;
+
+		static std::size_t const default_buffer_size = 64 * 1024;
+
+		//The header is a header block as described at end_of_header_block
+		//without Content-Length and Transfer-Encoding. The request is only
+		//used by the constructor. The sender has to stay valid until the
+		//handler of async_finish is called.
+		chunked_writer(http_request const &request,
+		               async_sender &sender,
+		               std::string header,
+		               std::size_t buffer_size = default_buffer_size);
+
+		//how many bytes write takes before the buffer has to be flushed
+		std::size_t available() const;
+
+		//Copies as much of the data as is available and returns how many
+		//bytes that were. Must not be called while a flush is pending.
+		std::size_t write(boost::string_ref data);
+
+		//Sends the header if it has not been sent yet and the buffer as a
+		//chunk, and flushes the sender, so that a slowly produced body
+		//reaches the client when it is written instead of when the sender
+		//has collected enough. The handler is called when the buffer can be
+		//written again.
+		void async_flush(write_handler handler);
+
+		//Sends what is left and the end of the body. The sender is not
+		//flushed, so that the response can share a write with the next one.
+		//The writer must not be used afterwards.
+		void async_finish(write_handler handler);
+
+	private:
+
+		async_sender &m_sender;
+		std::string m_header;
+		bool const m_chunked;
+		bool const m_has_body;
+		bool m_header_sent;
+		bool m_pending;
+		bool m_flush;
+		write_handler m_handler;
+
+		//Room for the size line of a chunk is kept in front of the data and
+		//room for the end of the chunk and the last chunk behind it, so a
+		//chunk is sent as a single part.
+		std::vector<char> m_buffer;
+		std::size_t const m_capacity;
+		std::size_t m_used;
+
+
+		void send(bool last, write_handler &handler);
+		void handle_sent(boost::system::error_code error);
+	};
+}
+
+
+#endif
@@ -14,4 +14,40 @@ namespace tempest
 	abstract_client::~abstract_client()
 	{
 	}
+
+	send_part send_part::from_memory(boost::asio::const_buffer memory)
+	{
+		send_part part;
+		part.memory = memory;
+		part.file = -1;
+		part.offset = 0;
+		part.length = 0;
+		return part;
+	}
+
+	send_part send_part::from_file(int file, file_size offset, file_size length)
+	{
+		send_part part;
+		part.file = file;
+		part.offset = offset;
+		part.length = length;
+		return part;
+	}
+
+	bool send_part::is_file() const
+	{
+		return (file >= 0);
+	}
+
+	async_sender::~async_sender()
+	{
+	}
+
+	async_receiver::~async_receiver()
+	{
+	}
+
+	async_client::~async_client()
+	{
+	}
 }
@@ -2,9 +2,21 @@
 #define TEMPEST_CLIENT_HPP
 
 
+#include <tempest/config.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/optional.hpp>
+#include <boost/function.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 105800
+#	include <boost/container/small_vector.hpp>
+#endif
 #include <istream>
 #include <ostream>
+#include <cstddef>
+#include <vector>
 
 
 namespace tempest
@@ -14,12 +26,26 @@ namespace tempest
 		virtual ~sender();
 		virtual std::ostream &response() = 0;
 		virtual boost::optional<int> posix_response() = 0;
+
+		//whether the connection stays open after the current response
+		virtual bool is_persistent() = 0;
 	};
 
 	struct receiver
 	{
 		virtual ~receiver();
 		virtual std::istream &request() = 0;
+
+		//A contiguous view of the bytes which have been received but not
+		//consumed yet. It is invalidated by receive_more and consume.
+		virtual char const *buffered_begin() = 0;
+		virtual std::size_t buffered_size() = 0;
+
+		//Blocks until more bytes have been appended to the buffered ones.
+		//Returns false if the connection has been closed.
+		virtual bool receive_more() = 0;
+
+		virtual void consume(std::size_t length) = 0;
 	};
 
 	struct abstract_client
@@ -28,6 +54,87 @@ namespace tempest
 		virtual void shutdown() = 0;
 		virtual sender &get_sender() = 0;
 		virtual receiver &get_receiver() = 0;
+		virtual void set_persistent(bool persistent) = 0;
+	};
+
+	//A part of the data sent by an async_sender: either bytes in memory or
+	//a region of an open file (the latter only on POSIX).
+	struct send_part
+	{
+		boost::asio::const_buffer memory;
+		int file;
+		file_size offset;
+		file_size length;
+
+		static send_part from_memory(boost::asio::const_buffer memory);
+		static send_part from_file(int file, file_size offset, file_size length);
+
+		bool is_file() const;
+	};
+
+	//A header, the end of the header block and a body fit without
+	//allocating.
+#if BOOST_VERSION >= 105800
+	typedef boost::container::small_vector<send_part, 4> send_parts;
+#else
+	typedef std::vector<send_part> send_parts;
+#endif
+
+	//The non-blocking counterpart of sender. Handlers are never called from
+	//within the initiating function. Only one operation may be pending at
+	//a time.
+	struct async_sender
+	{
+		typedef boost::function<void (boost::system::error_code)> send_handler;
+
+		virtual ~async_sender();
+
+		//The memory and files have to stay valid until the handler is
+		//called. Small parts may be collected and only be written by a later
+		//async_send or by async_flush so that several responses can share
+		//a write.
+		virtual void async_send(send_parts const &parts, send_handler handler) = 0;
+		virtual void async_flush(send_handler handler) = 0;
+
+		//whether the connection stays open after the current response
+		virtual bool is_persistent() = 0;
+
+		//A response whose end can only be told by closing the connection
+		//turns persistence off before it sends its header.
+		virtual void set_persistent(bool persistent) = 0;
+
+		//The bytes which have been handed to the operating system so far.
+		//Two readings tell a slow client from one which does not receive
+		//at all. Can be called from any thread.
+		virtual boost::uint64_t sent_bytes() = 0;
+	};
+
+	//The non-blocking counterpart of receiver
+	struct async_receiver
+	{
+		typedef boost::function<void (boost::system::error_code, std::size_t)> receive_handler;
+
+		virtual ~async_receiver();
+
+		//Receives at least one byte into the caller-owned buffer. Fails with
+		//boost::asio::error::timed_out if nothing arrives within the timeout.
+		virtual void async_receive(boost::asio::mutable_buffer buffer,
+		                           boost::posix_time::time_duration timeout,
+		                           receive_handler handler) = 0;
+	};
+
+	struct async_client
+	{
+		virtual ~async_client();
+		virtual void shutdown() = 0;
+		virtual async_sender &get_async_sender() = 0;
+		virtual async_receiver &get_async_receiver() = 0;
+		virtual void set_persistent(bool persistent) = 0;
+
+		//Calls the handler where the handlers of the operations are called,
+		//never concurrently with them, for example to shut the client down
+		//from a timer. Can be called from any thread.
+		virtual void post(boost::function<void ()> handler) = 0;
 	};
 }
 
@@ -13,6 +13,18 @@
 #	endif
 #endif
 
+//io_uring needs Linux 5.7 at runtime, which is checked when it is used
+#ifndef TEMPEST_USE_IO_URING
+#	if TEMPEST_USE_POSIX && defined(__has_include)
+#		if __has_include(<linux/io_uring.h>)
+#			define TEMPEST_USE_IO_URING 1
+#		endif
+#	endif
+#	ifndef TEMPEST_USE_IO_URING
+#		define TEMPEST_USE_IO_URING 0
+#	endif
+#endif
+
 #ifdef __GNUC__
 
 #	if __GNUC__ >= 4 && (__GNUC_MINOR__ >= 7 || __GNUC__ >= 5)
@@ -0,0 +1,98 @@
+#include "content_type.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+namespace tempest
+{
+	namespace
+	{
+		struct known_type
+		{
+			char const *extension;
+			char const *content_type;
+		};
+
+		//sorted by extension for binary search
+		known_type const known_types[] =
+		{
+			{"avif", "image/avif"},
+			{"bmp", "image/bmp"},
+			{"css", "text/css; charset=utf-8"},
+			{"csv", "text/csv; charset=utf-8"},
+			{"gif", "image/gif"},
+			{"gz", "application/gzip"},
+			{"htm", "text/html; charset=utf-8"},
+			{"html", "text/html; charset=utf-8"},
+			{"ico", "image/x-icon"},
+			{"jpeg", "image/jpeg"},
+			{"jpg", "image/jpeg"},
+			{"js", "text/javascript; charset=utf-8"},
+			{"json", "application/json"},
+			{"md", "text/markdown; charset=utf-8"},
+			{"mjs", "text/javascript; charset=utf-8"},
+			{"mp3", "audio/mpeg"},
+			{"mp4", "video/mp4"},
+			{"ogg", "audio/ogg"},
+			{"otf", "font/otf"},
+			{"pdf", "application/pdf"},
+			{"png", "image/png"},
+			{"svg", "image/svg+xml"},
+			{"tar", "application/x-tar"},
+			{"ttf", "font/ttf"},
+			{"txt", "text/plain; charset=utf-8"},
+			{"wasm", "application/wasm"},
+			{"wav", "audio/wav"},
+			{"webm", "video/webm"},
+			{"webp", "image/webp"},
+			{"woff", "font/woff"},
+			{"woff2", "font/woff2"},
+			{"xml", "application/xml"},
+			{"zip", "application/zip"},
+		};
+
+		std::size_t const max_extension_length = 8;
+
+		char to_lower(char c)
+		{
+			return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+
+		bool is_less(known_type const &type, char const *extension)
+		{
+			return std::strcmp(type.extension, extension) < 0;
+		}
+	}
+
+	boost::string_ref find_content_type(boost::string_ref file_name)
+	{
+		boost::string_ref const unknown = "application/octet-stream";
+
+		std::size_t const dot = file_name.rfind('.');
+		if (dot == boost::string_ref::npos)
+		{
+			return unknown;
+		}
+
+		boost::string_ref const extension = file_name.substr(dot + 1);
+		if (extension.size() > max_extension_length ||
+		    extension.find('/') != boost::string_ref::npos)
+		{
+			return unknown;
+		}
+
+		char lower[max_extension_length + 1];
+		std::transform(extension.begin(), extension.end(), lower, to_lower);
+		lower[extension.size()] = '\0';
+
+		known_type const * const end = known_types + (sizeof(known_types) / sizeof(known_types[0]));
+		known_type const * const found = std::lower_bound(known_types, end, lower, is_less);
+		if (found == end ||
+		    std::strcmp(found->extension, lower) != 0)
+		{
+			return unknown;
+		}
+		return found->content_type;
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef TEMPEST_CONTENT_TYPE_HPP
+#define TEMPEST_CONTENT_TYPE_HPP
+
+
+#include <boost/utility/string_ref.hpp>
+
+
+namespace tempest
+{
+	//Guesses the media type from the extension of the file name.
+	//Unknown files are application/octet-stream.
+	boost::string_ref find_content_type(boost::string_ref file_name);
+}
+
+
+#endif
@@ -1,9 +1,40 @@
 #include "directory.hpp"
+#include "client.hpp"
+#include "memory_sender.hpp"
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
 
 
 namespace tempest
 {
+	namespace
+	{
+		void release_response(boost::system::error_code error,
+		                      boost::shared_ptr<memory_sender> const &,
+		                      directory::response_handler const &handler)
+		{
+			handler(error);
+		}
+	}
+
 	directory::~directory()
 	{
 	}
+
+	void directory::async_respond(http_request const &request,
+	                              boost::string_ref sub_path,
+	                              async_sender &sender,
+	                              response_handler handler)
+	{
+		boost::shared_ptr<memory_sender> const collected =
+		        boost::make_shared<memory_sender>(sender.is_persistent());
+		respond(request, sub_path, *collected);
+
+		std::vector<char> const &contents = collected->contents();
+		send_parts parts;
+		parts.push_back(send_part::from_memory(boost::asio::buffer(contents)));
+		sender.async_send(parts, boost::bind(release_response, _1, collected,
+		                                     boost::move(handler)));
+	}
 }
@@ -2,20 +2,37 @@
 #define TEMPEST_DIRECTORY_HPP
 
 
-#include <string>
+#include <boost/function.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/utility/string_ref.hpp>
 
 
 namespace tempest
 {
 	struct http_request;
 	struct sender;
+	struct async_sender;
 
 	struct directory
 	{
+		typedef boost::function<void (boost::system::error_code)> response_handler;
+
 		virtual ~directory();
+
+		//The sub_path is the part of the requested path which is below the
+		//place where the directory is mounted.
 		virtual void respond(http_request const &request,
-		                     std::string const &sub_path,
+		                     boost::string_ref sub_path,
 		                     sender &sender) = 0;
+
+		//The request and the sub_path are only used before async_respond
+		//returns. The sender has to stay valid until the handler is called.
+		//The default implementation collects the response of respond in
+		//memory and sends it afterwards.
+		virtual void async_respond(http_request const &request,
+		                           boost::string_ref sub_path,
+		                           async_sender &sender,
+		                           response_handler handler);
 	};
 }
 
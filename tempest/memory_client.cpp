@@ -0,0 +1,283 @@
+#include "memory_client.hpp"
+#include "posix/file_handle.hpp"
+#include <boost/asio/error.hpp>
+#include <boost/foreach.hpp>
+#include <boost/move/move.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+
+#if TEMPEST_USE_POSIX
+#	include <unistd.h>
+#endif
+
+
+namespace tempest
+{
+	void memory_client::buffer::append_input(char const *data, std::size_t size)
+	{
+		//the consumed bytes are dropped, so that the input does not grow
+		//when a client is fed again and again
+		std::size_t const consumed = static_cast<std::size_t>(gptr() - eback());
+		input.erase(input.begin(), input.begin() + consumed);
+		input.insert(input.end(), data, data + size);
+		setg(input.data(), input.data(), input.data() + input.size());
+	}
+
+	char const *memory_client::buffer::input_begin() const
+	{
+		return gptr();
+	}
+
+	std::size_t memory_client::buffer::input_size() const
+	{
+		return static_cast<std::size_t>(egptr() - gptr());
+	}
+
+	void memory_client::buffer::consume_input(std::size_t length)
+	{
+		gbump(static_cast<int>(length));
+	}
+
+	memory_client::buffer::int_type memory_client::buffer::overflow(int_type c)
+	{
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			output.push_back(traits_type::to_char_type(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize memory_client::buffer::xsputn(char_type const *s, std::streamsize n)
+	{
+		output.insert(output.end(), s, s + n);
+		return n;
+	}
+
+	memory_client::memory_client(boost::optional<int> response_descriptor)
+	    : m_response_descriptor(response_descriptor)
+	    , m_stream(&m_buffer)
+	    , m_persistent(false)
+	    , m_shut_down(false)
+	    , m_sent(0)
+	{
+	}
+
+	void memory_client::shutdown()
+	{
+		m_shut_down = true;
+	}
+
+	sender &memory_client::get_sender()
+	{
+		return *this;
+	}
+
+	receiver &memory_client::get_receiver()
+	{
+		return *this;
+	}
+
+	async_sender &memory_client::get_async_sender()
+	{
+		return *this;
+	}
+
+	async_receiver &memory_client::get_async_receiver()
+	{
+		return *this;
+	}
+
+	void memory_client::set_persistent(bool persistent)
+	{
+		m_persistent = persistent;
+	}
+
+	void memory_client::post(boost::function<void ()> handler)
+	{
+		m_queued.push_back(completion());
+		m_queued.back().posted = boost::move(handler);
+	}
+
+	void memory_client::feed(char const *data, std::size_t size)
+	{
+		m_buffer.append_input(data, size);
+	}
+
+	void memory_client::feed(std::string const &data)
+	{
+		feed(data.data(), data.size());
+	}
+
+	std::vector<char> const &memory_client::output()
+	{
+		return m_buffer.output;
+	}
+
+	void memory_client::clear_output()
+	{
+		m_buffer.output.clear();
+	}
+
+	std::size_t memory_client::poll()
+	{
+		std::size_t called = 0;
+		while (!m_queued.empty())
+		{
+			m_ready.clear();
+			m_ready.swap(m_queued);
+			BOOST_FOREACH (completion const &completed, m_ready)
+			{
+				if (completed.posted)
+				{
+					completed.posted();
+				}
+				else if (completed.sent)
+				{
+					completed.sent(completed.error);
+				}
+				else
+				{
+					completed.received(completed.error, completed.size);
+				}
+				++called;
+			}
+		}
+
+		//the handlers may keep the owner of the client alive
+		m_ready.clear();
+		return called;
+	}
+
+	bool memory_client::is_shut_down() const
+	{
+		return m_shut_down;
+	}
+
+	std::ostream &memory_client::response()
+	{
+		return m_stream;
+	}
+
+	boost::optional<int> memory_client::posix_response()
+	{
+		return m_response_descriptor;
+	}
+
+	bool memory_client::is_persistent()
+	{
+		return m_persistent;
+	}
+
+	boost::uint64_t memory_client::sent_bytes()
+	{
+		return m_sent;
+	}
+
+	std::istream &memory_client::request()
+	{
+		return m_stream;
+	}
+
+	char const *memory_client::buffered_begin()
+	{
+		return m_buffer.input_begin();
+	}
+
+	std::size_t memory_client::buffered_size()
+	{
+		return m_buffer.input_size();
+	}
+
+	bool memory_client::receive_more()
+	{
+		//everything which has been fed is buffered already
+		return false;
+	}
+
+	void memory_client::consume(std::size_t length)
+	{
+		assert(length <= buffered_size());
+		m_buffer.consume_input(length);
+	}
+
+	void memory_client::async_send(send_parts const &parts, send_handler handler)
+	{
+		boost::system::error_code error;
+		try
+		{
+			BOOST_FOREACH (send_part const &part, parts)
+			{
+				if (part.is_file())
+				{
+					send_file(part);
+					m_sent += part.length;
+				}
+				else
+				{
+					char const * const data = boost::asio::buffer_cast<char const *>(part.memory);
+					m_buffer.output.insert(m_buffer.output.end(), data,
+					                       data + boost::asio::buffer_size(part.memory));
+					m_sent += boost::asio::buffer_size(part.memory);
+				}
+			}
+		}
+		catch (boost::system::system_error const &ex)
+		{
+			error = ex.code();
+		}
+		m_queued.push_back(completion());
+		m_queued.back().sent = boost::move(handler);
+		m_queued.back().error = error;
+	}
+
+	void memory_client::async_flush(send_handler handler)
+	{
+		m_queued.push_back(completion());
+		m_queued.back().sent = boost::move(handler);
+	}
+
+	void memory_client::async_receive(boost::asio::mutable_buffer buffer,
+	                                  boost::posix_time::time_duration,
+	                                  receive_handler handler)
+	{
+		//the end of the input is the end of the connection
+		std::size_t const received = std::min(buffered_size(), boost::asio::buffer_size(buffer));
+		std::copy(buffered_begin(), buffered_begin() + received,
+		          boost::asio::buffer_cast<char *>(buffer));
+		consume(received);
+		boost::system::error_code const error =
+		        received ? boost::system::error_code() : boost::asio::error::eof;
+		m_queued.push_back(completion());
+		m_queued.back().received = boost::move(handler);
+		m_queued.back().error = error;
+		m_queued.back().size = received;
+	}
+
+	void memory_client::send_file(send_part const &part)
+	{
+#if TEMPEST_USE_POSIX
+		if (m_response_descriptor)
+		{
+			if (posix::send_file_region(*m_response_descriptor, part.file, part.offset, part.length) != part.length)
+			{
+				throw boost::system::system_error(boost::asio::error::eof);
+			}
+			return;
+		}
+
+		std::size_t const begin = m_buffer.output.size();
+		m_buffer.output.resize(begin + static_cast<std::size_t>(part.length));
+		ssize_t const read = pread(part.file, m_buffer.output.data() + begin,
+		                           static_cast<std::size_t>(part.length),
+		                           static_cast<off_t>(part.offset));
+		if (read != static_cast<ssize_t>(part.length))
+		{
+			m_buffer.output.resize(begin);
+			throw boost::system::system_error(boost::asio::error::eof);
+		}
+#else
+		(void)part;
+		throw boost::system::system_error(boost::asio::error::operation_not_supported);
+#endif
+	}
+}
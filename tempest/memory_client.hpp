@@ -0,0 +1,124 @@
+#ifndef TEMPEST_MEMORY_CLIENT_HPP
+#define TEMPEST_MEMORY_CLIENT_HPP
+
+
+#include "client.hpp"
+#include <tempest/config.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+
+namespace tempest
+{
+	//A client whose connection consists of two buffers in memory. It drives
+	//the directories and the server without a network stack, so that their
+	//CPU cost can be measured and tested in isolation.
+	//The asynchronous handlers are queued and called by poll.
+	struct memory_client TEMPEST_FINAL
+	        : public abstract_client
+	        , public async_client
+	        , private sender
+	        , private receiver
+	        , private async_sender
+	        , private async_receiver
+	{
+		//If a descriptor is given, posix_response returns it and the file
+		//parts of asynchronous sends are written to it, for example to the
+		//null device or to a pipe. Otherwise the files are read into the
+		//output.
+		explicit memory_client(boost::optional<int> response_descriptor = boost::none);
+
+		virtual void shutdown() TEMPEST_OVERRIDE;
+		virtual sender &get_sender() TEMPEST_OVERRIDE;
+		virtual receiver &get_receiver() TEMPEST_OVERRIDE;
+		virtual async_sender &get_async_sender() TEMPEST_OVERRIDE;
+		virtual async_receiver &get_async_receiver() TEMPEST_OVERRIDE;
+		virtual void set_persistent(bool persistent) TEMPEST_OVERRIDE;
+
+		//queued like the completions, so poll calls it
+		virtual void post(boost::function<void ()> handler) TEMPEST_OVERRIDE;
+
+		//appends bytes to the input which the receivers return
+		void feed(char const *data, std::size_t size);
+		void feed(std::string const &data);
+
+		//the bytes sent so far
+		std::vector<char> const &output();
+		void clear_output();
+
+		//Calls the queued handlers including the ones queued meanwhile.
+		//Returns how many have been called. Must not be called by one of
+		//the handlers.
+		std::size_t poll();
+
+		bool is_shut_down() const;
+
+	private:
+
+		struct buffer : std::streambuf
+		{
+			std::vector<char> input;
+			std::vector<char> output;
+
+			void append_input(char const *data, std::size_t size);
+			char const *input_begin() const;
+			std::size_t input_size() const;
+			void consume_input(std::size_t length);
+
+		protected:
+
+			virtual int_type overflow(int_type c) TEMPEST_OVERRIDE;
+			virtual std::streamsize xsputn(char_type const *s, std::streamsize n) TEMPEST_OVERRIDE;
+		};
+
+		boost::optional<int> const m_response_descriptor;
+		buffer m_buffer;
+		std::iostream m_stream;
+		bool m_persistent;
+		bool m_shut_down;
+		boost::uint64_t m_sent;
+
+		//the handler of a send or of a receive with its arguments, or a
+		//posted handler
+		struct completion
+		{
+			boost::function<void ()> posted;
+			send_handler sent;
+			receive_handler received;
+			boost::system::error_code error;
+			std::size_t size;
+		};
+
+		//The completions are kept instead of bound handlers, so that queuing
+		//a handler does not allocate. The vectors keep their memory.
+		std::vector<completion> m_queued;
+		std::vector<completion> m_ready;
+
+
+		virtual std::ostream &response() TEMPEST_OVERRIDE;
+		virtual boost::optional<int> posix_response() TEMPEST_OVERRIDE;
+		virtual bool is_persistent() TEMPEST_OVERRIDE;
+		virtual boost::uint64_t sent_bytes() TEMPEST_OVERRIDE;
+
+		virtual std::istream &request() TEMPEST_OVERRIDE;
+		virtual char const *buffered_begin() TEMPEST_OVERRIDE;
+		virtual std::size_t buffered_size() TEMPEST_OVERRIDE;
+		virtual bool receive_more() TEMPEST_OVERRIDE;
+		virtual void consume(std::size_t length) TEMPEST_OVERRIDE;
+
+		virtual void async_send(send_parts const &parts, send_handler handler) TEMPEST_OVERRIDE;
+		virtual void async_flush(send_handler handler) TEMPEST_OVERRIDE;
+
+		virtual void async_receive(boost::asio::mutable_buffer buffer,
+		                           boost::posix_time::time_duration timeout,
+		                           receive_handler handler) TEMPEST_OVERRIDE;
+
+		void send_file(send_part const &part);
+	};
+}
+
+
+#endif
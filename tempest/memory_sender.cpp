@@ -0,0 +1,32 @@
+#include "memory_sender.hpp"
+
+
+namespace tempest
+{
+	memory_sender::memory_sender(bool persistent)
+	    : m_stream(device(m_contents))
+	    , m_persistent(persistent)
+	{
+	}
+
+	std::ostream &memory_sender::response()
+	{
+		return m_stream;
+	}
+
+	boost::optional<int> memory_sender::posix_response()
+	{
+		return boost::optional<int>();
+	}
+
+	bool memory_sender::is_persistent()
+	{
+		return m_persistent;
+	}
+
+	std::vector<char> const &memory_sender::contents()
+	{
+		m_stream.flush();
+		return m_contents;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef TEMPEST_MEMORY_SENDER_HPP
+#define TEMPEST_MEMORY_SENDER_HPP
+
+
+#include "client.hpp"
+#include <tempest/config.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <vector>
+
+
+namespace tempest
+{
+	//A sender which collects the response in memory
+	struct memory_sender TEMPEST_FINAL : sender
+	{
+		explicit memory_sender(bool persistent);
+		virtual std::ostream &response() TEMPEST_OVERRIDE;
+		virtual boost::optional<int> posix_response() TEMPEST_OVERRIDE;
+		virtual bool is_persistent() TEMPEST_OVERRIDE;
+
+		//flushes the stream
+		std::vector<char> const &contents();
+
+	private:
+
+		typedef boost::iostreams::back_insert_device<std::vector<char> > device;
+
+		std::vector<char> m_contents;
+		boost::iostreams::stream<device> m_stream;
+		bool const m_persistent;
+	};
+}
+
+
+#endif
@@ -0,0 +1,469 @@
+#include "metrics.hpp"
+#include "thread_index.hpp"
+#include "http/response_writer.hpp"
+#include <boost/atomic.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/move/move.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace tempest
+{
+	namespace
+	{
+		std::size_t const status_slots = last_counted_status - first_counted_status + 1;
+
+		//enough for the worker threads of a typical machine
+		std::size_t const shard_count = 16;
+
+		std::size_t latency_bucket(boost::uint64_t nanoseconds)
+		{
+			std::size_t bucket = 0;
+			for (boost::uint64_t rest = nanoseconds >> 7; rest && (bucket < latency_bucket_count); rest >>= 1)
+			{
+				++bucket;
+			}
+			return bucket;
+		}
+
+		void append_decimal(std::string &destination, boost::uint64_t value)
+		{
+			char digits[max_decimal_length];
+			char * const end = digits + max_decimal_length;
+			destination.append(format_decimal(value, end), end);
+		}
+
+		//exact, for example "0.000000128"
+		void append_seconds(std::string &destination, boost::uint64_t nanoseconds)
+		{
+			append_decimal(destination, nanoseconds / 1000000000u);
+			boost::uint64_t fraction = nanoseconds % 1000000000u;
+			if (!fraction)
+			{
+				return;
+			}
+			char digits[9];
+			for (std::size_t i = 9; i > 0; --i)
+			{
+				digits[i - 1] = static_cast<char>('0' + (fraction % 10));
+				fraction /= 10;
+			}
+			std::size_t length = 9;
+			while (digits[length - 1] == '0')
+			{
+				--length;
+			}
+			destination += '.';
+			destination.append(digits, length);
+		}
+
+		void append_value(std::string &destination, double value)
+		{
+			if ((value >= 0) && (value < 1e18) && (std::floor(value) == value))
+			{
+				return append_decimal(destination, static_cast<boost::uint64_t>(value));
+			}
+			destination += boost::lexical_cast<std::string>(value);
+		}
+
+		void append_family(std::string &destination,
+		                   char const *name,
+		                   char const *type,
+		                   char const *help)
+		{
+			destination += "# HELP ";
+			destination += name;
+			destination += ' ';
+			destination += help;
+			destination += "\n# TYPE ";
+			destination += name;
+			destination += ' ';
+			destination += type;
+			destination += '\n';
+		}
+
+		void append_metric(std::string &destination,
+		                    char const *name,
+		                    char const *type,
+		                    char const *help,
+		                    boost::uint64_t value)
+		{
+			append_family(destination, name, type, help);
+			destination += name;
+			destination += ' ';
+			append_decimal(destination, value);
+			destination += '\n';
+		}
+
+		void append_json_field(std::string &destination,
+		                       char const *name,
+		                       boost::uint64_t value)
+		{
+			destination += '"';
+			destination += name;
+			destination += "\":";
+			append_decimal(destination, value);
+			destination += ',';
+		}
+	}
+
+	char const *phase_name(request_phase phase)
+	{
+		switch (phase)
+		{
+		case parse_phase: return "parse";
+		case lookup_phase: return "lookup";
+		case send_phase: return "send";
+		case phase_count: break;
+		}
+		return "unknown";
+	}
+
+	boost::uint64_t latency_bucket_bound(std::size_t bucket)
+	{
+		assert(bucket < latency_bucket_count);
+		return boost::uint64_t(1) << (bucket + 7);
+	}
+
+	latency_histogram::latency_histogram()
+	    : count(0)
+	    , sum_nanoseconds(0)
+	{
+		std::fill(buckets, buckets + latency_bucket_count + 1, 0);
+	}
+
+	boost::uint64_t latency_percentile(latency_histogram const &histogram, double percent)
+	{
+		if (histogram.count == 0)
+		{
+			return 0;
+		}
+		boost::uint64_t const rank = (std::max)(static_cast<boost::uint64_t>(1),
+		    static_cast<boost::uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(histogram.count))));
+		boost::uint64_t seen = 0;
+		for (std::size_t i = 0; i < latency_bucket_count; ++i)
+		{
+			seen += histogram.buckets[i];
+			if (seen >= rank)
+			{
+				return latency_bucket_bound(i);
+			}
+		}
+		//beyond the last bound, so the bound is the best guess
+		return latency_bucket_bound(latency_bucket_count - 1);
+	}
+
+	metrics_snapshot::metrics_snapshot()
+	{
+		std::fill(counters, counters + counter_count, 0);
+		std::fill(statuses, statuses + status_slots, 0);
+	}
+
+	boost::uint64_t metrics_snapshot::status_count(unsigned status) const
+	{
+		if ((status < first_counted_status) || (status > last_counted_status))
+		{
+			return 0;
+		}
+		return statuses[status - first_counted_status];
+	}
+
+	boost::uint64_t metrics_snapshot::active_connections() const
+	{
+		//the shards are read one by one, so a closing can be seen without
+		//its opening
+		boost::uint64_t const opened = counters[opened_connection_counter];
+		boost::uint64_t const closed = counters[closed_connection_counter];
+		return (opened > closed) ? (opened - closed) : 0;
+	}
+
+	struct metrics::shard
+	{
+		boost::atomic<boost::uint64_t> counters[counter_count];
+		boost::atomic<boost::uint64_t> statuses[status_slots];
+		boost::atomic<boost::uint64_t> buckets[phase_count][latency_bucket_count + 1];
+		boost::atomic<boost::uint64_t> sums[phase_count];
+
+		//keeps the next shard off the cache line of the last counter
+		char padding[64];
+
+		shard()
+		{
+			for (std::size_t i = 0; i < counter_count; ++i)
+			{
+				counters[i].store(0, boost::memory_order_relaxed);
+			}
+			for (std::size_t i = 0; i < status_slots; ++i)
+			{
+				statuses[i].store(0, boost::memory_order_relaxed);
+			}
+			for (std::size_t phase = 0; phase < phase_count; ++phase)
+			{
+				for (std::size_t i = 0; i <= latency_bucket_count; ++i)
+				{
+					buckets[phase][i].store(0, boost::memory_order_relaxed);
+				}
+				sums[phase].store(0, boost::memory_order_relaxed);
+			}
+		}
+	};
+
+	metrics::metrics()
+	    : m_shards(new shard[shard_count])
+	{
+	}
+
+	metrics::~metrics()
+	{
+	}
+
+	void metrics::add(metrics_counter counter, boost::uint64_t amount)
+	{
+		assert(counter < counter_count);
+		local_shard().counters[counter].fetch_add(amount, boost::memory_order_relaxed);
+	}
+
+	void metrics::count_status(unsigned status)
+	{
+		if ((status < first_counted_status) || (status > last_counted_status))
+		{
+			return;
+		}
+		local_shard().statuses[status - first_counted_status].fetch_add(1, boost::memory_order_relaxed);
+	}
+
+	void metrics::record(request_phase phase, boost::chrono::steady_clock::duration duration)
+	{
+		assert(phase < phase_count);
+		boost::int64_t const signed_nanoseconds =
+		        boost::chrono::duration_cast<boost::chrono::nanoseconds>(duration).count();
+		boost::uint64_t const nanoseconds =
+		        static_cast<boost::uint64_t>((std::max)(signed_nanoseconds, boost::int64_t(0)));
+		shard &local = local_shard();
+		local.buckets[phase][latency_bucket(nanoseconds)].fetch_add(1, boost::memory_order_relaxed);
+		local.sums[phase].fetch_add(nanoseconds, boost::memory_order_relaxed);
+	}
+
+	void metrics::add_collector(collector collect)
+	{
+		assert(collect);
+		boost::mutex::scoped_lock const lock(m_collectors_mutex);
+		m_collectors.push_back(boost::move(collect));
+	}
+
+	metrics_snapshot metrics::snapshot() const
+	{
+		metrics_snapshot result;
+		for (std::size_t s = 0; s < shard_count; ++s)
+		{
+			shard const &source = m_shards[s];
+			for (std::size_t i = 0; i < counter_count; ++i)
+			{
+				result.counters[i] += source.counters[i].load(boost::memory_order_relaxed);
+			}
+			for (std::size_t i = 0; i < status_slots; ++i)
+			{
+				result.statuses[i] += source.statuses[i].load(boost::memory_order_relaxed);
+			}
+			for (std::size_t phase = 0; phase < phase_count; ++phase)
+			{
+				latency_histogram &histogram = result.phases[phase];
+				for (std::size_t i = 0; i <= latency_bucket_count; ++i)
+				{
+					boost::uint64_t const count = source.buckets[phase][i].load(boost::memory_order_relaxed);
+					histogram.buckets[i] += count;
+					histogram.count += count;
+				}
+				histogram.sum_nanoseconds += source.sums[phase].load(boost::memory_order_relaxed);
+			}
+		}
+
+		boost::mutex::scoped_lock const lock(m_collectors_mutex);
+		BOOST_FOREACH (collector const &collect, m_collectors)
+		{
+			collect(result.samples);
+		}
+		return result;
+	}
+
+	metrics::shard &metrics::local_shard()
+	{
+		return m_shards[thread_index() % shard_count];
+	}
+
+	void write_prometheus(metrics_snapshot const &snapshot, std::string &destination)
+	{
+		append_metric(destination, "tempest_requests_total", "counter",
+		               "Requests which have been parsed completely.",
+		               snapshot.counters[request_counter]);
+		append_metric(destination, "tempest_sent_bytes_total", "counter",
+		               "Bytes of responses including the headers.",
+		               snapshot.counters[sent_bytes_counter]);
+		append_metric(destination, "tempest_connections_total", "counter",
+		               "Connections which have been accepted.",
+		               snapshot.counters[opened_connection_counter]);
+		append_metric(destination, "tempest_active_connections", "gauge",
+		               "Connections which are open.",
+		               snapshot.active_connections());
+		append_metric(destination, "tempest_errors_total", "counter",
+		               "Connections closed because of an error in the server.",
+		               snapshot.counters[error_counter]);
+
+		append_family(destination, "tempest_timeouts_total", "counter",
+		              "Connections closed because the client was too slow.");
+		char const * const timeout_kinds[] = {"idle", "header", "send", "body"};
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			destination += "tempest_timeouts_total{kind=\"";
+			destination += timeout_kinds[i];
+			destination += "\"} ";
+			append_decimal(destination, snapshot.counters[idle_timeout_counter + i]);
+			destination += '\n';
+		}
+
+		append_metric(destination, "tempest_arena_allocations_total", "counter",
+		               "Allocations for requests which the arenas of the connections served.",
+		               snapshot.counters[arena_allocation_counter]);
+		append_metric(destination, "tempest_arena_bytes_total", "counter",
+		               "Bytes allocated for requests from the arenas of the connections.",
+		               snapshot.counters[arena_byte_counter]);
+		append_metric(destination, "tempest_arena_chunks_total", "counter",
+		               "Chunks which the arenas of the connections allocated from the heap.",
+		               snapshot.counters[arena_chunk_counter]);
+
+		append_family(destination, "tempest_responses_total", "counter",
+		              "Responses by status code.");
+		for (unsigned status = first_counted_status; status <= last_counted_status; ++status)
+		{
+			boost::uint64_t const count = snapshot.status_count(status);
+			if (count)
+			{
+				destination += "tempest_responses_total{code=\"";
+				append_decimal(destination, status);
+				destination += "\"} ";
+				append_decimal(destination, count);
+				destination += '\n';
+			}
+		}
+
+		append_family(destination, "tempest_phase_duration_seconds", "histogram",
+		              "Time spent in the phases of a request.");
+		for (std::size_t phase = 0; phase < phase_count; ++phase)
+		{
+			latency_histogram const &histogram = snapshot.phases[phase];
+			std::string const labels = std::string("{phase=\"") +
+			        phase_name(static_cast<request_phase>(phase)) + "\"";
+			boost::uint64_t cumulative = 0;
+			for (std::size_t i = 0; i < latency_bucket_count; ++i)
+			{
+				cumulative += histogram.buckets[i];
+				destination += "tempest_phase_duration_seconds_bucket";
+				destination += labels;
+				destination += ",le=\"";
+				append_seconds(destination, latency_bucket_bound(i));
+				destination += "\"} ";
+				append_decimal(destination, cumulative);
+				destination += '\n';
+			}
+			destination += "tempest_phase_duration_seconds_bucket";
+			destination += labels;
+			destination += ",le=\"+Inf\"} ";
+			append_decimal(destination, histogram.count);
+			destination += "\ntempest_phase_duration_seconds_sum";
+			destination += labels;
+			destination += "} ";
+			append_seconds(destination, histogram.sum_nanoseconds);
+			destination += "\ntempest_phase_duration_seconds_count";
+			destination += labels;
+			destination += "} ";
+			append_decimal(destination, histogram.count);
+			destination += '\n';
+		}
+
+		BOOST_FOREACH (metric_sample const &sample, snapshot.samples)
+		{
+			append_family(destination, sample.name.c_str(),
+			              sample.is_counter ? "counter" : "gauge",
+			              sample.help.c_str());
+			destination += sample.name;
+			destination += ' ';
+			append_value(destination, sample.value);
+			destination += '\n';
+		}
+	}
+
+	void write_json(metrics_snapshot const &snapshot, std::string &destination)
+	{
+		destination += '{';
+		append_json_field(destination, "requests", snapshot.counters[request_counter]);
+		append_json_field(destination, "sent_bytes", snapshot.counters[sent_bytes_counter]);
+		append_json_field(destination, "connections", snapshot.counters[opened_connection_counter]);
+		append_json_field(destination, "active_connections", snapshot.active_connections());
+		append_json_field(destination, "errors", snapshot.counters[error_counter]);
+		append_json_field(destination, "idle_timeouts", snapshot.counters[idle_timeout_counter]);
+		append_json_field(destination, "header_timeouts", snapshot.counters[header_timeout_counter]);
+		append_json_field(destination, "send_timeouts", snapshot.counters[send_timeout_counter]);
+		append_json_field(destination, "body_timeouts", snapshot.counters[body_timeout_counter]);
+		append_json_field(destination, "arena_allocations", snapshot.counters[arena_allocation_counter]);
+		append_json_field(destination, "arena_bytes", snapshot.counters[arena_byte_counter]);
+		append_json_field(destination, "arena_chunks", snapshot.counters[arena_chunk_counter]);
+
+		destination += "\"statuses\":{";
+		bool first = true;
+		for (unsigned status = first_counted_status; status <= last_counted_status; ++status)
+		{
+			boost::uint64_t const count = snapshot.status_count(status);
+			if (count)
+			{
+				if (!first)
+				{
+					destination += ',';
+				}
+				first = false;
+				destination += '"';
+				append_decimal(destination, status);
+				destination += "\":";
+				append_decimal(destination, count);
+			}
+		}
+
+		destination += "},\"phases\":{";
+		for (std::size_t phase = 0; phase < phase_count; ++phase)
+		{
+			latency_histogram const &histogram = snapshot.phases[phase];
+			if (phase)
+			{
+				destination += ',';
+			}
+			destination += '"';
+			destination += phase_name(static_cast<request_phase>(phase));
+			destination += "\":{";
+			append_json_field(destination, "count", histogram.count);
+			append_json_field(destination, "sum_ns", histogram.sum_nanoseconds);
+			append_json_field(destination, "p50_ns", latency_percentile(histogram, 50));
+			append_json_field(destination, "p90_ns", latency_percentile(histogram, 90));
+			append_json_field(destination, "p99_ns", latency_percentile(histogram, 99));
+			append_json_field(destination, "p999_ns", latency_percentile(histogram, 99.9));
+			destination.erase(destination.size() - 1);
+			destination += '}';
+		}
+
+		destination += "},\"samples\":{";
+		first = true;
+		BOOST_FOREACH (metric_sample const &sample, snapshot.samples)
+		{
+			if (!first)
+			{
+				destination += ',';
+			}
+			first = false;
+			destination += '"';
+			destination += sample.name;
+			destination += "\":";
+			append_value(destination, sample.value);
+		}
+		destination += "}}";
+	}
+}
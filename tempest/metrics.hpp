@@ -0,0 +1,156 @@
+#ifndef TEMPEST_METRICS_HPP
+#define TEMPEST_METRICS_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	enum metrics_counter
+	{
+		request_counter,
+		sent_bytes_counter,
+		opened_connection_counter,
+		closed_connection_counter,
+
+		//exceptions which ended a connection
+		error_counter,
+
+		//connections closed because the client took too long to send the
+		//next request, to complete the head of a request, to receive the
+		//response, or to send more of the body of a request
+		idle_timeout_counter,
+		header_timeout_counter,
+		send_timeout_counter,
+		body_timeout_counter,
+
+		//What the arenas of the connections did for the requests. The
+		//chunks are what they took from the heap, which stops when every
+		//connection has seen its largest request.
+		arena_allocation_counter,
+		arena_byte_counter,
+		arena_chunk_counter,
+
+		counter_count
+	};
+
+	//the steps of a request whose duration is recorded
+	enum request_phase
+	{
+		//parsing the complete head and making the http_request
+		parse_phase,
+
+		//from handing the request to the directory until the response starts
+		lookup_phase,
+
+		//from the start of the response until it has been sent
+		send_phase,
+
+		phase_count
+	};
+
+	char const *phase_name(request_phase phase);
+
+	//Bucket i of a latency_histogram counts the durations below
+	//latency_bucket_bound(i) which is 2^(i + 7) nanoseconds. The bucket at
+	//latency_bucket_count counts the longer ones.
+	std::size_t const latency_bucket_count = 27;
+
+	boost::uint64_t latency_bucket_bound(std::size_t bucket);
+
+	struct latency_histogram
+	{
+		boost::uint64_t buckets[latency_bucket_count + 1];
+		boost::uint64_t count;
+		boost::uint64_t sum_nanoseconds;
+
+		latency_histogram();
+	};
+
+	//The upper bound of the bucket below which the given percentage of the
+	//durations lie. Zero if nothing has been recorded.
+	boost::uint64_t latency_percentile(latency_histogram const &histogram, double percent);
+
+	//A value which is read from elsewhere when the metrics are collected,
+	//for example the statistics of a cache.
+	struct metric_sample
+	{
+		std::string name;
+		std::string help;
+
+		//a counter only increases, otherwise it is a gauge
+		bool is_counter;
+
+		double value;
+	};
+
+	//the status codes from first_counted_status to last_counted_status
+	unsigned const first_counted_status = 100;
+	unsigned const last_counted_status = 599;
+
+	struct metrics_snapshot
+	{
+		boost::uint64_t counters[counter_count];
+		boost::uint64_t statuses[last_counted_status - first_counted_status + 1];
+		latency_histogram phases[phase_count];
+		std::vector<metric_sample> samples;
+
+		metrics_snapshot();
+
+		boost::uint64_t status_count(unsigned status) const;
+		boost::uint64_t active_connections() const;
+	};
+
+	//Counters and latency histograms of a server. Every thread updates its
+	//own shard with relaxed atomic additions, and the shards are only added
+	//up when the metrics are read. Threads share a shard when there are
+	//more threads than shards, which is still correct but slower.
+	struct metrics TEMPEST_FINAL : boost::noncopyable
+	{
+		typedef boost::function<void (std::vector<metric_sample> &)> collector;
+
+		metrics();
+		~metrics();
+
+		void add(metrics_counter counter, boost::uint64_t amount = 1);
+
+		//statuses outside of the counted range are ignored
+		void count_status(unsigned status);
+
+		void record(request_phase phase, boost::chrono::steady_clock::duration duration);
+
+		//A collector appends samples when a snapshot is taken. It is called
+		//from the thread which reads the metrics.
+		void add_collector(collector collect);
+
+		metrics_snapshot snapshot() const;
+
+	private:
+
+		struct shard;
+
+		boost::scoped_array<shard> m_shards;
+		mutable boost::mutex m_collectors_mutex;
+		std::vector<collector> m_collectors;
+
+		shard &local_shard();
+	};
+
+	//appends the text exposition format of Prometheus (version 0.0.4)
+	void write_prometheus(metrics_snapshot const &snapshot, std::string &destination);
+
+	//appends a JSON object with the same values and some percentiles
+	void write_json(metrics_snapshot const &snapshot, std::string &destination);
+}
+
+
+#endif
@@ -0,0 +1,43 @@
+#include "metrics_directory.hpp"
+#include "metrics.hpp"
+#include "responses.hpp"
+#include "http/response_writer.hpp"
+#include <boost/move/move.hpp>
+
+
+namespace tempest
+{
+	metrics_directory::metrics_directory(boost::shared_ptr<metrics const> metrics)
+	    : m_metrics(boost::move(metrics))
+	{
+		assert(m_metrics);
+	}
+
+	void metrics_directory::respond(http_request const &,
+	                                boost::string_ref,
+	                                sender &sender)
+	{
+		send_in_memory_response(render(), sender);
+	}
+
+	void metrics_directory::async_respond(http_request const &,
+	                                      boost::string_ref,
+	                                      async_sender &sender,
+	                                      response_handler handler)
+	{
+		async_send_in_memory_response(render(), sender, boost::move(handler));
+	}
+
+	in_memory_response metrics_directory::render() const
+	{
+		in_memory_response response;
+		write_prometheus(m_metrics->snapshot(), response.body);
+
+		response_writer writer(response.header);
+		writer.status_line("HTTP/1.1", 200, "OK");
+		writer.header("Content-Length", static_cast<boost::uint64_t>(response.body.size()));
+		writer.header("Content-Type", "text/plain; version=0.0.4");
+		writer.header("Cache-Control", "no-store");
+		return response;
+	}
+}
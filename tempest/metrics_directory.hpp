@@ -0,0 +1,38 @@
+#ifndef TEMPEST_METRICS_DIRECTORY_HPP
+#define TEMPEST_METRICS_DIRECTORY_HPP
+
+
+#include <tempest/directory.hpp>
+#include <tempest/config.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+namespace tempest
+{
+	struct metrics;
+	struct in_memory_response;
+
+	//Answers every request with the current metrics in the Prometheus text
+	//format, so it is meant to be mounted in a virtual_directory, for
+	//example at /_tempest/metrics.
+	struct metrics_directory TEMPEST_FINAL : directory
+	{
+		explicit metrics_directory(boost::shared_ptr<metrics const> metrics);
+		virtual void respond(http_request const &request,
+		                     boost::string_ref sub_path,
+		                     sender &sender) TEMPEST_OVERRIDE;
+		virtual void async_respond(http_request const &request,
+		                           boost::string_ref sub_path,
+		                           async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE;
+
+	private:
+
+		boost::shared_ptr<metrics const> const m_metrics;
+
+		in_memory_response render() const;
+	};
+}
+
+
+#endif
@@ -2,11 +2,12 @@
 #include "responses.hpp"
 #include "client.hpp"
 #include "http/http_request.hpp"
-#include "http/http_response.hpp"
 #include <boost/filesystem/operations.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/iostreams/copy.hpp>
 #include <boost/move/move.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
 #include <fstream>
 
 
@@ -14,57 +15,275 @@ namespace tempest
 {
 	namespace portable
 	{
+		namespace
+		{
+			//Returns an error or a 304 response if the file is not to be
+			//sent. Otherwise body describes the response. The whole file is
+			//a single piece.
+			boost::optional<in_memory_response>
+			open_served_file(boost::filesystem::path const &dir,
+			                 http_request const &request,
+			                 boost::string_ref sub_path,
+			                 std::ifstream &file,
+			                 partial_response &body)
+			{
+				if (request.method != "GET" &&
+					request.method != "POST")
+				{
+					return make_not_implemented_response(request.file);
+				}
+
+				boost::optional<boost::filesystem::path> const full_path =
+						complete_served_path(dir, sub_path);
+
+				if (!full_path)
+				{
+					return make_not_found_response(request.file);
+				}
+
+				//the precompressed files are tried before the original
+				content_coding codings[3];
+				std::size_t const coding_count = preferred_codings(request, codings);
+				content_coding coding = identity_coding;
+				boost::filesystem::path served_path;
+				for (std::size_t i = 0; i < coding_count; ++i)
+				{
+					coding = codings[i];
+					served_path = full_path->string() + sidecar_extension(coding);
+					if (boost::filesystem::is_regular_file(served_path))
+					{
+						break;
+					}
+					served_path.clear();
+				}
+
+				if (served_path.empty())
+				{
+					return make_not_found_response(request.file);
+				}
+
+				boost::uintmax_t const file_size = boost::filesystem::file_size(served_path);
+				if (file_size > std::numeric_limits<std::size_t>::max())
+				{
+					return make_not_implemented_response(request.file);
+				}
+
+				//the modification time has only a resolution of seconds here
+				file_validators validators;
+				validators.modified_seconds = boost::filesystem::last_write_time(served_path);
+				validators.etag = make_weak_entity_tag(validators.modified_seconds, file_size);
+				if (is_not_modified(request, validators))
+				{
+					in_memory_response not_modified;
+					write_not_modified_header_block(not_modified.header, validators, coding);
+					return not_modified;
+				}
+
+				//ifstream does not support std::string in old implementations
+				//therefore c_str()
+				file.open(served_path.string().c_str(),
+						  std::ios::binary);
+				if (!file)
+				{
+					return make_not_found_response(request.file);
+				}
+
+				file.exceptions(std::ios::badbit);
+
+				std::string const file_name = full_path->filename().string();
+				boost::optional<in_memory_response> range_error =
+				        plan_partial_response(request, file_name, file_size, validators,
+				                              coding, body);
+				if (range_error)
+				{
+					return range_error;
+				}
+
+				if (body.pieces.empty())
+				{
+					body.header.clear();
+					write_file_header_block(body.header, file_name, file_size, validators, coding);
+					body.pieces.push_back(body_piece::from_file(0, file_size));
+				}
+				return boost::none;
+			}
+
+			void copy_range(std::ifstream &file,
+			                boost::uintmax_t offset,
+			                boost::uintmax_t length,
+			                std::ostream &sink)
+			{
+				char buffer[64 * 1024];
+				file.seekg(static_cast<std::streamoff>(offset));
+				while (length > 0)
+				{
+					std::size_t const piece = static_cast<std::size_t>(
+					            std::min<boost::uintmax_t>(sizeof(buffer), length));
+					file.read(buffer, static_cast<std::streamsize>(piece));
+					if (static_cast<std::size_t>(file.gcount()) != piece)
+					{
+						throw std::runtime_error("The file became shorter while sending it");
+					}
+					sink.write(buffer, static_cast<std::streamsize>(piece));
+					length -= piece;
+				}
+			}
+
+			//Sends the file chunk by chunk so that only one chunk has to be
+			//kept in memory.
+			struct file_transmission TEMPEST_FINAL
+			        : boost::enable_shared_from_this<file_transmission>
+			{
+				explicit file_transmission(async_sender &sender,
+				                           directory::response_handler handler)
+				    : m_sender(sender)
+				    , m_handler(boost::move(handler))
+				    , m_chunk(64 * 1024)
+				    , m_header_sent(false)
+				    , m_next_piece(0)
+				    , m_piece_progress(0)
+				{
+				}
+
+				void start(bool persistent)
+				{
+					m_end_of_header = end_of_header_block(persistent);
+					send_chunk();
+				}
+
+				partial_response &body()
+				{
+					return m_body;
+				}
+
+				std::ifstream &file()
+				{
+					return m_file;
+				}
+
+			private:
+
+				async_sender &m_sender;
+				directory::response_handler const m_handler;
+				std::ifstream m_file;
+				partial_response m_body;
+				boost::asio::const_buffer m_end_of_header;
+				std::vector<char> m_chunk;
+				bool m_header_sent;
+				std::size_t m_next_piece;
+				boost::uintmax_t m_piece_progress;
+
+
+				void send_chunk()
+				{
+					send_parts parts;
+					if (!m_header_sent)
+					{
+						parts.push_back(send_part::from_memory(boost::asio::buffer(m_body.header)));
+						parts.push_back(send_part::from_memory(m_end_of_header));
+					}
+
+					if (m_next_piece < m_body.pieces.size())
+					{
+						body_piece const &piece = m_body.pieces[m_next_piece];
+						if (piece.is_file)
+						{
+							std::size_t const chunk_size = static_cast<std::size_t>(
+							            std::min<boost::uintmax_t>(m_chunk.size(),
+							                                       piece.length - m_piece_progress));
+							m_file.seekg(static_cast<std::streamoff>(piece.offset + m_piece_progress));
+							m_file.read(m_chunk.data(), static_cast<std::streamsize>(chunk_size));
+							if (static_cast<std::size_t>(m_file.gcount()) != chunk_size)
+							{
+								//the file became shorter in the meantime
+								return m_handler(boost::system::errc::make_error_code(
+								                     boost::system::errc::io_error));
+							}
+							parts.push_back(send_part::from_memory(
+							                    boost::asio::buffer(m_chunk.data(), chunk_size)));
+							m_piece_progress += chunk_size;
+						}
+						else
+						{
+							parts.push_back(send_part::from_memory(boost::asio::buffer(
+							    m_body.framing.data() + piece.offset,
+							    static_cast<std::size_t>(piece.length))));
+							m_piece_progress = piece.length;
+						}
+
+						if (m_piece_progress == piece.length)
+						{
+							++m_next_piece;
+							m_piece_progress = 0;
+						}
+					}
+
+					m_sender.async_send(parts, boost::bind(&file_transmission::handle_sent,
+					                                       shared_from_this(), _1));
+				}
+
+				void handle_sent(boost::system::error_code error)
+				{
+					m_header_sent = true;
+					if (error || (m_next_piece == m_body.pieces.size()))
+					{
+						return m_handler(error);
+					}
+					send_chunk();
+				}
+			};
+		}
+
 		file_system_directory::file_system_directory(boost::filesystem::path dir)
 			: m_dir(boost::move(dir))
 		{
 		}
 
 		void file_system_directory::respond(http_request const &request,
-		                                    std::string const &sub_path,
+		                                    boost::string_ref sub_path,
 		                                    sender &sender)
 		{
-			if (request.method != "GET" &&
-				request.method != "POST")
-			{
-				return send_in_memory_response(make_not_implemented_response(request.file), sender);
-			}
-
-			boost::optional<boost::filesystem::path> const full_path =
-					complete_served_path(m_dir, sub_path);
-
-			if (!full_path ||
-					!boost::filesystem::is_regular_file(*full_path))
+			std::ifstream file;
+			partial_response body;
+			boost::optional<in_memory_response> const error =
+			        open_served_file(m_dir, request, sub_path, file, body);
+			if (error)
 			{
-				return send_in_memory_response(make_not_found_response(request.file), sender);
+				return send_in_memory_response(*error, sender);
 			}
 
-			//ifstream does not support std::string in old implementations
-			//therefore c_str()
-			std::ifstream file(full_path->string().c_str(),
-							   std::ios::binary);
-			if (!file)
+			send_header_block(body.header, sender);
+			BOOST_FOREACH (body_piece const &piece, body.pieces)
 			{
-				return send_in_memory_response(make_not_found_response(request.file), sender);
+				if (piece.is_file)
+				{
+					//iostreams::copy would flush the sender which is left to the caller
+					copy_range(file, piece.offset, piece.length, sender.response());
+				}
+				else
+				{
+					sender.response().write(body.framing.data() + piece.offset,
+					                        static_cast<std::streamsize>(piece.length));
+				}
 			}
+		}
 
-			file.exceptions(std::ios::failbit | std::ios::badbit);
-
-			boost::uintmax_t const file_size = boost::filesystem::file_size(*full_path);
-			if (file_size > std::numeric_limits<std::size_t>::max())
+		void file_system_directory::async_respond(http_request const &request,
+		                                          boost::string_ref sub_path,
+		                                          async_sender &sender,
+		                                          response_handler handler)
+		{
+			boost::shared_ptr<file_transmission> const transmission =
+			        boost::make_shared<file_transmission>(boost::ref(sender), handler);
+			boost::optional<in_memory_response> const error =
+			        open_served_file(m_dir, request, sub_path,
+			                         transmission->file(), transmission->body());
+			if (error)
 			{
-				return send_in_memory_response(make_not_implemented_response(request.file), sender);
+				return async_send_in_memory_response(*error, sender, handler);
 			}
 
-			http_response response;
-			response.version = "HTTP/1.1";
-			response.status = 200;
-			response.reason = "OK";
-			response.headers["Content-Length"] =
-					boost::lexical_cast<std::string>(file_size);
-
-			print_response(response, sender.response());
-			boost::iostreams::copy(file, sender.response());
-			sender.response().flush();
+			transmission->start(sender.is_persistent());
 		}
 	}
 }
@@ -15,8 +15,12 @@ namespace tempest
 		{
 			explicit file_system_directory(boost::filesystem::path dir);
 			virtual void respond(http_request const &request,
-			                     std::string const &sub_path,
+			                     boost::string_ref sub_path,
 			                     sender &sender) TEMPEST_OVERRIDE;
+			virtual void async_respond(http_request const &request,
+			                           boost::string_ref sub_path,
+			                           async_sender &sender,
+			                           response_handler handler) TEMPEST_OVERRIDE;
 
 		private:
 
@@ -0,0 +1,348 @@
+#include "archive_directory.hpp"
+#include <tempest/client.hpp>
+#include <http/http_request.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/system/system_error.hpp>
+#include <stdexcept>
+
+#if TEMPEST_USE_POSIX
+#	include <sys/mman.h>
+#	include <errno.h>
+#endif
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		namespace
+		{
+			//Smaller bodies are copied from the mapping into the write of the
+			//header instead of being sent with a sendfile of their own.
+			file_size const max_memory_body = 64 * 1024;
+
+			bool is_region(boost::uint64_t offset, boost::uint64_t length, boost::uint64_t size)
+			{
+				return (offset <= size) && (length <= size - offset);
+			}
+
+			boost::asio::const_buffer framing_buffer(partial_response const &partial,
+			                                         body_piece const &piece)
+			{
+				return boost::asio::buffer(partial.framing.data() + piece.offset,
+				                           static_cast<std::size_t>(piece.length));
+			}
+
+			void release_partial(boost::system::error_code error,
+			                     boost::shared_ptr<partial_response const> const &,
+			                     directory::response_handler const &handler)
+			{
+				handler(error);
+			}
+		}
+
+		archive_directory::archive_directory(boost::filesystem::path const &archive)
+		    : m_file(open_read(archive.string()))
+		    , m_begin(0)
+		    , m_size(0)
+		    , m_header(0)
+		    , m_seeds(0)
+		    , m_entries(0)
+		    , m_variants(0)
+		    , m_strings(0)
+		{
+			status const version = m_file.get_status();
+			if (!version.is_regular ||
+			    (version.size < sizeof(archive_header)) ||
+			    (version.size > std::numeric_limits<std::size_t>::max()))
+			{
+				throw std::invalid_argument(archive.string() + " is not an archive");
+			}
+
+			void * const mapped = mmap(0, static_cast<std::size_t>(version.size), PROT_READ,
+			                           MAP_SHARED, m_file.handle(), 0);
+			if (mapped == MAP_FAILED)
+			{
+				throw boost::system::system_error(errno, boost::system::system_category());
+			}
+			m_begin = static_cast<char const *>(mapped);
+			m_size = static_cast<std::size_t>(version.size);
+
+			//The tables are checked once so that a lookup only has to check
+			//the regions an entry refers to.
+			archive_header const &header = *reinterpret_cast<archive_header const *>(m_begin);
+			if (!is_archive_header(header) ||
+			    (header.size != m_size) ||
+			    (header.entry_count > m_size) ||
+			    (header.variant_count > m_size) ||
+			    !is_region(header.seeds_offset, header.entry_count * sizeof(*m_seeds), m_size) ||
+			    !is_region(header.entries_offset, header.entry_count * sizeof(*m_entries), m_size) ||
+			    !is_region(header.variants_offset, header.variant_count * sizeof(*m_variants), m_size) ||
+			    !is_region(header.strings_offset, header.strings_size, m_size))
+			{
+				munmap(mapped, m_size);
+				throw std::invalid_argument(archive.string() + " is not a valid archive of this version");
+			}
+			m_header = &header;
+			m_seeds = reinterpret_cast<boost::int32_t const *>(m_begin + header.seeds_offset);
+			m_entries = reinterpret_cast<archive_entry const *>(m_begin + header.entries_offset);
+			m_variants = reinterpret_cast<archive_variant const *>(m_begin + header.variants_offset);
+			m_strings = m_begin + header.strings_offset;
+
+			//The tables follow the bodies. Reading them ahead does not delay
+			//the start, but spares the first requests the page faults.
+			std::size_t const tables = static_cast<std::size_t>(
+			            header.seeds_offset - header.seeds_offset % archive_page_size);
+			madvise(const_cast<char *>(m_begin) + tables, m_size - tables, MADV_WILLNEED);
+		}
+
+		archive_directory::~archive_directory()
+		{
+			munmap(const_cast<char *>(m_begin), m_size);
+		}
+
+		void archive_directory::respond(http_request const &request,
+		                                boost::string_ref sub_path,
+		                                sender &sender)
+		{
+			served_file served;
+			boost::optional<in_memory_response> const error =
+			        find_served_file(request, sub_path, served);
+			if (error)
+			{
+				return send_in_memory_response(*error, sender);
+			}
+
+			archive_variant const &variant = *served.variant;
+			if (served.not_modified)
+			{
+				return send_header_block(get_string(variant.not_modified), sender);
+			}
+
+			partial_response const * const partial = served.partial.get();
+			if (!partial)
+			{
+				send_header_block(get_string(variant.ok), sender);
+				return send_body(variant, 0, variant.body_size, sender);
+			}
+
+			send_header_block(partial->header, sender);
+			BOOST_FOREACH (body_piece const &piece, partial->pieces)
+			{
+				if (piece.is_file)
+				{
+					send_body(variant, piece.offset, piece.length, sender);
+				}
+				else
+				{
+					boost::asio::const_buffer const framing = framing_buffer(*partial, piece);
+					sender.response().write(boost::asio::buffer_cast<char const *>(framing),
+					                        boost::asio::buffer_size(framing));
+				}
+			}
+		}
+
+		void archive_directory::async_respond(http_request const &request,
+		                                      boost::string_ref sub_path,
+		                                      async_sender &sender,
+		                                      response_handler handler)
+		{
+			served_file served;
+			boost::optional<in_memory_response> const error =
+			        find_served_file(request, sub_path, served);
+			if (error)
+			{
+				return async_send_in_memory_response(*error, sender, handler);
+			}
+
+			//The archive outlives the response, so only a partial response
+			//has to be kept alive.
+			archive_variant const &variant = *served.variant;
+			partial_response const * const partial = served.partial.get();
+			send_parts parts;
+			if (served.not_modified)
+			{
+				parts.push_back(send_part::from_memory(to_buffer(get_string(variant.not_modified))));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+			}
+			else if (!partial)
+			{
+				parts.push_back(send_part::from_memory(to_buffer(get_string(variant.ok))));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+				parts.push_back(make_body_part(variant, 0, variant.body_size));
+			}
+			else
+			{
+				parts.push_back(send_part::from_memory(boost::asio::buffer(partial->header)));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+				BOOST_FOREACH (body_piece const &piece, partial->pieces)
+				{
+					parts.push_back(piece.is_file
+					                ? make_body_part(variant, piece.offset, piece.length)
+					                : send_part::from_memory(framing_buffer(*partial, piece)));
+				}
+				return sender.async_send(parts, boost::bind(release_partial, _1, served.partial,
+				                                            boost::move(handler)));
+			}
+			sender.async_send(parts, boost::move(handler));
+		}
+
+		std::size_t archive_directory::size() const
+		{
+			return static_cast<std::size_t>(m_header->entry_count);
+		}
+
+		archive_directory::served_file::served_file()
+		    : variant(0)
+		    , coding(identity_coding)
+		    , not_modified(false)
+		{
+		}
+
+		boost::string_ref archive_directory::get_string(archive_string const &region) const
+		{
+			if (!is_region(region.offset, region.length, m_header->strings_size))
+			{
+				return boost::string_ref();
+			}
+			return boost::string_ref(m_strings + region.offset,
+			                         static_cast<std::size_t>(region.length));
+		}
+
+		boost::asio::const_buffer archive_directory::to_buffer(boost::string_ref content)
+		{
+			return boost::asio::buffer(content.data(), content.size());
+		}
+
+		archive_entry const *archive_directory::find_entry(boost::string_ref path) const
+		{
+			while (!path.empty() && (path.front() == '/'))
+			{
+				path.remove_prefix(1);
+			}
+			std::size_t const count = static_cast<std::size_t>(m_header->entry_count);
+			if (count == 0)
+			{
+				return 0;
+			}
+			std::size_t const slot = find_perfect_hash_slot(m_seeds, count, path);
+			if (slot >= count)
+			{
+				return 0;
+			}
+			archive_entry const &entry = m_entries[slot];
+			return (get_string(entry.path) == path) ? &entry : 0;
+		}
+
+		boost::optional<in_memory_response>
+		archive_directory::find_served_file(http_request const &request,
+		                                    boost::string_ref sub_path,
+		                                    served_file &served) const
+		{
+			if (request.method != "GET" &&
+				request.method != "POST")
+			{
+				return make_not_implemented_response(request.file);
+			}
+
+			archive_entry const * const entry = find_entry(sub_path);
+			if (!entry)
+			{
+				return make_not_found_response(request.file);
+			}
+
+			//the precompressed variants are tried before the original
+			content_coding codings[3];
+			std::size_t const coding_count = preferred_codings(request, codings);
+			for (std::size_t i = 0; i < coding_count; ++i)
+			{
+				boost::uint32_t const index = entry->variants[codings[i]];
+				if (index < m_header->variant_count)
+				{
+					served.variant = m_variants + index;
+					served.coding = codings[i];
+					break;
+				}
+			}
+
+			archive_variant const * const variant = served.variant;
+			if (!variant ||
+			    !is_region(variant->body_offset, variant->body_size, m_size))
+			{
+				return make_not_found_response(request.file);
+			}
+
+			//most requests need neither the validators nor a plan
+			bool const conditional = is_conditional(request);
+			bool const ranged = (find_header(request, "Range") != 0);
+			if (!conditional && !ranged)
+			{
+				return boost::none;
+			}
+
+			file_validators validators;
+			validators.etag = get_string(variant->etag).to_string();
+			validators.modified_seconds = variant->modified_seconds;
+			if (conditional && is_not_modified(request, validators))
+			{
+				served.not_modified = true;
+				return boost::none;
+			}
+
+			if (ranged)
+			{
+				boost::shared_ptr<partial_response> const planned =
+				        boost::make_shared<partial_response>();
+				boost::optional<in_memory_response> range_error =
+				        plan_partial_response(request, get_string(entry->path), variant->body_size,
+				                              validators, served.coding, *planned);
+				if (range_error)
+				{
+					return range_error;
+				}
+				if (!planned->pieces.empty())
+				{
+					served.partial = planned;
+				}
+			}
+			return boost::none;
+		}
+
+		send_part archive_directory::make_body_part(archive_variant const &variant,
+		                                            file_size offset,
+		                                            file_size length) const
+		{
+			if (length <= max_memory_body)
+			{
+				return send_part::from_memory(boost::asio::buffer(
+				    m_begin + variant.body_offset + offset, static_cast<std::size_t>(length)));
+			}
+			return send_part::from_file(m_file.handle(), variant.body_offset + offset, length);
+		}
+
+		void archive_directory::send_body(archive_variant const &variant,
+		                                  file_size offset,
+		                                  file_size length,
+		                                  sender &sender) const
+		{
+			boost::optional<int> const client_fd = sender.posix_response();
+			if (client_fd && (length > max_memory_body))
+			{
+				//the cork lets the header share a segment with the body
+				cork_guard const cork(*client_fd);
+				sender.response().flush();
+				if (m_file.send_to(*client_fd, variant.body_offset + offset, length) != length)
+				{
+					throw std::runtime_error("Sending the whole file failed");
+				}
+				return;
+			}
+			sender.response().write(m_begin + variant.body_offset + offset,
+			                        static_cast<std::streamsize>(length));
+		}
+#endif
+	}
+}
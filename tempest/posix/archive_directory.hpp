@@ -0,0 +1,96 @@
+#ifndef TEMPEST_POSIX_ARCHIVE_DIRECTORY_HPP
+#define TEMPEST_POSIX_ARCHIVE_DIRECTORY_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/archive.hpp>
+#include <tempest/client.hpp>
+#include <tempest/directory.hpp>
+#include <tempest/responses.hpp>
+#include <tempest/posix/file_handle.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		//Serves the files of an archive written by pack_directory. The archive
+		//is mapped into memory as a whole, but only the header is read when
+		//it is opened, so that opening does not depend on its size. A lookup
+		//is a perfect hash of the path and a comparison with the path of
+		//the entry. No file is opened or checked per request. Large bodies
+		//are sent from the archive with sendfile, small ones from the
+		//mapping together with the header.
+		struct archive_directory TEMPEST_FINAL : directory, boost::noncopyable
+		{
+			//throws if the archive cannot be mapped or is not valid
+			explicit archive_directory(boost::filesystem::path const &archive);
+			~archive_directory();
+
+			virtual void respond(http_request const &request,
+			                     boost::string_ref sub_path,
+			                     sender &sender) TEMPEST_OVERRIDE;
+			virtual void async_respond(http_request const &request,
+			                           boost::string_ref sub_path,
+			                           async_sender &sender,
+			                           response_handler handler) TEMPEST_OVERRIDE;
+
+			//the number of paths
+			std::size_t size() const;
+
+		private:
+
+			file_handle m_file;
+			char const *m_begin;
+			std::size_t m_size;
+			archive_header const *m_header;
+			boost::int32_t const *m_seeds;
+			archive_entry const *m_entries;
+			archive_variant const *m_variants;
+			char const *m_strings;
+
+			struct served_file
+			{
+				archive_variant const *variant;
+				content_coding coding;
+
+				//set if only ranges of the file are to be sent
+				boost::shared_ptr<partial_response const> partial;
+
+				//the client's copy is up to date
+				bool not_modified;
+
+				served_file();
+			};
+
+			boost::string_ref get_string(archive_string const &region) const;
+			archive_entry const *find_entry(boost::string_ref path) const;
+
+			//Returns an error response if the file cannot be served.
+			boost::optional<in_memory_response>
+			find_served_file(http_request const &request,
+			                 boost::string_ref sub_path,
+			                 served_file &served) const;
+
+			send_part make_body_part(archive_variant const &variant,
+			                         file_size offset,
+			                         file_size length) const;
+
+			void send_body(archive_variant const &variant,
+			               file_size offset,
+			               file_size length,
+			               sender &sender) const;
+
+			static boost::asio::const_buffer to_buffer(boost::string_ref content);
+		};
+#endif
+	}
+}
+
+
+#endif
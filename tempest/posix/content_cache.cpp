@@ -0,0 +1,95 @@
+#include "content_cache.hpp"
+#include <boost/move/move.hpp>
+#include <cassert>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		std::string make_cache_key(std::string const &path, content_coding coding)
+		{
+			if (coding == identity_coding)
+			{
+				return path;
+			}
+
+			//a null character cannot occur in a path
+			std::string key = path;
+			key += '\0';
+			key += coding_name(coding);
+			return key;
+		}
+
+		content_cache_options::content_cache_options()
+		    : max_total_size(64 * 1024 * 1024)
+		    , max_file_size(256 * 1024)
+		    , shard_count(16)
+		    , revalidation_interval(boost::chrono::seconds(1))
+		{
+		}
+
+		content_cache_statistics::content_cache_statistics()
+		    : hits(0)
+		    , misses(0)
+		    , invalidations(0)
+		    , evictions(0)
+		    , total_size(0)
+		    , file_count(0)
+		{
+		}
+
+		content_cache::content_cache(content_cache_options const &options)
+		    : m_options(options)
+		    , m_files(options.shard_count, options.max_total_size,
+		              options.revalidation_interval,
+		              0, boost::chrono::steady_clock::duration::zero())
+		{
+		}
+
+		boost::shared_ptr<cached_file const> content_cache::find(std::string const &path,
+		                                                         content_coding coding)
+		{
+			boost::shared_ptr<cached_file const> found;
+			if (!m_files.find(make_cache_key(path, coding), path + sidecar_extension(coding), found))
+			{
+				return boost::shared_ptr<cached_file const>();
+			}
+			return found;
+		}
+
+		bool content_cache::accepts(file_size size) const
+		{
+			return (size <= m_options.max_file_size) &&
+			       (size <= m_files.shard_budget());
+		}
+
+		void content_cache::insert(std::string const &path,
+		                           boost::shared_ptr<cached_file const> file,
+		                           content_coding coding)
+		{
+			assert(file);
+			file_size const size = file->content.size();
+			if (!accepts(size))
+			{
+				return;
+			}
+			m_files.insert(make_cache_key(path, coding), boost::move(file), size);
+		}
+
+		content_cache_statistics content_cache::statistics() const
+		{
+			revalidating_cache_statistics const files = m_files.statistics();
+			content_cache_statistics result;
+			result.hits = files.hits;
+			result.misses = files.misses;
+			result.invalidations = files.invalidations;
+			result.evictions = files.evictions;
+			result.total_size = files.total_cost;
+			result.file_count = files.entries;
+			return result;
+		}
+#endif
+	}
+}
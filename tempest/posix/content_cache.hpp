@@ -0,0 +1,96 @@
+#ifndef TEMPEST_POSIX_CONTENT_CACHE_HPP
+#define TEMPEST_POSIX_CONTENT_CACHE_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/posix/file_handle.hpp>
+#include <tempest/posix/revalidating_cache.hpp>
+#include <tempest/responses.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		//Precompressed files are cached separately from a request for the
+		//same file without a coding because the responses differ.
+		std::string make_cache_key(std::string const &path, content_coding coding);
+
+		struct content_cache_options
+		{
+			//the sum of the sizes of all cached files
+			file_size max_total_size;
+
+			//larger files are not cached
+			file_size max_file_size;
+
+			//Every shard has its own lock and an equal part of the budget.
+			unsigned shard_count;
+
+			//A cached file is compared to the file system again after this
+			//time. Zero means on every use.
+			boost::chrono::steady_clock::duration revalidation_interval;
+
+			content_cache_options();
+		};
+
+		//A small file held in memory together with its pre-rendered response
+		struct cached_file
+		{
+			status version;
+			std::vector<char> content;
+
+			file_headers headers;
+		};
+
+		struct content_cache_statistics
+		{
+			boost::uint64_t hits;
+			boost::uint64_t misses;
+			boost::uint64_t invalidations;
+			boost::uint64_t evictions;
+			file_size total_size;
+			std::size_t file_count;
+
+			content_cache_statistics();
+		};
+
+		//A thread-safe LRU cache of file contents with a byte budget. Files
+		//are invalidated when their size, inode or modification time changes.
+		struct content_cache TEMPEST_FINAL : boost::noncopyable
+		{
+			explicit content_cache(content_cache_options const &options);
+
+			//Returns the cached file if it is still up to date. Counts a hit
+			//or a miss. A coding refers to the precompressed file next to
+			//the path.
+			boost::shared_ptr<cached_file const> find(std::string const &path,
+			                                          content_coding coding = identity_coding);
+
+			//whether a file of this size would be cached by insert
+			bool accepts(file_size size) const;
+
+			void insert(std::string const &path,
+			            boost::shared_ptr<cached_file const> file,
+			            content_coding coding = identity_coding);
+
+			content_cache_statistics statistics() const;
+
+		private:
+
+			content_cache_options const m_options;
+			revalidating_cache<cached_file> m_files;
+		};
+#endif
+	}
+}
+
+
+#endif
@@ -8,6 +8,10 @@
 #	include <sys/stat.h>
 #	include <unistd.h>
 #	include <fcntl.h>
+#	include <poll.h>
+#	include <netinet/in.h>
+#	include <netinet/tcp.h>
+#	include <sys/socket.h>
 #endif
 
 
@@ -19,9 +23,23 @@ namespace tempest
 		status::status()
 		    : size(std::numeric_limits<file_size>::max())
 		    , is_regular(false)
+		    , device(0)
+		    , inode(0)
+		    , modified_seconds(0)
+		    , modified_nanoseconds(0)
 		{
 		}
 
+		bool is_same_version(status const &left, status const &right)
+		{
+			return (left.size == right.size) &&
+			       (left.is_regular == right.is_regular) &&
+			       (left.device == right.device) &&
+			       (left.inode == right.inode) &&
+			       (left.modified_seconds == right.modified_seconds) &&
+			       (left.modified_nanoseconds == right.modified_nanoseconds);
+		}
+
 
 		file_handle::file_handle()
 		    : m_fd(-1)
@@ -66,49 +84,61 @@ namespace tempest
 		{
 			boost::system::system_error make_errno_exception()
 			{
-				return boost::system::system_error(errno, boost::system::posix_category);
+				return boost::system::system_error(errno, boost::system::generic_category());
 			}
 		}
 
-		status file_handle::get_status()
+		namespace
 		{
-			struct stat64 s;
-			if (fstat64(m_fd, &s) == 0)
+			status make_status(struct stat64 const &s)
 			{
 				status result;
 				result.size = s.st_size;
 				result.is_regular = S_ISREG(s.st_mode);
+				result.device = s.st_dev;
+				result.inode = s.st_ino;
+				result.modified_seconds = s.st_mtim.tv_sec;
+				result.modified_nanoseconds = static_cast<boost::int32_t>(s.st_mtim.tv_nsec);
 				return result;
 			}
-			throw make_errno_exception();
 		}
 
-		file_size file_handle::send_to(int destination, file_size byte_count)
+		status file_handle::get_status()
 		{
-			file_size total_sent = 0;
-			file_size rest = byte_count;
-			while (rest > 0)
+			struct stat64 s;
+			if (fstat64(m_fd, &s) == 0)
 			{
-				ssize_t const max_per_piece = std::numeric_limits<ssize_t>::max();
-				//any positive ssize_t must be representible with file_size for this to work
-				assert(static_cast<file_size>(max_per_piece) < std::numeric_limits<file_size>::max());
+				return make_status(s);
+			}
+			throw make_errno_exception();
+		}
 
-				size_t const piece_length = static_cast<size_t>(
-				            std::min<file_size>(max_per_piece, rest));
+		file_size file_handle::send_to(int destination, file_size offset, file_size byte_count) const
+		{
+			return send_file_region(destination, m_fd, offset, byte_count);
+		}
 
-				ssize_t const sent = sendfile(destination, m_fd, NULL, piece_length);
-				if (sent >= 0)
+		std::size_t file_handle::read_at(file_size offset, char *destination, std::size_t length) const
+		{
+			std::size_t total_read = 0;
+			while (total_read < length)
+			{
+				ssize_t const read = pread64(m_fd, destination + total_read, length - total_read,
+				                             static_cast<off64_t>(offset + total_read));
+				if (read > 0)
 				{
-					file_size const sent_unsigned = static_cast<size_t>(sent);
-					total_sent += sent_unsigned;
-					rest -= sent_unsigned;
+					total_read += static_cast<std::size_t>(read);
 				}
-				else
+				else if (read == 0)
+				{
+					break;
+				}
+				else if (errno != EINTR)
 				{
 					throw make_errno_exception();
 				}
 			}
-			return total_sent;
+			return total_read;
 		}
 
 		int file_handle::handle() const
@@ -116,6 +146,11 @@ namespace tempest
 			return m_fd;
 		}
 
+		bool file_handle::is_open() const
+		{
+			return (m_fd >= 0);
+		}
+
 		void swap(file_handle &left, file_handle &right)
 		{
 			left.swap(right);
@@ -124,13 +159,120 @@ namespace tempest
 
 		file_handle open_read(std::string const &file_name)
 		{
-			int const fd = ::open(file_name.c_str(), O_RDONLY | O_LARGEFILE);
+			boost::system::error_code error;
+			file_handle file = try_open_read(file_name, error);
+			if (error)
+			{
+				throw boost::system::system_error(error);
+			}
+			return boost::move(file);
+		}
+
+		file_handle try_open_read(std::string const &file_name,
+		                          boost::system::error_code &error)
+		{
+			int const fd = ::open(file_name.c_str(), O_RDONLY | O_LARGEFILE | O_CLOEXEC);
 			if (fd < 0)
 			{
-				throw make_errno_exception();
+				error.assign(errno, boost::system::generic_category());
+				return file_handle();
 			}
+			error.clear();
 			return file_handle(fd);
 		}
+
+		boost::optional<status> get_status(std::string const &file_name)
+		{
+			struct stat64 s;
+			if (stat64(file_name.c_str(), &s) == 0)
+			{
+				return make_status(s);
+			}
+			return boost::none;
+		}
+
+		file_size try_send_file_region(int destination,
+		                               int source,
+		                               file_size offset,
+		                               file_size length,
+		                               boost::system::error_code &error)
+		{
+			error.clear();
+			off64_t position = static_cast<off64_t>(offset);
+			file_size rest = length;
+			while (rest > 0)
+			{
+				size_t const piece_length = static_cast<size_t>(
+				            std::min<file_size>(std::numeric_limits<ssize_t>::max(), rest));
+
+				ssize_t const sent = sendfile64(destination, source, &position, piece_length);
+				if (sent > 0)
+				{
+					rest -= static_cast<file_size>(sent);
+				}
+				else if (sent == 0)
+				{
+					//the file is shorter than expected
+					break;
+				}
+				else if (errno != EINTR)
+				{
+					//the system category is what Boost.ASIO uses for would_block
+					error.assign((errno == EWOULDBLOCK) ? EAGAIN : errno,
+					             boost::system::system_category());
+					break;
+				}
+			}
+			return (length - rest);
+		}
+
+		file_size send_file_region(int destination,
+		                           int source,
+		                           file_size offset,
+		                           file_size length)
+		{
+			file_size sent = 0;
+			while (sent < length)
+			{
+				boost::system::error_code error;
+				file_size const piece = try_send_file_region(
+				            destination, source, offset + sent, length - sent, error);
+				sent += piece;
+				if (error == boost::system::error_code(EAGAIN, boost::system::system_category()))
+				{
+					pollfd writable = {destination, POLLOUT, 0};
+					poll(&writable, 1, -1);
+				}
+				else if (error)
+				{
+					throw boost::system::system_error(error);
+				}
+				else if (sent < length)
+				{
+					//the file is shorter than expected
+					break;
+				}
+			}
+			return sent;
+		}
+
+		cork_guard::cork_guard(int socket)
+		    : m_socket(socket)
+		{
+			set_corked(true);
+		}
+
+		cork_guard::~cork_guard()
+		{
+			set_corked(false);
+		}
+
+		void cork_guard::set_corked(bool corked)
+		{
+			//not every socket is TCP, so failure is not an error
+			int const value = corked ? 1 : 0;
+			setsockopt(m_socket, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+		}
 #endif
 	}
 }
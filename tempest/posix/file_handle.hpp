@@ -5,6 +5,9 @@
 #include <tempest/config.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/move/move.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
 #include <string>
 
 
@@ -18,9 +21,18 @@ namespace tempest
 			file_size size;
 			bool is_regular;
 
+			//identify a version of a file
+			boost::uint64_t device;
+			boost::uint64_t inode;
+			boost::int64_t modified_seconds;
+			boost::int32_t modified_nanoseconds;
+
 			status();
 		};
 
+		//whether both describe the same version of a file
+		bool is_same_version(status const &left, status const &right);
+
 		struct file_handle TEMPEST_FINAL : boost::noncopyable
 		{
 			file_handle();
@@ -30,8 +42,14 @@ namespace tempest
 			file_handle &operator = (BOOST_RV_REF(file_handle) other);
 			void swap(file_handle &other);
 			status get_status();
-			file_size send_to(int destination, file_size byte_count);
+			//sends without using or changing the file position, so that
+			//concurrent users of the same handle do not interfere
+			file_size send_to(int destination, file_size offset, file_size byte_count) const;
+
+			//reads without using or changing the file position
+			std::size_t read_at(file_size offset, char *destination, std::size_t length) const;
 			int handle() const;
+			bool is_open() const;
 
 		private:
 
@@ -43,6 +61,45 @@ namespace tempest
 		void swap(file_handle &left, file_handle &right);
 
 		file_handle open_read(std::string const &file_name);
+
+		//returns an invalid handle and sets the error instead of throwing
+		file_handle try_open_read(std::string const &file_name,
+		                          boost::system::error_code &error);
+
+		//stat without opening the file, empty if it does not exist
+		boost::optional<status> get_status(std::string const &file_name);
+
+		//Sends a region of the source file without using or changing its file
+		//position, so that concurrent users of the same file do not interfere.
+		//A non-blocking destination is waited for until it is writable.
+		file_size send_file_region(int destination,
+		                           int source,
+		                           file_size offset,
+		                           file_size length);
+
+		//Sends until the file region is complete or until the non-blocking
+		//destination would block, which is reported as EAGAIN in the system
+		//category like boost::asio::error::would_block. Returns the number of
+		//bytes sent, which is less than the length at the end of the file.
+		file_size try_send_file_region(int destination,
+		                               int source,
+		                               file_size offset,
+		                               file_size length,
+		                               boost::system::error_code &error);
+
+		//Holds back incomplete segments of a TCP socket while it exists, so
+		//that a header and the beginning of a file share a segment.
+		struct cork_guard TEMPEST_FINAL : boost::noncopyable
+		{
+			explicit cork_guard(int socket);
+			~cork_guard();
+
+		private:
+
+			int const m_socket;
+
+			void set_corked(bool corked);
+		};
 #endif
 	}
 }
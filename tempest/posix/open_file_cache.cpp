@@ -0,0 +1,119 @@
+#include "open_file_cache.hpp"
+#include <tempest/responses.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cerrno>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		open_file_cache_options::open_file_cache_options()
+		    : max_open_files(1024)
+		    , shard_count(16)
+		    , revalidation_interval(boost::chrono::seconds(1))
+		    , max_missing_paths(4096)
+		    , missing_lifetime(boost::chrono::seconds(1))
+		{
+		}
+
+		open_file_cache_statistics::open_file_cache_statistics()
+		    : hits(0)
+		    , misses(0)
+		    , missing_hits(0)
+		    , invalidations(0)
+		    , evictions(0)
+		    , open_files(0)
+		    , missing_paths(0)
+		{
+		}
+
+		namespace
+		{
+			bool is_missing(boost::system::error_code const &error)
+			{
+				return (error.value() == ENOENT) ||
+				       (error.value() == ENOTDIR);
+			}
+		}
+
+		file_validators make_validators(status const &version)
+		{
+			file_validators validators;
+			validators.etag = make_entity_tag(version.inode, version.modified_seconds,
+			                                  static_cast<boost::uint32_t>(version.modified_nanoseconds),
+			                                  version.size);
+			validators.modified_seconds = version.modified_seconds;
+			return validators;
+		}
+
+		boost::shared_ptr<open_file const> open_uncached(std::string const &path,
+		                                                 content_coding coding)
+		{
+			boost::system::error_code error;
+			file_handle file = try_open_read(path + sidecar_extension(coding), error);
+			if (error)
+			{
+				if (is_missing(error))
+				{
+					return boost::shared_ptr<open_file const>();
+				}
+				throw boost::system::system_error(error);
+			}
+
+			boost::shared_ptr<open_file> const opened = boost::make_shared<open_file>();
+			opened->version = file.get_status();
+			opened->file = boost::move(file);
+			render_file_headers(opened->headers, path, opened->version.size,
+			                    make_validators(opened->version), coding);
+			return opened;
+		}
+
+		open_file_cache::open_file_cache(open_file_cache_options const &options)
+		    : m_files(options.shard_count,
+		              //every shard keeps at least one file open
+		              std::max<boost::uint64_t>(options.max_open_files, std::max(1u, options.shard_count)),
+		              options.revalidation_interval,
+		              options.max_missing_paths,
+		              options.missing_lifetime)
+		{
+		}
+
+		boost::shared_ptr<open_file const> open_file_cache::open(std::string const &path,
+		                                                         content_coding coding)
+		{
+			std::string const key = make_cache_key(path, coding);
+			boost::shared_ptr<open_file const> cached;
+			if (m_files.find(key, path + sidecar_extension(coding), cached))
+			{
+				return cached;
+			}
+
+			//the file system is accessed without holding the lock
+			boost::shared_ptr<open_file const> const opened = open_uncached(path, coding);
+
+			//missing paths do not count against the limit
+			m_files.insert(key, opened, opened ? 1 : 0);
+			return opened;
+		}
+
+		open_file_cache_statistics open_file_cache::statistics() const
+		{
+			revalidating_cache_statistics const files = m_files.statistics();
+			open_file_cache_statistics result;
+			result.hits = files.hits;
+			result.misses = files.misses;
+			result.missing_hits = files.missing_hits;
+			result.invalidations = files.invalidations;
+			result.evictions = files.evictions;
+			result.open_files = static_cast<std::size_t>(files.total_cost);
+			result.missing_paths = files.missing_entries;
+			return result;
+		}
+#endif
+	}
+}
@@ -0,0 +1,97 @@
+#ifndef TEMPEST_POSIX_OPEN_FILE_CACHE_HPP
+#define TEMPEST_POSIX_OPEN_FILE_CACHE_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/posix/content_cache.hpp>
+#include <tempest/posix/file_handle.hpp>
+#include <tempest/posix/revalidating_cache.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		struct open_file_cache_options
+		{
+			//the number of file descriptors kept open by the cache
+			std::size_t max_open_files;
+
+			//Every shard has its own lock and an equal part of the limit.
+			unsigned shard_count;
+
+			//An open file is compared to the file system again after this
+			//time. Zero means on every use.
+			boost::chrono::steady_clock::duration revalidation_interval;
+
+			//The number of missing paths which are remembered, split among
+			//the shards like the open files. Zero disables remembering them.
+			std::size_t max_missing_paths;
+
+			//how long a path is remembered as missing
+			boost::chrono::steady_clock::duration missing_lifetime;
+
+			open_file_cache_options();
+		};
+
+		//A file opened for reading. It may be used by several threads
+		//concurrently as long as they read and send at explicit offsets.
+		struct open_file
+		{
+			file_handle file;
+			status version;
+			file_headers headers;
+		};
+
+		//a strong entity tag from the inode, the modification time and the
+		//size
+		file_validators make_validators(status const &version);
+
+		struct open_file_cache_statistics
+		{
+			boost::uint64_t hits;
+			boost::uint64_t misses;
+			boost::uint64_t missing_hits;
+			boost::uint64_t invalidations;
+			boost::uint64_t evictions;
+			std::size_t open_files;
+			std::size_t missing_paths;
+
+			open_file_cache_statistics();
+		};
+
+		//A thread-safe LRU cache of open file descriptors and their status
+		//which also remembers missing paths for a short time.
+		struct open_file_cache TEMPEST_FINAL : boost::noncopyable
+		{
+			explicit open_file_cache(open_file_cache_options const &options);
+
+			//Returns an empty pointer if the path does not exist. Other errors
+			//are thrown as boost::system::system_error. A coding opens the
+			//precompressed file next to the path.
+			boost::shared_ptr<open_file const> open(std::string const &path,
+			                                        content_coding coding = identity_coding);
+
+			open_file_cache_statistics statistics() const;
+
+		private:
+
+			revalidating_cache<open_file> m_files;
+		};
+
+		//opens without a cache, returns an empty pointer if the path does
+		//not exist
+		boost::shared_ptr<open_file const> open_uncached(std::string const &path,
+		                                                 content_coding coding = identity_coding);
+#endif
+	}
+}
+
+
+#endif
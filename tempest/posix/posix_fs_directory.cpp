@@ -3,10 +3,10 @@
 #include <tempest/posix/file_handle.hpp>
 #include <tempest/responses.hpp>
 #include <http/http_request.hpp>
-#include <http/http_response.hpp>
-#include <boost/iostreams/device/file_descriptor.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <algorithm>
 
 
 namespace tempest
@@ -16,28 +16,228 @@ namespace tempest
 #if TEMPEST_USE_POSIX
 		namespace
 		{
-			void copy_file(int source, std::ostream &sink)
+			//The file position is not used because the descriptor may be
+			//shared with other threads.
+			void copy_file(file_handle const &source,
+			               file_size offset,
+			               file_size length,
+			               std::ostream &sink)
 			{
-				boost::iostreams::file_descriptor_source
-						source_device(source,
-									  boost::iostreams::never_close_handle);
-				boost::iostreams::copy(source_device, sink);
+				char buffer[64 * 1024];
+				file_size const end = offset + length;
+				while (offset < end)
+				{
+					std::size_t const piece = static_cast<std::size_t>(
+					            std::min<file_size>(sizeof(buffer), end - offset));
+					std::size_t const read = source.read_at(offset, buffer, piece);
+					if (read == 0)
+					{
+						throw std::runtime_error("The file became shorter while sending it");
+					}
+					sink.write(buffer, read);
+					offset += read;
+				}
+			}
+
+			boost::shared_ptr<cached_file const> load_file(open_file const &file)
+			{
+				status const &status = file.version;
+				boost::shared_ptr<cached_file> const loaded = boost::make_shared<cached_file>();
+				loaded->version = status;
+				loaded->content.resize(static_cast<std::size_t>(status.size));
+				if (file.file.read_at(0, loaded->content.data(), loaded->content.size()) !=
+				    loaded->content.size())
+				{
+					//the file became shorter in the meantime
+					return boost::shared_ptr<cached_file const>();
+				}
+				loaded->headers = file.headers;
+				return loaded;
+			}
+
+			//The cached content is used if there is any.
+			void send_region(cached_file const *cached,
+			                 open_file const *file,
+			                 file_size offset,
+			                 file_size length,
+			                 sender &sender)
+			{
+				if (cached)
+				{
+					sender.response().write(cached->content.data() + offset,
+					                        static_cast<std::streamsize>(length));
+					return;
+				}
+
+				boost::optional<int> const client_fd = sender.posix_response();
+				if (client_fd)
+				{
+					//The buffered output precedes the file on the wire. The cork
+					//lets the header share a segment with the file.
+					cork_guard const cork(*client_fd);
+					sender.response().flush();
+					file_size sent = file->file.send_to(*client_fd, offset, length);
+					if (sent != length)
+					{
+						throw std::runtime_error("Sending the whole file failed");
+					}
+				}
+				else
+				{
+					copy_file(file->file, offset, length, sender.response());
+				}
+			}
+
+			send_part make_region_part(cached_file const *cached,
+			                           open_file const *file,
+			                           file_size offset,
+			                           file_size length)
+			{
+				if (cached)
+				{
+					return send_part::from_memory(boost::asio::buffer(
+					    cached->content.data() + offset, static_cast<std::size_t>(length)));
+				}
+				return send_part::from_file(file->file.handle(), offset, length);
+			}
+
+			boost::asio::const_buffer framing_buffer(partial_response const &partial,
+			                                         body_piece const &piece)
+			{
+				return boost::asio::buffer(partial.framing.data() + piece.offset,
+				                           static_cast<std::size_t>(piece.length));
+			}
+
+			void release_file(boost::system::error_code error,
+			                  boost::shared_ptr<cached_file const> const &,
+			                  boost::shared_ptr<open_file const> const &,
+			                  boost::shared_ptr<partial_response const> const &,
+			                  directory::response_handler const &handler)
+			{
+				handler(error);
 			}
 		}
 
-		file_system_directory::file_system_directory(boost::filesystem::path dir)
+		file_system_directory::file_system_directory(boost::filesystem::path dir,
+		                                             boost::shared_ptr<content_cache> cache,
+		                                             boost::shared_ptr<open_file_cache> open_files)
 			: m_dir(boost::move(dir))
+			, m_cache(boost::move(cache))
+			, m_open_files(boost::move(open_files))
 		{
 		}
 
 		void file_system_directory::respond(http_request const &request,
-		                                    std::string const &sub_path,
+		                                    boost::string_ref sub_path,
 		                                    sender &sender)
+		{
+			served_file served;
+			boost::optional<in_memory_response> const error =
+			        open_served_file(request, sub_path, served);
+			if (error)
+			{
+				return send_in_memory_response(*error, sender);
+			}
+
+			cached_file const * const cached = served.cached.get();
+			open_file const * const file = served.file.get();
+			if (served.not_modified)
+			{
+				return send_header_block(served.headers().not_modified, sender);
+			}
+
+			partial_response const * const partial = served.partial.get();
+			if (!partial)
+			{
+				send_header_block(served.headers().ok, sender);
+				return send_region(cached, file, 0, served.size(), sender);
+			}
+
+			send_header_block(partial->header, sender);
+			BOOST_FOREACH (body_piece const &piece, partial->pieces)
+			{
+				if (piece.is_file)
+				{
+					send_region(cached, file, piece.offset, piece.length, sender);
+				}
+				else
+				{
+					boost::asio::const_buffer const framing = framing_buffer(*partial, piece);
+					sender.response().write(boost::asio::buffer_cast<char const *>(framing),
+					                        boost::asio::buffer_size(framing));
+				}
+			}
+		}
+
+		void file_system_directory::async_respond(http_request const &request,
+		                                          boost::string_ref sub_path,
+		                                          async_sender &sender,
+		                                          response_handler handler)
+		{
+			served_file served;
+			boost::optional<in_memory_response> const error =
+			        open_served_file(request, sub_path, served);
+			if (error)
+			{
+				return async_send_in_memory_response(*error, sender, handler);
+			}
+
+			//the header and the body are sent with one operation
+			cached_file const * const cached = served.cached.get();
+			open_file const * const file = served.file.get();
+			partial_response const * const partial = served.partial.get();
+			send_parts parts;
+			if (served.not_modified)
+			{
+				parts.push_back(send_part::from_memory(boost::asio::buffer(
+				                    served.headers().not_modified)));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+			}
+			else if (!partial)
+			{
+				parts.push_back(send_part::from_memory(boost::asio::buffer(served.headers().ok)));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+				parts.push_back(make_region_part(cached, file, 0, served.size()));
+			}
+			else
+			{
+				parts.push_back(send_part::from_memory(boost::asio::buffer(partial->header)));
+				parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+				BOOST_FOREACH (body_piece const &piece, partial->pieces)
+				{
+					parts.push_back(piece.is_file
+					                ? make_region_part(cached, file, piece.offset, piece.length)
+					                : send_part::from_memory(framing_buffer(*partial, piece)));
+				}
+			}
+			sender.async_send(parts, boost::bind(release_file, _1, served.cached, served.file,
+			                                     served.partial, boost::move(handler)));
+		}
+
+		file_system_directory::served_file::served_file()
+		    : not_modified(false)
+		{
+		}
+
+		file_headers const &file_system_directory::served_file::headers() const
+		{
+			return cached ? cached->headers : file->headers;
+		}
+
+		file_size file_system_directory::served_file::size() const
+		{
+			return cached ? cached->version.size : file->version.size;
+		}
+
+		boost::optional<in_memory_response>
+		file_system_directory::open_served_file(http_request const &request,
+		                                        boost::string_ref sub_path,
+		                                        served_file &served) const
 		{
 			if (request.method != "GET" &&
 				request.method != "POST")
 			{
-				return send_in_memory_response(make_not_implemented_response(request.file), sender);
+				return make_not_implemented_response(request.file);
 			}
 
 			boost::optional<boost::filesystem::path> const full_path =
@@ -45,46 +245,124 @@ namespace tempest
 
 			if (!full_path)
 			{
-				return send_in_memory_response(make_not_found_response(request.file), sender);
+				return make_not_found_response(request.file);
 			}
 
-			file_handle file = open_read(full_path->string());
-			posix::status const status = file.get_status();
-
-			if (status.size > std::numeric_limits<std::size_t>::max())
+			//the precompressed files are tried before the original
+			std::string const full_path_string = full_path->string();
+			content_coding codings[3];
+			std::size_t const coding_count = preferred_codings(request, codings);
+			content_coding coding = identity_coding;
+			boost::shared_ptr<cached_file const> &cached = served.cached;
+			boost::shared_ptr<open_file const> &file = served.file;
+			for (std::size_t i = 0; i < coding_count; ++i)
 			{
-				return send_in_memory_response(make_not_implemented_response(request.file), sender);
+				coding = codings[i];
+				if (m_cache)
+				{
+					cached = m_cache->find(full_path_string, coding);
+					if (cached)
+					{
+						break;
+					}
+				}
+
+				if (!m_open_files && is_conditional(request))
+				{
+					boost::optional<in_memory_response> not_modified =
+					        check_not_modified(request, full_path_string, coding);
+					if (not_modified)
+					{
+						return not_modified;
+					}
+				}
+
+				file = m_open_files ? m_open_files->open(full_path_string, coding)
+				                    : open_uncached(full_path_string, coding);
+				if (file &&
+				    (file->version.is_regular || (coding == identity_coding)))
+				{
+					break;
+				}
+				file.reset();
 			}
 
-			if (!status.is_regular)
+			if (!cached)
 			{
-				return send_in_memory_response(make_not_found_response(request.file), sender);
-			}
+				if (!file)
+				{
+					return make_not_found_response(request.file);
+				}
 
-			http_response response;
-			response.headers["Content-Length"] =
-					boost::lexical_cast<std::string>(status.size);
-			response.status = 200;
-			response.reason = "OK";
-			response.version = "HTTP/1.1";
+				status const &status = file->version;
+
+				if (status.size > std::numeric_limits<std::size_t>::max())
+				{
+					return make_not_implemented_response(request.file);
+				}
+
+				if (!status.is_regular)
+				{
+					return make_not_found_response(request.file);
+				}
+
+				if (m_cache && m_cache->accepts(status.size))
+				{
+					cached = load_file(*file);
+					if (cached)
+					{
+						m_cache->insert(full_path_string, cached, coding);
+					}
+				}
+			}
 
-			print_response(response, sender.response());
+			if (is_not_modified(request, served.headers().validators))
+			{
+				served.not_modified = true;
+				return boost::none;
+			}
 
-			boost::optional<int> const client_fd = sender.posix_response();
-			if (client_fd)
+			//most requests have no Range header and need no plan
+			if (find_header(request, "Range"))
 			{
-				sender.response().flush();
-				file_size sent = file.send_to(*client_fd, status.size);
-				if (sent != status.size)
+				boost::shared_ptr<partial_response> const planned =
+				        boost::make_shared<partial_response>();
+				boost::optional<in_memory_response> range_error =
+				        plan_partial_response(request, full_path_string, served.size(),
+				                              served.headers().validators, coding, *planned);
+				if (range_error)
 				{
-					throw std::runtime_error("Sending the whole file failed");
+					return range_error;
+				}
+				if (!planned->pieces.empty())
+				{
+					served.partial = planned;
 				}
 			}
-			else
+			return boost::none;
+		}
+
+		boost::optional<in_memory_response>
+		file_system_directory::check_not_modified(http_request const &request,
+		                                          std::string const &path,
+		                                          content_coding coding) const
+		{
+			boost::optional<status> const version = get_status(path + sidecar_extension(coding));
+			if (!version ||
+			    !version->is_regular)
+			{
+				return boost::none;
+			}
+
+			file_validators const validators = make_validators(*version);
+			if (!is_not_modified(request, validators))
 			{
-				copy_file(file.handle(), sender.response());
-				sender.response().flush();
+				return boost::none;
 			}
+
+			in_memory_response response;
+			write_not_modified_header_block(response.header, validators, coding);
+			return response;
 		}
 #endif
 	}
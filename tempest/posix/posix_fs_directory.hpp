@@ -4,7 +4,13 @@
 
 #include <tempest/config.hpp>
 #include <tempest/directory.hpp>
+#include <tempest/responses.hpp>
+#include <tempest/posix/content_cache.hpp>
+#include <tempest/posix/file_handle.hpp>
+#include <tempest/posix/open_file_cache.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 
 
 namespace tempest
@@ -14,14 +20,56 @@ namespace tempest
 #if TEMPEST_USE_POSIX
 		struct file_system_directory : directory
 		{
-			explicit file_system_directory(boost::filesystem::path dir);
+			//small files are served from the cache if one is given,
+			//descriptors are reused if an open file cache is given
+			explicit file_system_directory(boost::filesystem::path dir,
+			                               boost::shared_ptr<content_cache> cache =
+			                                   boost::shared_ptr<content_cache>(),
+			                               boost::shared_ptr<open_file_cache> open_files =
+			                                   boost::shared_ptr<open_file_cache>());
 			virtual void respond(http_request const &request,
-			                     std::string const &sub_path,
+			                     boost::string_ref sub_path,
 			                     sender &sender) TEMPEST_OVERRIDE;
+			virtual void async_respond(http_request const &request,
+			                           boost::string_ref sub_path,
+			                           async_sender &sender,
+			                           response_handler handler) TEMPEST_OVERRIDE;
 
 		private:
 
 			const boost::filesystem::path m_dir;
+			boost::shared_ptr<content_cache> const m_cache;
+			boost::shared_ptr<open_file_cache> const m_open_files;
+
+			//cached or file is set, the cached content is preferred
+			struct served_file
+			{
+				boost::shared_ptr<cached_file const> cached;
+				boost::shared_ptr<open_file const> file;
+
+				//set if only ranges of the file are to be sent
+				boost::shared_ptr<partial_response const> partial;
+
+				//the client's copy is up to date
+				bool not_modified;
+
+				served_file();
+				file_headers const &headers() const;
+				file_size size() const;
+			};
+
+			//Returns an error response if the file cannot be served.
+			boost::optional<in_memory_response>
+			open_served_file(http_request const &request,
+			                 boost::string_ref sub_path,
+			                 served_file &served) const;
+
+			//When there is no open file cache, a revalidation is answered
+			//with stat instead of opening the file.
+			boost::optional<in_memory_response>
+			check_not_modified(http_request const &request,
+			                   std::string const &path,
+			                   content_coding coding) const;
 		};
 #endif
 	}
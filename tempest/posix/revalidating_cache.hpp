@@ -0,0 +1,292 @@
+#ifndef TEMPEST_POSIX_REVALIDATING_CACHE_HPP
+#define TEMPEST_POSIX_REVALIDATING_CACHE_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/posix/file_handle.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/move/move.hpp>
+#include <boost/next_prior.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <string>
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_POSIX
+		struct revalidating_cache_statistics
+		{
+			boost::uint64_t hits;
+			boost::uint64_t misses;
+			boost::uint64_t missing_hits;
+			boost::uint64_t invalidations;
+			boost::uint64_t evictions;
+
+			//the sum of the costs of the entries
+			boost::uint64_t total_cost;
+			std::size_t entries;
+			std::size_t missing_entries;
+
+			revalidating_cache_statistics()
+			    : hits(0)
+			    , misses(0)
+			    , missing_hits(0)
+			    , invalidations(0)
+			    , evictions(0)
+			    , total_cost(0)
+			    , entries(0)
+			    , missing_entries(0)
+			{
+			}
+		};
+
+		//The thread-safe LRU behind content_cache and open_file_cache. Every
+		//shard has its own lock and an equal part of the budget. An entry
+		//which has not been compared to the file system for the revalidation
+		//interval is compared again without holding the lock, so that one
+		//slow stat does not block the other users of the shard. An empty
+		//value remembers that a path was missing. These entries are kept in
+		//an LRU of their own with a limited number of entries, so that
+		//requests for many different missing paths cannot grow the cache.
+		//Value has to have a member version of the type status.
+		template <class Value>
+		struct revalidating_cache TEMPEST_FINAL : boost::noncopyable
+		{
+			typedef boost::shared_ptr<Value const> value_pointer;
+			typedef boost::chrono::steady_clock clock;
+
+			revalidating_cache(unsigned shard_count,
+			                   boost::uint64_t total_budget,
+			                   clock::duration revalidation_interval,
+			                   std::size_t max_missing,
+			                   clock::duration missing_lifetime)
+			    : m_shard_count(std::max(1u, shard_count))
+			    , m_shard_budget(total_budget / m_shard_count)
+			    , m_shard_max_missing(max_missing ? std::max<std::size_t>(1, max_missing / m_shard_count) : 0)
+			    , m_revalidation_interval(revalidation_interval)
+			    , m_missing_lifetime(missing_lifetime)
+			    , m_shards(new shard[m_shard_count])
+			{
+			}
+
+			boost::uint64_t shard_budget() const
+			{
+				return m_shard_budget;
+			}
+
+			//Returns false and counts a miss if the key is not cached or the
+			//file at the path is not the cached version anymore. Otherwise
+			//the value is the cached one, which is empty for a missing path.
+			bool find(std::string const &key,
+			          std::string const &path,
+			          value_pointer &value)
+			{
+				shard &shard = find_shard(key);
+				clock::time_point const now = clock::now();
+				value_pointer found;
+				{
+					boost::unique_lock<boost::mutex> const lock(shard.mutex);
+					typename shard::index_map::iterator const i = shard.index.find(key);
+					if (i == shard.index.end())
+					{
+						++shard.counters.misses;
+						return false;
+					}
+
+					typename lru_list::iterator const cached = i->second;
+					if (!cached->value)
+					{
+						if ((now - cached->checked) < m_missing_lifetime)
+						{
+							shard.missing.splice(shard.missing.begin(), shard.missing, cached);
+							++shard.counters.missing_hits;
+							value.reset();
+							return true;
+						}
+						shard.erase(cached);
+						++shard.counters.misses;
+						return false;
+					}
+
+					shard.entries.splice(shard.entries.begin(), shard.entries, cached);
+					if ((now - cached->checked) < m_revalidation_interval)
+					{
+						++shard.counters.hits;
+						value = cached->value;
+						return true;
+					}
+
+					//Other threads can use the value until it has been
+					//revalidated.
+					cached->checked = now;
+					found = cached->value;
+				}
+
+				//the file system is accessed without holding the lock
+				boost::optional<status> const current = get_status(path);
+				bool const up_to_date = current && is_same_version(*current, found->version);
+
+				boost::unique_lock<boost::mutex> const lock(shard.mutex);
+				if (up_to_date)
+				{
+					++shard.counters.hits;
+					value = boost::move(found);
+					return true;
+				}
+
+				//The path refers to another file now. The old value is
+				//released when its last user is done with it.
+				++shard.counters.misses;
+				++shard.counters.invalidations;
+				typename shard::index_map::iterator const i = shard.index.find(key);
+				if ((i != shard.index.end()) &&
+				    (i->second->value == found))
+				{
+					shard.erase(i->second);
+				}
+				return false;
+			}
+
+			//Replaces an entry of the key and evicts the least recently used
+			//entries until the value fits into the budget of the shard. The
+			//cost must not exceed shard_budget. An empty value replaces the
+			//least recently used missing path when there are too many.
+			void insert(std::string const &key,
+			            value_pointer value,
+			            boost::uint64_t cost)
+			{
+				assert(cost <= m_shard_budget);
+				shard &shard = find_shard(key);
+
+				boost::unique_lock<boost::mutex> const lock(shard.mutex);
+				typename shard::index_map::iterator const existing = shard.index.find(key);
+				if (existing != shard.index.end())
+				{
+					//another thread was faster
+					shard.erase(existing->second);
+				}
+
+				lru_list *destination = &shard.entries;
+				if (value)
+				{
+					while ((shard.total_cost + cost) > m_shard_budget)
+					{
+						assert(!shard.entries.empty());
+						shard.erase(boost::prior(shard.entries.end()));
+						++shard.counters.evictions;
+					}
+				}
+				else
+				{
+					if (m_shard_max_missing == 0)
+					{
+						return;
+					}
+					//the open files are not displaced by a flood of missing paths
+					while (shard.missing.size() >= m_shard_max_missing)
+					{
+						shard.erase(boost::prior(shard.missing.end()));
+					}
+					destination = &shard.missing;
+					cost = 0;
+				}
+
+				entry inserted;
+				inserted.key = key;
+				inserted.value = boost::move(value);
+				inserted.cost = cost;
+				inserted.checked = clock::now();
+				destination->push_front(inserted);
+				shard.index.insert(std::make_pair(key, destination->begin()));
+				shard.total_cost += cost;
+			}
+
+			revalidating_cache_statistics statistics() const
+			{
+				revalidating_cache_statistics sum;
+				for (unsigned i = 0; i < m_shard_count; ++i)
+				{
+					shard &shard = m_shards[i];
+					boost::unique_lock<boost::mutex> const lock(shard.mutex);
+					sum.hits += shard.counters.hits;
+					sum.misses += shard.counters.misses;
+					sum.missing_hits += shard.counters.missing_hits;
+					sum.invalidations += shard.counters.invalidations;
+					sum.evictions += shard.counters.evictions;
+					sum.total_cost += shard.total_cost;
+					sum.entries += shard.entries.size();
+					sum.missing_entries += shard.missing.size();
+				}
+				return sum;
+			}
+
+		private:
+
+			struct entry
+			{
+				std::string key;
+				value_pointer value;
+				boost::uint64_t cost;
+				clock::time_point checked;
+			};
+
+			typedef std::list<entry> lru_list;
+
+			struct shard
+			{
+				typedef boost::unordered_map<std::string, typename lru_list::iterator> index_map;
+
+				boost::mutex mutex;
+
+				//the most recently used entry is at the front
+				lru_list entries;
+				lru_list missing;
+				index_map index;
+				boost::uint64_t total_cost;
+				revalidating_cache_statistics counters;
+
+				shard()
+				    : total_cost(0)
+				{
+				}
+
+				void erase(typename lru_list::iterator cached)
+				{
+					total_cost -= cached->cost;
+					index.erase(cached->key);
+					(cached->value ? entries : missing).erase(cached);
+				}
+			};
+
+			unsigned const m_shard_count;
+			boost::uint64_t const m_shard_budget;
+			std::size_t const m_shard_max_missing;
+			clock::duration const m_revalidation_interval;
+			clock::duration const m_missing_lifetime;
+			boost::scoped_array<shard> const m_shards;
+
+
+			shard &find_shard(std::string const &key) const
+			{
+				std::size_t const hash = boost::hash<std::string>()(key);
+				return m_shards[hash % m_shard_count];
+			}
+		};
+#endif
+	}
+}
+
+
+#endif
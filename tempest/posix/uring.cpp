@@ -0,0 +1,209 @@
+#include "uring.hpp"
+#include <boost/noncopyable.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if TEMPEST_USE_IO_URING
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_IO_URING
+		namespace
+		{
+			void throw_errno()
+			{
+				throw boost::system::system_error(errno, boost::system::system_category());
+			}
+
+			template <class T>
+			T *at_offset(void *ring, unsigned offset)
+			{
+				return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+			}
+
+			void *map_ring(int fd, std::size_t size, off_t offset)
+			{
+				void * const ring = mmap(0, size, PROT_READ | PROT_WRITE,
+				                         MAP_SHARED | MAP_POPULATE, fd, offset);
+				if (ring == MAP_FAILED)
+				{
+					int const error = errno;
+					close(fd);
+					errno = error;
+					throw_errno();
+				}
+				return ring;
+			}
+
+			//Unmaps a ring unless it has been released, so that the rings
+			//which have been mapped already do not leak when a later mmap
+			//fails in the constructor.
+			struct mapping_guard : boost::noncopyable
+			{
+				mapping_guard(void *ring, std::size_t size)
+				    : m_ring(ring)
+				    , m_size(size)
+				{
+				}
+
+				~mapping_guard()
+				{
+					if (m_ring)
+					{
+						munmap(m_ring, m_size);
+					}
+				}
+
+				void *release()
+				{
+					void * const ring = m_ring;
+					m_ring = 0;
+					return ring;
+				}
+
+			private:
+
+				void *m_ring;
+				std::size_t const m_size;
+			};
+		}
+
+		uring::uring(unsigned entries)
+		    : m_sqe_tail(0)
+		{
+			io_uring_params parameters;
+			std::memset(&parameters, 0, sizeof(parameters));
+			m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &parameters));
+			if (m_fd < 0)
+			{
+				throw_errno();
+			}
+			m_features = parameters.features;
+			m_entries = parameters.sq_entries;
+
+			m_sq_ring_size = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+			m_cq_ring_size = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+
+			//newer kernels map both rings with one mmap
+			bool const single_mmap = (m_features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single_mmap)
+			{
+				m_sq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+				m_cq_ring_size = m_sq_ring_size;
+			}
+			mapping_guard sq_ring(map_ring(m_fd, m_sq_ring_size, IORING_OFF_SQ_RING), m_sq_ring_size);
+			mapping_guard cq_ring(single_mmap ? 0 : map_ring(m_fd, m_cq_ring_size, IORING_OFF_CQ_RING),
+			                      m_cq_ring_size);
+			m_sqes = static_cast<io_uring_sqe *>(map_ring(
+			             m_fd, parameters.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+			m_sq_ring = sq_ring.release();
+			m_cq_ring = single_mmap ? m_sq_ring : cq_ring.release();
+
+			m_sq_head = at_offset<unsigned>(m_sq_ring, parameters.sq_off.head);
+			m_sq_tail = at_offset<unsigned>(m_sq_ring, parameters.sq_off.tail);
+			m_sq_mask = *at_offset<unsigned>(m_sq_ring, parameters.sq_off.ring_mask);
+			m_sq_array = at_offset<unsigned>(m_sq_ring, parameters.sq_off.array);
+			m_sqe_tail = *m_sq_tail;
+
+			m_cq_head = at_offset<unsigned>(m_cq_ring, parameters.cq_off.head);
+			m_cq_tail = at_offset<unsigned>(m_cq_ring, parameters.cq_off.tail);
+			m_cq_mask = *at_offset<unsigned>(m_cq_ring, parameters.cq_off.ring_mask);
+			m_cqes = at_offset<io_uring_cqe>(m_cq_ring, parameters.cq_off.cqes);
+		}
+
+		uring::~uring()
+		{
+			munmap(m_sqes, m_entries * sizeof(io_uring_sqe));
+			if (m_cq_ring != m_sq_ring)
+			{
+				munmap(m_cq_ring, m_cq_ring_size);
+			}
+			munmap(m_sq_ring, m_sq_ring_size);
+			close(m_fd);
+		}
+
+		io_uring_sqe *uring::get_sqe()
+		{
+			if (free_sqes() == 0)
+			{
+				return 0;
+			}
+			unsigned const index = m_sqe_tail & m_sq_mask;
+			io_uring_sqe * const entry = m_sqes + index;
+			std::memset(entry, 0, sizeof(*entry));
+			m_sq_array[index] = index;
+			++m_sqe_tail;
+			return entry;
+		}
+
+		unsigned uring::free_sqes() const
+		{
+			//the kernel advances the head when it has consumed entries
+			unsigned const head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			return m_entries - (m_sqe_tail - head);
+		}
+
+		void uring::submit(unsigned wait_for)
+		{
+			__atomic_store_n(m_sq_tail, m_sqe_tail, __ATOMIC_RELEASE);
+			unsigned const head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+			unsigned const to_submit = m_sqe_tail - head;
+			if ((to_submit == 0) && (wait_for == 0))
+			{
+				return;
+			}
+
+			unsigned const flags = (wait_for > 0) ? IORING_ENTER_GETEVENTS : 0;
+			if ((syscall(__NR_io_uring_enter, m_fd, to_submit, wait_for, flags, 0, 0) < 0) &&
+			    (errno != EINTR) &&
+			    //the completion queue is full, so the caller has to make room first
+			    (errno != EBUSY) &&
+			    (errno != EAGAIN))
+			{
+				throw_errno();
+			}
+		}
+
+		bool uring::pop(io_uring_cqe &completion)
+		{
+			unsigned const head = *m_cq_head;
+			if (head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+			{
+				return false;
+			}
+			completion = m_cqes[head & m_cq_mask];
+			__atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		bool uring::supports(unsigned char opcode) const
+		{
+			std::size_t const op_count = 256;
+			std::vector<char> buffer(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op));
+			io_uring_probe * const probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+			if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, op_count) < 0)
+			{
+				return false;
+			}
+			return (opcode <= probe->last_op) &&
+			       (opcode < probe->ops_len) &&
+			       ((probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0);
+		}
+
+		unsigned uring::features() const
+		{
+			return m_features;
+		}
+#endif
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef TEMPEST_POSIX_URING_HPP
+#define TEMPEST_POSIX_URING_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+
+#if TEMPEST_USE_IO_URING
+//the kernel header uses flexible arrays and anonymous structs
+#	pragma GCC diagnostic push
+#	pragma GCC diagnostic ignored "-Wpedantic"
+#	include <linux/io_uring.h>
+#	pragma GCC diagnostic pop
+#endif
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_IO_URING
+		//The submission and the completion queue of an io_uring instance.
+		//It is used with the raw system calls, so liburing is not needed.
+		//Only one thread may use a ring at a time.
+		struct uring TEMPEST_FINAL : boost::noncopyable
+		{
+			//throws boost::system::system_error if the kernel does not
+			//support io_uring or if it is disabled
+			explicit uring(unsigned entries);
+			~uring();
+
+			//Returns a zeroed entry or null if the submission queue is full.
+			//The entry is passed to the kernel by the next submit.
+			io_uring_sqe *get_sqe();
+			unsigned free_sqes() const;
+
+			//Submits the prepared entries and waits until at least
+			//wait_for completions are available. Returns early if
+			//interrupted by a signal.
+			void submit(unsigned wait_for);
+
+			//Takes the next completion from the queue if there is one.
+			bool pop(io_uring_cqe &completion);
+
+			//whether the kernel knows the operation (since Linux 5.6)
+			bool supports(unsigned char opcode) const;
+			unsigned features() const;
+
+		private:
+
+			int m_fd;
+			unsigned m_features;
+			unsigned m_entries;
+
+			void *m_sq_ring;
+			std::size_t m_sq_ring_size;
+			void *m_cq_ring;
+			std::size_t m_cq_ring_size;
+			io_uring_sqe *m_sqes;
+
+			unsigned *m_sq_head;
+			unsigned *m_sq_tail;
+			unsigned m_sq_mask;
+			unsigned *m_sq_array;
+			unsigned m_sqe_tail;
+
+			unsigned *m_cq_head;
+			unsigned *m_cq_tail;
+			unsigned m_cq_mask;
+			io_uring_cqe *m_cqes;
+		};
+#endif
+	}
+}
+
+
+#endif
@@ -0,0 +1,875 @@
+#include "uring_server.hpp"
+#include "uring.hpp"
+#include "file_handle.hpp"
+#include <tempest/admission.hpp>
+#include <tempest/client.hpp>
+#include <tempest/server.hpp>
+#include <tempest/timer_wheel.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if TEMPEST_USE_IO_URING
+#	include <netinet/in.h>
+#	include <sys/socket.h>
+#	include <sys/uio.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+
+namespace tempest
+{
+	namespace posix
+	{
+#if TEMPEST_USE_IO_URING
+		namespace
+		{
+			unsigned const ring_entries = 4096;
+
+			//A burst of new connections is taken with one submission.
+			std::size_t const pending_accepts = 16;
+
+			//long enough for a lack of descriptors to go away
+			boost::posix_time::time_duration const accept_retry_delay =
+			        boost::posix_time::milliseconds(100);
+
+			//Parts up to this size are collected instead of being written
+			//immediately.
+			std::size_t const max_pending_size = 64 * 1024;
+
+			//A larger pipe moves a file to the socket with fewer splices.
+			int const preferred_pipe_size = 256 * 1024;
+
+			//the offset of a pipe or a socket in a splice
+			__u64 const no_offset = static_cast<__u64>(-1);
+
+			__kernel_timespec make_timespec(boost::posix_time::time_duration duration)
+			{
+				__kernel_timespec result;
+				result.tv_sec = duration.total_seconds();
+				result.tv_nsec = (duration - boost::posix_time::seconds(
+				                      static_cast<long>(result.tv_sec))).total_nanoseconds();
+				return result;
+			}
+
+			boost::system::error_code make_error(int result)
+			{
+				return boost::system::error_code(-result, boost::system::system_category());
+			}
+
+			void throw_errno()
+			{
+				throw boost::system::system_error(errno, boost::system::system_category());
+			}
+
+			//The address of an operation is the user data of its entries, so
+			//that a completion finds its handler without a lookup.
+			struct operation
+			{
+				virtual void complete(int result) = 0;
+
+			protected:
+
+				~operation()
+				{
+				}
+			};
+
+			//The owner may be destroyed by the handler, like with delete this.
+			template <class Owner>
+			struct member_operation TEMPEST_FINAL : operation
+			{
+				typedef void (Owner::*handler)(int);
+
+				member_operation(Owner &owner, handler on_complete)
+				    : m_owner(owner)
+				    , m_on_complete(on_complete)
+				{
+				}
+
+				virtual void complete(int result) TEMPEST_OVERRIDE
+				{
+					(m_owner.*m_on_complete)(result);
+				}
+
+			private:
+
+				Owner &m_owner;
+				handler const m_on_complete;
+			};
+
+			struct event_loop TEMPEST_FINAL : boost::noncopyable
+			{
+				explicit event_loop(unsigned entries)
+				    : m_ring(entries)
+				    , m_has_foreign(false)
+				{
+				}
+
+				//The entries of a link have to be submitted together, so they
+				//are reserved at once.
+				void reserve(unsigned count)
+				{
+					while (m_ring.free_sqes() < count)
+					{
+						m_ring.submit(0);
+					}
+				}
+
+				io_uring_sqe *prepare(operation &operation, unsigned char opcode, int fd)
+				{
+					reserve(1);
+					io_uring_sqe * const entry = m_ring.get_sqe();
+					entry->opcode = opcode;
+					entry->fd = fd;
+					entry->user_data = reinterpret_cast<__u64>(&operation);
+					return entry;
+				}
+
+				//The handler is called in the next iteration of the loop.
+				void post(boost::function<void ()> handler)
+				{
+					m_posted.push_back(boost::move(handler));
+				}
+
+				//Can be called from any thread. The loop does not wake up for
+				//it, but the tick of the timers ends every wait.
+				void post_from_other_thread(boost::function<void ()> handler)
+				{
+					boost::mutex::scoped_lock const lock(m_foreign_mutex);
+					m_foreign.push_back(boost::move(handler));
+					m_has_foreign.store(true, boost::memory_order_release);
+				}
+
+				void run()
+				{
+					std::vector<boost::function<void ()> > ready;
+					for (;;)
+					{
+						if (m_has_foreign.load(boost::memory_order_acquire))
+						{
+							boost::mutex::scoped_lock const lock(m_foreign_mutex);
+							m_posted.insert(m_posted.end(), m_foreign.begin(), m_foreign.end());
+							m_foreign.clear();
+							m_has_foreign.store(false, boost::memory_order_relaxed);
+						}
+
+						ready.swap(m_posted);
+						BOOST_FOREACH (boost::function<void ()> const &handler, ready)
+						{
+							handler();
+						}
+						ready.clear();
+
+						//everything the handlers have prepared is submitted with
+						//the same system call which waits for completions
+						m_ring.submit(m_posted.empty() ? 1 : 0);
+
+						io_uring_cqe completion;
+						while (m_ring.pop(completion))
+						{
+							reinterpret_cast<operation *>(completion.user_data)->complete(completion.res);
+						}
+					}
+				}
+
+			private:
+
+				uring m_ring;
+				std::vector<boost::function<void ()> > m_posted;
+
+				//handlers posted by other threads, which take the lock
+				boost::mutex m_foreign_mutex;
+				std::vector<boost::function<void ()> > m_foreign;
+				boost::atomic<bool> m_has_foreign;
+			};
+
+			struct uring_client TEMPEST_FINAL
+			        : public async_client
+			        , public boost::enable_shared_from_this<uring_client>
+			        , private async_sender
+			        , private async_receiver
+			{
+				explicit uring_client(event_loop &loop, int socket)
+				    : m_loop(loop)
+				    , m_socket(socket)
+				    , m_persistent(false)
+				    , m_submitted(0)
+				    , m_receive_operation(*this, &uring_client::handle_received)
+				    , m_timeout_operation(*this, &uring_client::handle_timeout)
+				    , m_send_operation(*this, &uring_client::handle_sent)
+				    , m_fill_operation(*this, &uring_client::handle_filled)
+				    , m_drain_operation(*this, &uring_client::handle_drained)
+				    , m_next_part(0)
+				    , m_next_iovec(0)
+				    , m_pipe_size(0)
+				    , m_in_pipe(0)
+				    , m_splicing(0)
+				    , m_sent(0)
+				{
+					std::memset(&m_timeout, 0, sizeof(m_timeout));
+					std::memset(&m_message, 0, sizeof(m_message));
+				}
+
+				virtual void shutdown() TEMPEST_OVERRIDE
+				{
+					//pending receives complete when the socket is shut down
+					::shutdown(m_socket.handle(), SHUT_RDWR);
+				}
+
+				virtual void post(boost::function<void ()> handler) TEMPEST_OVERRIDE
+				{
+					//the timers of the client may be advanced by another loop
+					m_loop.post_from_other_thread(boost::move(handler));
+				}
+
+				virtual async_sender &get_async_sender() TEMPEST_OVERRIDE
+				{
+					return *this;
+				}
+
+				virtual async_receiver &get_async_receiver() TEMPEST_OVERRIDE
+				{
+					return *this;
+				}
+
+				virtual void set_persistent(bool persistent) TEMPEST_OVERRIDE
+				{
+					m_persistent = persistent;
+				}
+
+			private:
+
+				event_loop &m_loop;
+				file_handle const m_socket;
+				bool m_persistent;
+
+				//The kernel uses the buffers of the client until the
+				//submitted operations have completed.
+				boost::shared_ptr<uring_client> m_self;
+				unsigned m_submitted;
+
+				member_operation<uring_client> m_receive_operation;
+				member_operation<uring_client> m_timeout_operation;
+				member_operation<uring_client> m_send_operation;
+				member_operation<uring_client> m_fill_operation;
+				member_operation<uring_client> m_drain_operation;
+
+				__kernel_timespec m_timeout;
+				receive_handler m_receive_handler;
+
+				//small parts of sends which have not been written yet
+				std::vector<char> m_pending;
+				send_parts m_sending;
+				std::size_t m_next_part;
+				send_handler m_send_handler;
+				std::vector<iovec> m_iovecs;
+				std::size_t m_next_iovec;
+				msghdr m_message;
+
+				//A file region is moved to the socket through a pipe by two
+				//linked splices without being copied to user space.
+				file_handle m_pipe_read;
+				file_handle m_pipe_write;
+				std::size_t m_pipe_size;
+				send_part m_file;
+				std::size_t m_in_pipe;
+				unsigned m_splicing;
+				boost::system::error_code m_splice_error;
+
+				//read by the timers of other threads
+				boost::atomic<boost::uint64_t> m_sent;
+
+
+				virtual bool is_persistent() TEMPEST_OVERRIDE
+				{
+					return m_persistent;
+				}
+
+				virtual boost::uint64_t sent_bytes() TEMPEST_OVERRIDE
+				{
+					return m_sent.load(boost::memory_order_relaxed);
+				}
+
+				virtual void async_receive(boost::asio::mutable_buffer buffer,
+				                           boost::posix_time::time_duration timeout,
+				                           receive_handler handler) TEMPEST_OVERRIDE
+				{
+					m_receive_handler = boost::move(handler);
+
+					//The linked timeout cancels the receive if nothing arrives.
+					//An infinite timeout leaves the timing to the caller.
+					bool const linked = !timeout.is_special();
+					m_loop.reserve(linked ? 2 : 1);
+					io_uring_sqe * const receive = start(m_receive_operation, IORING_OP_RECV, m_socket.handle());
+					receive->addr = reinterpret_cast<__u64>(boost::asio::buffer_cast<char *>(buffer));
+					receive->len = static_cast<__u32>(boost::asio::buffer_size(buffer));
+					if (!linked)
+					{
+						return;
+					}
+					receive->flags = IOSQE_IO_LINK;
+
+					m_timeout = make_timespec(timeout);
+					io_uring_sqe * const timer = start(m_timeout_operation, IORING_OP_LINK_TIMEOUT, -1);
+					timer->addr = reinterpret_cast<__u64>(&m_timeout);
+					timer->len = 1;
+				}
+
+				virtual void async_send(send_parts const &parts, send_handler handler) TEMPEST_OVERRIDE
+				{
+					assert(!m_send_handler);
+
+					bool collect = true;
+					std::size_t total_size = m_pending.size();
+					BOOST_FOREACH (send_part const &part, parts)
+					{
+						total_size += boost::asio::buffer_size(part.memory);
+						collect = collect && !part.is_file();
+					}
+
+					if (collect && (total_size <= max_pending_size))
+					{
+						BOOST_FOREACH (send_part const &part, parts)
+						{
+							char const * const data = boost::asio::buffer_cast<char const *>(part.memory);
+							m_pending.insert(m_pending.end(), data, data + boost::asio::buffer_size(part.memory));
+						}
+						m_loop.post(boost::bind(handler, boost::system::error_code()));
+						return;
+					}
+
+					m_sending = parts;
+					m_next_part = 0;
+					m_send_handler = boost::move(handler);
+					continue_sending();
+				}
+
+				virtual void async_flush(send_handler handler) TEMPEST_OVERRIDE
+				{
+					assert(!m_send_handler);
+
+					m_sending.clear();
+					m_next_part = 0;
+					m_send_handler = boost::move(handler);
+					continue_sending();
+				}
+
+				io_uring_sqe *start(operation &operation, unsigned char opcode, int fd)
+				{
+					if (m_submitted++ == 0)
+					{
+						m_self = shared_from_this();
+					}
+					return m_loop.prepare(operation, opcode, fd);
+				}
+
+				//This may destroy the client, so it has to be the last step
+				//of a completion handler.
+				void finish_operation()
+				{
+					assert(m_submitted > 0);
+					if (--m_submitted == 0)
+					{
+						boost::shared_ptr<uring_client> self;
+						self.swap(m_self);
+					}
+				}
+
+				void handle_received(int result)
+				{
+					receive_handler handler;
+					handler.swap(m_receive_handler);
+
+					boost::system::error_code error;
+					std::size_t received = 0;
+					if (result == -ECANCELED)
+					{
+						error = boost::asio::error::timed_out;
+					}
+					else if (result < 0)
+					{
+						error = make_error(result);
+					}
+					else
+					{
+						received = static_cast<std::size_t>(result);
+					}
+					handler(error, received);
+					finish_operation();
+				}
+
+				void handle_timeout(int)
+				{
+					finish_operation();
+				}
+
+				void continue_sending()
+				{
+					//the collected bytes and the following memory parts are
+					//written together
+					m_iovecs.clear();
+					m_next_iovec = 0;
+					if (!m_pending.empty())
+					{
+						iovec const pending = {m_pending.data(), m_pending.size()};
+						m_iovecs.push_back(pending);
+					}
+					while ((m_next_part < m_sending.size()) &&
+					       !m_sending[m_next_part].is_file())
+					{
+						boost::asio::const_buffer const memory = m_sending[m_next_part].memory;
+						iovec const part = {const_cast<char *>(boost::asio::buffer_cast<char const *>(memory)),
+						                    boost::asio::buffer_size(memory)};
+						m_iovecs.push_back(part);
+						++m_next_part;
+					}
+
+					if (!m_iovecs.empty())
+					{
+						return send_iovecs();
+					}
+
+					if (m_next_part == m_sending.size())
+					{
+						return finish_sending(boost::system::error_code());
+					}
+
+					m_file = m_sending[m_next_part];
+					++m_next_part;
+					continue_splicing();
+				}
+
+				void send_iovecs()
+				{
+					m_message.msg_iov = &m_iovecs[m_next_iovec];
+					m_message.msg_iovlen = m_iovecs.size() - m_next_iovec;
+					io_uring_sqe * const entry = start(m_send_operation, IORING_OP_SENDMSG, m_socket.handle());
+					entry->addr = reinterpret_cast<__u64>(&m_message);
+
+					//a header shares a segment with the beginning of a file
+					bool const file_follows = (m_next_part < m_sending.size());
+					entry->msg_flags = MSG_NOSIGNAL | (file_follows ? MSG_MORE : 0);
+				}
+
+				void handle_sent(int result)
+				{
+					if (result < 0)
+					{
+						finish_sending(make_error(result));
+						return finish_operation();
+					}
+
+					//the rest of a short write is submitted again
+					std::size_t written = static_cast<std::size_t>(result);
+					m_sent.fetch_add(written, boost::memory_order_relaxed);
+					while ((m_next_iovec < m_iovecs.size()) &&
+					       (written >= m_iovecs[m_next_iovec].iov_len))
+					{
+						written -= m_iovecs[m_next_iovec].iov_len;
+						++m_next_iovec;
+					}
+
+					if (m_next_iovec < m_iovecs.size())
+					{
+						iovec &rest = m_iovecs[m_next_iovec];
+						rest.iov_base = static_cast<char *>(rest.iov_base) + written;
+						rest.iov_len -= written;
+						send_iovecs();
+					}
+					else
+					{
+						m_pending.clear();
+						continue_sending();
+					}
+					finish_operation();
+				}
+
+				void continue_splicing()
+				{
+					//a short splice to the socket leaves bytes in the pipe
+					if (m_in_pipe > 0)
+					{
+						m_splicing = 1;
+						return drain(m_in_pipe);
+					}
+
+					if (m_file.length == 0)
+					{
+						return continue_sending();
+					}
+
+					if (!m_pipe_write.is_open())
+					{
+						boost::system::error_code const error = open_pipe();
+						if (error)
+						{
+							return finish_sending(error);
+						}
+					}
+
+					std::size_t const chunk = static_cast<std::size_t>(
+					            std::min<file_size>(m_file.length, m_pipe_size));
+					m_loop.reserve(2);
+					io_uring_sqe * const fill = start(m_fill_operation, IORING_OP_SPLICE, m_pipe_write.handle());
+					fill->splice_fd_in = m_file.file;
+					fill->splice_off_in = m_file.offset;
+					fill->off = no_offset;
+					fill->len = static_cast<__u32>(chunk);
+					fill->flags = IOSQE_IO_LINK;
+					m_splicing = 2;
+					drain(chunk);
+				}
+
+				void drain(std::size_t length)
+				{
+					io_uring_sqe * const entry = start(m_drain_operation, IORING_OP_SPLICE, m_socket.handle());
+					entry->splice_fd_in = m_pipe_read.handle();
+					entry->splice_off_in = no_offset;
+					entry->off = no_offset;
+					entry->len = static_cast<__u32>(length);
+					bool const more_follows = (m_in_pipe + m_file.length > length) ||
+					                          (m_next_part < m_sending.size());
+					entry->splice_flags = SPLICE_F_MOVE | (more_follows ? SPLICE_F_MORE : 0);
+				}
+
+				boost::system::error_code open_pipe()
+				{
+					int ends[2];
+					if (pipe2(ends, O_CLOEXEC) < 0)
+					{
+						return boost::system::error_code(errno, boost::system::system_category());
+					}
+					file_handle(ends[0]).swap(m_pipe_read);
+					file_handle(ends[1]).swap(m_pipe_write);
+
+					//the size may be limited for unprivileged users
+					fcntl(ends[1], F_SETPIPE_SZ, preferred_pipe_size);
+					int const size = fcntl(ends[1], F_GETPIPE_SZ);
+					m_pipe_size = (size > 0) ? static_cast<std::size_t>(size) : 64 * 1024;
+					return boost::system::error_code();
+				}
+
+				void handle_filled(int result)
+				{
+					if (result < 0)
+					{
+						m_splice_error = make_error(result);
+					}
+					else if (result == 0)
+					{
+						//the file has become shorter
+						m_splice_error = boost::asio::error::eof;
+					}
+					else
+					{
+						m_in_pipe += static_cast<std::size_t>(result);
+						m_file.offset += static_cast<file_size>(result);
+						m_file.length -= static_cast<file_size>(result);
+					}
+					finish_splice();
+				}
+
+				void handle_drained(int result)
+				{
+					//A short fill cancels the linked drain. The bytes in the
+					//pipe are drained by the next step.
+					if (result == -ECANCELED)
+					{
+					}
+					else if (result < 0)
+					{
+						m_splice_error = make_error(result);
+					}
+					else if (result == 0)
+					{
+						m_splice_error = boost::asio::error::broken_pipe;
+					}
+					else
+					{
+						m_in_pipe -= static_cast<std::size_t>(result);
+						m_sent.fetch_add(static_cast<boost::uint64_t>(result), boost::memory_order_relaxed);
+					}
+					finish_splice();
+				}
+
+				void finish_splice()
+				{
+					assert(m_splicing > 0);
+					if (--m_splicing == 0)
+					{
+						if (m_splice_error)
+						{
+							boost::system::error_code const error = m_splice_error;
+							m_splice_error.clear();
+							finish_sending(error);
+						}
+						else
+						{
+							continue_splicing();
+						}
+					}
+					finish_operation();
+				}
+
+				void finish_sending(boost::system::error_code error)
+				{
+					send_handler handler;
+					handler.swap(m_send_handler);
+					m_sending.clear();
+					m_loop.post(boost::bind(handler, error));
+				}
+			};
+
+			struct listener TEMPEST_FINAL : boost::noncopyable
+			{
+				explicit listener(event_loop &loop,
+				                  boost::uint16_t port,
+				                  boost::shared_ptr<directory> directory,
+				                  server_options const &options)
+				    : m_loop(loop)
+				    , m_directory(boost::move(directory))
+				    , m_options(options)
+				    , m_accept_operation(*this, &listener::handle_accepted)
+				    , m_pause_operation(*this, &listener::handle_pause_ended)
+				    , m_accepting(0)
+				    , m_paused(false)
+				    , m_retry_operation(*this, &listener::handle_retry)
+				    , m_retry_interval(make_timespec(accept_retry_delay))
+				    , m_retrying(false)
+				    , m_tick_operation(*this, &listener::handle_tick)
+				{
+					std::memset(&m_pause_interval, 0, sizeof(m_pause_interval));
+					if (m_options.admission)
+					{
+						m_pause_interval = make_timespec(m_options.admission->options().pause_interval);
+					}
+					m_tick = make_timespec(boost::posix_time::microseconds(
+					    boost::chrono::duration_cast<boost::chrono::microseconds>(m_options.timers->tick()).count()));
+
+					file_handle socket(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+					if (!socket.is_open())
+					{
+						throw_errno();
+					}
+
+					//every worker thread listens on the same port and the kernel
+					//distributes the connections
+					int const enabled = 1;
+					sockaddr_in address;
+					std::memset(&address, 0, sizeof(address));
+					address.sin_family = AF_INET;
+					address.sin_addr.s_addr = htonl(INADDR_ANY);
+					address.sin_port = htons(port);
+					if ((setsockopt(socket.handle(), SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) < 0) ||
+					    (setsockopt(socket.handle(), SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) < 0) ||
+					    (bind(socket.handle(), reinterpret_cast<sockaddr const *>(&address), sizeof(address)) < 0) ||
+					    (listen(socket.handle(), SOMAXCONN) < 0))
+					{
+						throw_errno();
+					}
+					m_socket.swap(socket);
+
+					//the completions do not differ, so the accepts share the
+					//operation
+					accept_more();
+					wait_for_tick();
+				}
+
+			private:
+
+				event_loop &m_loop;
+				boost::shared_ptr<directory> const m_directory;
+				server_options const &m_options;
+				file_handle m_socket;
+				member_operation<listener> m_accept_operation;
+
+				//While the admission control wants to pause, the accepts are
+				//not renewed and a timeout checks again later. The accepts
+				//which are pending already are not cancelled.
+				member_operation<listener> m_pause_operation;
+				__kernel_timespec m_pause_interval;
+				std::size_t m_accepting;
+				bool m_paused;
+
+				//A failed accept, for example for lack of descriptors, leaves
+				//the connection in the backlog, so accepting again at once
+				//would fail at once. The accepts are renewed after a delay.
+				member_operation<listener> m_retry_operation;
+				__kernel_timespec m_retry_interval;
+				bool m_retrying;
+
+				//Every thread advances the shared timer wheel, so that the
+				//timeouts do not depend on one busy thread.
+				member_operation<listener> m_tick_operation;
+				__kernel_timespec m_tick;
+
+
+				void accept_more()
+				{
+					if (m_options.admission && m_options.admission->should_pause())
+					{
+						//a pause is counted once however often it is checked
+						if (!m_paused)
+						{
+							m_paused = true;
+							m_options.admission->count_pause();
+						}
+						io_uring_sqe * const timer = m_loop.prepare(m_pause_operation, IORING_OP_TIMEOUT, -1);
+						timer->addr = reinterpret_cast<__u64>(&m_pause_interval);
+						timer->len = 1;
+						return;
+					}
+					m_paused = false;
+
+					while (m_accepting < pending_accepts)
+					{
+						io_uring_sqe * const entry = m_loop.prepare(
+						            m_accept_operation, IORING_OP_ACCEPT, m_socket.handle());
+						entry->accept_flags = SOCK_CLOEXEC;
+						++m_accepting;
+					}
+				}
+
+				void handle_accepted(int result)
+				{
+					--m_accepting;
+					if (result >= 0)
+					{
+						serve_client(boost::make_shared<uring_client>(m_loop, result),
+						             m_directory, m_options);
+					}
+					else if ((result != -ECONNABORTED) && !m_retrying)
+					{
+						//the other pending accepts are likely to fail as well
+						m_retrying = true;
+						io_uring_sqe * const timer = m_loop.prepare(m_retry_operation, IORING_OP_TIMEOUT, -1);
+						timer->addr = reinterpret_cast<__u64>(&m_retry_interval);
+						timer->len = 1;
+					}
+
+					//a failed accept does not stop the listener
+					if (!m_paused && !m_retrying)
+					{
+						accept_more();
+					}
+				}
+
+				void handle_retry(int)
+				{
+					m_retrying = false;
+					if (!m_paused)
+					{
+						accept_more();
+					}
+				}
+
+				//Only one of the timeouts renews the accepts when a pause and a
+				//retry overlap.
+				void handle_pause_ended(int)
+				{
+					if (m_retrying)
+					{
+						m_paused = false;
+						return;
+					}
+					accept_more();
+				}
+
+				void wait_for_tick()
+				{
+					io_uring_sqe * const timer = m_loop.prepare(m_tick_operation, IORING_OP_TIMEOUT, -1);
+					timer->addr = reinterpret_cast<__u64>(&m_tick);
+					timer->len = 1;
+				}
+
+				void handle_tick(int)
+				{
+					m_options.timers->advance();
+					wait_for_tick();
+				}
+			};
+		}
+
+		bool is_uring_available()
+		{
+			try
+			{
+				uring ring(8);
+
+				//without NODROP completions are lost when the queue overflows
+				if ((ring.features() & IORING_FEAT_NODROP) == 0)
+				{
+					return false;
+				}
+
+				unsigned char const required[] =
+				{
+				    IORING_OP_ACCEPT,
+				    IORING_OP_TIMEOUT,
+				    IORING_OP_RECV,
+				    IORING_OP_SENDMSG,
+				    IORING_OP_SPLICE,
+				    IORING_OP_LINK_TIMEOUT
+				};
+				BOOST_FOREACH (unsigned char opcode, required)
+				{
+					if (!ring.supports(opcode))
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+			catch (boost::system::system_error const &)
+			{
+				//ENOSYS on old kernels, EPERM if it has been disabled
+				return false;
+			}
+		}
+
+		void run_uring_server(boost::uint16_t port,
+		                      boost::shared_ptr<directory> directory,
+		                      server_options const &options)
+		{
+			assert(options.thread_count >= 1);
+
+			server_options timed = options;
+			if (!timed.timers)
+			{
+				timed.timers = boost::make_shared<timer_wheel>();
+			}
+
+			//everything which can fail is set up before the threads start
+			std::vector<boost::shared_ptr<event_loop> > loops;
+			std::vector<boost::shared_ptr<listener> > listeners;
+			for (unsigned i = 0; i < options.thread_count; ++i)
+			{
+				loops.push_back(boost::make_shared<event_loop>(ring_entries));
+				listeners.push_back(boost::make_shared<listener>(
+				                        boost::ref(*loops.back()), port, directory, boost::cref(timed)));
+			}
+
+			//the current thread is one of the workers
+			boost::thread_group workers;
+			for (unsigned i = 1; i < options.thread_count; ++i)
+			{
+				workers.create_thread(boost::bind(&event_loop::run, loops[i].get()));
+			}
+			loops.front()->run();
+			workers.join_all();
+		}
+#endif
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef TEMPEST_POSIX_URING_SERVER_HPP
+#define TEMPEST_POSIX_URING_SERVER_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+namespace tempest
+{
+	struct directory;
+	struct server_options;
+
+	namespace posix
+	{
+#if TEMPEST_USE_IO_URING
+		//whether the running kernel supports every operation which
+		//run_uring_server needs (Linux 5.7 or later)
+		bool is_uring_available();
+
+		//Serves like run_server, but every worker thread has a listening
+		//socket and an io_uring of its own instead of sharing an io_service.
+		//The accepts, receives with their timeouts and file transmissions of
+		//the connections of a thread are submitted together, so one system
+		//call per loop iteration both submits and waits.
+		//Check is_uring_available before calling this.
+		void run_uring_server(boost::uint16_t port,
+		                      boost::shared_ptr<directory> directory,
+		                      server_options const &options);
+#endif
+	}
+}
+
+
+#endif
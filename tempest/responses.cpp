@@ -1,82 +1,545 @@
 #include "responses.hpp"
 #include "client.hpp"
-#include "http/http_response.hpp"
-#include <boost/lexical_cast.hpp>
+#include "content_type.hpp"
+#include "http/byte_range.hpp"
+#include "http/http_request.hpp"
+#include "http/response_writer.hpp"
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/move/move.hpp>
 
 
 namespace tempest
 {
-	http_response make_bad_request()
+	namespace
 	{
-		http_response response;
-		response.version = "HTTP/1.1";
-		response.status = 400;
-		response.reason = "Bad Request";
-		response.headers["Content-Type"] = "text/html";
-		response.headers["Content-Length"] = "0";
-		return response;
+		std::string render_empty_error(unsigned status, boost::string_ref reason)
+		{
+			std::string rendered;
+			response_writer writer(rendered);
+			writer.status_line("HTTP/1.1", status, reason);
+			writer.header("Content-Length", "0");
+			writer.header("Content-Type", "text/html");
+			writer.header("Connection", "close");
+			writer.end();
+			return rendered;
+		}
+
+		in_memory_response make_html_error(unsigned status,
+		                                   boost::string_ref reason,
+		                                   boost::string_ref message,
+		                                   std::string const &requested_file)
+		{
+			in_memory_response response;
+			std::string &body = response.body;
+			body.reserve(message.size() + requested_file.size() + 7);
+			body.append(message.data(), message.size());
+			body += "<p>";
+			body += requested_file;
+			body += "</p>";
+
+			response_writer writer(response.header);
+			writer.status_line("HTTP/1.1", status, reason);
+			writer.header("Content-Length", static_cast<boost::uint64_t>(body.size()));
+			writer.header("Content-Type", "text/html");
+			return response;
+		}
+
+		void release_response(boost::system::error_code error,
+		                      boost::shared_ptr<in_memory_response const> const &,
+		                      boost::function<void (boost::system::error_code)> const &handler)
+		{
+			handler(error);
+		}
+	}
+
+	boost::asio::const_buffer bad_request_response()
+	{
+		static std::string const rendered = render_empty_error(400, "Bad Request");
+		return boost::asio::buffer(rendered);
+	}
+
+	boost::asio::const_buffer header_too_large_response()
+	{
+		static std::string const rendered =
+		        render_empty_error(431, "Request Header Fields Too Large");
+		return boost::asio::buffer(rendered);
+	}
+
+	boost::asio::const_buffer body_too_large_response()
+	{
+		static std::string const rendered =
+		        render_empty_error(413, "Payload Too Large");
+		return boost::asio::buffer(rendered);
+	}
+
+	boost::asio::const_buffer continue_response()
+	{
+		static char const rendered[] = "HTTP/1.1 100 Continue\r\n\r\n";
+		return boost::asio::buffer(rendered, sizeof(rendered) - 1);
+	}
+
+	std::string render_unavailable_response(unsigned retry_after_seconds)
+	{
+		std::string rendered;
+		response_writer writer(rendered);
+		writer.status_line("HTTP/1.1", 503, "Service Unavailable");
+		writer.header("Retry-After", static_cast<boost::uint64_t>(retry_after_seconds));
+		writer.header("Content-Length", "0");
+		writer.header("Content-Type", "text/html");
+		writer.header("Connection", "close");
+		writer.end();
+		return rendered;
+	}
+
+	in_memory_response make_not_found_response(std::string const &requested_file)
+	{
+		return make_html_error(404, "Not Found",
+		                       "<h2>The requested file could not be found</h2>",
+		                       requested_file);
+	}
+
+	in_memory_response make_not_implemented_response(std::string const &requested_file)
+	{
+		return make_html_error(501, "Not Implemented",
+		                       "<h2>could not serve the file because some required "
+		                       "functionality is not implemented in the web server</h2>",
+		                       requested_file);
+	}
+
+	char const *coding_name(content_coding coding)
+	{
+		switch (coding)
+		{
+		case gzip_coding: return "gzip";
+		case brotli_coding: return "br";
+		case identity_coding: break;
+		}
+		return "identity";
+	}
+
+	char const *sidecar_extension(content_coding coding)
+	{
+		switch (coding)
+		{
+		case gzip_coding: return ".gz";
+		case brotli_coding: return ".br";
+		case identity_coding: break;
+		}
+		return "";
+	}
+
+	std::size_t preferred_codings(http_request const &request,
+	                              content_coding (&codings)[3])
+	{
+		//Brotli files are usually smaller than gzip files.
+		std::size_t count = 0;
+		if (accepts_encoding(request, "br"))
+		{
+			codings[count++] = brotli_coding;
+		}
+		if (accepts_encoding(request, "gzip"))
+		{
+			codings[count++] = gzip_coding;
+		}
+		codings[count++] = identity_coding;
+		return count;
+	}
+
+	namespace
+	{
+		void append_decimal(std::string &destination, boost::uint64_t value)
+		{
+			char digits[max_decimal_length];
+			char * const end = digits + sizeof(digits);
+			destination.append(format_decimal(value, end), end);
+		}
+
+		//"bytes 0-99/1000"
+		std::string format_content_range(byte_range const &range, file_size size)
+		{
+			std::string formatted = "bytes ";
+			append_decimal(formatted, range.first);
+			formatted += '-';
+			append_decimal(formatted, range.first + range.length - 1);
+			formatted += '/';
+			append_decimal(formatted, size);
+			return formatted;
+		}
+
+		void write_representation_headers(response_writer &writer,
+		                                   file_validators const &validators,
+		                                   content_coding coding)
+		{
+			writer.date_header("Last-Modified", validators.modified_seconds);
+			writer.header("ETag", validators.etag);
+			if (coding != identity_coding)
+			{
+				writer.header("Content-Encoding", coding_name(coding));
+				writer.header("Vary", "Accept-Encoding");
+			}
+		}
+
+		void append_hex(std::string &destination, boost::uint64_t value)
+		{
+			static char const hex_digits[] = "0123456789abcdef";
+			char digits[16];
+			char * const end = digits + sizeof(digits);
+			char *first = end;
+			do
+			{
+				*--first = hex_digits[value & 15];
+				value >>= 4;
+			}
+			while (value != 0);
+			destination.append(first, end);
+		}
+
+		bool is_weak(boost::string_ref etag)
+		{
+			return etag.starts_with("W/");
+		}
+
+		boost::string_ref opaque_tag(boost::string_ref etag)
+		{
+			if (is_weak(etag))
+			{
+				etag.remove_prefix(2);
+			}
+			return etag;
+		}
+
+		//If-None-Match uses the weak comparison, "*" matches any tag.
+		bool matches_any_tag(boost::string_ref list, boost::string_ref etag)
+		{
+			for (;;)
+			{
+				std::size_t const comma = list.find(',');
+				boost::string_ref element = list.substr(0, comma);
+				while (!element.empty() && element.front() == ' ')
+				{
+					element.remove_prefix(1);
+				}
+				while (!element.empty() && element.back() == ' ')
+				{
+					element.remove_suffix(1);
+				}
+				if ((element == "*") ||
+				    (opaque_tag(element) == opaque_tag(etag)))
+				{
+					return true;
+				}
+				if (comma == boost::string_ref::npos)
+				{
+					return false;
+				}
+				list.remove_prefix(comma + 1);
+			}
+		}
+
+		//If-Range makes a Range header conditional on the file being
+		//unchanged since the client got a part of it. Entity tags are
+		//compared strongly.
+		bool is_range_still_valid(http_request const &request,
+		                          file_validators const &validators)
+		{
+			http_request::header_string const * const found = find_header(request, "If-Range");
+			if (!found)
+			{
+				return true;
+			}
+
+			boost::string_ref const if_range = *found;
+			if (!if_range.empty() &&
+			    (if_range[0] == '"' || is_weak(if_range)))
+			{
+				return !is_weak(if_range) &&
+				       !is_weak(validators.etag) &&
+				       (if_range == validators.etag);
+			}
+
+			char date[http_date_length];
+			format_http_date(validators.modified_seconds, date);
+			return (if_range == boost::string_ref(date, sizeof(date)));
+		}
+
+		//a boundary which is unlikely to occur in the file
+		std::string make_boundary(file_size size, boost::int64_t modified_seconds)
+		{
+			boost::uint64_t const mixed = (static_cast<boost::uint64_t>(modified_seconds) *
+			                               0x9e3779b97f4a7c15ULL) ^ size;
+			std::string boundary = "tempest-byteranges-";
+			append_hex(boundary, mixed);
+			return boundary;
+		}
+	}
+
+	std::string make_entity_tag(boost::uint64_t inode,
+	                            boost::int64_t modified_seconds,
+	                            boost::uint32_t modified_nanoseconds,
+	                            file_size size)
+	{
+		std::string etag = "\"";
+		append_hex(etag, inode);
+		etag += '-';
+		append_hex(etag, static_cast<boost::uint64_t>(modified_seconds));
+		etag += '.';
+		append_hex(etag, modified_nanoseconds);
+		etag += '-';
+		append_hex(etag, size);
+		etag += '"';
+		return etag;
+	}
+
+	std::string make_weak_entity_tag(boost::int64_t modified_seconds,
+	                                 file_size size)
+	{
+		std::string etag = "W/\"";
+		append_hex(etag, static_cast<boost::uint64_t>(modified_seconds));
+		etag += '-';
+		append_hex(etag, size);
+		etag += '"';
+		return etag;
+	}
+
+	void write_file_header_block(std::string &destination,
+	                             boost::string_ref file_name,
+	                             file_size size,
+	                             file_validators const &validators,
+	                             content_coding coding)
+	{
+		response_writer writer(destination);
+		writer.status_line("HTTP/1.1", 200, "OK");
+		writer.header("Content-Length", static_cast<boost::uint64_t>(size));
+		writer.header("Content-Type", find_content_type(file_name));
+		writer.header("Accept-Ranges", "bytes");
+		write_representation_headers(writer, validators, coding);
+	}
+
+	void write_not_modified_header_block(std::string &destination,
+	                                     file_validators const &validators,
+	                                     content_coding coding)
+	{
+		response_writer writer(destination);
+		writer.status_line("HTTP/1.1", 304, "Not Modified");
+		write_representation_headers(writer, validators, coding);
+	}
+
+	void render_file_headers(file_headers &headers,
+	                         boost::string_ref file_name,
+	                         file_size size,
+	                         file_validators const &validators,
+	                         content_coding coding)
+	{
+		headers.validators = validators;
+		headers.ok.clear();
+		write_file_header_block(headers.ok, file_name, size, validators, coding);
+		headers.not_modified.clear();
+		write_not_modified_header_block(headers.not_modified, validators, coding);
+	}
+
+	bool is_conditional(http_request const &request)
+	{
+		return find_header(request, "If-None-Match") ||
+		       find_header(request, "If-Modified-Since");
+	}
+
+	bool is_not_modified(http_request const &request,
+	                     file_validators const &validators)
+	{
+		if (request.method != "GET")
+		{
+			return false;
+		}
+
+		http_request::header_string const * const if_none_match = find_header(request, "If-None-Match");
+		if (if_none_match)
+		{
+			return matches_any_tag(*if_none_match, validators.etag);
+		}
+
+		http_request::header_string const * const if_modified_since = find_header(request, "If-Modified-Since");
+		boost::int64_t since = 0;
+		return if_modified_since &&
+		       parse_http_date(*if_modified_since, since) &&
+		       (validators.modified_seconds <= since);
+	}
+
+	body_piece body_piece::from_file(file_size offset, file_size length)
+	{
+		body_piece piece;
+		piece.is_file = true;
+		piece.offset = offset;
+		piece.length = length;
+		return piece;
+	}
+
+	body_piece body_piece::from_framing(file_size offset, file_size length)
+	{
+		body_piece piece;
+		piece.is_file = false;
+		piece.offset = offset;
+		piece.length = length;
+		return piece;
 	}
 
-	std::pair<http_response, std::string>
-	make_not_found_response(std::string const &requested_file)
+	boost::optional<in_memory_response>
+	plan_partial_response(http_request const &request,
+	                      boost::string_ref file_name,
+	                      file_size size,
+	                      file_validators const &validators,
+	                      content_coding coding,
+	                      partial_response &partial)
 	{
-		http_response response;
-		response.version = "HTTP/1.1";
-		response.status = 404;
-		response.reason = "Not Found";
-		response.headers["Content-Type"] = "text/html";
+		partial.pieces.clear();
+		if (request.method != "GET")
+		{
+			return boost::none;
+		}
+
+		http_request::header_string const * const range_header = find_header(request, "Range");
+		if (!range_header ||
+		    !is_range_still_valid(request, validators))
+		{
+			return boost::none;
+		}
+
+		std::vector<byte_range> ranges;
+		switch (parse_byte_ranges(*range_header, size, ranges))
+		{
+		case range_ignored:
+			return boost::none;
+
+		case range_not_satisfiable:
+			{
+				in_memory_response response;
+				response_writer writer(response.header);
+				writer.status_line("HTTP/1.1", 416, "Range Not Satisfiable");
+				writer.header("Content-Length", "0");
+				std::string content_range = "bytes */";
+				append_decimal(content_range, size);
+				writer.header("Content-Range", content_range);
+				return response;
+			}
 
-		std::string body =
-		        "<h2>The requested file could not be found</h2>"
-		        "<p>" + requested_file + "</p>"
-		        ;
+		case range_satisfiable:
+			break;
+		}
+
+		boost::string_ref const content_type = find_content_type(file_name);
+		partial.header.clear();
+		partial.framing.clear();
+		response_writer writer(partial.header);
+		writer.status_line("HTTP/1.1", 206, "Partial Content");
+
+		if (ranges.size() == 1)
+		{
+			byte_range const &range = ranges.front();
+			writer.header("Content-Length", range.length);
+			writer.header("Content-Type", content_type);
+			writer.header("Content-Range", format_content_range(range, size));
+			write_representation_headers(writer, validators, coding);
+			partial.pieces.push_back(body_piece::from_file(range.first, range.length));
+			return boost::none;
+		}
+
+		//multipart/byteranges with a part header in front of every range
+		std::string const boundary = make_boundary(size, validators.modified_seconds);
+		file_size content_length = 0;
+		for (std::size_t i = 0; i < ranges.size(); ++i)
+		{
+			byte_range const &range = ranges[i];
+			std::size_t const part_begin = partial.framing.size();
+			if (i > 0)
+			{
+				partial.framing += "\r\n";
+			}
+			partial.framing += "--";
+			partial.framing += boundary;
+			partial.framing += "\r\n";
+			response_writer part_writer(partial.framing);
+			part_writer.header("Content-Type", content_type);
+			part_writer.header("Content-Range", format_content_range(range, size));
+			part_writer.end();
+
+			file_size const part_length = partial.framing.size() - part_begin;
+			partial.pieces.push_back(body_piece::from_framing(part_begin, part_length));
+			partial.pieces.push_back(body_piece::from_file(range.first, range.length));
+			content_length += part_length + range.length;
+		}
 
-		response.headers["Content-Length"] =
-		        boost::lexical_cast<std::string>(body.size());
-		return std::make_pair(boost::move(response), boost::move(body));
+		std::size_t const end_begin = partial.framing.size();
+		partial.framing += "\r\n--";
+		partial.framing += boundary;
+		partial.framing += "--\r\n";
+		file_size const end_length = partial.framing.size() - end_begin;
+		partial.pieces.push_back(body_piece::from_framing(end_begin, end_length));
+		content_length += end_length;
+
+		writer.header("Content-Length", static_cast<boost::uint64_t>(content_length));
+		writer.header("Content-Type", "multipart/byteranges; boundary=" + boundary);
+		write_representation_headers(writer, validators, coding);
+		return boost::none;
+	}
+
+	boost::asio::const_buffer end_of_header_block(bool persistent)
+	{
+		static char const keep_alive[] = "Connection: keep-alive\r\n\r\n";
+		static char const close[] = "Connection: close\r\n\r\n";
+		return persistent
+		        ? boost::asio::buffer(keep_alive, sizeof(keep_alive) - 1)
+		        : boost::asio::buffer(close, sizeof(close) - 1);
 	}
 
-	std::pair<http_response, std::string>
-	make_not_implemented_response(std::string const &requested_file)
+	void send_header_block(boost::string_ref header, sender &sender)
 	{
-		http_response response;
-		response.version = "HTTP/1.1";
-		response.status = 501;
-		response.reason = "Not Implemented";
-		response.headers["Content-Type"] = "text/html";
+		std::ostream &out = sender.response();
+		out.write(header.data(), static_cast<std::streamsize>(header.size()));
 
-		std::string body =
-		        "<h2>could not serve the file because some required "
-		        "functionality is not implemented in the web server</h2>"
-		        "<p>" + requested_file + "</p>"
-		        ;
+		boost::asio::const_buffer const end = end_of_header_block(sender.is_persistent());
+		out.write(boost::asio::buffer_cast<char const *>(end),
+		          static_cast<std::streamsize>(boost::asio::buffer_size(end)));
+	}
 
-		response.headers["Content-Length"] =
-		        boost::lexical_cast<std::string>(body.size());
-		return std::make_pair(boost::move(response), boost::move(body));
+	void send_in_memory_response(in_memory_response const &response,
+	                             sender &sender)
+	{
+		send_header_block(response.header, sender);
+		sender.response().write(response.body.data(),
+		                        static_cast<std::streamsize>(response.body.size()));
 	}
 
-	void send_in_memory_response(
-		std::pair<http_response, std::string> const &response,
-		sender &sender)
+	void async_send_in_memory_response(
+		in_memory_response response,
+		async_sender &sender,
+		boost::function<void (boost::system::error_code)> handler)
 	{
-		print_response(response.first, sender.response());
+		boost::shared_ptr<in_memory_response> const sent =
+		        boost::make_shared<in_memory_response>();
+		sent->header.swap(response.header);
+		sent->body.swap(response.body);
 
-		std::string const &body = response.second;
-		sender.response().write(body.data(), body.size());
+		send_parts parts;
+		parts.push_back(send_part::from_memory(boost::asio::buffer(sent->header)));
+		parts.push_back(send_part::from_memory(end_of_header_block(sender.is_persistent())));
+		if (!sent->body.empty())
+		{
+			parts.push_back(send_part::from_memory(boost::asio::buffer(sent->body)));
+		}
+		sender.async_send(parts, boost::bind(release_response, _1, sent,
+		                                     boost::move(handler)));
 	}
 
 	boost::optional<boost::filesystem::path>
 	complete_served_path(boost::filesystem::path const &top,
-	                     std::string const &requested)
+	                     boost::string_ref requested)
 	{
 		//TODO white-listing instead of black-listing
-		if (requested.find("..") != std::string::npos)
+		if (requested.find("..") != boost::string_ref::npos)
 		{
 			return boost::optional<boost::filesystem::path>();
 		}
 
-		return top / requested;
+		return top / boost::filesystem::path(requested.begin(), requested.end());
 	}
 }
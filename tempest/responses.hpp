@@ -2,32 +2,176 @@
 #define TEMPEST_RESPONSES_HPP
 
 
+#include <tempest/config.hpp>
 #include <string>
-#include <utility>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <boost/function.hpp>
 #include <boost/optional.hpp>
+#include <boost/system/error_code.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/utility/string_ref.hpp>
 
 
 namespace tempest
 {
-	struct http_response;
 	struct sender;
+	struct async_sender;
+	struct http_request;
 
-	http_response make_bad_request();
+	//A precompressed file is stored next to the original with the extension
+	//of its coding, for example "site.css.gz".
+	enum content_coding
+	{
+		identity_coding,
+		gzip_coding,
+		brotli_coding
+	};
 
-	std::pair<http_response, std::string>
-	make_not_found_response(std::string const &requested_file);
+	//the name used in Accept-Encoding and Content-Encoding
+	char const *coding_name(content_coding coding);
 
-	std::pair<http_response, std::string>
-	make_not_implemented_response(std::string const &requested_file);
+	//the extension of the precompressed file, empty for the identity
+	char const *sidecar_extension(content_coding coding);
 
-	void send_in_memory_response(
-		std::pair<http_response, std::string> const &response,
-		sender &sender);
+	//Fills codings with the precompressed variants the client accepts in
+	//the order they should be tried. The identity is always last. Returns
+	//the number of codings.
+	std::size_t preferred_codings(http_request const &request,
+	                              content_coding (&codings)[3]);
+
+	//A complete response except for the Connection header. The header is a
+	//header block as described at end_of_header_block.
+	struct in_memory_response
+	{
+		std::string header;
+		std::string body;
+	};
+
+	//complete responses which close the connection
+	boost::asio::const_buffer bad_request_response();
+	boost::asio::const_buffer header_too_large_response();
+	boost::asio::const_buffer body_too_large_response();
+
+	//the interim response which asks a client for the body of its request
+	boost::asio::const_buffer continue_response();
+
+	//a complete 503 response which asks the client to come back later
+	std::string render_unavailable_response(unsigned retry_after_seconds);
+
+	in_memory_response make_not_found_response(std::string const &requested_file);
+
+	in_memory_response make_not_implemented_response(std::string const &requested_file);
+
+	//What a client can use to revalidate its copy of a file
+	struct file_validators
+	{
+		//quoted, "W/" in front of weak tags
+		std::string etag;
+		boost::int64_t modified_seconds;
+	};
+
+	//A strong entity tag which changes when the file is replaced or
+	//modified. The numbers are written in hexadecimal.
+	std::string make_entity_tag(boost::uint64_t inode,
+	                            boost::int64_t modified_seconds,
+	                            boost::uint32_t modified_nanoseconds,
+	                            file_size size);
+
+	//for platforms where a modification within the same second cannot be
+	//recognized
+	std::string make_weak_entity_tag(boost::int64_t modified_seconds,
+	                                 file_size size);
+
+	//Appends the header block of a 200 response for a file. Can be rendered
+	//once and sent many times. The Content-Type is derived from the name of
+	//the original file.
+	void write_file_header_block(std::string &destination,
+	                             boost::string_ref file_name,
+	                             file_size size,
+	                             file_validators const &validators,
+	                             content_coding coding = identity_coding);
+
+	//appends the header block of a 304 response
+	void write_not_modified_header_block(std::string &destination,
+	                                     file_validators const &validators,
+	                                     content_coding coding = identity_coding);
+
+	//The header blocks of a file rendered in advance so that neither a
+	//full response nor a revalidation needs any formatting.
+	struct file_headers
+	{
+		file_validators validators;
+		std::string ok;
+		std::string not_modified;
+	};
+
+	void render_file_headers(file_headers &headers,
+	                         boost::string_ref file_name,
+	                         file_size size,
+	                         file_validators const &validators,
+	                         content_coding coding);
+
+	//whether the request has If-None-Match or If-Modified-Since
+	bool is_conditional(http_request const &request);
+
+	//Evaluates If-None-Match and If-Modified-Since for a GET request.
+	//If-Modified-Since is only considered without If-None-Match.
+	bool is_not_modified(http_request const &request,
+	                     file_validators const &validators);
+
+	//a part of a response body
+	struct body_piece
+	{
+		//whether the bytes come from the served file or from the framing of
+		//the partial_response
+		bool is_file;
+		file_size offset;
+		file_size length;
+
+		static body_piece from_file(file_size offset, file_size length);
+		static body_piece from_framing(file_size offset, file_size length);
+	};
+
+	//A 206 response for one or more ranges of a file. A multipart body
+	//consists of the ranges and the delimiters between them.
+	struct partial_response
+	{
+		std::string header;
+		std::string framing;
+		std::vector<body_piece> pieces;
+	};
+
+	//Applies the Range and If-Range headers of a GET request to a file.
+	//Returns a 416 response if no range can be satisfied. Otherwise
+	//partial has no pieces if the whole file is to be sent as usual.
+	boost::optional<in_memory_response>
+	plan_partial_response(http_request const &request,
+	                      boost::string_ref file_name,
+	                      file_size size,
+	                      file_validators const &validators,
+	                      content_coding coding,
+	                      partial_response &partial);
+
+	//A header block is the status line and headers without the Connection
+	//header and without the empty line at the end. This completes it for
+	//the client.
+	boost::asio::const_buffer end_of_header_block(bool persistent);
+
+	//writes the header block and its end
+	void send_header_block(boost::string_ref header, sender &sender);
+
+	void send_in_memory_response(in_memory_response const &response,
+	                             sender &sender);
+
+	void async_send_in_memory_response(
+		in_memory_response response,
+		async_sender &sender,
+		boost::function<void (boost::system::error_code)> handler);
 
 	boost::optional<boost::filesystem::path>
 	complete_served_path(boost::filesystem::path const &top,
-	                     std::string const &requested);
+	                     boost::string_ref requested);
 }
 
 
@@ -0,0 +1,297 @@
+#include "router.hpp"
+#include "responses.hpp"
+#include "http/http_request.hpp"
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/move/move.hpp>
+#include <stdexcept>
+
+
+namespace tempest
+{
+	namespace
+	{
+		//Splits off the next segment of a path whose leading '/' has been
+		//removed. "a/" consists of "a" and an empty segment.
+		boost::string_ref next_segment(boost::string_ref &remaining, bool &last)
+		{
+			std::size_t const end = remaining.find('/');
+			boost::string_ref const segment = remaining.substr(0, end);
+			last = (end == boost::string_ref::npos);
+			remaining.remove_prefix(last ? remaining.size() : (end + 1));
+			return segment;
+		}
+
+		boost::string_ref without_leading_slash(boost::string_ref path)
+		{
+			if (!path.empty() && (path.front() == '/'))
+			{
+				path.remove_prefix(1);
+			}
+			return path;
+		}
+
+		char to_lower(char c)
+		{
+			return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		//"Example.com:8080" is "example.com", "[::1]:8080" is "[::1]"
+		boost::string_ref without_port(boost::string_ref host)
+		{
+			std::size_t const end = (!host.empty() && (host.front() == '['))
+			        ? host.find(']')
+			        : host.find(':');
+			return host.substr(0, (end == boost::string_ref::npos || host[end] == ':') ? end : (end + 1));
+		}
+
+		//longer host names do not exist
+		std::size_t const max_host_length = 255;
+
+		void release_table(boost::system::error_code error,
+		                   boost::shared_ptr<route_table const> const &,
+		                   directory::response_handler const &handler)
+		{
+			handler(error);
+		}
+	}
+
+	route_table::route_table()
+	    : m_default_root(no_node)
+	    , m_size(0)
+	{
+	}
+
+	void route_table::add(boost::string_ref host,
+	                      boost::string_ref path,
+	                      route_match match,
+	                      boost::shared_ptr<directory> handler)
+	{
+		if (host.size() > max_host_length)
+		{
+			throw std::invalid_argument("The host name of a route is too long");
+		}
+		std::string normalized;
+		boost::string_ref const name = without_port(host);
+		for (boost::string_ref::const_iterator i = name.begin(); i != name.end(); ++i)
+		{
+			normalized += to_lower(*i);
+		}
+
+		boost::uint32_t index = no_node;
+		if (normalized.empty())
+		{
+			if (m_default_root == no_node)
+			{
+				m_default_root = add_node();
+			}
+			index = m_default_root;
+		}
+		else
+		{
+			host_map::const_iterator const existing = m_hosts.find(normalized);
+			index = (existing == m_hosts.end())
+			        ? (m_hosts[normalized] = add_node())
+			        : existing->second;
+		}
+
+		boost::string_ref remaining = without_leading_slash(path);
+		bool last = remaining.empty();
+		while (!last)
+		{
+			segment_key key;
+			key.parent = index;
+			key.segment = next_segment(remaining, last).to_string();
+			segment_map::const_iterator const child = m_segments.find(key);
+			if (child == m_segments.end())
+			{
+				boost::uint32_t const added = add_node();
+				m_segments.insert(std::make_pair(key, added));
+				index = added;
+			}
+			else
+			{
+				index = child->second;
+			}
+		}
+
+		boost::shared_ptr<directory> &slot = (match == exact_match)
+		        ? m_nodes[index].exact
+		        : m_nodes[index].prefix;
+		if (!slot)
+		{
+			++m_size;
+		}
+		slot = boost::move(handler);
+	}
+
+	directory *route_table::find(boost::string_ref host,
+	                             boost::string_ref path,
+	                             boost::string_ref &rest) const
+	{
+		boost::uint32_t index = find_root(host);
+		if (index == no_node)
+		{
+			return 0;
+		}
+
+		//the query does not take part in routing
+		boost::string_ref const routed = without_leading_slash(path.substr(0, path.find('?')));
+		boost::string_ref remaining = routed;
+		directory *found = m_nodes[index].prefix.get();
+		rest = path;
+		bool last = remaining.empty();
+		while (!last)
+		{
+			boost::string_ref const segment = next_segment(remaining, last);
+			segment_ref const key = {index, segment};
+			segment_map::const_iterator const child = m_segments.find(key, segment_hash(), segment_equal());
+			if (child == m_segments.end())
+			{
+				return found;
+			}
+			index = child->second;
+			if (m_nodes[index].prefix)
+			{
+				found = m_nodes[index].prefix.get();
+				rest = path.substr(static_cast<std::size_t>(segment.end() - path.begin()));
+			}
+		}
+
+		node const &matched = m_nodes[index];
+		if (matched.exact)
+		{
+			rest = path.substr(static_cast<std::size_t>(routed.end() - path.begin()));
+			return matched.exact.get();
+		}
+		return found;
+	}
+
+	std::size_t route_table::size() const
+	{
+		return m_size;
+	}
+
+	boost::uint32_t route_table::find_root(boost::string_ref host) const
+	{
+		host = without_port(host);
+		if (!host.empty() &&
+		    (host.size() <= max_host_length))
+		{
+			char lower[max_host_length];
+			for (std::size_t i = 0; i < host.size(); ++i)
+			{
+				lower[i] = to_lower(host[i]);
+			}
+			host_map::const_iterator const found =
+			        m_hosts.find(boost::string_ref(lower, host.size()), host_hash(), host_equal());
+			if (found != m_hosts.end())
+			{
+				return found->second;
+			}
+		}
+		return m_default_root;
+	}
+
+	boost::uint32_t route_table::add_node()
+	{
+		if (m_nodes.size() >= no_node)
+		{
+			throw std::length_error("Too many routes");
+		}
+		m_nodes.push_back(node());
+		return static_cast<boost::uint32_t>(m_nodes.size() - 1);
+	}
+
+	std::size_t route_table::segment_hash::operator ()(segment_key const &key) const
+	{
+		segment_ref const ref = {key.parent, key.segment};
+		return (*this)(ref);
+	}
+
+	std::size_t route_table::segment_hash::operator ()(segment_ref const &key) const
+	{
+		std::size_t hash = boost::hash_range(key.segment.begin(), key.segment.end());
+		boost::hash_combine(hash, key.parent);
+		return hash;
+	}
+
+	bool route_table::segment_equal::operator ()(segment_key const &left, segment_key const &right) const
+	{
+		return (left.parent == right.parent) && (left.segment == right.segment);
+	}
+
+	bool route_table::segment_equal::operator ()(segment_ref const &left, segment_key const &right) const
+	{
+		return (left.parent == right.parent) && (left.segment == right.segment);
+	}
+
+	bool route_table::segment_equal::operator ()(segment_key const &left, segment_ref const &right) const
+	{
+		return (right.parent == left.parent) && (right.segment == left.segment);
+	}
+
+	std::size_t route_table::host_hash::operator ()(boost::string_ref host) const
+	{
+		return boost::hash_range(host.begin(), host.end());
+	}
+
+	bool route_table::host_equal::operator ()(boost::string_ref left, boost::string_ref right) const
+	{
+		return left == right;
+	}
+
+	router::router(boost::shared_ptr<route_table const> table)
+	    : m_table(boost::move(table))
+	{
+		assert(m_table);
+	}
+
+	void router::respond(http_request const &request,
+	                     boost::string_ref sub_path,
+	                     sender &sender)
+	{
+		boost::shared_ptr<route_table const> const table = this->table();
+		http_request::header_string const * const host = find_header(request, "Host");
+		boost::string_ref rest;
+		directory * const found = table->find(host ? boost::string_ref(*host) : boost::string_ref(),
+		                                      sub_path, rest);
+		if (!found)
+		{
+			return send_in_memory_response(make_not_found_response(request.file), sender);
+		}
+		found->respond(request, rest, sender);
+	}
+
+	void router::async_respond(http_request const &request,
+	                           boost::string_ref sub_path,
+	                           async_sender &sender,
+	                           response_handler handler)
+	{
+		boost::shared_ptr<route_table const> const table = this->table();
+		http_request::header_string const * const host = find_header(request, "Host");
+		boost::string_ref rest;
+		directory * const found = table->find(host ? boost::string_ref(*host) : boost::string_ref(),
+		                                      sub_path, rest);
+		if (!found)
+		{
+			return async_send_in_memory_response(make_not_found_response(request.file),
+			                                     sender, boost::move(handler));
+		}
+
+		//the table may be replaced before the response has been sent
+		found->async_respond(request, rest, sender,
+		                     boost::bind(release_table, _1, table, boost::move(handler)));
+	}
+
+	boost::shared_ptr<route_table const> router::table() const
+	{
+		return boost::atomic_load(&m_table);
+	}
+
+	void router::replace(boost::shared_ptr<route_table const> table)
+	{
+		assert(table);
+		boost::atomic_store(&m_table, boost::move(table));
+	}
+}
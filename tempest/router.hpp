@@ -0,0 +1,148 @@
+#ifndef TEMPEST_ROUTER_HPP
+#define TEMPEST_ROUTER_HPP
+
+
+#include <tempest/config.hpp>
+#include <tempest/directory.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <string>
+#include <vector>
+
+
+namespace tempest
+{
+	enum route_match
+	{
+		//only the path of the route itself
+		exact_match,
+
+		//the path and everything below it
+		prefix_match
+	};
+
+	//The routes of a server, built once and then only read, so that any
+	//number of threads can look them up at the same time.
+	//A path is split into segments at every '/'. All the segments of all
+	//hosts are in a single hash table keyed by the segment and the node it
+	//belongs to, so a lookup costs a probe per segment of the requested
+	//path however many routes there are. Looking up does not allocate.
+	struct route_table TEMPEST_FINAL : boost::noncopyable
+	{
+		route_table();
+
+		//Adds a route for the requests with the given Host. Hosts are
+		//compared without the port and case-insensitively. The empty host
+		//stands for every host without routes of its own. The path starts
+		//with a '/', so "/" with prefix_match routes every request of the
+		//host. A route replaces an earlier one of the same kind for the
+		//same host and path.
+		void add(boost::string_ref host,
+		         boost::string_ref path,
+		         route_match match,
+		         boost::shared_ptr<directory> handler);
+
+		//Returns the directory of the exact route or else of the longest
+		//prefix route for the path, null if there is none. The rest is the
+		//part of the path after the route, including a query. It refers
+		//to the path.
+		directory *find(boost::string_ref host,
+		                boost::string_ref path,
+		                boost::string_ref &rest) const;
+
+		//the number of routes
+		std::size_t size() const;
+
+	private:
+
+		struct node
+		{
+			boost::shared_ptr<directory> exact;
+			boost::shared_ptr<directory> prefix;
+		};
+
+		struct segment_key
+		{
+			boost::uint32_t parent;
+			std::string segment;
+		};
+
+		//looks up a segment_key without copying the segment
+		struct segment_ref
+		{
+			boost::uint32_t parent;
+			boost::string_ref segment;
+		};
+
+		struct segment_hash
+		{
+			std::size_t operator ()(segment_key const &key) const;
+			std::size_t operator ()(segment_ref const &key) const;
+		};
+
+		struct segment_equal
+		{
+			bool operator ()(segment_key const &left, segment_key const &right) const;
+			bool operator ()(segment_ref const &left, segment_key const &right) const;
+			bool operator ()(segment_key const &left, segment_ref const &right) const;
+		};
+
+		struct host_hash
+		{
+			std::size_t operator ()(boost::string_ref host) const;
+		};
+
+		struct host_equal
+		{
+			bool operator ()(boost::string_ref left, boost::string_ref right) const;
+		};
+
+		typedef boost::unordered_map<segment_key, boost::uint32_t, segment_hash, segment_equal> segment_map;
+		typedef boost::unordered_map<std::string, boost::uint32_t, host_hash, host_equal> host_map;
+
+		static boost::uint32_t const no_node = 0xffffffffu;
+
+		std::vector<node> m_nodes;
+		segment_map m_segments;
+		host_map m_hosts;
+		boost::uint32_t m_default_root;
+		std::size_t m_size;
+
+
+		boost::uint32_t find_root(boost::string_ref host) const;
+		boost::uint32_t add_node();
+	};
+
+	//A directory which dispatches every request with a route_table. The
+	//table can be replaced while requests are served, for example when
+	//the configuration is reloaded. A response keeps its table and thereby
+	//its directory until it has been sent.
+	struct router TEMPEST_FINAL : directory
+	{
+		explicit router(boost::shared_ptr<route_table const> table);
+
+		virtual void respond(http_request const &request,
+		                     boost::string_ref sub_path,
+		                     sender &sender) TEMPEST_OVERRIDE;
+		virtual void async_respond(http_request const &request,
+		                           boost::string_ref sub_path,
+		                           async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE;
+
+		boost::shared_ptr<route_table const> table() const;
+
+		//the requests which have been dispatched already keep the old table
+		void replace(boost::shared_ptr<route_table const> table);
+
+	private:
+
+		//only accessed with boost::atomic_load and boost::atomic_store
+		boost::shared_ptr<route_table const> m_table;
+	};
+}
+
+
+#endif
@@ -0,0 +1,878 @@
+#include "server.hpp"
+#include "client.hpp"
+#include "directory.hpp"
+#include "metrics.hpp"
+#include "access_log.hpp"
+#include "admission.hpp"
+#include "timer_wheel.hpp"
+#include "tcp_acceptor.hpp"
+#include "responses.hpp"
+#include "http/arena.hpp"
+#include "http/body_parser.hpp"
+#include "http/http_request.hpp"
+#include "http/request_body.hpp"
+#include "http/request_parser.hpp"
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace tempest
+{
+	server_options::server_options()
+	    : thread_count(1)
+	    , max_requests_per_connection(100)
+	    , keep_alive_timeout(boost::posix_time::seconds(5))
+	    , header_timeout(boost::posix_time::seconds(10))
+	    , send_timeout(boost::posix_time::seconds(30))
+	    , body_timeout(boost::posix_time::seconds(30))
+	    , max_body_size(64 * 1024 * 1024)
+	{
+	}
+
+	namespace
+	{
+		//HTTP/1.0 clients do not know the interim responses
+		bool expects_continue(http_request const &request)
+		{
+			http_request::header_string const * const expect = find_header(request, "Expect");
+			return expect && (request.version != "HTTP/1.0") &&
+			        boost::algorithm::iequals(*expect, "100-continue");
+		}
+
+		//the status code of a response which begins with a status line
+		unsigned parse_status(boost::asio::const_buffer header)
+		{
+			//HTTP/1.1 200 OK
+			char const * const begin = boost::asio::buffer_cast<char const *>(header);
+			std::size_t const size = boost::asio::buffer_size(header);
+			if ((size < 12) || (std::memcmp(begin, "HTTP/", 5) != 0))
+			{
+				return 0;
+			}
+			char const * const code = static_cast<char const *>(std::memchr(begin, ' ', size - 3));
+			if (!code)
+			{
+				return 0;
+			}
+			unsigned status = 0;
+			for (std::size_t i = 1; i <= 3; ++i)
+			{
+				char const digit = code[i];
+				if ((digit < '0') || (digit > '9'))
+				{
+					return 0;
+				}
+				status = status * 10 + static_cast<unsigned>(digit - '0');
+			}
+			return status;
+		}
+
+		//Passes the response of a directory on to the client and measures
+		//it: the first part of a response is its header.
+		struct metered_sender TEMPEST_FINAL : async_sender
+		{
+			//the metrics may be null
+			metered_sender(async_sender &next, metrics *metrics)
+			    : m_next(next)
+			    , m_metrics(metrics)
+			    , m_started(false)
+			    , m_status(0)
+			    , m_bytes(0)
+			{
+			}
+
+			void begin_response(boost::chrono::steady_clock::time_point now)
+			{
+				m_begin = now;
+				m_send_begin = now;
+				m_started = false;
+				m_status = 0;
+				m_bytes = 0;
+			}
+
+			//returns the time since begin_response
+			boost::chrono::steady_clock::duration end_response()
+			{
+				boost::chrono::steady_clock::time_point const now = boost::chrono::steady_clock::now();
+				if (m_metrics)
+				{
+					if (m_started)
+					{
+						m_metrics->record(send_phase, now - m_send_begin);
+					}
+					m_metrics->add(sent_bytes_counter, m_bytes);
+				}
+				return now - m_begin;
+			}
+
+			//zero if the response did not start with a status line
+			unsigned status() const
+			{
+				return m_status;
+			}
+
+			boost::uint64_t bytes() const
+			{
+				return m_bytes;
+			}
+
+			virtual void async_send(send_parts const &parts, send_handler handler) TEMPEST_OVERRIDE
+			{
+				if (!m_started && !parts.empty())
+				{
+					m_started = true;
+					if (!parts.front().is_file())
+					{
+						m_status = parse_status(parts.front().memory);
+					}
+					if (m_metrics)
+					{
+						m_send_begin = boost::chrono::steady_clock::now();
+						m_metrics->record(lookup_phase, m_send_begin - m_begin);
+						m_metrics->count_status(m_status);
+					}
+				}
+				BOOST_FOREACH (send_part const &part, parts)
+				{
+					m_bytes += part.is_file() ? part.length : boost::asio::buffer_size(part.memory);
+				}
+				m_next.async_send(parts, boost::move(handler));
+			}
+
+			virtual void async_flush(send_handler handler) TEMPEST_OVERRIDE
+			{
+				m_next.async_flush(boost::move(handler));
+			}
+
+			virtual bool is_persistent() TEMPEST_OVERRIDE
+			{
+				return m_next.is_persistent();
+			}
+
+			virtual void set_persistent(bool persistent) TEMPEST_OVERRIDE
+			{
+				m_next.set_persistent(persistent);
+			}
+
+			virtual boost::uint64_t sent_bytes() TEMPEST_OVERRIDE
+			{
+				return m_next.sent_bytes();
+			}
+
+		private:
+
+			async_sender &m_next;
+			metrics * const m_metrics;
+			boost::chrono::steady_clock::time_point m_begin;
+			boost::chrono::steady_clock::time_point m_send_begin;
+			bool m_started;
+			unsigned m_status;
+			boost::uint64_t m_bytes;
+		};
+
+		//what the timer of a connection is waiting for
+		enum connection_wait
+		{
+			no_wait,
+
+			//the first byte of the next request
+			idle_wait,
+
+			//the rest of the head of a request
+			header_wait,
+
+			//progress of the response
+			send_wait,
+
+			//more of a body which is being read
+			body_wait
+		};
+
+		boost::chrono::steady_clock::duration to_chrono(boost::posix_time::time_duration duration)
+		{
+			return boost::chrono::microseconds(duration.total_microseconds());
+		}
+
+		//The connection is the body of the request it is responding to.
+		struct connection TEMPEST_FINAL
+		        : boost::enable_shared_from_this<connection>
+		        , private request_body
+		{
+			explicit connection(boost::shared_ptr<async_client> client,
+			                    boost::shared_ptr<directory> directory,
+			                    server_options const &options)
+			    : m_client(boost::move(client))
+			    , m_directory(boost::move(directory))
+			    , m_options(options)
+			    , m_served(0)
+			    , m_input(8192)
+			    , m_input_begin(0)
+			    , m_input_end(0)
+			    , m_request(m_arena)
+			    , m_metered(m_client->get_async_sender(), m_options.metrics.get())
+			    , m_expects_continue(false)
+			    , m_wanted_persistent(false)
+			    , m_connection_admitted(!m_options.admission || m_options.admission->try_open_connection())
+			    , m_request_admitted(false)
+			    , m_waiting(no_wait)
+			    , m_sent_mark(0)
+			    , m_timer(m_options.timers.get(), boost::bind(&connection::handle_timeout, this))
+			{
+				if (m_options.metrics)
+				{
+					m_options.metrics->add(opened_connection_counter);
+				}
+			}
+
+			~connection()
+			{
+				end_admitted_request();
+				if (m_options.admission && m_connection_admitted)
+				{
+					m_options.admission->close_connection();
+				}
+				if (m_options.metrics)
+				{
+					m_options.metrics->add(closed_connection_counter);
+				}
+			}
+
+			void receive()
+			{
+				make_room();
+
+				//The head of a request has to be complete in time after its
+				//first byte, however slowly the rest trickles in.
+				if (m_input_end == 0)
+				{
+					wait(idle_wait, m_options.keep_alive_timeout);
+				}
+				else if (m_waiting.load(boost::memory_order_relaxed) != header_wait)
+				{
+					wait(header_wait, m_options.header_timeout);
+				}
+
+				m_client->get_async_receiver().async_receive(
+				    boost::asio::buffer(m_input.data() + m_input_end,
+				                        m_input.size() - m_input_end),
+				    m_options.timers
+				        ? boost::posix_time::time_duration(boost::posix_time::pos_infin)
+				        : m_options.keep_alive_timeout,
+				    received<&connection::handle_received>());
+			}
+
+		private:
+
+			boost::shared_ptr<async_client> const m_client;
+			boost::shared_ptr<directory> const m_directory;
+			server_options const m_options;
+			unsigned m_served;
+			request_parser m_parser;
+			std::vector<char> m_input;
+			std::size_t m_input_begin;
+			std::size_t m_input_end;
+
+			//The headers of the current request. The arena is reset for
+			//every request, so a connection stops allocating for the
+			//headers once it has seen its largest request.
+			arena m_arena;
+			arena_statistics m_counted_arena;
+			http_request m_request;
+			metered_sender m_metered;
+
+			//The body of the current request. Its pieces are slices of the
+			//input. A client which expects 100 Continue may never send the
+			//body, so its connection is only persistent once it has been
+			//asked for the body.
+			body_parser m_body;
+			boost::optional<boost::uint64_t> m_body_length;
+			wait_handler m_body_handler;
+			bool m_expects_continue;
+			bool m_wanted_persistent;
+
+			//A connection which has not been admitted answers its first
+			//request with a 503 response.
+			bool const m_connection_admitted;
+			bool m_request_admitted;
+
+			//The timer of the current wait. Its handler reads these from
+			//the thread which advances the wheel. It is destroyed first, so
+			//the handler cannot outlive the rest of the connection.
+			boost::atomic<connection_wait> m_waiting;
+			boost::atomic<boost::uint64_t> m_sent_mark;
+			wheel_timer m_timer;
+
+
+			//The handlers keep the connection alive. Unlike the result of
+			//boost::bind they fit into a boost::function, so passing them to
+			//the client does not allocate.
+			template <void (connection::*Handle)(boost::system::error_code, std::size_t)>
+			struct received_handler
+			{
+				boost::shared_ptr<connection> self;
+
+				explicit received_handler(boost::shared_ptr<connection> kept)
+				    : self(boost::move(kept))
+				{
+				}
+
+				void operator ()(boost::system::error_code error, std::size_t received) const
+				{
+					((*self).*Handle)(error, received);
+				}
+			};
+
+			template <void (connection::*Handle)(boost::system::error_code, std::size_t)>
+			received_handler<Handle> received()
+			{
+				return received_handler<Handle>(shared_from_this());
+			}
+
+			template <void (connection::*Handle)(boost::system::error_code)>
+			struct completion_handler
+			{
+				boost::shared_ptr<connection> self;
+
+				explicit completion_handler(boost::shared_ptr<connection> kept)
+				    : self(boost::move(kept))
+				{
+				}
+
+				void operator ()(boost::system::error_code error) const
+				{
+					((*self).*Handle)(error);
+				}
+			};
+
+			template <void (connection::*Handle)(boost::system::error_code)>
+			completion_handler<Handle> completion()
+			{
+				return completion_handler<Handle>(shared_from_this());
+			}
+
+			void handle_received(boost::system::error_code error,
+			                     std::size_t received)
+			{
+				if (error || (received == 0))
+				{
+					//timed out or closed by the client
+					return m_client->shutdown();
+				}
+
+				m_input_end += received;
+				process();
+			}
+
+			//Pipelined requests which have already been received are
+			//handled back to back. Their responses are collected by the
+			//sender and written together.
+			void process()
+			{
+				//We have to catch exceptions before they propagate to
+				//io_service::run because that would end the worker thread.
+				try
+				{
+					metrics * const metrics = m_options.metrics.get();
+					bool const metered = metrics || m_options.access_log;
+					async_sender &sender = metered
+					        ? static_cast<async_sender &>(m_metered)
+					        : m_client->get_async_sender();
+					if (m_input_begin == m_input_end)
+					{
+						wait(send_wait, m_options.send_timeout);
+						return sender.async_flush(
+						    completion<&connection::handle_flushed>());
+					}
+
+					boost::chrono::steady_clock::time_point parse_begin;
+					if (metered)
+					{
+						parse_begin = boost::chrono::steady_clock::now();
+					}
+
+					switch (m_parser.parse(m_input.data() + m_input_begin,
+					                       m_input_end - m_input_begin))
+					{
+					case parse_incomplete:
+						return receive();
+
+					case parse_complete:
+						break;
+
+					case parse_bad_request:
+						return respond_with_error(bad_request_response(), 400);
+
+					case parse_too_large:
+						return respond_with_error(header_too_large_response(), 431);
+					}
+
+					//nothing refers to the headers of the previous request anymore
+					m_request.headers.clear();
+					m_arena.reset();
+					try
+					{
+						make_request(m_parser.request(), m_request);
+					}
+					catch (std::invalid_argument const &)
+					{
+						//a malformed percent-escape in the target is the client's fault
+						return respond_with_error(bad_request_response(), 400);
+					}
+
+					//the view still has every copy of the headers
+					boost::uint64_t length = 0;
+					body_framing const framing = find_body_framing(m_parser.request(), length);
+					m_input_begin += m_parser.consumed();
+					m_parser.reset();
+
+					switch (framing)
+					{
+					case no_body:
+						m_body.start_length(0);
+						break;
+
+					case length_framing:
+						if (length > m_options.max_body_size)
+						{
+							return respond_with_error(body_too_large_response(), 413);
+						}
+						m_body.start_length(length);
+						m_body_length = length;
+						m_request.body = this;
+						break;
+
+					case chunked_framing:
+						m_body.start_chunked(m_options.max_body_size);
+						m_body_length = boost::none;
+						m_request.body = this;
+						break;
+
+					case invalid_framing:
+						return respond_with_error(bad_request_response(), 400);
+					}
+
+					if (m_options.admission)
+					{
+						if (!m_connection_admitted ||
+						    !m_options.admission->try_begin_request())
+						{
+							return respond_with_error(m_options.admission->rejection(), 503);
+						}
+						m_request_admitted = true;
+					}
+					++m_served;
+
+					if (metered)
+					{
+						boost::chrono::steady_clock::time_point const parse_end =
+						        boost::chrono::steady_clock::now();
+						if (metrics)
+						{
+							metrics->add(request_counter);
+							metrics->record(parse_phase, parse_end - parse_begin);
+							count_arena_usage(*metrics);
+						}
+						m_metered.begin_response(parse_end);
+					}
+
+					//a streamed response may still turn persistence off
+					m_wanted_persistent =
+					        wants_persistent_connection(m_request) &&
+					        (m_served < m_options.max_requests_per_connection);
+					m_expects_continue = m_request.body && expects_continue(m_request);
+					m_client->set_persistent(m_wanted_persistent && !m_expects_continue);
+
+					wait(send_wait, m_options.send_timeout);
+					m_directory->async_respond(
+					    m_request, m_request.file, sender,
+					    completion<&connection::handle_responded>());
+				}
+				catch (std::exception const &ex)
+				{
+					if (m_options.metrics)
+					{
+						m_options.metrics->add(error_counter);
+					}
+					if (m_options.error_log)
+					{
+						m_options.error_log->log_error(ex.what());
+					}
+					else
+					{
+						std::cerr << ex.what() << '\n';
+					}
+					m_client->shutdown();
+				}
+			}
+
+			//the error responses are complete including the Connection header
+			void respond_with_error(boost::asio::const_buffer response,
+			                        unsigned status)
+			{
+				if (m_options.metrics)
+				{
+					m_options.metrics->count_status(status);
+					m_options.metrics->add(sent_bytes_counter, boost::asio::buffer_size(response));
+				}
+				if (m_options.access_log)
+				{
+					//there is no valid request to describe
+					m_options.access_log->log_request("-", "-", status,
+					                                  boost::asio::buffer_size(response),
+					                                  boost::chrono::steady_clock::duration::zero());
+				}
+				m_client->set_persistent(false);
+				wait(send_wait, m_options.send_timeout);
+				send_parts parts;
+				parts.push_back(send_part::from_memory(response));
+				m_client->get_async_sender().async_send(
+				    parts,
+				    completion<&connection::handle_error_sent>());
+			}
+
+			void handle_error_sent(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return m_client->shutdown();
+				}
+				m_client->get_async_sender().async_flush(
+				    completion<&connection::handle_last_flushed>());
+			}
+
+			void handle_responded(boost::system::error_code error)
+			{
+				end_admitted_request();
+				if (error)
+				{
+					return m_client->shutdown();
+				}
+
+				if (m_options.metrics || m_options.access_log)
+				{
+					boost::chrono::steady_clock::duration const duration = m_metered.end_response();
+					if (m_options.access_log)
+					{
+						m_options.access_log->log_request(m_request.method, m_request.file,
+						                                  m_metered.status(), m_metered.bytes(),
+						                                  duration);
+					}
+				}
+
+				if (!m_client->get_async_sender().is_persistent())
+				{
+					return m_client->get_async_sender().async_flush(
+					    completion<&connection::handle_last_flushed>());
+				}
+
+				if (m_request.body && !m_body.is_complete())
+				{
+					return skip_body();
+				}
+
+				process();
+			}
+
+			virtual body_result read(boost::string_ref &piece) TEMPEST_OVERRIDE
+			{
+				body_result const result = m_body.parse(m_input.data() + m_input_begin,
+				                                        m_input_end - m_input_begin,
+				                                        piece);
+				m_input_begin += m_body.consumed();
+				return result;
+			}
+
+			virtual void async_wait(wait_handler handler) TEMPEST_OVERRIDE
+			{
+				assert(!m_body_handler);
+				m_body_handler = boost::move(handler);
+				if (m_expects_continue)
+				{
+					m_expects_continue = false;
+					m_client->set_persistent(m_wanted_persistent);
+					send_parts parts;
+					parts.push_back(send_part::from_memory(continue_response()));
+					return m_client->get_async_sender().async_send(
+					    parts,
+					    completion<&connection::handle_continue_sent>());
+				}
+				receive_body();
+			}
+
+			virtual boost::optional<boost::uint64_t> length() const TEMPEST_OVERRIDE
+			{
+				return m_body_length;
+			}
+
+			void handle_continue_sent(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return end_body_wait(error);
+				}
+				//the client waits for it
+				m_client->get_async_sender().async_flush(
+				    completion<&connection::handle_continue_flushed>());
+			}
+
+			void handle_continue_flushed(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return end_body_wait(error);
+				}
+				receive_body();
+			}
+
+			void receive_body()
+			{
+				make_room();
+				wait(body_wait, m_options.body_timeout);
+				m_client->get_async_receiver().async_receive(
+				    boost::asio::buffer(m_input.data() + m_input_end,
+				                        m_input.size() - m_input_end),
+				    m_options.timers
+				        ? boost::posix_time::time_duration(boost::posix_time::pos_infin)
+				        : m_options.body_timeout,
+				    received<&connection::handle_body_received>());
+			}
+
+			void handle_body_received(boost::system::error_code error,
+			                          std::size_t received)
+			{
+				if (error || (received == 0))
+				{
+					//timed out or closed by the client
+					return end_body_wait(error ? error : boost::asio::error::eof);
+				}
+				m_input_end += received;
+
+				//the directory goes on with the response
+				wait(send_wait, m_options.send_timeout);
+				end_body_wait(boost::system::error_code());
+			}
+
+			//calls the handler of async_wait
+			void end_body_wait(boost::system::error_code error)
+			{
+				wait_handler handler;
+				handler.swap(m_body_handler);
+				handler(error);
+			}
+
+			//The rest of a body which the directory has not read is
+			//skipped to get to the next request.
+			void skip_body()
+			{
+				for (;;)
+				{
+					boost::string_ref piece;
+					switch (read(piece))
+					{
+					case body_piece:
+						break;
+
+					case body_complete:
+						return process();
+
+					case body_incomplete:
+						m_body_handler = completion<&connection::handle_skip_wait>();
+						return receive_body();
+
+					case body_bad_request:
+					case body_too_large:
+						return m_client->get_async_sender().async_flush(
+						    completion<&connection::handle_last_flushed>());
+					}
+				}
+			}
+
+			void handle_skip_wait(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return m_client->shutdown();
+				}
+				skip_body();
+			}
+
+			void handle_flushed(boost::system::error_code error)
+			{
+				if (error)
+				{
+					return m_client->shutdown();
+				}
+				receive();
+			}
+
+			void handle_last_flushed(boost::system::error_code)
+			{
+				m_client->shutdown();
+			}
+
+			//the unconsumed bytes are kept contiguous at the front
+			void make_room()
+			{
+				std::copy(m_input.begin() + m_input_begin,
+				          m_input.begin() + m_input_end,
+				          m_input.begin());
+				m_input_end -= m_input_begin;
+				m_input_begin = 0;
+
+				//the parsers limit the length of what they leave unconsumed
+				if (m_input_end == m_input.size())
+				{
+					m_input.resize(m_input.size() * 2);
+				}
+			}
+
+			//Pipelined responses are one long send whose progress is
+			//checked when the timer expires, so they do not restart it.
+			void wait(connection_wait waiting, boost::posix_time::time_duration timeout)
+			{
+				if (!m_options.timers ||
+				    ((waiting == send_wait) && (m_waiting.load(boost::memory_order_relaxed) == send_wait)))
+				{
+					return;
+				}
+				m_waiting.store(waiting, boost::memory_order_relaxed);
+				if (waiting == send_wait)
+				{
+					m_sent_mark.store(m_client->get_async_sender().sent_bytes(), boost::memory_order_relaxed);
+				}
+				m_timer.start(to_chrono(timeout));
+			}
+
+			//Called by the wheel from any thread. Shutting the client down
+			//makes the pending operation fail, which ends the connection.
+			//The client is not thread-safe, so it is shut down by a handler
+			//of its own, which keeps it alive until then.
+			bool handle_timeout()
+			{
+				connection_wait const waiting = m_waiting.load(boost::memory_order_relaxed);
+				if (waiting == send_wait)
+				{
+					boost::uint64_t const sent = m_client->get_async_sender().sent_bytes();
+					if (m_sent_mark.exchange(sent, boost::memory_order_relaxed) != sent)
+					{
+						return true;
+					}
+				}
+				if (m_options.metrics)
+				{
+					switch (waiting)
+					{
+					case idle_wait: m_options.metrics->add(idle_timeout_counter); break;
+					case header_wait: m_options.metrics->add(header_timeout_counter); break;
+					case send_wait: m_options.metrics->add(send_timeout_counter); break;
+					case body_wait: m_options.metrics->add(body_timeout_counter); break;
+					case no_wait: break;
+					}
+				}
+				m_client->post(boost::bind(&async_client::shutdown, m_client));
+				return false;
+			}
+
+			//adds what the arena did since the previous call
+			void count_arena_usage(metrics &metrics)
+			{
+				arena_statistics const &current = m_arena.statistics();
+				metrics.add(arena_allocation_counter, current.allocations - m_counted_arena.allocations);
+				metrics.add(arena_byte_counter, current.allocated_bytes - m_counted_arena.allocated_bytes);
+				metrics.add(arena_chunk_counter, current.chunks - m_counted_arena.chunks);
+				m_counted_arena = current;
+			}
+
+			void end_admitted_request()
+			{
+				if (m_request_admitted)
+				{
+					m_request_admitted = false;
+					m_options.admission->end_request();
+				}
+			}
+		};
+
+		//A single system timer advances the wheel with the timeouts of all
+		//connections.
+		void advance_timers(boost::asio::deadline_timer &ticker,
+		                    timer_wheel &timers,
+		                    boost::system::error_code error)
+		{
+			if (error)
+			{
+				return;
+			}
+			timers.advance();
+			ticker.expires_from_now(boost::posix_time::microseconds(
+			    boost::chrono::duration_cast<boost::chrono::microseconds>(timers.tick()).count()));
+			ticker.async_wait(boost::bind(advance_timers, boost::ref(ticker), boost::ref(timers), _1));
+		}
+
+		void handle_client(tcp_acceptor::client_ptr &client,
+		                   boost::shared_ptr<directory> directory,
+		                   server_options const &options)
+		{
+			serve_client(movable_ptr<tcp_client>::to_shared(client),
+			             boost::move(directory), options);
+		}
+	}
+
+	void serve_client(boost::shared_ptr<async_client> client,
+	                  boost::shared_ptr<directory> directory,
+	                  server_options const &options)
+	{
+		//Every step of the connection is handled asynchronously by one of the
+		//worker threads which run the io_service. Waiting for the client does
+		//not occupy a thread.
+		boost::make_shared<connection>(boost::move(client),
+		                               boost::move(directory),
+		                               options)->receive();
+	}
+
+	void run_server(boost::uint16_t port,
+	                boost::shared_ptr<directory> directory,
+	                server_options const &options)
+	{
+		assert(options.thread_count >= 1);
+
+		server_options timed = options;
+		if (!timed.timers)
+		{
+			timed.timers = boost::make_shared<timer_wheel>();
+		}
+
+		boost::asio::io_service io_service;
+		boost::asio::deadline_timer ticker(io_service);
+		advance_timers(ticker, *timed.timers, boost::system::error_code());
+		tcp_acceptor acceptor(port,
+		                      boost::bind(handle_client, _1, directory,
+		                                  boost::cref(timed)),
+		                      io_service,
+		                      timed.admission);
+
+		//the current thread is one of the workers
+		boost::thread_group workers;
+		for (unsigned i = 1; i < options.thread_count; ++i)
+		{
+			workers.create_thread(
+				boost::bind(&boost::asio::io_service::run, &io_service));
+		}
+		io_service.run();
+		workers.join_all();
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef TEMPEST_SERVER_HPP
+#define TEMPEST_SERVER_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+
+namespace tempest
+{
+	struct directory;
+	struct async_client;
+	struct metrics;
+	struct access_log;
+	struct admission_control;
+	struct timer_wheel;
+
+	struct server_options
+	{
+		//the number of threads running the io_service
+		unsigned thread_count;
+
+		//a connection is closed after this many requests
+		unsigned max_requests_per_connection;
+
+		//A connection is closed when the first byte of a request does not
+		//arrive within keep_alive_timeout, when the rest of its head does not
+		//arrive within header_timeout, when a response makes no progress
+		//for send_timeout, or when nothing of a body which is being read
+		//arrives within body_timeout. Receiving a byte at a time does not
+		//extend the header_timeout. The progress is checked every
+		//send_timeout, so a stalled client is noticed after one to two of
+		//them.
+		boost::posix_time::time_duration keep_alive_timeout;
+		boost::posix_time::time_duration header_timeout;
+		boost::posix_time::time_duration send_timeout;
+		boost::posix_time::time_duration body_timeout;
+
+		//A request with a larger Content-Length is answered with 413 and a
+		//chunked body which grows larger fails to be read.
+		boost::uint64_t max_body_size;
+
+		//The timeouts are kept here. run_server creates a wheel if this is
+		//null. A connection without a wheel only has the keep_alive_timeout
+		//of every receive.
+		boost::shared_ptr<tempest::timer_wheel> timers;
+
+		//counts the connections, requests and responses if not null
+		boost::shared_ptr<tempest::metrics> metrics;
+
+		//gets a record for every response if not null
+		boost::shared_ptr<tempest::access_log> access_log;
+
+		//Errors which end a connection are logged here instead of being
+		//written to std::cerr if not null.
+		boost::shared_ptr<tempest::access_log> error_log;
+
+		//limits the connections and the requests in flight if not null
+		boost::shared_ptr<tempest::admission_control> admission;
+
+		server_options();
+	};
+
+	//Serves requests on the client until it closes the connection, sends a
+	//non-persistent request or the limits in the options are reached.
+	//The client is kept alive by the pending operations.
+	void serve_client(boost::shared_ptr<async_client> client,
+	                  boost::shared_ptr<directory> directory,
+	                  server_options const &options);
+
+	//On POSIX the process should ignore SIGPIPE, because files are sent with
+	//sendfile which raises it when the client has gone.
+	void run_server(boost::uint16_t port,
+	                boost::shared_ptr<directory> directory,
+	                server_options const &options);
+}
+
+
+#endif
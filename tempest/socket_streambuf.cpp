@@ -0,0 +1,175 @@
+#include "socket_streambuf.hpp"
+#include <boost/asio/write.hpp>
+#include <algorithm>
+
+
+namespace tempest
+{
+	namespace
+	{
+		std::size_t const buffer_size = 8192;
+
+		//Output is collected up to this size so that the responses to
+		//pipelined requests can be sent with a single write.
+		std::size_t const max_output_size = 64 * 1024;
+	}
+
+	socket_streambuf::socket_streambuf(boost::asio::ip::tcp::socket &socket)
+	    : m_socket(socket)
+	    , m_input(buffer_size)
+	    , m_output(buffer_size)
+	{
+		setg(m_input.data(), m_input.data(), m_input.data());
+		setp(m_output.data(), m_output.data() + m_output.size());
+	}
+
+	char const *socket_streambuf::input_begin() const
+	{
+		return gptr();
+	}
+
+	std::size_t socket_streambuf::input_size() const
+	{
+		return static_cast<std::size_t>(egptr() - gptr());
+	}
+
+	bool socket_streambuf::receive_more()
+	{
+		if (!write_pending())
+		{
+			return false;
+		}
+
+		//the unconsumed bytes are kept contiguous at the front
+		std::size_t const pending = input_size();
+		std::copy(gptr(), egptr(), m_input.data());
+		if (pending == m_input.size())
+		{
+			m_input.resize(m_input.size() * 2);
+		}
+
+		boost::system::error_code error;
+		std::size_t const received = m_socket.read_some(
+		    boost::asio::buffer(m_input.data() + pending, m_input.size() - pending),
+		    error);
+		setg(m_input.data(), m_input.data(), m_input.data() + pending + received);
+		return !error && (received > 0);
+	}
+
+	void socket_streambuf::consume_input(std::size_t length)
+	{
+		assert(length <= input_size());
+		gbump(static_cast<int>(length));
+	}
+
+	socket_streambuf::int_type socket_streambuf::underflow()
+	{
+		if (gptr() < egptr())
+		{
+			return traits_type::to_int_type(*gptr());
+		}
+
+		//The peer may wait for the responses which are still buffered
+		//before it sends more.
+		if (!write_pending())
+		{
+			return traits_type::eof();
+		}
+
+		boost::system::error_code error;
+		std::size_t const received =
+		        m_socket.read_some(boost::asio::buffer(m_input), error);
+		if (error || (received == 0))
+		{
+			return traits_type::eof();
+		}
+
+		setg(m_input.data(), m_input.data(), m_input.data() + received);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	socket_streambuf::int_type socket_streambuf::overflow(int_type c)
+	{
+		if (!reserve_output(1))
+		{
+			return traits_type::eof();
+		}
+
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize socket_streambuf::xsputn(char_type const *s, std::streamsize n)
+	{
+		//small pieces are collected in the buffer
+		if (static_cast<std::size_t>(n) <= max_output_size)
+		{
+			if (!reserve_output(static_cast<std::size_t>(n)))
+			{
+				return 0;
+			}
+			traits_type::copy(pptr(), s, static_cast<std::size_t>(n));
+			pbump(static_cast<int>(n));
+			return n;
+		}
+
+		//large pieces are written directly without copying them
+		if (!write_pending())
+		{
+			return 0;
+		}
+
+		boost::system::error_code error;
+		return static_cast<std::streamsize>(boost::asio::write(
+		    m_socket,
+		    boost::asio::buffer(s, static_cast<std::size_t>(n)),
+		    error));
+	}
+
+	int socket_streambuf::sync()
+	{
+		return write_pending() ? 0 : -1;
+	}
+
+	bool socket_streambuf::reserve_output(std::size_t size)
+	{
+		assert(size <= max_output_size);
+
+		std::size_t const pending = static_cast<std::size_t>(pptr() - pbase());
+		if ((pending + size) <= m_output.size())
+		{
+			return true;
+		}
+
+		if ((pending + size) > max_output_size)
+		{
+			return write_pending();
+		}
+
+		m_output.resize(std::min(max_output_size,
+		                         std::max(pending + size, m_output.size() * 2)));
+		setp(m_output.data(), m_output.data() + m_output.size());
+		pbump(static_cast<int>(pending));
+		return true;
+	}
+
+	bool socket_streambuf::write_pending()
+	{
+		std::size_t const pending = static_cast<std::size_t>(pptr() - pbase());
+		if (pending > 0)
+		{
+			boost::system::error_code error;
+			boost::asio::write(m_socket, boost::asio::buffer(pbase(), pending), error);
+			setp(m_output.data(), m_output.data() + m_output.size());
+			if (error)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
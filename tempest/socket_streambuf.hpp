@@ -0,0 +1,49 @@
+#ifndef TEMPEST_SOCKET_STREAMBUF_HPP
+#define TEMPEST_SOCKET_STREAMBUF_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <streambuf>
+#include <vector>
+
+
+namespace tempest
+{
+	//A blocking stream buffer on top of a socket which is owned elsewhere.
+	//In contrast to boost::asio::ip::tcp::iostream the socket can still be
+	//used for asynchronous operations on the io_service of the server.
+	struct socket_streambuf TEMPEST_FINAL : std::streambuf
+	{
+		explicit socket_streambuf(boost::asio::ip::tcp::socket &socket);
+
+		//the received bytes which have not been consumed yet
+		char const *input_begin() const;
+		std::size_t input_size() const;
+
+		//Blocks until more bytes have been appended to the input. Returns
+		//false at the end of the stream.
+		bool receive_more();
+
+		void consume_input(std::size_t length);
+
+	protected:
+
+		virtual int_type underflow() TEMPEST_OVERRIDE;
+		virtual int_type overflow(int_type c) TEMPEST_OVERRIDE;
+		virtual std::streamsize xsputn(char_type const *s, std::streamsize n) TEMPEST_OVERRIDE;
+		virtual int sync() TEMPEST_OVERRIDE;
+
+	private:
+
+		boost::asio::ip::tcp::socket &m_socket;
+		std::vector<char> m_input;
+		std::vector<char> m_output;
+
+		bool reserve_output(std::size_t size);
+		bool write_pending();
+	};
+}
+
+
+#endif
@@ -1,40 +1,85 @@
 #include "tcp_acceptor.hpp"
 #include "tcp_client.hpp"
+#include "admission.hpp"
 #include <boost/bind.hpp>
+#include <boost/asio/error.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/move/move.hpp>
 
 
 namespace tempest
 {
+	namespace
+	{
+		//long enough for a lack of descriptors to go away
+		boost::posix_time::time_duration const accept_retry_delay =
+		        boost::posix_time::milliseconds(100);
+	}
+
 	tcp_acceptor::tcp_acceptor(boost::uint16_t port,
 	                           client_handler on_client,
-	                           boost::asio::io_service &io_service)
-	    : m_impl(io_service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4(), port))
+	                           boost::asio::io_service &io_service,
+	                           boost::shared_ptr<admission_control> admission)
+	    : m_io_service(io_service)
+	    , m_impl(io_service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4(), port))
 	    , m_on_client(boost::move(on_client))
+	    , m_admission(boost::move(admission))
+	    , m_delay(io_service)
+	    , m_paused(false)
 	{
 		begin_accept();
 	}
 
 	void tcp_acceptor::begin_accept()
 	{
+		if (m_admission && m_admission->should_pause())
+		{
+			//a pause is counted once however often it is checked
+			if (!m_paused)
+			{
+				m_paused = true;
+				m_admission->count_pause();
+			}
+			return accept_later(m_admission->options().pause_interval);
+		}
+		m_paused = false;
+
 		m_next_client.reset(
-		            new boost::asio::ip::tcp::iostream());
-		m_impl.async_accept(*m_next_client->rdbuf(),
+		            new boost::asio::ip::tcp::socket(m_io_service));
+		m_impl.async_accept(*m_next_client,
 		                    boost::bind(&tcp_acceptor::handle_accept, this,
 		                                boost::asio::placeholders::error));
 	}
 
 	void tcp_acceptor::handle_accept(boost::system::error_code error)
 	{
-		if (error)
+		if (error == boost::asio::error::operation_aborted)
 		{
-			//TODO
 			return;
 		}
+		if (error)
+		{
+			return accept_later(accept_retry_delay);
+		}
 
 		client_ptr client(new tcp_client(boost::move(m_next_client)));
 		m_on_client(client);
 		begin_accept();
 	}
+
+	void tcp_acceptor::accept_later(boost::posix_time::time_duration delay)
+	{
+		m_delay.expires_from_now(delay);
+		m_delay.async_wait(boost::bind(&tcp_acceptor::handle_delay, this,
+		                               boost::asio::placeholders::error));
+	}
+
+	void tcp_acceptor::handle_delay(boost::system::error_code error)
+	{
+		if (error)
+		{
+			return;
+		}
+		begin_accept();
+	}
 }
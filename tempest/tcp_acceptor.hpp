@@ -2,34 +2,51 @@
 #define TEMPEST_TCP_ACCEPTOR_HPP
 
 
-#include "client.hpp"
+#include "tcp_client.hpp"
 #include <tempest/config.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/deadline_timer.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 #include <memory>
 
 
 namespace tempest
 {
+	struct admission_control;
+
+	//Accepts connections until the io_service is stopped. A failed accept,
+	//for example for lack of descriptors, is retried after a moment.
 	struct tcp_acceptor TEMPEST_FINAL
 	{
-		typedef movable_ptr<abstract_client>::type client_ptr;
+		typedef movable_ptr<tcp_client>::type client_ptr;
 		typedef boost::function<void (client_ptr &)>
 			client_handler;
 
+		//While the admission control wants to pause, the connections are
+		//left in the backlog of the kernel.
 		explicit tcp_acceptor(boost::uint16_t port,
 		                      client_handler on_client,
-		                      boost::asio::io_service &io_service);
+		                      boost::asio::io_service &io_service,
+		                      boost::shared_ptr<admission_control> admission =
+		                          boost::shared_ptr<admission_control>());
 
 	private:
 
+		boost::asio::io_service &m_io_service;
 		boost::asio::ip::tcp::acceptor m_impl;
 		const client_handler m_on_client;
-		movable_ptr<boost::asio::ip::tcp::iostream>::type m_next_client;
+		boost::shared_ptr<admission_control> const m_admission;
+		movable_ptr<boost::asio::ip::tcp::socket>::type m_next_client;
+		boost::asio::deadline_timer m_delay;
+		bool m_paused;
 
 		void begin_accept();
 		void handle_accept(boost::system::error_code error);
+		void accept_later(boost::posix_time::time_duration delay);
+		void handle_delay(boost::system::error_code error);
 	};
 
 }
@@ -1,17 +1,67 @@
 #include "tcp_client.hpp"
+#include "posix/file_handle.hpp"
+#include <boost/asio/placeholders.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/move/move.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/version.hpp>
+
+#if TEMPEST_USE_POSIX
+#	include <sys/socket.h>
+#	include <sys/uio.h>
+#	include <cerrno>
+#endif
 
 
 namespace tempest
 {
-	tcp_client::tcp_client(socket_ptr stream)
-	    : m_stream(boost::move(stream))
+	namespace
 	{
+		boost::asio::io_service &get_io_service(boost::asio::ip::tcp::socket &socket)
+		{
+#if BOOST_VERSION >= 107000
+			return static_cast<boost::asio::io_service &>(socket.get_executor().context());
+#else
+			return socket.get_io_service();
+#endif
+		}
+
+		//Parts up to this size are collected instead of being written
+		//immediately.
+		std::size_t const max_pending_size = 64 * 1024;
+	}
+
+	tcp_client::tcp_client(socket_ptr socket)
+	    : m_socket(boost::move(socket))
+	    , m_buffer(*m_socket)
+	    , m_stream(&m_buffer)
+	    , m_strand(get_io_service(*m_socket))
+	    , m_timer(get_io_service(*m_socket))
+	    , m_persistent(false)
+	    , m_timed_out(false)
+	    , m_next_part(0)
+	    , m_sent(0)
+	{
+		//Files are sent without blocking. The blocking interface still
+		//waits because Boost.ASIO polls unless the user has asked for
+		//non-blocking operations.
+		boost::system::error_code ignored;
+		m_socket->native_non_blocking(true, ignored);
 	}
 
 	void tcp_client::shutdown()
 	{
-		m_stream->rdbuf()->shutdown(boost::asio::socket_base::shutdown_both);
+		m_buffer.pubsync();
+
+		boost::system::error_code error;
+		m_socket->shutdown(boost::asio::socket_base::shutdown_both, error);
+	}
+
+	void tcp_client::post(boost::function<void ()> handler)
+	{
+		m_strand.post(boost::move(handler));
 	}
 
 	sender &tcp_client::get_sender()
@@ -24,24 +74,331 @@ namespace tempest
 		return *this;
 	}
 
+	async_sender &tcp_client::get_async_sender()
+	{
+		return *this;
+	}
+
+	async_receiver &tcp_client::get_async_receiver()
+	{
+		return *this;
+	}
+
+	void tcp_client::set_persistent(bool persistent)
+	{
+		m_persistent = persistent;
+	}
+
 	std::ostream &tcp_client::response()
 	{
-		return *m_stream;
+		return m_stream;
 	}
 
 	boost::optional<int> tcp_client::posix_response()
 	{
 #if TEMPEST_USE_POSIX
-		//Boost 1.46.1 does not know native_handle(), so we use native() here
-		int const fd = m_stream->rdbuf()->native();
+		//Boost 1.46.1 does not know native_handle(), and native() was removed
+		//in later versions
+#if BOOST_VERSION >= 104700
+		int const fd = m_socket->native_handle();
+#else
+		int const fd = m_socket->native();
+#endif
 		return fd;
 #else
 		return boost::optional<int>();
 #endif
 	}
 
+	bool tcp_client::is_persistent()
+	{
+		return m_persistent;
+	}
+
+	boost::uint64_t tcp_client::sent_bytes()
+	{
+		return m_sent.load(boost::memory_order_relaxed);
+	}
+
 	std::istream &tcp_client::request()
 	{
-		return *m_stream;
+		return m_stream;
+	}
+
+	char const *tcp_client::buffered_begin()
+	{
+		return m_buffer.input_begin();
+	}
+
+	std::size_t tcp_client::buffered_size()
+	{
+		return m_buffer.input_size();
+	}
+
+	bool tcp_client::receive_more()
+	{
+		return m_buffer.receive_more();
+	}
+
+	void tcp_client::consume(std::size_t length)
+	{
+		m_buffer.consume_input(length);
+	}
+
+	void tcp_client::async_send(send_parts const &parts, send_handler handler)
+	{
+		assert(!m_send_handler);
+
+		bool collect = true;
+		std::size_t total_size = m_pending.size();
+		BOOST_FOREACH (send_part const &part, parts)
+		{
+			total_size += boost::asio::buffer_size(part.memory);
+			collect = collect && !part.is_file();
+		}
+
+		if (collect && (total_size <= max_pending_size))
+		{
+			BOOST_FOREACH (send_part const &part, parts)
+			{
+				char const * const data = boost::asio::buffer_cast<char const *>(part.memory);
+				m_pending.insert(m_pending.end(), data, data + boost::asio::buffer_size(part.memory));
+			}
+			m_strand.post(boost::bind(handler, boost::system::error_code()));
+			return;
+		}
+
+		m_sending = parts;
+		m_next_part = 0;
+		m_send_handler = boost::move(handler);
+		continue_sending();
+	}
+
+	void tcp_client::async_flush(send_handler handler)
+	{
+		assert(!m_send_handler);
+
+		m_sending.clear();
+		m_next_part = 0;
+		m_send_handler = boost::move(handler);
+		continue_sending();
+	}
+
+	void tcp_client::async_receive(boost::asio::mutable_buffer buffer,
+	                               boost::posix_time::time_duration timeout,
+	                               receive_handler handler)
+	{
+		//an infinite timeout leaves the timing to the caller
+		m_timed_out = false;
+		if (!timeout.is_special())
+		{
+			m_timer.expires_from_now(timeout);
+			m_timer.async_wait(m_strand.wrap(
+				boost::bind(&tcp_client::handle_timeout, this,
+				            boost::asio::placeholders::error)));
+		}
+
+		m_socket->async_read_some(boost::asio::mutable_buffers_1(buffer), m_strand.wrap(
+			boost::bind(&tcp_client::handle_received, this,
+			            boost::asio::placeholders::error,
+			            boost::asio::placeholders::bytes_transferred,
+			            boost::move(handler))));
+	}
+
+	void tcp_client::continue_sending()
+	{
+		//the collected bytes and the following memory parts are written
+		//together
+		std::vector<boost::asio::const_buffer> buffers;
+		if (!m_pending.empty())
+		{
+			buffers.push_back(boost::asio::buffer(m_pending));
+		}
+		while ((m_next_part < m_sending.size()) &&
+		       !m_sending[m_next_part].is_file())
+		{
+			buffers.push_back(m_sending[m_next_part].memory);
+			++m_next_part;
+		}
+
+		if (!buffers.empty())
+		{
+#if TEMPEST_USE_POSIX
+			if (m_next_part < m_sending.size())
+			{
+				return send_before_file(buffers);
+			}
+#endif
+			boost::asio::async_write(*m_socket, buffers, m_strand.wrap(
+				boost::bind(&tcp_client::handle_written, this,
+				            boost::asio::placeholders::error,
+				            boost::asio::placeholders::bytes_transferred)));
+			return;
+		}
+
+		if (m_next_part == m_sending.size())
+		{
+			return finish_sending(boost::system::error_code());
+		}
+
+		send_file_part();
+	}
+
+	void tcp_client::send_before_file(std::vector<boost::asio::const_buffer> const &buffers)
+	{
+#if TEMPEST_USE_POSIX
+		//The header is written with MSG_MORE, so that it shares a segment with
+		//the beginning of the file. Usually the socket has room for it and
+		//the file follows without a round trip through the io_service.
+		std::vector<iovec> parts;
+		std::size_t total_size = 0;
+		BOOST_FOREACH (boost::asio::const_buffer const &buffer, buffers)
+		{
+			iovec const part = {const_cast<char *>(boost::asio::buffer_cast<char const *>(buffer)),
+			                    boost::asio::buffer_size(buffer)};
+			parts.push_back(part);
+			total_size += part.iov_len;
+		}
+		msghdr message = msghdr();
+		message.msg_iov = parts.data();
+		message.msg_iovlen = parts.size();
+		ssize_t written = sendmsg(*posix_response(), &message, MSG_MORE | MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+			{
+				return finish_sending(boost::system::error_code(errno, boost::system::system_category()));
+			}
+			written = 0;
+		}
+		m_sent.fetch_add(static_cast<boost::uint64_t>(written), boost::memory_order_relaxed);
+
+		if (static_cast<std::size_t>(written) == total_size)
+		{
+			m_pending.clear();
+			return send_file_part();
+		}
+
+		//the rest waits for the socket to become writable
+		std::vector<boost::asio::const_buffer> rest;
+		std::size_t skipped = static_cast<std::size_t>(written);
+		BOOST_FOREACH (boost::asio::const_buffer const &buffer, buffers)
+		{
+			std::size_t const size = boost::asio::buffer_size(buffer);
+			if (skipped >= size)
+			{
+				skipped -= size;
+				continue;
+			}
+			rest.push_back(buffer + skipped);
+			skipped = 0;
+		}
+		boost::asio::async_write(*m_socket, rest, m_strand.wrap(
+			boost::bind(&tcp_client::handle_written, this,
+			            boost::asio::placeholders::error,
+			            boost::asio::placeholders::bytes_transferred)));
+#else
+		(void)buffers;
+		assert(false);
+#endif
+	}
+
+	void tcp_client::send_file_part()
+	{
+		//the part is advanced by what has been sent so far
+		send_part &file = m_sending[m_next_part];
+
+		boost::system::error_code error;
+#if TEMPEST_USE_POSIX
+		file_size const sent = posix::try_send_file_region(
+		            *posix_response(), file.file, file.offset, file.length, error);
+		file.offset += sent;
+		file.length -= sent;
+		m_sent.fetch_add(sent, boost::memory_order_relaxed);
+		if (error == boost::asio::error::would_block)
+		{
+			//a slow client does not occupy a thread while the rest waits
+			return wait_until_writable();
+		}
+		if (!error && (file.length > 0))
+		{
+			error = boost::asio::error::eof;
+		}
+#else
+		error = boost::asio::error::operation_not_supported;
+#endif
+
+		if (error)
+		{
+			return finish_sending(error);
+		}
+		++m_next_part;
+		m_strand.post(boost::bind(&tcp_client::continue_sending, this));
+	}
+
+	void tcp_client::wait_until_writable()
+	{
+#if BOOST_VERSION >= 106600
+		m_socket->async_wait(boost::asio::socket_base::wait_write, m_strand.wrap(
+			boost::bind(&tcp_client::handle_writable, this,
+			            boost::asio::placeholders::error)));
+#else
+		m_socket->async_write_some(boost::asio::null_buffers(), m_strand.wrap(
+			boost::bind(&tcp_client::handle_writable, this,
+			            boost::asio::placeholders::error)));
+#endif
+	}
+
+	void tcp_client::handle_writable(boost::system::error_code error)
+	{
+		if (error)
+		{
+			return finish_sending(error);
+		}
+		send_file_part();
+	}
+
+	void tcp_client::handle_written(boost::system::error_code error, std::size_t written)
+	{
+		m_sent.fetch_add(written, boost::memory_order_relaxed);
+		m_pending.clear();
+		if (error)
+		{
+			return finish_sending(error);
+		}
+		continue_sending();
+	}
+
+	void tcp_client::finish_sending(boost::system::error_code error)
+	{
+		send_handler handler;
+		handler.swap(m_send_handler);
+		m_sending.clear();
+		m_strand.post(boost::bind(handler, error));
+	}
+
+	void tcp_client::handle_received(boost::system::error_code error,
+	                                 std::size_t received,
+	                                 receive_handler const &handler)
+	{
+		m_timer.cancel();
+		if (m_timed_out)
+		{
+			error = boost::asio::error::timed_out;
+		}
+		handler(error, received);
+	}
+
+	void tcp_client::handle_timeout(boost::system::error_code error)
+	{
+		//the timer may have been restarted by a later receive in the meantime
+		if (error ||
+		    m_timer.expires_at() > boost::asio::deadline_timer::traits_type::now())
+		{
+			return;
+		}
+
+		m_timed_out = true;
+		m_socket->cancel(error);
 	}
 }
@@ -3,31 +3,86 @@
 
 
 #include "client.hpp"
+#include "socket_streambuf.hpp"
 #include <tempest/config.hpp>
 #include <memory>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/atomic.hpp>
 
 
 namespace tempest
 {
-	struct tcp_client : public abstract_client, private sender, private receiver
+	//Implements both the blocking and the asynchronous interfaces. They must
+	//not be mixed on the same connection because they buffer independently.
+	struct tcp_client
+	        : public abstract_client
+	        , public async_client
+	        , private sender
+	        , private receiver
+	        , private async_sender
+	        , private async_receiver
 	{
-		typedef movable_ptr<boost::asio::ip::tcp::iostream>::type socket_ptr;
+		typedef movable_ptr<boost::asio::ip::tcp::socket>::type socket_ptr;
 
 		explicit tcp_client(socket_ptr socket);
 		virtual void shutdown() TEMPEST_OVERRIDE;
 		virtual sender &get_sender() TEMPEST_OVERRIDE;
 		virtual receiver &get_receiver() TEMPEST_OVERRIDE;
+		virtual async_sender &get_async_sender() TEMPEST_OVERRIDE;
+		virtual async_receiver &get_async_receiver() TEMPEST_OVERRIDE;
+		virtual void set_persistent(bool persistent) TEMPEST_OVERRIDE;
+		virtual void post(boost::function<void ()> handler) TEMPEST_OVERRIDE;
 
 	private:
 
-		const socket_ptr m_stream;
+		const socket_ptr m_socket;
+		socket_streambuf m_buffer;
+		std::iostream m_stream;
+		boost::asio::io_service::strand m_strand;
+		boost::asio::deadline_timer m_timer;
+		bool m_persistent;
+		bool m_timed_out;
+
+		//small parts of asynchronous sends which have not been written yet
+		std::vector<char> m_pending;
+		send_parts m_sending;
+		std::size_t m_next_part;
+		send_handler m_send_handler;
+		boost::atomic<boost::uint64_t> m_sent;
 
 
 		virtual std::ostream &response() TEMPEST_OVERRIDE;
 		virtual boost::optional<int> posix_response() TEMPEST_OVERRIDE;
+		virtual bool is_persistent() TEMPEST_OVERRIDE;
+		virtual boost::uint64_t sent_bytes() TEMPEST_OVERRIDE;
 
 		virtual std::istream &request() TEMPEST_OVERRIDE;
+		virtual char const *buffered_begin() TEMPEST_OVERRIDE;
+		virtual std::size_t buffered_size() TEMPEST_OVERRIDE;
+		virtual bool receive_more() TEMPEST_OVERRIDE;
+		virtual void consume(std::size_t length) TEMPEST_OVERRIDE;
+
+		virtual void async_send(send_parts const &parts, send_handler handler) TEMPEST_OVERRIDE;
+		virtual void async_flush(send_handler handler) TEMPEST_OVERRIDE;
+
+		virtual void async_receive(boost::asio::mutable_buffer buffer,
+		                           boost::posix_time::time_duration timeout,
+		                           receive_handler handler) TEMPEST_OVERRIDE;
+
+		void continue_sending();
+		void send_before_file(std::vector<boost::asio::const_buffer> const &buffers);
+		void send_file_part();
+		void wait_until_writable();
+		void handle_writable(boost::system::error_code error);
+		void handle_written(boost::system::error_code error, std::size_t written);
+		void finish_sending(boost::system::error_code error);
+		void handle_received(boost::system::error_code error,
+		                     std::size_t received,
+		                     receive_handler const &handler);
+		void handle_timeout(boost::system::error_code error);
 	};
 }
 
@@ -0,0 +1,20 @@
+#include "thread_index.hpp"
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
+
+namespace tempest
+{
+	std::size_t thread_index()
+	{
+		static boost::atomic<std::size_t> next_index(0);
+		static boost::thread_specific_ptr<std::size_t> index;
+		std::size_t *existing = index.get();
+		if (!existing)
+		{
+			existing = new std::size_t(next_index.fetch_add(1, boost::memory_order_relaxed));
+			index.reset(existing);
+		}
+		return *existing;
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef TEMPEST_THREAD_INDEX_HPP
+#define TEMPEST_THREAD_INDEX_HPP
+
+
+#include <cstddef>
+
+
+namespace tempest
+{
+	//The threads are numbered in the order in which they first ask. A
+	//thread keeps its index for its whole life, so that it always uses the
+	//same shard of a sharded object.
+	std::size_t thread_index();
+}
+
+
+#endif
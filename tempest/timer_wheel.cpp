@@ -0,0 +1,273 @@
+#include "timer_wheel.hpp"
+#include "thread_index.hpp"
+#include <boost/move/move.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+
+namespace tempest
+{
+	namespace
+	{
+		std::size_t round_up_to_power_of_two(std::size_t value)
+		{
+			std::size_t result = 1;
+			while (result < value)
+			{
+				result *= 2;
+			}
+			return result;
+		}
+	}
+
+	struct timer_wheel::shard
+	{
+		boost::mutex mutex;
+
+		//signalled when the handler of an expired timer has returned
+		boost::condition_variable fired;
+
+		boost::uint64_t current_tick;
+		std::size_t size;
+		std::vector<wheel_timer *> slots;
+
+		//keeps the next shard off the cache line of the mutex
+		char padding[64];
+
+		shard()
+		    : current_tick(0)
+		    , size(0)
+		{
+		}
+	};
+
+	timer_wheel::timer_wheel(clock::duration tick,
+	                         std::size_t slot_count,
+	                         clock::time_point now,
+	                         unsigned shard_count)
+	    : m_tick(tick)
+	    , m_origin(now)
+	    , m_mask(round_up_to_power_of_two((std::max)(slot_count, std::size_t(1))) - 1)
+	    , m_shard_count((std::max)(shard_count, 1u))
+	    , m_shards(new shard[m_shard_count])
+	{
+		assert(tick > clock::duration::zero());
+		for (unsigned i = 0; i < m_shard_count; ++i)
+		{
+			m_shards[i].slots.resize(m_mask + 1, static_cast<wheel_timer *>(0));
+		}
+	}
+
+	timer_wheel::~timer_wheel()
+	{
+		//the timers refer to their wheel
+		assert(size() == 0);
+	}
+
+	timer_wheel::clock::duration timer_wheel::tick() const
+	{
+		return m_tick;
+	}
+
+	std::size_t timer_wheel::advance(clock::time_point now)
+	{
+		std::size_t called = 0;
+		for (unsigned i = 0; i < m_shard_count; ++i)
+		{
+			called += advance(m_shards[i], now);
+		}
+		return called;
+	}
+
+	std::size_t timer_wheel::size() const
+	{
+		std::size_t sum = 0;
+		for (unsigned i = 0; i < m_shard_count; ++i)
+		{
+			shard &shard = m_shards[i];
+			boost::mutex::scoped_lock const lock(shard.mutex);
+			sum += shard.size;
+		}
+		return sum;
+	}
+
+	timer_wheel::shard &timer_wheel::local_shard() const
+	{
+		return m_shards[thread_index() % m_shard_count];
+	}
+
+	std::size_t timer_wheel::advance(shard &shard, clock::time_point now)
+	{
+		if (now < m_origin)
+		{
+			return 0;
+		}
+		boost::uint64_t const target = static_cast<boost::uint64_t>((now - m_origin) / m_tick);
+
+		//The expired timers are unlinked with the lock held and their
+		//handlers are called without it, so that a slow handler does not
+		//block the threads which start and stop timers.
+		wheel_timer *expired = 0;
+		wheel_timer **last_expired = &expired;
+		std::size_t called = 0;
+		{
+			boost::mutex::scoped_lock const lock(shard.mutex);
+			if (target <= shard.current_tick)
+			{
+				return 0;
+			}
+
+			//After a long pause every slot is visited once. The timers which
+			//are restarted by their handlers expire after the new current
+			//tick.
+			boost::uint64_t const previous = shard.current_tick;
+			boost::uint64_t const steps = (std::min)(target - previous,
+			                                         static_cast<boost::uint64_t>(shard.slots.size()));
+			shard.current_tick = target;
+			for (boost::uint64_t step = 1; step <= steps; ++step)
+			{
+				wheel_timer *timer = shard.slots[static_cast<std::size_t>((previous + step) & m_mask)];
+				while (timer)
+				{
+					wheel_timer * const next = timer->m_next;
+
+					//a timer whose handler is still running from a concurrent
+					//advance is left for the next turn
+					if ((timer->m_expiry_tick <= target) && !timer->m_firing)
+					{
+						unlink(shard, *timer);
+						timer->m_firing = true;
+						timer->m_touched = false;
+						*last_expired = timer;
+						last_expired = &timer->m_next_expired;
+						++called;
+					}
+					timer = next;
+				}
+			}
+		}
+
+		while (expired)
+		{
+			wheel_timer &timer = *expired;
+			expired = timer.m_next_expired;
+			bool const restart = timer.m_on_expired();
+
+			boost::mutex::scoped_lock const lock(shard.mutex);
+			if (restart && !timer.m_touched)
+			{
+				start(shard, timer, now);
+			}
+			timer.m_firing = false;
+			timer.m_next_expired = 0;
+
+			//a stop may be waiting to destroy the timer
+			shard.fired.notify_all();
+		}
+		return called;
+	}
+
+	void timer_wheel::start(shard &shard, wheel_timer &timer, clock::time_point now)
+	{
+		if (timer.m_running)
+		{
+			unlink(shard, timer);
+		}
+		//rounded up, so that a timer never expires early
+		clock::duration const from_origin = (std::max)(now - m_origin, clock::duration::zero()) + timer.m_timeout;
+		boost::uint64_t const expiry_tick =
+		        static_cast<boost::uint64_t>((from_origin + m_tick - clock::duration(1)) / m_tick);
+		link(shard, timer, (std::max)(expiry_tick, shard.current_tick + 1));
+	}
+
+	void timer_wheel::link(shard &shard, wheel_timer &timer, boost::uint64_t expiry_tick)
+	{
+		assert(!timer.m_running);
+		wheel_timer *&head = shard.slots[static_cast<std::size_t>(expiry_tick & m_mask)];
+		timer.m_expiry_tick = expiry_tick;
+		timer.m_running = true;
+		timer.m_previous = 0;
+		timer.m_next = head;
+		if (head)
+		{
+			head->m_previous = &timer;
+		}
+		head = &timer;
+		++shard.size;
+	}
+
+	void timer_wheel::unlink(shard &shard, wheel_timer &timer)
+	{
+		assert(timer.m_running);
+		if (timer.m_previous)
+		{
+			timer.m_previous->m_next = timer.m_next;
+		}
+		else
+		{
+			shard.slots[static_cast<std::size_t>(timer.m_expiry_tick & m_mask)] = timer.m_next;
+		}
+		if (timer.m_next)
+		{
+			timer.m_next->m_previous = timer.m_previous;
+		}
+		timer.m_running = false;
+		timer.m_previous = 0;
+		timer.m_next = 0;
+		--shard.size;
+	}
+
+	wheel_timer::wheel_timer(timer_wheel *wheel, expiry_handler on_expired)
+	    : m_wheel(wheel)
+	    , m_shard(wheel ? &wheel->local_shard() : 0)
+	    , m_on_expired(boost::move(on_expired))
+	    , m_timeout(timer_wheel::clock::duration::zero())
+	    , m_expiry_tick(0)
+	    , m_running(false)
+	    , m_previous(0)
+	    , m_next(0)
+	    , m_firing(false)
+	    , m_touched(false)
+	    , m_next_expired(0)
+	{
+	}
+
+	wheel_timer::~wheel_timer()
+	{
+		stop();
+	}
+
+	void wheel_timer::start(timer_wheel::clock::duration timeout,
+	                        timer_wheel::clock::time_point now)
+	{
+		if (!m_wheel)
+		{
+			return;
+		}
+		boost::mutex::scoped_lock const lock(m_shard->mutex);
+		m_timeout = timeout;
+		m_touched = true;
+		m_wheel->start(*m_shard, *this, now);
+	}
+
+	void wheel_timer::stop()
+	{
+		if (!m_wheel)
+		{
+			return;
+		}
+		boost::mutex::scoped_lock lock(m_shard->mutex);
+		if (m_running)
+		{
+			m_wheel->unlink(*m_shard, *this);
+		}
+		m_touched = true;
+		while (m_firing)
+		{
+			m_shard->fired.wait(lock);
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#ifndef TEMPEST_TIMER_WHEEL_HPP
+#define TEMPEST_TIMER_WHEEL_HPP
+
+
+#include <tempest/config.hpp>
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+
+namespace tempest
+{
+	struct wheel_timer;
+
+	//A hashed timing wheel: a timer is linked into the slot of the tick in
+	//which it expires, so starting and stopping one costs O(1) however
+	//many there are. A timer which expires more than a turn ahead stays in
+	//its slot for several turns. Timers expire at the first tick at or
+	//after their deadline, so the resolution is one tick.
+	//The wheel does not wait by itself. Its owner calls advance about once
+	//per tick, so that a whole server needs a single system timer. Every
+	//method can be called from any thread.
+	//The wheel consists of shards with a lock of their own. A timer belongs
+	//to the shard of the thread which has created it, so worker threads
+	//which start and stop the timers of their connections rarely wait for
+	//each other.
+	struct timer_wheel TEMPEST_FINAL : boost::noncopyable
+	{
+		typedef boost::chrono::steady_clock clock;
+
+		explicit timer_wheel(clock::duration tick = boost::chrono::milliseconds(100),
+		                     std::size_t slot_count = 1024,
+		                     clock::time_point now = clock::now(),
+		                     unsigned shard_count = 16);
+
+		~timer_wheel();
+
+		clock::duration tick() const;
+
+		//Calls the handlers of the timers which have expired until now.
+		//Returns how many have been called.
+		std::size_t advance(clock::time_point now = clock::now());
+
+		//the number of running timers
+		std::size_t size() const;
+
+	private:
+
+		friend struct wheel_timer;
+
+		struct shard;
+
+		clock::duration const m_tick;
+		clock::time_point const m_origin;
+		std::size_t const m_mask;
+		unsigned const m_shard_count;
+		boost::scoped_array<shard> const m_shards;
+
+
+		shard &local_shard() const;
+		std::size_t advance(shard &shard, clock::time_point now);
+		void start(shard &shard, wheel_timer &timer, clock::time_point now);
+		void link(shard &shard, wheel_timer &timer, boost::uint64_t expiry_tick);
+		void unlink(shard &shard, wheel_timer &timer);
+	};
+
+	//A timeout in a timer_wheel. The handler is called by the thread which
+	//advances the wheel without holding a lock, so it may use the wheel
+	//and other timers, but it must not stop or destroy its own timer:
+	//stopping a timer waits for its running handler, and so does
+	//destroying it.
+	struct wheel_timer TEMPEST_FINAL : boost::noncopyable
+	{
+		//Returns true to start the timer again with the same timeout, for
+		//example when the awaited thing has made some progress. A timer
+		//which has been started or stopped while its handler was running
+		//keeps that state.
+		typedef boost::function<bool ()> expiry_handler;
+
+		//a timer without a wheel never expires
+		wheel_timer(timer_wheel *wheel, expiry_handler on_expired);
+		~wheel_timer();
+
+		//restarts the timer if it is running already
+		void start(timer_wheel::clock::duration timeout,
+		           timer_wheel::clock::time_point now = timer_wheel::clock::now());
+		void stop();
+
+	private:
+
+		friend struct timer_wheel;
+
+		timer_wheel * const m_wheel;
+		timer_wheel::shard * const m_shard;
+		expiry_handler const m_on_expired;
+		timer_wheel::clock::duration m_timeout;
+		boost::uint64_t m_expiry_tick;
+		bool m_running;
+		wheel_timer *m_previous;
+		wheel_timer *m_next;
+
+		//While the handler runs, the timer is in the list of expired timers
+		//of the advancing thread. A start or a stop meanwhile overrides
+		//what the handler returns.
+		bool m_firing;
+		bool m_touched;
+		wheel_timer *m_next_expired;
+	};
+}
+
+
+#endif
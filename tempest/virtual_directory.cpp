@@ -1,23 +1,66 @@
 #include "virtual_directory.hpp"
 #include "responses.hpp"
 #include "http/http_request.hpp"
-#include "http/http_response.hpp"
 #include <boost/move/move.hpp>
 
 
 namespace tempest
 {
-	virtual_directory::virtual_directory(sub_dir_mapping mapping)
+	virtual_directory::virtual_directory(sub_dir_mapping mapping,
+	                                     directory *fallback)
 	    : m_mapping(boost::move(mapping))
+	    , m_fallback(fallback)
 	{
 		assert(m_mapping);
 	}
 
 	void virtual_directory::respond(http_request const &request,
-	                                std::string const &sub_path,
+	                                boost::string_ref sub_path,
 	                                sender &sender)
 	{
-		std::string::const_iterator sub_dir_begin = sub_path.begin();
+		boost::string_ref rest;
+		directory * const sub_dir = find_sub_dir(sub_path, rest);
+		if (sub_dir)
+		{
+			return sub_dir->respond(request, rest, sender);
+		}
+		else if (m_fallback)
+		{
+			return m_fallback->respond(request, sub_path, sender);
+		}
+		else
+		{
+			return send_in_memory_response(
+			            make_not_found_response(request.file), sender);
+		}
+	}
+
+	void virtual_directory::async_respond(http_request const &request,
+	                                      boost::string_ref sub_path,
+	                                      async_sender &sender,
+	                                      response_handler handler)
+	{
+		boost::string_ref rest;
+		directory * const sub_dir = find_sub_dir(sub_path, rest);
+		if (sub_dir)
+		{
+			return sub_dir->async_respond(request, rest, sender, handler);
+		}
+		else if (m_fallback)
+		{
+			return m_fallback->async_respond(request, sub_path, sender, handler);
+		}
+		else
+		{
+			return async_send_in_memory_response(
+			            make_not_found_response(request.file), sender, handler);
+		}
+	}
+
+	directory *virtual_directory::find_sub_dir(boost::string_ref sub_path,
+	                                           boost::string_ref &rest) const
+	{
+		boost::string_ref::const_iterator sub_dir_begin = sub_path.begin();
 		if (sub_dir_begin != sub_path.end())
 		{
 			if (*sub_dir_begin == '/')
@@ -25,19 +68,15 @@ namespace tempest
 				++sub_dir_begin;
 			}
 		}
-		std::string::const_iterator const sub_dir_end =
+		boost::string_ref::const_iterator const sub_dir_end =
 		    std::find(sub_dir_begin, sub_path.end(), '/');
 		std::string const sub_dir_name(sub_dir_begin, sub_dir_end);
 		directory * const sub_dir = m_mapping(sub_dir_name);
 		if (sub_dir)
 		{
-			std::string const rest(sub_dir_end, sub_path.end());
-			return sub_dir->respond(request, rest, sender);
-		}
-		else
-		{
-			return send_in_memory_response(
-			            make_not_found_response(request.file), sender);
+			//the rest refers to the path of the request instead of a copy
+			rest = sub_path.substr(static_cast<std::size_t>(sub_dir_end - sub_path.begin()));
 		}
+		return sub_dir;
 	}
 }
@@ -13,14 +13,25 @@ namespace tempest
 	{
 		typedef boost::function<directory *(std::string const &)> sub_dir_mapping;
 
-		explicit virtual_directory(sub_dir_mapping mapping);
+		//The fallback gets the whole path of the requests whose first
+		//segment is not mapped. Without one they are answered with 404.
+		explicit virtual_directory(sub_dir_mapping mapping,
+		                           directory *fallback = 0);
 		virtual void respond(http_request const &request,
-		                     std::string const &sub_path,
+		                     boost::string_ref sub_path,
 		                     sender &sender) TEMPEST_OVERRIDE;
+		virtual void async_respond(http_request const &request,
+		                           boost::string_ref sub_path,
+		                           async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE;
 
 	private:
 
 		sub_dir_mapping const m_mapping;
+		directory * const m_fallback;
+
+		directory *find_sub_dir(boost::string_ref sub_path,
+		                        boost::string_ref &rest) const;
 	};
 }
 
@@ -1,62 +1,221 @@
-#include <http/http_request.hpp>
-#include <tempest/tcp_acceptor.hpp>
+#include <tempest/server.hpp>
+#include <tempest/access_log.hpp>
+#include <tempest/admission.hpp>
+#include <tempest/metrics.hpp>
+#include <tempest/metrics_directory.hpp>
 #include <tempest/portable_fs_directory.hpp>
+#include <tempest/posix/archive_directory.hpp>
 #include <tempest/posix/posix_fs_directory.hpp>
+#include <tempest/posix/uring_server.hpp>
+#include <tempest/router.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/signal_set.hpp>
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 #include <boost/program_options.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/make_shared.hpp>
+#include <csignal>
+#include <iostream>
 
 namespace tempest
 {
-	typedef
+	metric_sample make_sample(char const *name, char const *help, bool is_counter, double value)
+	{
+		metric_sample sample;
+		sample.name = name;
+		sample.help = help;
+		sample.is_counter = is_counter;
+		sample.value = value;
+		return sample;
+	}
+
 #if TEMPEST_USE_POSIX
-		posix::file_system_directory
-#else
-		portable::file_system_directory
+	void collect_content_cache(boost::shared_ptr<posix::content_cache> const &cache,
+							   std::vector<metric_sample> &samples)
+	{
+		posix::content_cache_statistics const statistics = cache->statistics();
+		samples.push_back(make_sample("tempest_content_cache_hits_total", "Files served from memory.",
+									  true, static_cast<double>(statistics.hits)));
+		samples.push_back(make_sample("tempest_content_cache_misses_total", "Files not found in memory.",
+									  true, static_cast<double>(statistics.misses)));
+		samples.push_back(make_sample("tempest_content_cache_evictions_total", "Files evicted from memory.",
+									  true, static_cast<double>(statistics.evictions)));
+		samples.push_back(make_sample("tempest_content_cache_bytes", "Bytes of files held in memory.",
+									  false, static_cast<double>(statistics.total_size)));
+	}
+
+	void collect_open_file_cache(boost::shared_ptr<posix::open_file_cache> const &cache,
+								 std::vector<metric_sample> &samples)
+	{
+		posix::open_file_cache_statistics const statistics = cache->statistics();
+		samples.push_back(make_sample("tempest_open_file_cache_hits_total", "Files which were open already.",
+									  true, static_cast<double>(statistics.hits)));
+		samples.push_back(make_sample("tempest_open_file_cache_misses_total", "Files which had to be opened.",
+									  true, static_cast<double>(statistics.misses)));
+		samples.push_back(make_sample("tempest_open_file_cache_missing_hits_total", "Requests for files remembered as missing.",
+									  true, static_cast<double>(statistics.missing_hits)));
+		samples.push_back(make_sample("tempest_open_file_cache_files", "File descriptors kept open.",
+									  false, static_cast<double>(statistics.open_files)));
+		samples.push_back(make_sample("tempest_open_file_cache_missing_paths", "Paths remembered as missing.",
+									  false, static_cast<double>(statistics.missing_paths)));
+	}
 #endif
-		optimal_file_system_directory;
 
-	void handle_request_threaded(boost::shared_ptr<abstract_client> client,
-								 boost::shared_ptr<directory> directory)
+	void collect_access_log(boost::shared_ptr<access_log> const &log,
+							std::vector<metric_sample> &samples)
+	{
+		samples.push_back(make_sample("tempest_access_log_dropped_total", "Records which did not fit into the log queue.",
+									  true, static_cast<double>(log->dropped())));
+	}
+
+	void collect_admission(boost::shared_ptr<admission_control> const &admission,
+						   std::vector<metric_sample> &samples)
 	{
-		assert(client);
-		assert(directory);
+		admission_statistics const statistics = admission->statistics();
+		samples.push_back(make_sample("tempest_shed_connections_total", "Connections answered with 503 because of the connection limit.",
+									  true, static_cast<double>(statistics.rejected_connections)));
+		samples.push_back(make_sample("tempest_shed_requests_total", "Requests answered with 503 because of the request limit.",
+									  true, static_cast<double>(statistics.rejected_requests)));
+		samples.push_back(make_sample("tempest_accept_pauses_total", "Times accepting was paused because the server was full.",
+									  true, static_cast<double>(statistics.accept_pauses)));
+		samples.push_back(make_sample("tempest_requests_in_flight", "Requests being responded to.",
+									  false, static_cast<double>(statistics.requests)));
+	}
 
-		//We have to catch exceptions before they propagate to
-		//boost::thread because that would terminate the whole process.
-		try
+	//Makes the directories of all the hosts. The caches are only available
+	//on POSIX. They are shared by the hosts because they are keyed by the
+	//full path anyway. Their statistics are added to the metrics if there
+	//are any.
+	struct file_system_factory
+	{
+		file_system_factory(bool portable,
+							file_size cache_size,
+							file_size max_cached_file_size,
+							std::size_t max_open_files,
+							metrics *metrics)
+			: m_portable(portable)
 		{
-			http_request request = parse_request(client->get_receiver().request());
-			directory->respond(request, request.file, client->get_sender());
+#if TEMPEST_USE_POSIX
+			if (portable)
+			{
+				return;
+			}
+			if (cache_size > 0)
+			{
+				posix::content_cache_options cache_options;
+				cache_options.max_total_size = cache_size;
+				cache_options.max_file_size = max_cached_file_size;
+				m_cache = boost::make_shared<posix::content_cache>(cache_options);
+				if (metrics)
+				{
+					metrics->add_collector(boost::bind(collect_content_cache, m_cache, _1));
+				}
+			}
+			if (max_open_files > 0)
+			{
+				posix::open_file_cache_options open_file_options;
+				open_file_options.max_open_files = max_open_files;
+				m_open_files = boost::make_shared<posix::open_file_cache>(open_file_options);
+				if (metrics)
+				{
+					metrics->add_collector(boost::bind(collect_open_file_cache, m_open_files, _1));
+				}
+			}
+#else
+			(void)cache_size;
+			(void)max_cached_file_size;
+			(void)max_open_files;
+			(void)metrics;
+#endif
+		}
 
-			client->shutdown();
+		boost::shared_ptr<directory> make(boost::filesystem::path const &dir) const
+		{
+#if TEMPEST_USE_POSIX
+			if (!m_portable)
+			{
+				return boost::make_shared<posix::file_system_directory>(dir, m_cache, m_open_files);
+			}
+#endif
+			return boost::make_shared<portable::file_system_directory>(dir);
 		}
-		catch (std::exception const &ex)
+
+	private:
+
+		bool const m_portable;
+#if TEMPEST_USE_POSIX
+		boost::shared_ptr<posix::content_cache> m_cache;
+		boost::shared_ptr<posix::open_file_cache> m_open_files;
+#endif
+	};
+
+	//"example.com=/srv/example" is served from /srv/example for the
+	//requests with that Host
+	bool parse_virtual_host(std::string const &option,
+							std::string &host,
+							boost::filesystem::path &dir)
+	{
+		std::size_t const equals = option.find('=');
+		if ((equals == std::string::npos) ||
+			(equals == 0) ||
+			(equals + 1 == option.size()))
 		{
-			std::cerr << ex.what() << '\n';
+			return false;
 		}
+		host = option.substr(0, equals);
+		dir = boost::filesystem::absolute(option.substr(equals + 1));
+		return true;
 	}
 
-	void handle_client(tcp_acceptor::client_ptr &client,
-					   boost::shared_ptr<directory> directory)
+	//SIGUSR1 writes the metrics as JSON to stderr, SIGHUP reopens the access
+	//log after it has been rotated
+	void handle_signal(boost::asio::signal_set &signals,
+					   server_options const &options,
+					   boost::system::error_code error,
+					   int signal_number)
 	{
-		boost::shared_ptr<abstract_client> const shared_client =
-			movable_ptr<abstract_client>::to_shared(client);
-		boost::thread client_thread(handle_request_threaded,
-									shared_client, directory);
-		client_thread.detach();
+		if (error)
+		{
+			return;
+		}
+#ifdef SIGUSR1
+		if ((signal_number == SIGUSR1) && options.metrics)
+		{
+			std::string dumped;
+			write_json(options.metrics->snapshot(), dumped);
+			std::cerr << dumped << '\n';
+		}
+#endif
+#ifdef SIGHUP
+		if ((signal_number == SIGHUP) && options.access_log)
+		{
+			options.access_log->reopen();
+		}
+#endif
+		(void)signal_number;
+		signals.async_wait(boost::bind(handle_signal, boost::ref(signals), boost::cref(options), _1, _2));
 	}
 
-	void run_file_server(boost::uint16_t port,
-						 boost::shared_ptr<directory> directory)
+	//Falls back to the io_service if io_uring is not available. The options
+	//need an error log.
+	void run_optimal_server(boost::uint16_t port,
+							boost::shared_ptr<directory> directory,
+							server_options const &options,
+							bool prefer_io_uring)
 	{
-		boost::asio::io_service io_service;
-		tcp_acceptor acceptor(port,
-							  boost::bind(handle_client, _1, directory),
-							  io_service);
-		io_service.run();
+		if (prefer_io_uring)
+		{
+#if TEMPEST_USE_IO_URING
+			if (posix::is_uring_available())
+			{
+				return posix::run_uring_server(port, directory, options);
+			}
+#endif
+			options.error_log->log_error("io_uring is not available, using the default backend");
+		}
+		run_server(port, directory, options);
 	}
 }
 
@@ -66,6 +225,20 @@ int main(int argc, char **argv)
 {
 	boost::uint16_t port = 8080;
 	std::string served_directory;
+	std::string served_archive;
+	std::vector<std::string> virtual_hosts;
+	tempest::server_options server_options;
+	server_options.thread_count = std::max(1u, boost::thread::hardware_concurrency());
+	unsigned keep_alive_seconds = static_cast<unsigned>(server_options.keep_alive_timeout.total_seconds());
+	unsigned header_seconds = static_cast<unsigned>(server_options.header_timeout.total_seconds());
+	unsigned send_seconds = static_cast<unsigned>(server_options.send_timeout.total_seconds());
+	unsigned body_seconds = static_cast<unsigned>(server_options.body_timeout.total_seconds());
+	tempest::file_size cache_size_mib = 0;
+	tempest::file_size max_cached_file_kib = 256;
+	std::size_t max_open_files = 1024;
+	tempest::access_log_options access_log_options;
+	tempest::admission_options admission_options;
+	std::string overload_policy = "pause";
 
 	po::options_description options("Tempest web server options");
 	options.add_options()
@@ -74,7 +247,55 @@ int main(int argc, char **argv)
 		("port", po::value(&port), ("the port to listen on (default: " +
 									boost::lexical_cast<std::string>(port) + ")").c_str())
 		("dir", po::value(&served_directory), "the directory accessible to clients")
+		("archive", po::value(&served_archive), "serve an archive written by tempest-pack instead of a directory")
+		("vhost", po::value(&virtual_hosts),
+		 "serve the requests for a Host from another directory like example.com=/srv/example, can be repeated")
 		("portable", "avoid possibly platform-specific system calls")
+		("threads", po::value(&server_options.thread_count), ("the number of worker threads handling clients (default: " +
+															  boost::lexical_cast<std::string>(server_options.thread_count) + ")").c_str())
+		("max-requests", po::value(&server_options.max_requests_per_connection),
+		 ("the maximum number of requests per connection (default: " +
+		  boost::lexical_cast<std::string>(server_options.max_requests_per_connection) + ")").c_str())
+		("keep-alive-timeout", po::value(&keep_alive_seconds),
+		 ("seconds an idle persistent connection is kept open (default: " +
+		  boost::lexical_cast<std::string>(keep_alive_seconds) + ")").c_str())
+		("header-timeout", po::value(&header_seconds),
+		 ("seconds the head of a request may take after its first byte (default: " +
+		  boost::lexical_cast<std::string>(header_seconds) + ")").c_str())
+		("send-timeout", po::value(&send_seconds),
+		 ("seconds a response may make no progress (default: " +
+		  boost::lexical_cast<std::string>(send_seconds) + ")").c_str())
+		("body-timeout", po::value(&body_seconds),
+		 ("seconds the body of a request may make no progress (default: " +
+		  boost::lexical_cast<std::string>(body_seconds) + ")").c_str())
+		("max-body-size", po::value(&server_options.max_body_size),
+		 ("the maximum number of bytes in the body of a request (default: " +
+		  boost::lexical_cast<std::string>(server_options.max_body_size) + ")").c_str())
+		("cache-size", po::value(&cache_size_mib),
+		 "MiB of small files kept in memory, 0 disables the cache (default: 0)")
+		("cache-max-file", po::value(&max_cached_file_kib),
+		 ("KiB up to which a file is cached (default: " +
+		  boost::lexical_cast<std::string>(max_cached_file_kib) + ")").c_str())
+		("open-files", po::value(&max_open_files),
+		 ("files kept open between requests, 0 disables reuse (default: " +
+		  boost::lexical_cast<std::string>(max_open_files) + ")").c_str())
+		("io-uring", "handle the connections with io_uring if the kernel supports it (Linux 5.7)")
+		("metrics", "serve metrics at /_tempest/metrics and write them as JSON to stderr on SIGUSR1")
+		("access-log", po::value(&access_log_options.path),
+		 "append a line for every response to this file, reopened on SIGHUP")
+		("access-log-format", po::value(&access_log_options.format),
+		 ("%t date, %m method, %U path, %s status, %b bytes, %D microseconds (default: " +
+		  access_log_options.format + ")").c_str())
+		("access-log-binary", "write compact binary records instead of lines")
+		("max-connections", po::value(&admission_options.max_connections),
+		 "the maximum number of open connections, 0 for no limit (default: 0)")
+		("max-in-flight", po::value(&admission_options.max_requests),
+		 "the maximum number of requests responded to at the same time, 0 for no limit (default: 0)")
+		("overload", po::value(&overload_policy),
+		 "what happens to connections over the limit: pause (leave them in the backlog) or reject (answer 503) (default: pause)")
+		("retry-after", po::value(&admission_options.retry_after_seconds),
+		 ("the Retry-After seconds of a 503 response (default: " +
+		  boost::lexical_cast<std::string>(admission_options.retry_after_seconds) + ")").c_str())
 		;
 
 	po::positional_options_description positions;
@@ -98,26 +319,144 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
-	if (!variables.count("dir"))
+	if (!variables.count("dir") && !variables.count("archive") && virtual_hosts.empty())
 	{
-		std::cout << "'dir' argument required\n\n";
+		std::cout << "'dir', 'archive' or 'vhost' argument required\n\n";
 		std::cout << options << '\n';
 		return 1;
 	}
 
-	bool const favor_portability = variables.count("portable") > 0;
-	boost::filesystem::path const served_directory_absolute =
-		boost::filesystem::absolute(served_directory);
+	if (server_options.thread_count < 1)
+	{
+		std::cout << "'threads' has to be at least 1\n";
+		return 1;
+	}
+
+	if (server_options.max_requests_per_connection < 1)
+	{
+		std::cout << "'max-requests' has to be at least 1\n";
+		return 1;
+	}
+
+	server_options.keep_alive_timeout = boost::posix_time::seconds(keep_alive_seconds);
+	server_options.header_timeout = boost::posix_time::seconds(header_seconds);
+	server_options.send_timeout = boost::posix_time::seconds(send_seconds);
+	server_options.body_timeout = boost::posix_time::seconds(body_seconds);
 
-	boost::shared_ptr<tempest::directory> directory_handler;
-	if (favor_portability)
+	if (overload_policy == "pause")
+	{
+		admission_options.policy = tempest::pause_policy;
+	}
+	else if (overload_policy == "reject")
 	{
-		directory_handler = boost::make_shared<tempest::portable::file_system_directory>(served_directory_absolute);
+		admission_options.policy = tempest::reject_policy;
 	}
 	else
 	{
-		directory_handler = boost::make_shared<tempest::optimal_file_system_directory>(served_directory_absolute);
+		std::cout << "'overload' has to be pause or reject\n";
+		return 1;
 	}
 
-	tempest::run_file_server(port, directory_handler);
-}
+	if (variables.count("metrics"))
+	{
+		server_options.metrics = boost::make_shared<tempest::metrics>();
+	}
+
+	//errors are written by a background thread like the access log, so
+	//that they cannot block the handling of requests
+	server_options.error_log = boost::make_shared<tempest::access_log>(tempest::access_log_options());
+	if (variables.count("access-log"))
+	{
+		access_log_options.binary = variables.count("access-log-binary") > 0;
+		server_options.access_log = boost::make_shared<tempest::access_log>(access_log_options);
+		if (server_options.metrics)
+		{
+			server_options.metrics->add_collector(boost::bind(tempest::collect_access_log, server_options.access_log, _1));
+		}
+	}
+
+	if (admission_options.max_connections || admission_options.max_requests)
+	{
+		server_options.admission = boost::make_shared<tempest::admission_control>(admission_options);
+		if (server_options.metrics)
+		{
+			server_options.metrics->add_collector(boost::bind(tempest::collect_admission, server_options.admission, _1));
+		}
+	}
+
+	tempest::file_system_factory const files(
+		variables.count("portable") > 0,
+		cache_size_mib * 1024 * 1024,
+		max_cached_file_kib * 1024,
+		max_open_files,
+		server_options.metrics.get());
+
+	//the directory or the archive serve the hosts without a vhost
+	boost::shared_ptr<tempest::route_table> const routes = boost::make_shared<tempest::route_table>();
+	std::vector<std::string> hosts(1);
+	if (variables.count("archive"))
+	{
+#if TEMPEST_USE_POSIX
+		routes->add("", "/", tempest::prefix_match,
+					boost::make_shared<tempest::posix::archive_directory>(served_archive));
+#else
+		std::cout << "'archive' is only available on POSIX\n";
+		return 1;
+#endif
+	}
+	else if (variables.count("dir"))
+	{
+		routes->add("", "/", tempest::prefix_match,
+					files.make(boost::filesystem::absolute(served_directory)));
+	}
+	BOOST_FOREACH (std::string const &option, virtual_hosts)
+	{
+		std::string host;
+		boost::filesystem::path dir;
+		if (!tempest::parse_virtual_host(option, host, dir))
+		{
+			std::cout << "'vhost' has to be a host and a directory like example.com=/srv/example\n";
+			return 1;
+		}
+		routes->add(host, "/", tempest::prefix_match, files.make(dir));
+		hosts.push_back(host);
+	}
+
+	if (server_options.metrics)
+	{
+		boost::shared_ptr<tempest::directory> const metrics_handler =
+			boost::make_shared<tempest::metrics_directory>(server_options.metrics);
+		BOOST_FOREACH (std::string const &host, hosts)
+		{
+			routes->add(host, "/_tempest/metrics", tempest::exact_match, metrics_handler);
+		}
+	}
+	boost::shared_ptr<tempest::directory> const root = boost::make_shared<tempest::router>(routes);
+
+#ifdef SIGPIPE
+	//Files are sent with sendfile which cannot suppress SIGPIPE like send
+	//does. A client which disappears during a response, or which is cut
+	//off by the send timeout, must not end the server.
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	//the signals are waited for in a thread of their own so that it works
+	//with every backend
+	boost::asio::io_service signal_service;
+	boost::asio::signal_set signals(signal_service);
+#ifdef SIGUSR1
+	signals.add(SIGUSR1);
+#endif
+#ifdef SIGHUP
+	signals.add(SIGHUP);
+#endif
+	signals.async_wait(boost::bind(tempest::handle_signal, boost::ref(signals),
+								   boost::cref(server_options), _1, _2));
+	boost::thread signal_thread(boost::bind(&boost::asio::io_service::run, &signal_service));
+
+	tempest::run_optimal_server(port, root, server_options,
+								variables.count("io-uring") > 0);
+
+	signal_service.stop();
+	signal_thread.join();
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/access_log.hpp"
+#include "tempest/bounded_queue.hpp"
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/thread.hpp>
+#include <iterator>
+
+namespace
+{
+	void push_numbers(tempest::bounded_queue<unsigned> *queue, unsigned first, unsigned count)
+	{
+		for (unsigned i = first; i < first + count; )
+		{
+			if (queue->try_push(i))
+			{
+				++i;
+			}
+			else
+			{
+				boost::this_thread::yield();
+			}
+		}
+	}
+
+	std::string read_file(boost::filesystem::path const &file)
+	{
+		boost::filesystem::ifstream stream(file, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(stream),
+		                   std::istreambuf_iterator<char>());
+	}
+
+	boost::filesystem::path make_temporary_path()
+	{
+		return boost::filesystem::temp_directory_path() /
+		       boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%.log");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_single_thread)
+{
+	tempest::bounded_queue<int> queue(3);
+	BOOST_CHECK_EQUAL(queue.capacity(), 4u);
+
+	int value = 0;
+	BOOST_CHECK(!queue.try_pop(value));
+	for (int i = 0; i < 4; ++i)
+	{
+		BOOST_CHECK(queue.try_push(i));
+	}
+	BOOST_CHECK(!queue.try_push(4));
+	for (int i = 0; i < 4; ++i)
+	{
+		BOOST_REQUIRE(queue.try_pop(value));
+		BOOST_CHECK_EQUAL(value, i);
+	}
+	BOOST_CHECK(!queue.try_pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_producers)
+{
+	tempest::bounded_queue<unsigned> queue(64);
+	unsigned const per_thread = 5000;
+	boost::thread_group producers;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		producers.create_thread(boost::bind(push_numbers, &queue, i * per_thread, per_thread));
+	}
+
+	//every number arrives exactly once
+	std::vector<bool> seen(4 * per_thread);
+	for (std::size_t received = 0; received < seen.size(); )
+	{
+		unsigned value;
+		if (queue.try_pop(value))
+		{
+			BOOST_REQUIRE_LT(value, seen.size());
+			BOOST_REQUIRE(!seen[value]);
+			seen[value] = true;
+			++received;
+		}
+		else
+		{
+			boost::this_thread::yield();
+		}
+	}
+	producers.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(access_log_text_format)
+{
+	boost::filesystem::path const file = make_temporary_path();
+	{
+		tempest::access_log_options options;
+		options.path = file.string();
+		options.format = "%m %U %s %b 100%%";
+		tempest::access_log log(options);
+		log.log_request("GET", "/a b\n\"", 200, 123, boost::chrono::milliseconds(2));
+		log.log_error("failed");
+	}
+	std::string const written = read_file(file);
+	BOOST_CHECK_EQUAL(written.substr(0, written.find('\n') + 1),
+	                  "GET /a b\\x0a\\x22 200 123 100%\n");
+	BOOST_CHECK(written.find(" error: failed\n") != std::string::npos);
+	boost::filesystem::remove(file);
+
+	tempest::access_log_options invalid;
+	invalid.format = "%x";
+	BOOST_CHECK_THROW(tempest::access_log log(invalid), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(access_log_binary)
+{
+	boost::filesystem::path const file = make_temporary_path();
+	{
+		tempest::access_log_options options;
+		options.path = file.string();
+		options.binary = true;
+		tempest::access_log log(options);
+		log.log_request("GET", "/x", 404, 0x0102, boost::chrono::nanoseconds(7));
+	}
+	std::string const written = read_file(file);
+	BOOST_REQUIRE_EQUAL(written.size(), 32u + 3u + 2u);
+	BOOST_CHECK_EQUAL(written[0], 0);
+	BOOST_CHECK_EQUAL(written[1], 3);
+	BOOST_CHECK_EQUAL(written[2], 2);
+	BOOST_CHECK_EQUAL(static_cast<unsigned char>(written[4]) + 256 * static_cast<unsigned char>(written[5]), 404);
+	BOOST_CHECK_EQUAL(written[16], 7);
+	BOOST_CHECK_EQUAL(written[24], 2);
+	BOOST_CHECK_EQUAL(written[25], 1);
+	BOOST_CHECK_EQUAL(written.substr(32), "GET/x");
+	boost::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(access_log_drops_and_reports)
+{
+	boost::filesystem::path const file = make_temporary_path();
+	boost::uint64_t dropped = 0;
+	{
+		tempest::access_log_options options;
+		options.path = file.string();
+		options.format = "%U";
+		options.capacity = 2;
+		options.idle_interval = boost::chrono::milliseconds(10000);
+		tempest::access_log log(options);
+		for (unsigned i = 0; i < 100; ++i)
+		{
+			log.log_request("GET", "/", 200, 0, boost::chrono::nanoseconds(0));
+		}
+		dropped = log.dropped();
+	}
+	BOOST_CHECK_GT(dropped, 0u);
+
+	std::string const written = read_file(file);
+	std::size_t written_records = 0;
+	for (std::size_t i = 0; (i = written.find("/\n", i)) != std::string::npos; ++i)
+	{
+		++written_records;
+	}
+	BOOST_CHECK_EQUAL(written_records + dropped, 100u);
+	BOOST_CHECK(written.find("records have been dropped") != std::string::npos);
+	boost::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(access_log_reopen)
+{
+	boost::filesystem::path const file = make_temporary_path();
+	boost::filesystem::path rotated = file;
+	rotated += ".1";
+	{
+		tempest::access_log_options options;
+		options.path = file.string();
+		options.format = "%U";
+		options.idle_interval = boost::chrono::milliseconds(1);
+		tempest::access_log log(options);
+		log.log_request("GET", "/old", 200, 0, boost::chrono::nanoseconds(0));
+		while (read_file(file).empty())
+		{
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+		}
+		boost::filesystem::rename(file, rotated);
+		log.reopen();
+		log.log_request("GET", "/new", 200, 0, boost::chrono::nanoseconds(0));
+	}
+	BOOST_CHECK_EQUAL(read_file(rotated), "/old\n");
+	BOOST_CHECK_EQUAL(read_file(file), "/new\n");
+	boost::filesystem::remove(file);
+	boost::filesystem::remove(rotated);
+}
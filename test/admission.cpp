@@ -0,0 +1,130 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/admission.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/portable_fs_directory.hpp"
+#include "tempest/server.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+
+namespace
+{
+	//serves one request for /a.txt and returns the output
+	std::string serve_one(boost::shared_ptr<tempest::admission_control> admission)
+	{
+		boost::filesystem::path const dir = boost::filesystem::temp_directory_path() /
+		        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+		boost::filesystem::create_directories(dir);
+		{
+			boost::filesystem::ofstream file(dir / "a.txt", std::ios::binary);
+			file << "abc";
+		}
+
+		tempest::server_options options;
+		options.admission = admission;
+		boost::shared_ptr<tempest::memory_client> const client =
+		        boost::make_shared<tempest::memory_client>();
+		client->feed("GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n");
+		tempest::serve_client(client,
+		                      boost::make_shared<tempest::portable::file_system_directory>(dir),
+		                      options);
+		client->poll();
+
+		boost::filesystem::remove_all(dir);
+		return std::string(client->output().begin(), client->output().end());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(admission_control_limits)
+{
+	tempest::admission_options options;
+	options.max_connections = 2;
+	options.max_requests = 1;
+	options.policy = tempest::reject_policy;
+	tempest::admission_control admission(options);
+
+	BOOST_CHECK(!admission.should_pause());
+	BOOST_CHECK(admission.try_open_connection());
+	BOOST_CHECK(admission.try_open_connection());
+	BOOST_CHECK(!admission.try_open_connection());
+	admission.close_connection();
+	BOOST_CHECK(admission.try_open_connection());
+
+	BOOST_CHECK(admission.try_begin_request());
+	BOOST_CHECK(!admission.try_begin_request());
+	admission.end_request();
+	BOOST_CHECK(admission.try_begin_request());
+
+	//rejecting servers never pause
+	BOOST_CHECK(!admission.should_pause());
+
+	tempest::admission_statistics const statistics = admission.statistics();
+	BOOST_CHECK_EQUAL(statistics.connections, 2u);
+	BOOST_CHECK_EQUAL(statistics.requests, 1u);
+	BOOST_CHECK_EQUAL(statistics.rejected_connections, 1u);
+	BOOST_CHECK_EQUAL(statistics.rejected_requests, 1u);
+
+	std::string const rejection(boost::asio::buffer_cast<char const *>(admission.rejection()),
+	                            boost::asio::buffer_size(admission.rejection()));
+	BOOST_CHECK_EQUAL(rejection.compare(0, 32, "HTTP/1.1 503 Service Unavailable"), 0);
+	BOOST_CHECK(rejection.find("\r\nRetry-After: 1\r\n") != std::string::npos);
+	BOOST_CHECK(rejection.find("\r\nConnection: close\r\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(admission_control_pauses)
+{
+	tempest::admission_options options;
+	options.max_connections = 1;
+	options.max_requests = 1;
+	tempest::admission_control admission(options);
+
+	//the acceptor has checked the limit already
+	BOOST_CHECK(admission.try_open_connection());
+	BOOST_CHECK(admission.should_pause());
+	BOOST_CHECK(admission.try_open_connection());
+	admission.close_connection();
+	admission.close_connection();
+	BOOST_CHECK(!admission.should_pause());
+
+	BOOST_CHECK(admission.try_begin_request());
+	BOOST_CHECK(admission.should_pause());
+	admission.end_request();
+	BOOST_CHECK(!admission.should_pause());
+	BOOST_CHECK_EQUAL(admission.statistics().rejected_connections, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(admission_rejects_with_503)
+{
+	tempest::admission_options options;
+	options.max_connections = 1;
+	options.max_requests = 1;
+	options.policy = tempest::reject_policy;
+	options.retry_after_seconds = 7;
+	boost::shared_ptr<tempest::admission_control> const admission =
+	        boost::make_shared<tempest::admission_control>(options);
+
+	//below the limits the request is served and everything is released
+	std::string output = serve_one(admission);
+	BOOST_CHECK_EQUAL(output.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+	BOOST_CHECK_EQUAL(admission->statistics().connections, 0u);
+	BOOST_CHECK_EQUAL(admission->statistics().requests, 0u);
+
+	//all requests are busy
+	BOOST_REQUIRE(admission->try_begin_request());
+	output = serve_one(admission);
+	BOOST_CHECK_EQUAL(output.compare(0, 12, "HTTP/1.1 503"), 0);
+	BOOST_CHECK(output.find("\r\nRetry-After: 7\r\n") != std::string::npos);
+	BOOST_CHECK_EQUAL(admission->statistics().rejected_requests, 1u);
+	admission->end_request();
+
+	//all connections are busy
+	BOOST_REQUIRE(admission->try_open_connection());
+	output = serve_one(admission);
+	BOOST_CHECK_EQUAL(output.compare(0, 12, "HTTP/1.1 503"), 0);
+	BOOST_CHECK_EQUAL(admission->statistics().rejected_connections, 1u);
+	BOOST_CHECK_EQUAL(admission->statistics().rejected_requests, 1u);
+	admission->close_connection();
+
+	BOOST_CHECK_EQUAL(admission->statistics().connections, 0u);
+	BOOST_CHECK_EQUAL(admission->statistics().requests, 0u);
+}
@@ -0,0 +1,121 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/archive.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/server.hpp"
+#include "tempest/posix/archive_directory.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <set>
+
+BOOST_AUTO_TEST_CASE(perfect_hash_is_minimal_and_perfect)
+{
+	std::vector<std::string> keys;
+	for (unsigned i = 0; i < 20000; ++i)
+	{
+		keys.push_back("static/" + boost::lexical_cast<std::string>(i) + ".css");
+	}
+	std::vector<std::size_t> slots;
+	std::vector<boost::int32_t> const seeds = tempest::build_perfect_hash(keys, slots);
+	BOOST_REQUIRE_EQUAL(seeds.size(), keys.size());
+
+	//every key has a slot of its own which the lookup finds again
+	std::set<std::size_t> const distinct(slots.begin(), slots.end());
+	BOOST_CHECK_EQUAL(distinct.size(), keys.size());
+	BOOST_CHECK(*distinct.rbegin() < keys.size());
+	for (std::size_t i = 0; i < keys.size(); ++i)
+	{
+		BOOST_REQUIRE_EQUAL(tempest::find_perfect_hash_slot(&seeds[0], seeds.size(), keys[i]), slots[i]);
+	}
+	BOOST_CHECK(tempest::find_perfect_hash_slot(&seeds[0], seeds.size(), "unknown") < keys.size());
+
+	std::vector<std::string> const none;
+	BOOST_CHECK(tempest::build_perfect_hash(none, slots).empty());
+}
+
+#if TEMPEST_USE_POSIX
+namespace
+{
+	void write_file(boost::filesystem::path const &file, std::string const &content)
+	{
+		boost::filesystem::ofstream out(file, std::ios::binary);
+		out << content;
+	}
+
+	std::string serve(boost::shared_ptr<tempest::directory> const &served, std::string const &request)
+	{
+		boost::shared_ptr<tempest::memory_client> const client =
+		        boost::make_shared<tempest::memory_client>();
+		client->feed(request);
+		tempest::serve_client(client, served, tempest::server_options());
+		client->poll();
+		return std::string(client->output().begin(), client->output().end());
+	}
+
+	std::string body_of(std::string const &response)
+	{
+		std::size_t const end_of_header = response.find("\r\n\r\n");
+		return (end_of_header == std::string::npos) ? std::string() : response.substr(end_of_header + 4);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(archive_directory_serves_packed_files)
+{
+	boost::filesystem::path const dir = boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	boost::filesystem::create_directories(dir / "site" / "css");
+	write_file(dir / "site" / "index.html", "<p>hello</p>");
+	write_file(dir / "site" / "css" / "site.css", "body{}");
+	write_file(dir / "site" / "css" / "site.css.gz", "gzipped");
+	std::string const large(100 * 1024, 'x');
+	write_file(dir / "site" / "large.bin", large);
+
+	tempest::pack_summary const summary = tempest::pack_directory(dir / "site", dir / "site.pack");
+	BOOST_CHECK_EQUAL(summary.files, 4u);
+	BOOST_CHECK_EQUAL(summary.precompressed, 1u);
+	BOOST_CHECK_EQUAL(summary.archive_bytes, boost::filesystem::file_size(dir / "site.pack"));
+
+	boost::shared_ptr<tempest::posix::archive_directory> const archive =
+	        boost::make_shared<tempest::posix::archive_directory>(dir / "site.pack");
+	BOOST_CHECK_EQUAL(archive->size(), 4u);
+
+	std::string response = serve(archive, "GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n");
+	BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+	BOOST_CHECK(response.find("\r\nContent-Type: text/html") != std::string::npos);
+	BOOST_CHECK_EQUAL(body_of(response), "<p>hello</p>");
+
+	//sent from the archive descriptor instead of the mapping
+	response = serve(archive, "GET /large.bin HTTP/1.1\r\nHost: x\r\n\r\n");
+	BOOST_CHECK(body_of(response) == large);
+
+	//the sidecar is a variant of the original
+	response = serve(archive, "GET /css/site.css HTTP/1.1\r\nHost: x\r\nAccept-Encoding: gzip\r\n\r\n");
+	BOOST_CHECK(response.find("\r\nContent-Encoding: gzip\r\n") != std::string::npos);
+	BOOST_CHECK(response.find("\r\nContent-Type: text/css") != std::string::npos);
+	BOOST_CHECK_EQUAL(body_of(response), "gzipped");
+	response = serve(archive, "GET /css/site.css HTTP/1.1\r\nHost: x\r\n\r\n");
+	BOOST_CHECK_EQUAL(body_of(response), "body{}");
+
+	//revalidation with the tag of the first response
+	std::size_t const etag_begin = response.find("ETag: ") + 6;
+	std::string const etag = response.substr(etag_begin, response.find("\r\n", etag_begin) - etag_begin);
+	response = serve(archive, "GET /css/site.css HTTP/1.1\r\nHost: x\r\nIf-None-Match: " + etag + "\r\n\r\n");
+	BOOST_CHECK_EQUAL(response.compare(0, 12, "HTTP/1.1 304"), 0);
+
+	response = serve(archive, "GET /index.html HTTP/1.1\r\nHost: x\r\nRange: bytes=3-7\r\n\r\n");
+	BOOST_CHECK_EQUAL(response.compare(0, 12, "HTTP/1.1 206"), 0);
+	BOOST_CHECK_EQUAL(body_of(response), "hello");
+
+	response = serve(archive, "GET /css HTTP/1.1\r\nHost: x\r\n\r\n");
+	BOOST_CHECK_EQUAL(response.compare(0, 12, "HTTP/1.1 404"), 0);
+	response = serve(archive, "GET /missing HTTP/1.1\r\nHost: x\r\n\r\n");
+	BOOST_CHECK_EQUAL(response.compare(0, 12, "HTTP/1.1 404"), 0);
+
+	//anything else is refused
+	write_file(dir / "broken.pack", std::string(8192, 'x'));
+	BOOST_CHECK_THROW(tempest::posix::archive_directory(dir / "broken.pack"), std::invalid_argument);
+
+	boost::filesystem::remove_all(dir);
+}
+#endif
@@ -0,0 +1,68 @@
+#include <boost/test/unit_test.hpp>
+#include "http/arena.hpp"
+#include "http/http_request.hpp"
+#include "http/request_parser.hpp"
+#include <boost/cstdint.hpp>
+
+BOOST_AUTO_TEST_CASE(arena_reuses_its_chunks)
+{
+	tempest::arena memory(256);
+	BOOST_CHECK_EQUAL(memory.statistics().chunks, 0u);
+
+	for (unsigned round = 0; round < 3; ++round)
+	{
+		memory.reset();
+		char * const small = static_cast<char *>(memory.allocate(3, 1));
+		void * const aligned = memory.allocate(8, 8);
+		BOOST_CHECK_EQUAL(reinterpret_cast<std::size_t>(aligned) % 8, 0u);
+		BOOST_CHECK(static_cast<char *>(aligned) >= small + 3);
+
+		//does not fit into the first chunk
+		void * const large = memory.allocate(1000, 16);
+		BOOST_CHECK_EQUAL(reinterpret_cast<std::size_t>(large) % 16, 0u);
+		memory.allocate(100, 1);
+
+		//the chunks of the first round are enough for the others
+		BOOST_CHECK_EQUAL(memory.statistics().chunks, 3u);
+	}
+	BOOST_CHECK_EQUAL(memory.statistics().allocations, 12u);
+	BOOST_CHECK_EQUAL(memory.statistics().allocated_bytes, 3u * (3 + 8 + 1000 + 100));
+}
+
+BOOST_AUTO_TEST_CASE(arena_holds_the_headers_of_a_request)
+{
+	tempest::arena memory;
+	tempest::http_request request(memory);
+	tempest::request_parser parser;
+	std::string const head =
+	        "GET /a%20b HTTP/1.1\r\n"
+	        "Host: localhost\r\n"
+	        "User-Agent: a user agent with a name which does not fit into a string\r\n"
+	        "\r\n";
+
+	for (unsigned round = 0; round < 3; ++round)
+	{
+		parser.reset();
+		BOOST_REQUIRE_EQUAL(parser.parse(head.data(), head.size()), tempest::parse_complete);
+		request.headers.clear();
+		memory.reset();
+		tempest::make_request(parser.request(), request);
+
+		BOOST_CHECK_EQUAL(request.method, "GET");
+		BOOST_CHECK_EQUAL(request.file, "/a b");
+		BOOST_REQUIRE(tempest::find_header(request, "host"));
+		BOOST_CHECK_EQUAL(*tempest::find_header(request, "host"), "localhost");
+		BOOST_CHECK_EQUAL(request.headers.size(), 2u);
+	}
+	BOOST_CHECK_EQUAL(memory.statistics().chunks, 1u);
+
+	//a copy does not depend on the arena
+	tempest::http_request const copy = request;
+	BOOST_CHECK(!copy.headers.get_allocator().get_arena());
+	BOOST_CHECK(request.headers.get_allocator().get_arena() == &memory);
+	request.headers.clear();
+	memory.reset();
+	BOOST_REQUIRE(tempest::find_header(copy, "User-Agent"));
+	BOOST_CHECK_EQUAL(*tempest::find_header(copy, "User-Agent"),
+	                  "a user agent with a name which does not fit into a string");
+}
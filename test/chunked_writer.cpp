@@ -0,0 +1,282 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/chunked_writer.hpp"
+#include "tempest/directory.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/server.hpp"
+#include "http/http_request.hpp"
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+
+namespace
+{
+	//writes a body through a writer with a small buffer
+	struct body_stream : boost::enable_shared_from_this<body_stream>
+	{
+		body_stream(tempest::http_request const &request,
+		            tempest::async_sender &sender,
+		            std::string body,
+		            tempest::directory::response_handler handler)
+		    : m_writer(request, sender, "HTTP/1.1 200 OK\r\n", 8)
+		    , m_body(body)
+		    , m_written(0)
+		    , m_handler(boost::move(handler))
+		{
+		}
+
+		void produce(boost::system::error_code error)
+		{
+			if (error)
+			{
+				return m_handler(error);
+			}
+			m_written += m_writer.write(boost::string_ref(m_body).substr(m_written));
+			if (m_written < m_body.size())
+			{
+				return m_writer.async_flush(
+				    boost::bind(&body_stream::produce, shared_from_this(), _1));
+			}
+			m_writer.async_finish(
+			    boost::bind(&body_stream::handle_finished, shared_from_this(), _1));
+		}
+
+	private:
+
+		tempest::chunked_writer m_writer;
+		std::string const m_body;
+		std::size_t m_written;
+		tempest::directory::response_handler const m_handler;
+
+
+		void handle_finished(boost::system::error_code error)
+		{
+			m_handler(error);
+		}
+	};
+
+	struct streaming_directory : tempest::directory
+	{
+		virtual void respond(tempest::http_request const &,
+		                     boost::string_ref,
+		                     tempest::sender &) TEMPEST_OVERRIDE
+		{
+			BOOST_FAIL("only async_respond is expected");
+		}
+
+		virtual void async_respond(tempest::http_request const &request,
+		                           boost::string_ref sub_path,
+		                           tempest::async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE
+		{
+			boost::make_shared<body_stream>(request, sender, sub_path.substr(1).to_string(),
+			                                boost::move(handler))->produce(boost::system::error_code());
+		}
+	};
+
+	void store_result(std::vector<boost::system::error_code> *results,
+	                  boost::system::error_code error)
+	{
+		results->push_back(error);
+	}
+
+	//Records what is sent and when the sender is flushed, and passes it
+	//on to a memory_client.
+	struct recording_sender : tempest::async_sender
+	{
+		explicit recording_sender(tempest::async_sender &next)
+		    : m_next(next)
+		{
+		}
+
+		std::vector<std::string> events;
+
+		virtual void async_send(tempest::send_parts const &parts, send_handler handler) TEMPEST_OVERRIDE
+		{
+			std::string sent;
+			BOOST_FOREACH (tempest::send_part const &part, parts)
+			{
+				char const * const data = boost::asio::buffer_cast<char const *>(part.memory);
+				sent.append(data, boost::asio::buffer_size(part.memory));
+			}
+			events.push_back("send " + sent);
+			m_next.async_send(parts, boost::move(handler));
+		}
+
+		virtual void async_flush(send_handler handler) TEMPEST_OVERRIDE
+		{
+			events.push_back("flush");
+			m_next.async_flush(boost::move(handler));
+		}
+
+		virtual bool is_persistent() TEMPEST_OVERRIDE
+		{
+			return m_next.is_persistent();
+		}
+
+		virtual void set_persistent(bool persistent) TEMPEST_OVERRIDE
+		{
+			m_next.set_persistent(persistent);
+		}
+
+		virtual boost::uint64_t sent_bytes() TEMPEST_OVERRIDE
+		{
+			return m_next.sent_bytes();
+		}
+
+	private:
+
+		tempest::async_sender &m_next;
+	};
+
+	std::string serve(std::string const &requests, bool &shut_down)
+	{
+		boost::shared_ptr<tempest::memory_client> const client =
+		        boost::make_shared<tempest::memory_client>();
+		client->feed(requests);
+		tempest::serve_client(client, boost::make_shared<streaming_directory>(),
+		                      tempest::server_options());
+		client->poll();
+		shut_down = client->is_shut_down();
+		return std::string(client->output().begin(), client->output().end());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_frames_chunks)
+{
+	bool shut_down = false;
+	std::string const output = serve("GET /abcdefghijklmnopqrst HTTP/1.1\r\n\r\n"
+	                                 "GET /abcdefgh HTTP/1.1\r\nConnection: close\r\n\r\n",
+	                                 shut_down);
+	BOOST_CHECK_EQUAL(output,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Transfer-Encoding: chunked\r\n"
+	                  "Connection: keep-alive\r\n\r\n"
+	                  "8\r\nabcdefgh\r\n"
+	                  "8\r\nijklmnop\r\n"
+	                  "4\r\nqrst\r\n"
+	                  "0\r\n\r\n"
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Transfer-Encoding: chunked\r\n"
+	                  "Connection: close\r\n\r\n"
+	                  "8\r\nabcdefgh\r\n"
+	                  "0\r\n\r\n");
+	BOOST_CHECK(shut_down);
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_closes_http_1_0_connections)
+{
+	bool shut_down = false;
+	std::string const output = serve("GET /abcdefghijk HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+	                                 "GET /never HTTP/1.0\r\n\r\n",
+	                                 shut_down);
+	BOOST_CHECK_EQUAL(output,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Connection: close\r\n\r\n"
+	                  "abcdefghijk");
+	BOOST_CHECK(shut_down);
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_closes_connections_of_unknown_versions)
+{
+	tempest::memory_client client;
+	client.set_persistent(true);
+	tempest::http_request request;
+	request.method = "GET";
+	request.version = "HTTP/9.x";
+
+	tempest::chunked_writer writer(request, client.get_async_sender(), "HTTP/1.1 200 OK\r\n", 4);
+	writer.write("ab");
+	std::vector<boost::system::error_code> results;
+	writer.async_finish(boost::bind(store_result, &results, _1));
+	client.poll();
+	std::string const output(client.output().begin(), client.output().end());
+	BOOST_CHECK_EQUAL(output, "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nab");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_sends_only_the_header_for_head)
+{
+	bool shut_down = false;
+	std::string const output = serve("HEAD /abcdefghijk HTTP/1.1\r\nConnection: close\r\n\r\n",
+	                                 shut_down);
+	BOOST_CHECK_EQUAL(output,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Transfer-Encoding: chunked\r\n"
+	                  "Connection: close\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_waits_for_the_sender)
+{
+	tempest::memory_client client;
+	client.set_persistent(true);
+	tempest::http_request request;
+	request.method = "GET";
+	request.version = "HTTP/1.1";
+
+	tempest::chunked_writer writer(request, client.get_async_sender(), "HTTP/1.1 200 OK\r\n", 4);
+	BOOST_CHECK_EQUAL(writer.available(), 4u);
+	BOOST_CHECK_EQUAL(writer.write("abcdef"), 4u);
+	BOOST_CHECK_EQUAL(writer.available(), 0u);
+	BOOST_CHECK_EQUAL(writer.write("ef"), 0u);
+
+	std::vector<boost::system::error_code> results;
+	writer.async_flush(boost::bind(store_result, &results, _1));
+	BOOST_CHECK(results.empty());
+	BOOST_CHECK_EQUAL(client.poll(), 2u);
+	BOOST_REQUIRE_EQUAL(results.size(), 1u);
+	BOOST_CHECK(!results[0]);
+	BOOST_CHECK_EQUAL(writer.available(), 4u);
+
+	//a flush of nothing sends no empty chunk, which would end the body
+	writer.async_flush(boost::bind(store_result, &results, _1));
+	BOOST_CHECK_EQUAL(client.poll(), 2u);
+
+	BOOST_CHECK_EQUAL(writer.write("ef"), 2u);
+	writer.async_finish(boost::bind(store_result, &results, _1));
+	BOOST_CHECK_EQUAL(client.poll(), 1u);
+	BOOST_CHECK_EQUAL(results.size(), 3u);
+
+	std::string const output(client.output().begin(), client.output().end());
+	BOOST_CHECK_EQUAL(output,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Transfer-Encoding: chunked\r\n"
+	                  "Connection: keep-alive\r\n\r\n"
+	                  "4\r\nabcd\r\n"
+	                  "2\r\nef\r\n"
+	                  "0\r\n\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(chunked_writer_flushes_every_chunk)
+{
+	tempest::memory_client client;
+	client.set_persistent(false);
+	recording_sender sender(client.get_async_sender());
+	tempest::http_request request;
+	request.method = "GET";
+	request.version = "HTTP/1.1";
+
+	//a sender which collects small parts would keep the chunks otherwise
+	tempest::chunked_writer writer(request, sender, "HTTP/1.1 200 OK\r\n", 4);
+	std::vector<boost::system::error_code> results;
+	writer.write("ab");
+	writer.async_flush(boost::bind(store_result, &results, _1));
+	client.poll();
+	writer.write("cd");
+	writer.async_flush(boost::bind(store_result, &results, _1));
+	client.poll();
+	writer.async_finish(boost::bind(store_result, &results, _1));
+	client.poll();
+	BOOST_CHECK_EQUAL(results.size(), 3u);
+
+	char const * const expected[] =
+	{
+		"send HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n2\r\nab\r\n",
+		"flush",
+		"send 2\r\ncd\r\n",
+		"flush",
+		"send 0\r\n\r\n"
+	};
+	BOOST_CHECK_EQUAL_COLLECTIONS(sender.events.begin(), sender.events.end(),
+	                              expected, expected + (sizeof(expected) / sizeof(expected[0])));
+}
@@ -0,0 +1,87 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/posix/content_cache.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+#include <fstream>
+
+#if TEMPEST_USE_POSIX
+namespace
+{
+	boost::shared_ptr<tempest::posix::cached_file const>
+	make_cached_file(std::size_t size)
+	{
+		boost::shared_ptr<tempest::posix::cached_file> file =
+		        boost::make_shared<tempest::posix::cached_file>();
+		file->content.resize(size);
+		return file;
+	}
+
+	void write_file(boost::filesystem::path const &file, std::string const &content)
+	{
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		out << content;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(content_cache_find)
+{
+	tempest::posix::content_cache cache((tempest::posix::content_cache_options()));
+	BOOST_CHECK(!cache.find("/a"));
+
+	boost::shared_ptr<tempest::posix::cached_file const> const file = make_cached_file(10);
+	cache.insert("/a", file);
+	BOOST_CHECK(cache.find("/a") == file);
+
+	tempest::posix::content_cache_statistics const statistics = cache.statistics();
+	BOOST_CHECK_EQUAL(statistics.hits, 1u);
+	BOOST_CHECK_EQUAL(statistics.misses, 1u);
+	BOOST_CHECK_EQUAL(statistics.total_size, 10u);
+	BOOST_CHECK_EQUAL(statistics.file_count, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(content_cache_evicts_least_recently_used)
+{
+	tempest::posix::content_cache_options options;
+	options.max_total_size = 100;
+	options.max_file_size = 60;
+	options.shard_count = 1;
+	tempest::posix::content_cache cache(options);
+
+	BOOST_CHECK(!cache.accepts(61));
+
+	cache.insert("/a", make_cached_file(40));
+	cache.insert("/b", make_cached_file(40));
+	BOOST_CHECK(cache.find("/a"));
+
+	//b is the least recently used
+	cache.insert("/c", make_cached_file(40));
+	BOOST_CHECK(cache.find("/a"));
+	BOOST_CHECK(!cache.find("/b"));
+	BOOST_CHECK(cache.find("/c"));
+	BOOST_CHECK_EQUAL(cache.statistics().evictions, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(content_cache_invalidates_changed_files)
+{
+	boost::filesystem::path const file_name =
+	        boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	write_file(file_name, "abc");
+
+	tempest::posix::content_cache_options options;
+	options.revalidation_interval = boost::chrono::steady_clock::duration::zero();
+	tempest::posix::content_cache cache(options);
+
+	boost::shared_ptr<tempest::posix::cached_file> const file =
+	        boost::make_shared<tempest::posix::cached_file>();
+	file->version = *tempest::posix::get_status(file_name.string());
+	cache.insert(file_name.string(), file);
+	BOOST_CHECK(cache.find(file_name.string()));
+
+	write_file(file_name, "abcdef");
+	BOOST_CHECK(!cache.find(file_name.string()));
+	BOOST_CHECK_EQUAL(cache.statistics().invalidations, 1u);
+
+	boost::filesystem::remove(file_name);
+}
+#endif
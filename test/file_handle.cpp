@@ -0,0 +1,61 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/posix/file_handle.hpp"
+#include <boost/asio/error.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+
+#if TEMPEST_USE_POSIX
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+BOOST_AUTO_TEST_CASE(try_send_file_region_resumes_after_would_block)
+{
+	boost::filesystem::path const file_name = boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	std::string const content(4 * 1024 * 1024, 'a');
+	{
+		std::ofstream out(file_name.string().c_str(), std::ios::binary);
+		out << content;
+	}
+	tempest::posix::file_handle const file = tempest::posix::open_read(file_name.string());
+
+	int sockets[2];
+	BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+	BOOST_REQUIRE_EQUAL(fcntl(sockets[0], F_SETFL, O_NONBLOCK), 0);
+
+	//the file does not fit into the socket buffer
+	boost::system::error_code error;
+	tempest::file_size const first = tempest::posix::try_send_file_region(
+	            sockets[0], file.handle(), 0, content.size(), error);
+	BOOST_CHECK(error == boost::asio::error::would_block);
+	BOOST_REQUIRE_LT(first, content.size());
+
+	std::vector<char> received;
+	std::vector<char> buffer(64 * 1024);
+	tempest::file_size sent = first;
+	while (received.size() < content.size())
+	{
+		ssize_t const read = ::read(sockets[1], buffer.data(), buffer.size());
+		BOOST_REQUIRE_GT(read, 0);
+		received.insert(received.end(), buffer.begin(), buffer.begin() + read);
+
+		if (sent < content.size())
+		{
+			sent += tempest::posix::try_send_file_region(
+			            sockets[0], file.handle(), sent, content.size() - sent, error);
+			BOOST_REQUIRE(!error || (error == boost::asio::error::would_block));
+		}
+	}
+	BOOST_CHECK(std::string(received.begin(), received.end()) == content);
+
+	//the end of the file is not an error
+	BOOST_CHECK_EQUAL(tempest::posix::try_send_file_region(
+	                      sockets[0], file.handle(), content.size() - 1, 10, error), 1u);
+	BOOST_CHECK(!error);
+
+	close(sockets[0]);
+	close(sockets[1]);
+	boost::filesystem::remove(file_name);
+}
+#endif
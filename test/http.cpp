@@ -1,7 +1,12 @@
 #include <boost/test/unit_test.hpp>
 #include "http/http_request.hpp"
+#include "http/request_parser.hpp"
 #include "http/http_response.hpp"
+#include "http/response_writer.hpp"
+#include "http/byte_range.hpp"
 #include "http/decode_uri.hpp"
+#include "http/scan.hpp"
+#include <boost/foreach.hpp>
 
 BOOST_AUTO_TEST_CASE(http_request_parse)
 {
@@ -19,6 +24,152 @@ BOOST_AUTO_TEST_CASE(http_request_parse)
 	BOOST_CHECK_EQUAL(parsed.headers["Host"], "localhost");
 }
 
+BOOST_AUTO_TEST_CASE(http_request_parser_incremental)
+{
+	std::string const head =
+	        "GET /a%20b HTTP/1.1\r\n"
+	        "Host: localhost\r\n"
+	        "Accept:  text/html \r\n"
+	        "\r\n"
+	        "next";
+	std::size_t const head_length = head.size() - 4;
+
+	//the bytes arrive one at a time
+	tempest::request_parser parser;
+	for (std::size_t received = 1; received < head_length; ++received)
+	{
+		BOOST_REQUIRE_EQUAL(parser.parse(head.data(), received), tempest::parse_incomplete);
+	}
+	BOOST_REQUIRE_EQUAL(parser.parse(head.data(), head.size()), tempest::parse_complete);
+	BOOST_CHECK_EQUAL(parser.consumed(), head_length);
+
+	tempest::request_view const &view = parser.request();
+	BOOST_CHECK_EQUAL(view.method, "GET");
+	BOOST_CHECK_EQUAL(view.target, "/a%20b");
+	BOOST_CHECK_EQUAL(view.version, "HTTP/1.1");
+	BOOST_REQUIRE_EQUAL(view.headers.size(), 2);
+	BOOST_CHECK_EQUAL(view.headers[1].name, "Accept");
+	BOOST_CHECK_EQUAL(view.headers[1].value, "text/html");
+	BOOST_REQUIRE(view.find_header("host"));
+	BOOST_CHECK_EQUAL(*view.find_header("host"), "localhost");
+
+	tempest::http_request const request = tempest::make_request(view);
+	BOOST_CHECK_EQUAL(request.file, "/a b");
+}
+
+BOOST_AUTO_TEST_CASE(http_request_parser_errors)
+{
+	tempest::request_parser parser;
+	std::string const no_version = "GET /\r\n\r\n";
+	BOOST_CHECK_EQUAL(parser.parse(no_version.data(), no_version.size()), tempest::parse_bad_request);
+
+	parser.reset();
+	std::string const no_colon = "GET / HTTP/1.1\r\nHost\r\n\r\n";
+	BOOST_CHECK_EQUAL(parser.parse(no_colon.data(), no_colon.size()), tempest::parse_bad_request);
+
+	parser.reset();
+	std::string const folded = "GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n";
+	BOOST_CHECK_EQUAL(parser.parse(folded.data(), folded.size()), tempest::parse_bad_request);
+
+	parser.reset();
+	std::string const space_in_name = "GET / HTTP/1.1\r\nHost : x\r\n\r\n";
+	BOOST_CHECK_EQUAL(parser.parse(space_in_name.data(), space_in_name.size()), tempest::parse_bad_request);
+
+	tempest::request_limits limits;
+	limits.max_header_bytes = 32;
+	tempest::request_parser limited(limits);
+	std::string const too_large = "GET / HTTP/1.1\r\nCookie: " + std::string(32, 'a');
+	BOOST_CHECK_EQUAL(limited.parse(too_large.data(), too_large.size()), tempest::parse_too_large);
+}
+
+BOOST_AUTO_TEST_CASE(http_request_persistent_connection)
+{
+	tempest::http_request request;
+	request.version = "HTTP/1.1";
+	BOOST_CHECK(tempest::wants_persistent_connection(request));
+
+	request.headers["connection"] = "Close";
+	BOOST_CHECK(!tempest::wants_persistent_connection(request));
+
+	request.version = "HTTP/1.0";
+	request.headers.clear();
+	BOOST_CHECK(!tempest::wants_persistent_connection(request));
+
+	request.headers["Connection"] = "TE, keep-alive";
+	BOOST_CHECK(tempest::wants_persistent_connection(request));
+}
+
+BOOST_AUTO_TEST_CASE(http_request_accepts_encoding)
+{
+	tempest::http_request request;
+	BOOST_CHECK(!tempest::accepts_encoding(request, "gzip"));
+
+	request.headers["accept-encoding"] = "deflate, GZIP;q=0.5";
+	BOOST_CHECK(tempest::accepts_encoding(request, "gzip"));
+	BOOST_CHECK(!tempest::accepts_encoding(request, "br"));
+
+	request.headers["accept-encoding"] = "gzip; q=0, *";
+	BOOST_CHECK(!tempest::accepts_encoding(request, "gzip"));
+	BOOST_CHECK(tempest::accepts_encoding(request, "br"));
+
+	request.headers["accept-encoding"] = "*;q=0.000";
+	BOOST_CHECK(!tempest::accepts_encoding(request, "br"));
+}
+
+BOOST_AUTO_TEST_CASE(http_parse_byte_ranges)
+{
+	std::vector<tempest::byte_range> ranges;
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=0-99, 200-, -50", 1000, ranges),
+	                  tempest::range_satisfiable);
+	BOOST_REQUIRE_EQUAL(ranges.size(), 3u);
+	BOOST_CHECK_EQUAL(ranges[0].first, 0u);
+	BOOST_CHECK_EQUAL(ranges[0].length, 100u);
+	BOOST_CHECK_EQUAL(ranges[1].first, 200u);
+	BOOST_CHECK_EQUAL(ranges[1].length, 800u);
+	BOOST_CHECK_EQUAL(ranges[2].first, 950u);
+	BOOST_CHECK_EQUAL(ranges[2].length, 50u);
+
+	//clamped to the size
+	ranges.clear();
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=990-2000,-5000", 1000, ranges),
+	                  tempest::range_satisfiable);
+	BOOST_REQUIRE_EQUAL(ranges.size(), 2u);
+	BOOST_CHECK_EQUAL(ranges[0].length, 10u);
+	BOOST_CHECK_EQUAL(ranges[1].first, 0u);
+	BOOST_CHECK_EQUAL(ranges[1].length, 1000u);
+
+	ranges.clear();
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=1000-", 1000, ranges),
+	                  tempest::range_not_satisfiable);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=-0", 1000, ranges),
+	                  tempest::range_not_satisfiable);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=0-", 0, ranges),
+	                  tempest::range_not_satisfiable);
+	BOOST_CHECK(ranges.empty());
+
+	//syntax errors and other units are ignored
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=5-1", 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=0-1,x", 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("items=0-1", 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=", 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges("bytes=99999999999999999999-", 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK(ranges.empty());
+
+	std::string many = "bytes=0-0";
+	for (std::size_t i = 0; i < tempest::max_byte_ranges; ++i)
+	{
+		many += ",0-0";
+	}
+	BOOST_CHECK_EQUAL(tempest::parse_byte_ranges(many, 1000, ranges),
+	                  tempest::range_ignored);
+	BOOST_CHECK(ranges.empty());
+}
+
 BOOST_AUTO_TEST_CASE(http_response_print)
 {
 	tempest::http_response response;
@@ -38,6 +189,55 @@ BOOST_AUTO_TEST_CASE(http_response_print)
 	                  );
 }
 
+BOOST_AUTO_TEST_CASE(http_response_writer)
+{
+	std::string rendered = "x";
+	tempest::response_writer writer(rendered);
+	writer.status_line("HTTP/1.1", 200, "OK");
+	writer.header("Content-Length", static_cast<boost::uint64_t>(18446744073709551615ULL));
+	writer.header("Content-Type", "text/plain");
+	writer.date_header("Last-Modified", 784111777);
+	writer.end();
+	BOOST_CHECK_EQUAL(rendered,
+	                  "x"
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Content-Length: 18446744073709551615\r\n"
+	                  "Content-Type: text/plain\r\n"
+	                  "Last-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+	                  "\r\n"
+	                  );
+}
+
+BOOST_AUTO_TEST_CASE(http_format_date)
+{
+	char date[tempest::http_date_length];
+	tempest::format_http_date(0, date);
+	BOOST_CHECK_EQUAL(std::string(date, sizeof(date)), "Thu, 01 Jan 1970 00:00:00 GMT");
+
+	//a leap day
+	tempest::format_http_date(951825600, date);
+	BOOST_CHECK_EQUAL(std::string(date, sizeof(date)), "Tue, 29 Feb 2000 12:00:00 GMT");
+
+	tempest::format_http_date(-1, date);
+	BOOST_CHECK_EQUAL(std::string(date, sizeof(date)), "Wed, 31 Dec 1969 23:59:59 GMT");
+}
+
+BOOST_AUTO_TEST_CASE(http_parse_date)
+{
+	boost::int64_t seconds = 0;
+	BOOST_REQUIRE(tempest::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", seconds));
+	BOOST_CHECK_EQUAL(seconds, 784111777);
+	BOOST_REQUIRE(tempest::parse_http_date("Tue, 29 Feb 2000 12:00:00 GMT", seconds));
+	BOOST_CHECK_EQUAL(seconds, 951825600);
+	BOOST_REQUIRE(tempest::parse_http_date("Thu, 01 Jan 1970 00:00:00 GMT", seconds));
+	BOOST_CHECK_EQUAL(seconds, 0);
+
+	BOOST_CHECK(!tempest::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", seconds));
+	BOOST_CHECK(!tempest::parse_http_date("Sun Nov  6 08:49:37 1994", seconds));
+	BOOST_CHECK(!tempest::parse_http_date("Sun, 06 Nox 1994 08:49:37 GMT", seconds));
+	BOOST_CHECK(!tempest::parse_http_date("Sun, 06 Nov 1994 08:49:37 UTC", seconds));
+}
+
 namespace
 {
 	bool test_decode_uri(std::string const &encoded,
@@ -47,7 +247,11 @@ namespace
 		tempest::decode_uri(encoded.begin(),
 		                    encoded.end(),
 		                    std::back_inserter(decoded));
-		return (raw == decoded);
+
+		//the in-place fast path for strings
+		std::string in_place = encoded;
+		tempest::decode_uri(in_place);
+		return (raw == decoded) && (raw == in_place);
 	}
 
 	void decode_invalid(std::string const &invalid)
@@ -57,6 +261,11 @@ namespace
 		                    invalid.end(),
 		                    std::back_inserter(decoded));
 	}
+
+	void decode_invalid_in_place(std::string invalid)
+	{
+		tempest::decode_uri(invalid);
+	}
 }
 
 BOOST_AUTO_TEST_CASE(http_decode_uri)
@@ -71,4 +280,46 @@ BOOST_AUTO_TEST_CASE(http_decode_uri)
 	BOOST_CHECK_THROW(decode_invalid("%%"), std::invalid_argument);
 	BOOST_CHECK_THROW(decode_invalid("%2G"), std::invalid_argument);
 	BOOST_CHECK_THROW(decode_invalid("%H1"), std::invalid_argument);
+
+	BOOST_CHECK(test_decode_uri("%2f%2F", "//"));
+	BOOST_CHECK(test_decode_uri("/search?q=a%20b&lang=en%2Cde", "/search?q=a b&lang=en,de"));
+	BOOST_CHECK(test_decode_uri(std::string(100, 'x') + "%41" + std::string(100, 'y'),
+	                            std::string(100, 'x') + "A" + std::string(100, 'y')));
+
+	char const * const invalid[] = {"%", "%1", "%%", "%2G", "%H1", "abc%", "a%20%g0"};
+	BOOST_FOREACH (char const *uri, invalid)
+	{
+		BOOST_CHECK_THROW(decode_invalid_in_place(uri), std::invalid_argument);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(http_find_first_of)
+{
+	//every length and every position of the match, so that the vector
+	//blocks and the scalar rest are covered
+	for (std::size_t length = 0; length < 80; ++length)
+	{
+		for (std::size_t match = 0; match <= length; ++match)
+		{
+			std::string text(length, 'a');
+			if (match < length)
+			{
+				text[match] = '\n';
+			}
+			if (match + 1 < length)
+			{
+				text[match + 1] = ':';
+			}
+			char const * const begin = text.data();
+			char const * const end = begin + text.size();
+			char const * const found = tempest::find_first_of(begin, end, '\r', '\n', ':', ' ');
+			BOOST_CHECK_EQUAL(found - begin, static_cast<std::ptrdiff_t>(match));
+			BOOST_CHECK(found == tempest::detail::find_first_of_scalar(begin, end, '\r', '\n', ':', ' '));
+		}
+	}
+
+	//bytes with the highest bit set must not confuse the comparison
+	std::string const high = "\xff\x80\xe9" + std::string(40, '\xfe') + "%";
+	BOOST_CHECK_EQUAL(tempest::find_first_of(high.data(), high.data() + high.size(), '%', '%', '%', '%') - high.data(),
+	                  static_cast<std::ptrdiff_t>(high.size() - 1));
 }
@@ -0,0 +1,42 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/memory_client.hpp"
+#include "tempest/portable_fs_directory.hpp"
+#include "tempest/server.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+
+BOOST_AUTO_TEST_CASE(memory_client_serves_pipelined_requests)
+{
+	boost::filesystem::path const dir = boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	boost::filesystem::create_directories(dir);
+	{
+		boost::filesystem::ofstream file(dir / "a.txt", std::ios::binary);
+		file << "abc";
+	}
+
+	boost::shared_ptr<tempest::memory_client> const client =
+	        boost::make_shared<tempest::memory_client>();
+	client->feed("GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+	             "GET /missing HTTP/1.1\r\nHost: x\r\n\r\n");
+	tempest::serve_client(client,
+	                      boost::make_shared<tempest::portable::file_system_directory>(dir),
+	                      tempest::server_options());
+
+	//nothing happens before the handlers are called
+	BOOST_CHECK(client->output().empty());
+	BOOST_CHECK_GT(client->poll(), 0u);
+
+	std::string const output(client->output().begin(), client->output().end());
+	std::size_t const second = output.find("HTTP/1.1 404");
+	BOOST_CHECK_EQUAL(output.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+	BOOST_REQUIRE(second != std::string::npos);
+	BOOST_CHECK_EQUAL(output.substr(second - 3, 3), "abc");
+
+	//the end of the input closes the connection
+	BOOST_CHECK(client->is_shut_down());
+	BOOST_CHECK_EQUAL(client->poll(), 0u);
+
+	boost::filesystem::remove_all(dir);
+}
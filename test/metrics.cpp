@@ -0,0 +1,131 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/metrics.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/portable_fs_directory.hpp"
+#include "tempest/server.hpp"
+#include <boost/bind.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+	void count_requests(tempest::metrics *metrics, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			metrics->add(tempest::request_counter);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(metrics_sums_up_threads)
+{
+	tempest::metrics metrics;
+	boost::thread_group threads;
+	for (unsigned i = 0; i < 20; ++i)
+	{
+		threads.create_thread(boost::bind(count_requests, &metrics, 1000u));
+	}
+	threads.join_all();
+	metrics.add(tempest::sent_bytes_counter, 123);
+	metrics.count_status(200);
+	metrics.count_status(200);
+	metrics.count_status(404);
+	metrics.count_status(1000);
+
+	tempest::metrics_snapshot const snapshot = metrics.snapshot();
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::request_counter], 20000u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::sent_bytes_counter], 123u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(200), 2u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(404), 1u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(1000), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_latency_histogram)
+{
+	tempest::metrics metrics;
+	for (unsigned i = 0; i < 99; ++i)
+	{
+		metrics.record(tempest::send_phase, boost::chrono::microseconds(3));
+	}
+	metrics.record(tempest::send_phase, boost::chrono::milliseconds(5));
+
+	tempest::latency_histogram const &send = metrics.snapshot().phases[tempest::send_phase];
+	BOOST_CHECK_EQUAL(send.count, 100u);
+	BOOST_CHECK_EQUAL(send.sum_nanoseconds, 99u * 3000u + 5000000u);
+	BOOST_CHECK_EQUAL(tempest::latency_percentile(send, 50), 4096u);
+	BOOST_CHECK_EQUAL(tempest::latency_percentile(send, 100), 8388608u);
+	BOOST_CHECK_EQUAL(metrics.snapshot().phases[tempest::parse_phase].count, 0u);
+
+	std::string text;
+	tempest::write_prometheus(metrics.snapshot(), text);
+	BOOST_CHECK(text.find("tempest_phase_duration_seconds_bucket{phase=\"send\",le=\"0.000004096\"} 99\n") != std::string::npos);
+	BOOST_CHECK(text.find("tempest_phase_duration_seconds_count{phase=\"send\"} 100\n") != std::string::npos);
+	BOOST_CHECK(text.find("tempest_phase_duration_seconds_sum{phase=\"send\"} 0.005297\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_count_served_requests)
+{
+	boost::filesystem::path const dir = boost::filesystem::temp_directory_path() /
+	        boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	boost::filesystem::create_directories(dir);
+	{
+		boost::filesystem::ofstream file(dir / "a.txt", std::ios::binary);
+		file << "abc";
+	}
+
+	tempest::server_options options;
+	options.metrics = boost::make_shared<tempest::metrics>();
+	boost::shared_ptr<tempest::memory_client> const client =
+	        boost::make_shared<tempest::memory_client>();
+	client->feed("GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+	             "GET /missing HTTP/1.1\r\nHost: x\r\n\r\n"
+	             "GET\r\n\r\n");
+	tempest::serve_client(client,
+	                      boost::make_shared<tempest::portable::file_system_directory>(dir),
+	                      options);
+	client->poll();
+
+	tempest::metrics_snapshot const snapshot = options.metrics->snapshot();
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::request_counter], 2u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(200), 1u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(404), 1u);
+	BOOST_CHECK_EQUAL(snapshot.status_count(400), 1u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::sent_bytes_counter], client->output().size());
+	BOOST_CHECK_EQUAL(snapshot.phases[tempest::lookup_phase].count, 2u);
+	BOOST_CHECK_EQUAL(snapshot.phases[tempest::send_phase].count, 2u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::opened_connection_counter], 1u);
+
+	//at least the map node of the Host header of each request
+	BOOST_CHECK(snapshot.counters[tempest::arena_allocation_counter] >= 2u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::arena_chunk_counter], 1u);
+
+	boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_count_malformed_escapes_as_bad_requests)
+{
+	tempest::server_options options;
+	options.metrics = boost::make_shared<tempest::metrics>();
+	boost::shared_ptr<tempest::memory_client> const client =
+	        boost::make_shared<tempest::memory_client>();
+	client->feed("GET /%zz HTTP/1.1\r\nHost: x\r\n\r\n"
+	             "GET /hidden HTTP/1.1\r\nHost: x\r\n\r\n");
+	tempest::serve_client(client,
+	                      boost::make_shared<tempest::portable::file_system_directory>(
+	                          boost::filesystem::temp_directory_path()),
+	                      options);
+	client->poll();
+
+	std::string const output(client->output().begin(), client->output().end());
+	BOOST_CHECK_EQUAL(output.substr(0, 12), "HTTP/1.1 400");
+	BOOST_CHECK(output.find("/hidden") == std::string::npos);
+	BOOST_CHECK(client->is_shut_down());
+
+	tempest::metrics_snapshot const snapshot = options.metrics->snapshot();
+	BOOST_CHECK_EQUAL(snapshot.status_count(400), 1u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::request_counter], 0u);
+	BOOST_CHECK_EQUAL(snapshot.counters[tempest::error_counter], 0u);
+}
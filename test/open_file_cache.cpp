@@ -0,0 +1,148 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/posix/open_file_cache.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+
+#if TEMPEST_USE_POSIX
+namespace
+{
+	boost::filesystem::path make_temporary_path()
+	{
+		return boost::filesystem::temp_directory_path() /
+		       boost::filesystem::unique_path("tempest-%%%%-%%%%-%%%%");
+	}
+
+	void write_file(boost::filesystem::path const &file, std::string const &content)
+	{
+		std::ofstream out(file.string().c_str(), std::ios::binary);
+		out << content;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(open_file_cache_reuses_descriptors)
+{
+	boost::filesystem::path const file_name = make_temporary_path();
+	write_file(file_name, "abc");
+
+	tempest::posix::open_file_cache cache((tempest::posix::open_file_cache_options()));
+	boost::shared_ptr<tempest::posix::open_file const> const first = cache.open(file_name.string());
+	BOOST_REQUIRE(first);
+	BOOST_CHECK_EQUAL(first->version.size, 3u);
+	BOOST_CHECK(cache.open(file_name.string()) == first);
+
+	tempest::posix::open_file_cache_statistics const statistics = cache.statistics();
+	BOOST_CHECK_EQUAL(statistics.hits, 1u);
+	BOOST_CHECK_EQUAL(statistics.misses, 1u);
+	BOOST_CHECK_EQUAL(statistics.open_files, 1u);
+
+	boost::filesystem::remove(file_name);
+}
+
+BOOST_AUTO_TEST_CASE(open_file_cache_remembers_missing_files)
+{
+	boost::filesystem::path const file_name = make_temporary_path();
+
+	tempest::posix::open_file_cache cache((tempest::posix::open_file_cache_options()));
+	BOOST_CHECK(!cache.open(file_name.string()));
+	BOOST_CHECK(!cache.open(file_name.string()));
+	BOOST_CHECK(!cache.open((file_name / "sub").string()));
+
+	tempest::posix::open_file_cache_statistics const statistics = cache.statistics();
+	BOOST_CHECK_EQUAL(statistics.missing_hits, 1u);
+	BOOST_CHECK_EQUAL(statistics.misses, 2u);
+	BOOST_CHECK_EQUAL(statistics.open_files, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(open_file_cache_evicts_and_revalidates)
+{
+	boost::filesystem::path const first_name = make_temporary_path();
+	boost::filesystem::path const second_name = make_temporary_path();
+	write_file(first_name, "abc");
+	write_file(second_name, "def");
+
+	tempest::posix::open_file_cache_options options;
+	options.max_open_files = 1;
+	options.shard_count = 1;
+	options.revalidation_interval = boost::chrono::steady_clock::duration::zero();
+	tempest::posix::open_file_cache cache(options);
+
+	boost::shared_ptr<tempest::posix::open_file const> const first = cache.open(first_name.string());
+	BOOST_REQUIRE(first);
+	BOOST_CHECK(cache.open(second_name.string()));
+	BOOST_CHECK_EQUAL(cache.statistics().evictions, 1u);
+	BOOST_CHECK_EQUAL(cache.statistics().open_files, 1u);
+
+	//an unchanged file keeps its descriptor
+	boost::shared_ptr<tempest::posix::open_file const> const second = cache.open(second_name.string());
+	BOOST_CHECK(cache.open(second_name.string()) == second);
+
+	//a replaced file is opened again
+	boost::filesystem::remove(second_name);
+	write_file(second_name, "defgh");
+	boost::shared_ptr<tempest::posix::open_file const> const replaced = cache.open(second_name.string());
+	BOOST_REQUIRE(replaced);
+	BOOST_CHECK(replaced != second);
+	BOOST_CHECK_EQUAL(replaced->version.size, 5u);
+	BOOST_CHECK_EQUAL(cache.statistics().invalidations, 1u);
+
+	boost::filesystem::remove(first_name);
+	boost::filesystem::remove(second_name);
+}
+
+BOOST_AUTO_TEST_CASE(open_file_cache_precompressed_variant)
+{
+	boost::filesystem::path const file_name = make_temporary_path();
+	std::string const sidecar_name = file_name.string() + ".gz";
+	write_file(sidecar_name, "compressed");
+
+	tempest::posix::open_file_cache cache((tempest::posix::open_file_cache_options()));
+	BOOST_CHECK(!cache.open(file_name.string()));
+
+	boost::shared_ptr<tempest::posix::open_file const> const variant =
+	        cache.open(file_name.string(), tempest::gzip_coding);
+	BOOST_REQUIRE(variant);
+	BOOST_CHECK(variant->headers.ok.find("Content-Encoding: gzip\r\n") != std::string::npos);
+
+	//the same file requested by its own name is not a variant
+	boost::shared_ptr<tempest::posix::open_file const> const direct = cache.open(sidecar_name);
+	BOOST_REQUIRE(direct);
+	BOOST_CHECK(direct != variant);
+	BOOST_CHECK(direct->headers.ok.find("Content-Encoding") == std::string::npos);
+
+	boost::filesystem::remove(sidecar_name);
+}
+BOOST_AUTO_TEST_CASE(open_file_cache_limits_missing_paths)
+{
+	boost::filesystem::path const file_name = make_temporary_path();
+	write_file(file_name, "abc");
+
+	tempest::posix::open_file_cache_options options;
+	options.max_open_files = 1;
+	options.shard_count = 1;
+	options.max_missing_paths = 8;
+	tempest::posix::open_file_cache cache(options);
+	boost::shared_ptr<tempest::posix::open_file const> const file = cache.open(file_name.string());
+	BOOST_REQUIRE(file);
+
+	//a flood of distinct missing paths replaces the oldest of them
+	for (unsigned i = 0; i < 1000; ++i)
+	{
+		BOOST_CHECK(!cache.open(file_name.string() + boost::lexical_cast<std::string>(i), tempest::gzip_coding));
+		BOOST_CHECK(!cache.open(file_name.string() + boost::lexical_cast<std::string>(i)));
+		BOOST_CHECK(cache.statistics().missing_paths <= 8u);
+	}
+	BOOST_CHECK_EQUAL(cache.statistics().missing_paths, 8u);
+
+	//and does not displace the open file
+	BOOST_CHECK_EQUAL(cache.statistics().evictions, 0u);
+	BOOST_CHECK(cache.open(file_name.string()) == file);
+
+	//the recently missing paths are still remembered
+	tempest::posix::open_file_cache_statistics const before = cache.statistics();
+	BOOST_CHECK(!cache.open(file_name.string() + "999"));
+	BOOST_CHECK_EQUAL(cache.statistics().missing_hits, before.missing_hits + 1);
+
+	boost::filesystem::remove(file_name);
+}
+#endif
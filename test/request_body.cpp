@@ -0,0 +1,348 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/directory.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/responses.hpp"
+#include "tempest/server.hpp"
+#include "http/body_parser.hpp"
+#include "http/http_request.hpp"
+#include "http/request_body.hpp"
+#include "http/request_parser.hpp"
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/move/move.hpp>
+
+namespace
+{
+	//Feeds the encoded body to the parser in pieces of the given size as
+	//if they were received one after another. Returns the decoded body or
+	//"bad" or "too large".
+	std::string decode(tempest::body_parser &parser, std::string const &encoded, std::size_t step)
+	{
+		std::string decoded;
+		std::string buffer;
+		std::size_t fed = 0;
+		for (;;)
+		{
+			boost::string_ref piece;
+			tempest::body_result const result = parser.parse(buffer.data(), buffer.size(), piece);
+			if (result == tempest::body_piece)
+			{
+				decoded.append(piece.begin(), piece.end());
+			}
+			buffer.erase(0, parser.consumed());
+			switch (result)
+			{
+			case tempest::body_piece:
+				break;
+
+			case tempest::body_incomplete:
+				if (fed == encoded.size())
+				{
+					return "incomplete";
+				}
+				buffer.append(encoded, fed, step);
+				fed = (std::min)(encoded.size(), fed + step);
+				break;
+
+			case tempest::body_complete:
+				//the rest belongs to the next request
+				return decoded + "|" + buffer + encoded.substr(fed);
+
+			case tempest::body_bad_request:
+				return "bad";
+
+			case tempest::body_too_large:
+				return "too large";
+			}
+		}
+	}
+
+	//Answers with the body of the request or with "no body". The client
+	//is fed more of the body when the directory has to wait for it.
+	struct body_echo : boost::enable_shared_from_this<body_echo>
+	{
+		body_echo(tempest::request_body &body,
+		          tempest::async_sender &sender,
+		          tempest::directory::response_handler handler,
+		          boost::function<void ()> const &on_wait)
+		    : m_body(body)
+		    , m_sender(sender)
+		    , m_handler(boost::move(handler))
+		    , m_on_wait(on_wait)
+		{
+		}
+
+		void read(boost::system::error_code error)
+		{
+			if (error)
+			{
+				return m_handler(error);
+			}
+			for (;;)
+			{
+				boost::string_ref piece;
+				switch (m_body.read(piece))
+				{
+				case tempest::body_piece:
+					m_received.append(piece.begin(), piece.end());
+					break;
+
+				case tempest::body_incomplete:
+					m_body.async_wait(boost::bind(&body_echo::read, shared_from_this(), _1));
+					if (m_on_wait)
+					{
+						m_on_wait();
+					}
+					return;
+
+				case tempest::body_complete:
+					return respond(m_received, m_sender, m_handler);
+
+				case tempest::body_bad_request:
+				case tempest::body_too_large:
+					return m_handler(boost::system::errc::make_error_code(boost::system::errc::bad_message));
+				}
+			}
+		}
+
+		static void respond(std::string const &body,
+		                    tempest::async_sender &sender,
+		                    tempest::directory::response_handler handler)
+		{
+			tempest::in_memory_response response;
+			response.body = body;
+			response.header = "HTTP/1.1 200 OK\r\nContent-Length: " +
+			                  boost::lexical_cast<std::string>(body.size()) + "\r\n";
+			tempest::async_send_in_memory_response(response, sender, boost::move(handler));
+		}
+
+	private:
+
+		tempest::request_body &m_body;
+		tempest::async_sender &m_sender;
+		tempest::directory::response_handler const m_handler;
+		boost::function<void ()> const m_on_wait;
+		std::string m_received;
+	};
+
+	struct body_directory : tempest::directory
+	{
+		bool reads_bodies;
+		boost::function<void ()> on_wait;
+
+		body_directory()
+		    : reads_bodies(true)
+		{
+		}
+
+		virtual void respond(tempest::http_request const &,
+		                     boost::string_ref,
+		                     tempest::sender &) TEMPEST_OVERRIDE
+		{
+			BOOST_FAIL("only async_respond is expected");
+		}
+
+		virtual void async_respond(tempest::http_request const &request,
+		                           boost::string_ref sub_path,
+		                           tempest::async_sender &sender,
+		                           response_handler handler) TEMPEST_OVERRIDE
+		{
+			if (!request.body || !reads_bodies)
+			{
+				return body_echo::respond("no body for " + sub_path.to_string(), sender,
+				                          boost::move(handler));
+			}
+			boost::make_shared<body_echo>(boost::ref(*request.body), boost::ref(sender),
+			                              boost::move(handler), on_wait)
+			        ->read(boost::system::error_code());
+		}
+	};
+
+	std::string serve(boost::shared_ptr<tempest::memory_client> const &client,
+	                  boost::shared_ptr<body_directory> const &directory,
+	                  tempest::server_options const &options = tempest::server_options())
+	{
+		tempest::serve_client(client, directory, options);
+		client->poll();
+		return std::string(client->output().begin(), client->output().end());
+	}
+
+	//the framing of a POST request with the given header lines
+	tempest::body_framing framing(std::string const &headers, boost::uint64_t &length)
+	{
+		std::string const head = "POST / HTTP/1.1\r\n" + headers + "\r\n";
+		tempest::request_parser parser;
+		BOOST_REQUIRE_EQUAL(parser.parse(head.data(), head.size()), tempest::parse_complete);
+		return tempest::find_body_framing(parser.request(), length);
+	}
+
+	std::size_t count(std::string const &text, std::string const &found)
+	{
+		std::size_t counted = 0;
+		for (std::size_t i = text.find(found); i != std::string::npos; i = text.find(found, i + 1))
+		{
+			++counted;
+		}
+		return counted;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(body_parser_resumes_at_any_byte)
+{
+	std::string const chunked = "5\r\nhello\r\n6;name=value\r\n world\r\n0\r\nTrailer: x\r\n\r\nGET";
+	for (std::size_t step = 1; step <= chunked.size(); ++step)
+	{
+		tempest::body_parser parser;
+		parser.start_chunked(100);
+		BOOST_CHECK_EQUAL(decode(parser, chunked, step), "hello world|GET");
+		BOOST_CHECK(parser.is_complete());
+
+		parser.start_length(5);
+		BOOST_CHECK_EQUAL(decode(parser, "hello world", step), "hello| world");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(body_parser_rejects_invalid_chunks)
+{
+	tempest::body_parser parser;
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "x\r\n", 100), "bad");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "5 x\r\nhello\r\n0\r\n\r\n", 100), "bad");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "5\r\nhelloXX0\r\n\r\n", 100), "bad");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n", 100), "too large");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "fffffffffffffffffff\r\n", 100), "too large");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, std::string(tempest::body_parser::max_line_length + 1, '0'), 100), "bad");
+	parser.start_chunked(10);
+	BOOST_CHECK_EQUAL(decode(parser, "5\r\nhel", 100), "incomplete");
+}
+
+BOOST_AUTO_TEST_CASE(body_framing_is_found_in_the_headers)
+{
+	boost::uint64_t length = 0;
+	BOOST_CHECK_EQUAL(framing("", length), tempest::no_body);
+	BOOST_CHECK_EQUAL(framing("Content-Length: 0\r\n", length), tempest::no_body);
+	BOOST_CHECK_EQUAL(framing("Content-Length:  12 \r\n", length), tempest::length_framing);
+	BOOST_CHECK_EQUAL(length, 12u);
+	BOOST_CHECK_EQUAL(framing("Content-Length: -1\r\n", length), tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("Content-Length: 99999999999999999999\r\n", length), tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("transfer-encoding: Chunked\r\n", length), tempest::chunked_framing);
+	BOOST_CHECK_EQUAL(framing("Transfer-Encoding: gzip, chunked\r\n", length), tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("Transfer-Encoding: chunked\r\nContent-Length: 5\r\n", length),
+	                  tempest::invalid_framing);
+}
+
+BOOST_AUTO_TEST_CASE(body_framing_sees_every_copy_of_a_header)
+{
+	boost::uint64_t length = 0;
+	BOOST_CHECK_EQUAL(framing("Content-Length: 5\r\nContent-Length: 5\r\n", length),
+	                  tempest::length_framing);
+	BOOST_CHECK_EQUAL(length, 5u);
+	BOOST_CHECK_EQUAL(framing("Content-Length: 5\r\nContent-Length: 100\r\n", length),
+	                  tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("content-length: 100\r\nContent-Length: 5\r\n", length),
+	                  tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("Transfer-Encoding: chunked\r\ntransfer-encoding: identity\r\n", length),
+	                  tempest::invalid_framing);
+	BOOST_CHECK_EQUAL(framing("Transfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n", length),
+	                  tempest::invalid_framing);
+}
+
+BOOST_AUTO_TEST_CASE(repeated_framing_headers_are_rejected)
+{
+	char const * const heads[] =
+	{
+		"POST /a HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 100\r\n\r\n",
+		"POST /a HTTP/1.1\r\ncontent-length: 100\r\nContent-Length: 5\r\n\r\n",
+		"POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\ntransfer-encoding: identity\r\n\r\n"
+	};
+	BOOST_FOREACH (char const *head, heads)
+	{
+		boost::shared_ptr<tempest::memory_client> const client = boost::make_shared<tempest::memory_client>();
+		client->feed(std::string(head) + "hello0\r\n\r\nGET /hidden HTTP/1.1\r\n\r\n");
+		std::string const output = serve(client, boost::make_shared<body_directory>());
+		BOOST_CHECK_EQUAL(output.substr(0, 12), "HTTP/1.1 400");
+		BOOST_CHECK(output.find("/hidden") == std::string::npos);
+		BOOST_CHECK(client->is_shut_down());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(request_bodies_are_read_from_the_connection)
+{
+	boost::shared_ptr<tempest::memory_client> const client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+	             "POST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+	             "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"
+	             "GET /c HTTP/1.1\r\n\r\n");
+	std::string const output = serve(client, boost::make_shared<body_directory>());
+	BOOST_CHECK_EQUAL(count(output, "HTTP/1.1 200 OK"), 3u);
+	BOOST_CHECK(output.find("Content-Length: 5\r\nConnection: keep-alive\r\n\r\nhello") != std::string::npos);
+	BOOST_CHECK(output.find("\r\n\r\nhello world") != std::string::npos);
+	BOOST_CHECK(output.find("\r\n\r\nno body for /c") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(unread_request_bodies_are_skipped)
+{
+	boost::shared_ptr<tempest::memory_client> const client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nContent-Length: 20\r\n\r\nGET /hidden HTTP/1.1"
+	             "POST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+	             "14\r\nGET /hidden HTTP/1.1\r\n0\r\n\r\n"
+	             "GET /c HTTP/1.1\r\n\r\n");
+	boost::shared_ptr<body_directory> const directory = boost::make_shared<body_directory>();
+	directory->reads_bodies = false;
+	std::string const output = serve(client, directory);
+	BOOST_CHECK_EQUAL(count(output, "HTTP/1.1 200 OK"), 3u);
+	BOOST_CHECK(output.find("no body for /c") != std::string::npos);
+	BOOST_CHECK(output.find("/hidden") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(request_bodies_are_limited)
+{
+	tempest::server_options options;
+	options.max_body_size = 4;
+
+	boost::shared_ptr<tempest::memory_client> client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello");
+	std::string output = serve(client, boost::make_shared<body_directory>(), options);
+	BOOST_CHECK_EQUAL(output.substr(0, 12), "HTTP/1.1 413");
+	BOOST_CHECK(client->is_shut_down());
+
+	client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n");
+	output = serve(client, boost::make_shared<body_directory>(), options);
+	BOOST_CHECK(output.empty());
+	BOOST_CHECK(client->is_shut_down());
+
+	client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\nhello");
+	output = serve(client, boost::make_shared<body_directory>(), options);
+	BOOST_CHECK_EQUAL(output.substr(0, 12), "HTTP/1.1 400");
+}
+
+BOOST_AUTO_TEST_CASE(request_bodies_are_asked_for_with_100_continue)
+{
+	boost::shared_ptr<tempest::memory_client> client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nContent-Length: 5\r\nExpect: 100-continue\r\n\r\n");
+	boost::shared_ptr<body_directory> const directory = boost::make_shared<body_directory>();
+	directory->on_wait = boost::bind(
+	    static_cast<void (tempest::memory_client::*)(std::string const &)>(&tempest::memory_client::feed),
+	    client.get(), "hello");
+	std::string output = serve(client, directory);
+	BOOST_CHECK_EQUAL(output.substr(0, 46), "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nCont");
+	BOOST_CHECK(output.find("Connection: keep-alive\r\n\r\nhello") != std::string::npos);
+
+	//a client which sends the body anyway is not asked for it, and it is
+	//not known whether it would have sent it
+	client = boost::make_shared<tempest::memory_client>();
+	client->feed("POST /a HTTP/1.1\r\nContent-Length: 5\r\nExpect: 100-continue\r\n\r\nhello");
+	output = serve(client, boost::make_shared<body_directory>());
+	BOOST_CHECK_EQUAL(output.substr(0, 15), "HTTP/1.1 200 OK");
+	BOOST_CHECK(output.find("Connection: close\r\n\r\nhello") != std::string::npos);
+}
@@ -0,0 +1,222 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/content_type.hpp"
+#include "tempest/responses.hpp"
+#include "http/http_request.hpp"
+#include <boost/lexical_cast.hpp>
+
+namespace
+{
+	tempest::file_validators make_validators()
+	{
+		tempest::file_validators validators;
+		validators.etag = tempest::make_entity_tag(0x1a, 0, 0x2b, 100);
+		validators.modified_seconds = 0;
+		return validators;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(responses_content_type)
+{
+	BOOST_CHECK_EQUAL(tempest::find_content_type("/www/index.HTML"), "text/html; charset=utf-8");
+	BOOST_CHECK_EQUAL(tempest::find_content_type("a.b/style.css"), "text/css; charset=utf-8");
+	BOOST_CHECK_EQUAL(tempest::find_content_type("font.woff2"), "font/woff2");
+	BOOST_CHECK_EQUAL(tempest::find_content_type("a.png/README"), "application/octet-stream");
+	BOOST_CHECK_EQUAL(tempest::find_content_type("archive.unknown"), "application/octet-stream");
+	BOOST_CHECK_EQUAL(tempest::find_content_type("Makefile"), "application/octet-stream");
+}
+
+BOOST_AUTO_TEST_CASE(responses_file_header_block)
+{
+	std::string header;
+	tempest::write_file_header_block(header, "/www/a.txt", 3, make_validators());
+	BOOST_CHECK_EQUAL(header,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Content-Length: 3\r\n"
+	                  "Content-Type: text/plain; charset=utf-8\r\n"
+	                  "Accept-Ranges: bytes\r\n"
+	                  "Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+	                  "ETag: \"1a-0.2b-64\"\r\n"
+	                  );
+}
+
+BOOST_AUTO_TEST_CASE(responses_not_found)
+{
+	tempest::in_memory_response const response = tempest::make_not_found_response("/a");
+	BOOST_CHECK_EQUAL(response.body, "<h2>The requested file could not be found</h2><p>/a</p>");
+	BOOST_CHECK_EQUAL(response.header,
+	                  "HTTP/1.1 404 Not Found\r\n"
+	                  "Content-Length: 55\r\n"
+	                  "Content-Type: text/html\r\n"
+	                  );
+}
+
+BOOST_AUTO_TEST_CASE(responses_preferred_codings)
+{
+	tempest::http_request request;
+	tempest::content_coding codings[3];
+	BOOST_REQUIRE_EQUAL(tempest::preferred_codings(request, codings), 1u);
+	BOOST_CHECK_EQUAL(codings[0], tempest::identity_coding);
+
+	request.headers["Accept-Encoding"] = "gzip, deflate, br";
+	BOOST_REQUIRE_EQUAL(tempest::preferred_codings(request, codings), 3u);
+	BOOST_CHECK_EQUAL(codings[0], tempest::brotli_coding);
+	BOOST_CHECK_EQUAL(codings[1], tempest::gzip_coding);
+	BOOST_CHECK_EQUAL(codings[2], tempest::identity_coding);
+
+	std::string header;
+	tempest::write_file_header_block(header, "/www/site.css", 10, make_validators(), codings[1]);
+	BOOST_CHECK_EQUAL(header,
+	                  "HTTP/1.1 200 OK\r\n"
+	                  "Content-Length: 10\r\n"
+	                  "Content-Type: text/css; charset=utf-8\r\n"
+	                  "Accept-Ranges: bytes\r\n"
+	                  "Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+	                  "ETag: \"1a-0.2b-64\"\r\n"
+	                  "Content-Encoding: gzip\r\n"
+	                  "Vary: Accept-Encoding\r\n"
+	                  );
+}
+
+BOOST_AUTO_TEST_CASE(responses_partial_single_range)
+{
+	tempest::http_request request;
+	request.method = "GET";
+	tempest::partial_response partial;
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_CHECK(partial.pieces.empty());
+
+	request.headers["Range"] = "bytes=10-19";
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_REQUIRE_EQUAL(partial.pieces.size(), 1u);
+	BOOST_CHECK(partial.pieces[0].is_file);
+	BOOST_CHECK_EQUAL(partial.pieces[0].offset, 10u);
+	BOOST_CHECK_EQUAL(partial.pieces[0].length, 10u);
+	BOOST_CHECK_EQUAL(partial.header,
+	                  "HTTP/1.1 206 Partial Content\r\n"
+	                  "Content-Length: 10\r\n"
+	                  "Content-Type: text/plain; charset=utf-8\r\n"
+	                  "Content-Range: bytes 10-19/100\r\n"
+	                  "Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+	                  "ETag: \"1a-0.2b-64\"\r\n"
+	                  );
+
+	request.headers["If-Range"] = "\"1a-0.2b-64\"";
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_CHECK_EQUAL(partial.pieces.size(), 1u);
+
+	//the file has changed since the client got the first part
+	request.headers["If-Range"] = "Fri, 02 Jan 1970 00:00:00 GMT";
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_CHECK(partial.pieces.empty());
+
+	//weak tags are not sufficient for ranges
+	request.headers["If-Range"] = "W/\"1a-0.2b-64\"";
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_CHECK(partial.pieces.empty());
+}
+
+BOOST_AUTO_TEST_CASE(responses_partial_multiple_ranges)
+{
+	tempest::http_request request;
+	request.method = "GET";
+	request.headers["Range"] = "bytes=0-0,-2";
+	tempest::partial_response partial;
+	BOOST_CHECK(!tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                            tempest::identity_coding, partial));
+	BOOST_REQUIRE_EQUAL(partial.pieces.size(), 5u);
+
+	tempest::file_size body_size = 0;
+	std::string body;
+	for (std::size_t i = 0; i < partial.pieces.size(); ++i)
+	{
+		tempest::body_piece const &piece = partial.pieces[i];
+		body_size += piece.length;
+		body += piece.is_file
+		        ? std::string(piece.length, 'x')
+		        : partial.framing.substr(piece.offset, piece.length);
+	}
+	BOOST_CHECK(partial.header.find("Content-Length: " +
+	                                boost::lexical_cast<std::string>(body_size) + "\r\n") !=
+	            std::string::npos);
+
+	std::string const boundary_parameter = "boundary=";
+	std::size_t const boundary_begin = partial.header.find(boundary_parameter);
+	BOOST_REQUIRE(boundary_begin != std::string::npos);
+	std::string const boundary = partial.header.substr(
+	            boundary_begin + boundary_parameter.size(),
+	            partial.header.find("\r\n", boundary_begin) - boundary_begin - boundary_parameter.size());
+	BOOST_CHECK_EQUAL(body,
+	                  "--" + boundary + "\r\n"
+	                  "Content-Type: text/plain; charset=utf-8\r\n"
+	                  "Content-Range: bytes 0-0/100\r\n"
+	                  "\r\n"
+	                  "x\r\n"
+	                  "--" + boundary + "\r\n"
+	                  "Content-Type: text/plain; charset=utf-8\r\n"
+	                  "Content-Range: bytes 98-99/100\r\n"
+	                  "\r\n"
+	                  "xx\r\n"
+	                  "--" + boundary + "--\r\n");
+}
+
+BOOST_AUTO_TEST_CASE(responses_range_not_satisfiable)
+{
+	tempest::http_request request;
+	request.method = "GET";
+	request.headers["Range"] = "bytes=100-";
+	tempest::partial_response partial;
+	boost::optional<tempest::in_memory_response> const error =
+	        tempest::plan_partial_response(request, "a.txt", 100, make_validators(),
+	                                       tempest::identity_coding, partial);
+	BOOST_REQUIRE(error);
+	BOOST_CHECK_EQUAL(error->header,
+	                  "HTTP/1.1 416 Range Not Satisfiable\r\n"
+	                  "Content-Length: 0\r\n"
+	                  "Content-Range: bytes */100\r\n"
+	                  );
+}
+
+BOOST_AUTO_TEST_CASE(responses_not_modified)
+{
+	tempest::file_validators validators = make_validators();
+	validators.modified_seconds = 784111777;
+
+	tempest::http_request request;
+	request.method = "GET";
+	BOOST_CHECK(!tempest::is_conditional(request));
+	BOOST_CHECK(!tempest::is_not_modified(request, validators));
+
+	request.headers["If-None-Match"] = "\"other\", W/\"1a-0.2b-64\"";
+	BOOST_CHECK(tempest::is_conditional(request));
+	BOOST_CHECK(tempest::is_not_modified(request, validators));
+
+	request.headers["If-None-Match"] = "*";
+	BOOST_CHECK(tempest::is_not_modified(request, validators));
+
+	//If-Modified-Since is ignored when there is If-None-Match
+	request.headers["If-None-Match"] = "\"other\"";
+	request.headers["If-Modified-Since"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+	BOOST_CHECK(!tempest::is_not_modified(request, validators));
+
+	request.headers.erase("If-None-Match");
+	BOOST_CHECK(tempest::is_not_modified(request, validators));
+	request.headers["If-Modified-Since"] = "Sun, 06 Nov 1994 08:49:36 GMT";
+	BOOST_CHECK(!tempest::is_not_modified(request, validators));
+	request.headers["If-Modified-Since"] = "Sunday, 06-Nov-94 08:49:37 GMT";
+	BOOST_CHECK(!tempest::is_not_modified(request, validators));
+
+	std::string header;
+	tempest::write_not_modified_header_block(header, validators, tempest::gzip_coding);
+	BOOST_CHECK_EQUAL(header,
+	                  "HTTP/1.1 304 Not Modified\r\n"
+	                  "Last-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+	                  "ETag: \"1a-0.2b-64\"\r\n"
+	                  "Content-Encoding: gzip\r\n"
+	                  "Vary: Accept-Encoding\r\n"
+	                  );
+}
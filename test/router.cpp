@@ -0,0 +1,145 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/router.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/responses.hpp"
+#include "tempest/server.hpp"
+#include "http/http_request.hpp"
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+namespace
+{
+	//answers with its name and the path it gets
+	struct echo_directory : tempest::directory
+	{
+		explicit echo_directory(std::string name)
+		    : m_name(name)
+		{
+		}
+
+		virtual void respond(tempest::http_request const &,
+		                     boost::string_ref sub_path,
+		                     tempest::sender &sender) TEMPEST_OVERRIDE
+		{
+			tempest::in_memory_response response;
+			response.body = m_name + ":" + sub_path.to_string();
+			response.header = "HTTP/1.1 200 OK\r\nContent-Length: " +
+			                  boost::lexical_cast<std::string>(response.body.size()) + "\r\n";
+			tempest::send_in_memory_response(response, sender);
+		}
+
+	private:
+
+		std::string const m_name;
+	};
+
+	boost::shared_ptr<tempest::directory> echo(std::string const &name)
+	{
+		return boost::make_shared<echo_directory>(name);
+	}
+
+	//the name of the directory found and the rest of the path
+	std::string route(tempest::route_table const &table,
+	                  boost::string_ref host,
+	                  boost::string_ref path)
+	{
+		boost::string_ref rest;
+		echo_directory * const found = static_cast<echo_directory *>(table.find(host, path, rest));
+		if (!found)
+		{
+			return "none";
+		}
+		tempest::http_request request;
+		boost::shared_ptr<tempest::memory_client> const client =
+		        boost::make_shared<tempest::memory_client>();
+		found->respond(request, rest, client->get_sender());
+		std::string const output(client->output().begin(), client->output().end());
+		return output.substr(output.find("\r\n\r\n") + 4);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(route_table_matches_exact_and_longest_prefix)
+{
+	tempest::route_table table;
+	BOOST_CHECK_EQUAL(route(table, "", "/"), "none");
+
+	table.add("", "/", tempest::prefix_match, echo("root"));
+	table.add("", "/", tempest::exact_match, echo("index"));
+	table.add("", "/static", tempest::prefix_match, echo("static"));
+	table.add("", "/static/css/site.css", tempest::exact_match, echo("css"));
+	table.add("", "/api/v1", tempest::prefix_match, echo("v1"));
+	table.add("", "/api/v1/", tempest::exact_match, echo("v1-slash"));
+	BOOST_CHECK_EQUAL(table.size(), 6u);
+
+	BOOST_CHECK_EQUAL(route(table, "", "/"), "index:");
+	BOOST_CHECK_EQUAL(route(table, "", "/?page=2"), "index:?page=2");
+	BOOST_CHECK_EQUAL(route(table, "", "/about"), "root:/about");
+	BOOST_CHECK_EQUAL(route(table, "", "/static"), "static:");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/"), "static:/");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/img/a.png"), "static:/img/a.png");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/css/site.css"), "css:");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/css/site.css?v=3"), "css:?v=3");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/css/other.css"), "static:/css/other.css");
+	BOOST_CHECK_EQUAL(route(table, "", "/static/css/site.css/x"), "static:/css/site.css/x");
+	BOOST_CHECK_EQUAL(route(table, "", "/api"), "root:/api");
+	BOOST_CHECK_EQUAL(route(table, "", "/api/v1/users?id=1"), "v1:/users?id=1");
+	BOOST_CHECK_EQUAL(route(table, "", "/api/v1/"), "v1-slash:");
+	BOOST_CHECK_EQUAL(route(table, "", "/staticx"), "root:/staticx");
+
+	//a later route replaces an earlier one
+	table.add("", "/static", tempest::prefix_match, echo("assets"));
+	BOOST_CHECK_EQUAL(table.size(), 6u);
+	BOOST_CHECK_EQUAL(route(table, "", "/static/a"), "assets:/a");
+}
+
+BOOST_AUTO_TEST_CASE(route_table_routes_hosts)
+{
+	tempest::route_table table;
+	table.add("example.com", "/", tempest::prefix_match, echo("example"));
+	table.add("Blog.Example.com", "/", tempest::prefix_match, echo("blog"));
+	table.add("[::1]", "/", tempest::prefix_match, echo("ipv6"));
+
+	//without a default host only the known hosts are served
+	BOOST_CHECK_EQUAL(route(table, "", "/a"), "none");
+	BOOST_CHECK_EQUAL(route(table, "other.org", "/a"), "none");
+
+	table.add("", "/", tempest::prefix_match, echo("default"));
+	BOOST_CHECK_EQUAL(route(table, "example.com", "/a"), "example:/a");
+	BOOST_CHECK_EQUAL(route(table, "EXAMPLE.com:8080", "/a"), "example:/a");
+	BOOST_CHECK_EQUAL(route(table, "blog.example.com", "/a"), "blog:/a");
+	BOOST_CHECK_EQUAL(route(table, "[::1]:8080", "/a"), "ipv6:/a");
+	BOOST_CHECK_EQUAL(route(table, "other.org", "/a"), "default:/a");
+	BOOST_CHECK_EQUAL(route(table, "", "/a"), "default:/a");
+	BOOST_CHECK_EQUAL(route(table, std::string(300, 'x'), "/a"), "default:/a");
+}
+
+BOOST_AUTO_TEST_CASE(router_dispatches_and_replaces_its_table)
+{
+	boost::shared_ptr<tempest::route_table> const first = boost::make_shared<tempest::route_table>();
+	first->add("", "/", tempest::prefix_match, echo("first"));
+	first->add("example.com", "/static", tempest::prefix_match, echo("static"));
+	boost::shared_ptr<tempest::router> const router = boost::make_shared<tempest::router>(first);
+
+	boost::shared_ptr<tempest::memory_client> client = boost::make_shared<tempest::memory_client>();
+	client->feed("GET /static/a.css HTTP/1.1\r\nHost: example.com\r\n\r\n"
+	             "GET /static/a.css HTTP/1.1\r\nHost: other.org\r\n\r\n");
+	tempest::serve_client(client, router, tempest::server_options());
+	client->poll();
+	std::string output(client->output().begin(), client->output().end());
+	BOOST_CHECK(output.find("static:/a.css") != std::string::npos);
+	BOOST_CHECK(output.find("first:/static/a.css") != std::string::npos);
+
+	boost::shared_ptr<tempest::route_table> const second = boost::make_shared<tempest::route_table>();
+	second->add("", "/static", tempest::exact_match, echo("second"));
+	router->replace(second);
+	BOOST_CHECK(router->table() == second);
+
+	client = boost::make_shared<tempest::memory_client>();
+	client->feed("GET /static HTTP/1.1\r\nHost: example.com\r\n\r\n"
+	             "GET /missing HTTP/1.1\r\nHost: example.com\r\n\r\n");
+	tempest::serve_client(client, router, tempest::server_options());
+	client->poll();
+	output.assign(client->output().begin(), client->output().end());
+	BOOST_CHECK(output.find("second:") != std::string::npos);
+	BOOST_CHECK(output.find("HTTP/1.1 404") != std::string::npos);
+}
@@ -0,0 +1,199 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/timer_wheel.hpp"
+#include "tempest/memory_client.hpp"
+#include "tempest/metrics.hpp"
+#include "tempest/portable_fs_directory.hpp"
+#include "tempest/server.hpp"
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+	typedef tempest::timer_wheel::clock clock;
+
+	bool count_expiry(unsigned *expired, bool restart)
+	{
+		++*expired;
+		return restart;
+	}
+
+	//would dead-lock if the handlers were called with the wheel locked
+	bool start_other(tempest::timer_wheel *wheel, tempest::wheel_timer *other)
+	{
+		BOOST_CHECK_EQUAL(wheel->size(), 0u);
+		other->start(boost::chrono::milliseconds(10));
+		return false;
+	}
+
+	void start_on_this_thread(tempest::timer_wheel *wheel,
+	                          boost::ptr_vector<tempest::wheel_timer> *timers,
+	                          unsigned *expired,
+	                          clock::time_point start)
+	{
+		for (unsigned i = 0; i < 100; ++i)
+		{
+			timers->push_back(new tempest::wheel_timer(wheel, boost::bind(count_expiry, expired, false)));
+			timers->back().start(boost::chrono::milliseconds(1 + (i % 10)), start);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_expires_at_the_next_tick)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(10), 8, start);
+	unsigned expired = 0;
+	tempest::wheel_timer timer(&wheel, boost::bind(count_expiry, &expired, false));
+
+	//25 ms are rounded up to the third tick
+	timer.start(boost::chrono::milliseconds(25), start);
+	BOOST_CHECK_EQUAL(wheel.size(), 1u);
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(29)), 0u);
+	BOOST_CHECK_EQUAL(expired, 0u);
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(30)), 1u);
+	BOOST_CHECK_EQUAL(expired, 1u);
+	BOOST_CHECK_EQUAL(wheel.size(), 0u);
+
+	//a stopped or restarted timer does not expire at the old time
+	timer.start(boost::chrono::milliseconds(10), start + boost::chrono::milliseconds(30));
+	timer.stop();
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(50)), 0u);
+	timer.start(boost::chrono::milliseconds(10), start + boost::chrono::milliseconds(50));
+	timer.start(boost::chrono::milliseconds(30), start + boost::chrono::milliseconds(50));
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(70)), 0u);
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(80)), 1u);
+	BOOST_CHECK_EQUAL(expired, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_survives_several_turns)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(1), 4, start);
+	unsigned expired = 0;
+	tempest::wheel_timer near(&wheel, boost::bind(count_expiry, &expired, false));
+	tempest::wheel_timer far(&wheel, boost::bind(count_expiry, &expired, false));
+
+	//both share a slot, but far has to wait for three more turns
+	near.start(boost::chrono::milliseconds(2), start);
+	far.start(boost::chrono::milliseconds(14), start);
+	for (unsigned ms = 1; ms <= 13; ++ms)
+	{
+		wheel.advance(start + boost::chrono::milliseconds(ms));
+		BOOST_CHECK_EQUAL(expired, (ms >= 2) ? 1u : 0u);
+	}
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(14)), 1u);
+
+	//a late advance visits every slot once
+	near.start(boost::chrono::milliseconds(1), start + boost::chrono::milliseconds(14));
+	far.start(boost::chrono::milliseconds(3), start + boost::chrono::milliseconds(14));
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(1000)), 2u);
+	BOOST_CHECK_EQUAL(expired, 4u);
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_restarts_from_the_handler)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(10), 16, start);
+	unsigned expired = 0;
+	tempest::wheel_timer timer(&wheel, boost::bind(count_expiry, &expired, true));
+	timer.start(boost::chrono::milliseconds(20), start);
+	for (unsigned ms = 10; ms <= 100; ms += 10)
+	{
+		wheel.advance(start + boost::chrono::milliseconds(ms));
+	}
+	BOOST_CHECK_EQUAL(expired, 5u);
+	BOOST_CHECK_EQUAL(wheel.size(), 1u);
+	timer.stop();
+	BOOST_CHECK_EQUAL(wheel.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_many_timers)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(1), 256, start);
+	unsigned expired = 0;
+	boost::ptr_vector<tempest::wheel_timer> timers;
+	for (unsigned i = 0; i < 10000; ++i)
+	{
+		timers.push_back(new tempest::wheel_timer(&wheel, boost::bind(count_expiry, &expired, false)));
+		timers.back().start(boost::chrono::milliseconds(1 + (i % 1000)), start);
+	}
+	BOOST_CHECK_EQUAL(wheel.size(), 10000u);
+
+	//every millisecond ten timers expire
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(500)), 5000u);
+	for (unsigned i = 0; i < 10000; i += 2)
+	{
+		timers[i].stop();
+	}
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(1000)), 2500u);
+	BOOST_CHECK_EQUAL(expired, 7500u);
+	BOOST_CHECK_EQUAL(wheel.size(), 0u);
+
+	//a timer without a wheel never runs
+	tempest::wheel_timer idle(0, boost::bind(count_expiry, &expired, false));
+	idle.start(boost::chrono::milliseconds(1));
+	idle.stop();
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_handlers_may_use_the_wheel)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(10), 16, start);
+	unsigned expired = 0;
+	tempest::wheel_timer other(&wheel, boost::bind(count_expiry, &expired, false));
+	tempest::wheel_timer timer(&wheel, boost::bind(start_other, &wheel, &other));
+	timer.start(boost::chrono::milliseconds(10), start);
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(10)), 1u);
+	BOOST_CHECK_EQUAL(wheel.size(), 1u);
+	other.stop();
+	BOOST_CHECK_EQUAL(wheel.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_shards_the_timers_of_threads)
+{
+	clock::time_point const start = clock::now();
+	tempest::timer_wheel wheel(boost::chrono::milliseconds(1), 64, start, 4);
+	unsigned expired[4] = {};
+	boost::ptr_vector<tempest::wheel_timer> timers[4];
+	boost::thread_group threads;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		threads.create_thread(boost::bind(start_on_this_thread, &wheel, &timers[i], &expired[i], start));
+	}
+	threads.join_all();
+	BOOST_CHECK_EQUAL(wheel.size(), 400u);
+
+	//one advance goes through every shard
+	BOOST_CHECK_EQUAL(wheel.advance(start + boost::chrono::milliseconds(10)), 400u);
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		BOOST_CHECK_EQUAL(expired[i], 100u);
+	}
+	BOOST_CHECK_EQUAL(wheel.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(timer_wheel_shuts_clients_down_through_their_handlers)
+{
+	tempest::server_options options;
+	options.metrics = boost::make_shared<tempest::metrics>();
+	options.timers = boost::make_shared<tempest::timer_wheel>();
+	boost::shared_ptr<tempest::memory_client> const client =
+	        boost::make_shared<tempest::memory_client>();
+	tempest::serve_client(client,
+	                      boost::make_shared<tempest::portable::file_system_directory>(
+	                          boost::filesystem::temp_directory_path()),
+	                      options);
+
+	//the connection waits for its first request
+	BOOST_CHECK_EQUAL(options.timers->advance(clock::now() + boost::chrono::hours(1)), 1u);
+	BOOST_CHECK_EQUAL(options.metrics->snapshot().counters[tempest::idle_timeout_counter], 1u);
+	BOOST_CHECK(!client->is_shut_down());
+
+	client->poll();
+	BOOST_CHECK(client->is_shut_down());
+	BOOST_CHECK_EQUAL(options.timers->size(), 0u);
+}
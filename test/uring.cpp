@@ -0,0 +1,55 @@
+#include <boost/test/unit_test.hpp>
+#include "tempest/posix/uring.hpp"
+#include "tempest/posix/uring_server.hpp"
+
+#if TEMPEST_USE_IO_URING
+#include <unistd.h>
+
+BOOST_AUTO_TEST_CASE(uring_completes_submissions)
+{
+	//the kernel of the test machine may be too old
+	if (!tempest::posix::is_uring_available())
+	{
+		return;
+	}
+
+	tempest::posix::uring ring(4);
+	BOOST_CHECK_EQUAL(ring.free_sqes(), 4u);
+
+	int ends[2];
+	BOOST_REQUIRE_EQUAL(pipe(ends), 0);
+	BOOST_REQUIRE_EQUAL(write(ends[1], "abc", 3), 3);
+
+	io_uring_sqe * const nop = ring.get_sqe();
+	BOOST_REQUIRE(nop);
+	nop->opcode = IORING_OP_NOP;
+	nop->user_data = 1;
+
+	char buffer[8] = {};
+	io_uring_sqe * const read = ring.get_sqe();
+	BOOST_REQUIRE(read);
+	read->opcode = IORING_OP_READ;
+	read->fd = ends[0];
+	read->addr = reinterpret_cast<__u64>(buffer);
+	read->len = sizeof(buffer);
+	read->user_data = 2;
+	BOOST_CHECK_EQUAL(ring.free_sqes(), 2u);
+
+	ring.submit(2);
+	io_uring_cqe completion;
+	int results[3] = {-1, -1, -1};
+	while (ring.pop(completion))
+	{
+		BOOST_REQUIRE(completion.user_data < 3);
+		results[completion.user_data] = completion.res;
+	}
+	BOOST_CHECK_EQUAL(results[1], 0);
+	BOOST_CHECK_EQUAL(results[2], 3);
+	BOOST_CHECK_EQUAL(std::string(buffer), "abc");
+	BOOST_CHECK(!ring.pop(completion));
+	BOOST_CHECK_EQUAL(ring.free_sqes(), 4u);
+
+	close(ends[0]);
+	close(ends[1]);
+}
+#endif